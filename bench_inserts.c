@@ -0,0 +1,249 @@
+/* bench_inserts.c
+ *
+ * Rendimiento de las inserciones de p2-search: C conexiones (protocolo
+ * versión 2), cada una con D inserciones en vuelo, durante unos segundos,
+ * contra un servidor que ya está andando.
+ *   make bench-inserts ARGS="16 1 5"
+ *   ./bench_inserts [conexiones] [en_vuelo] [segundos]
+ *
+ * Imprime inserciones por segundo, latencias y los lotes del log según
+ * STATS (cuántas inserciones se llevó cada fdatasync). Para ver el efecto
+ * del commit en grupo el servidor se arranca con slowsync.so (slowsync.c),
+ * que le suma a cada fsync la demora de un disco sin caché. Inserta de
+ * verdad en el dataset: se corre sobre una copia.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <time.h>
+#include <netinet/in.h>
+#include "common.h"
+
+#define CMD_INSERT 2
+#define CMD_HELLO 12
+#define CMD_STATS 11
+
+#define MAX_DEPTH 64            // el server deja de leer una conexión con 64 en vuelo
+#define REPLY_SZ 8192
+
+typedef struct {
+    int k;
+    int sock;
+    uint32_t next_id;
+    uint32_t ids[MAX_DEPTH];    // en vuelo (0: libre) y cuándo se mandaron
+    double sent[MAX_DEPTH];
+    double *lat;
+    long n_lat, cap_lat;
+    long ok, failed;
+} Client;
+
+static int g_depth = 1;
+static volatile int g_stop = 0;
+static long g_pid;
+static char g_date[16];
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Conecta y negocia la versión 2 (HELLO va con el formato de la versión 1).
+static int connect_v2(void) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_PORT);
+    inet_pton(AF_INET, SERVER_IP, &addr.sin_addr);
+
+    uint32_t head[2] = { htonl(CMD_HELLO), htonl(1) };
+    uint32_t len;
+    char v;
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        writen(sock, head, sizeof(head)) != sizeof(head) || writen(sock, "2", 1) != 1 ||
+        readn(sock, &len, sizeof(len)) != sizeof(len) || ntohl(len) != 1 ||
+        readn(sock, &v, 1) != 1 || v != '2') {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Manda (cmd)(id)(len)(payload) con un solo write (en dos, Nagle demora el
+// payload hasta el ACK de la cabecera).
+static int send_request(int sock, int cmd, uint32_t id, const char *payload) {
+    uint32_t plen = (uint32_t)strlen(payload);
+    uint32_t head[3] = { htonl(cmd), htonl(id), htonl(plen) };
+    char msg[sizeof(head) + 1024];
+    if (plen > sizeof(msg) - sizeof(head)) return -1;
+    memcpy(msg, head, sizeof(head));
+    memcpy(msg + sizeof(head), payload, plen);
+    return writen(sock, msg, sizeof(head) + plen) == (ssize_t)(sizeof(head) + plen) ? 0 : -1;
+}
+
+// Lee una respuesta: deja su id en *id y el cuerpo (cortado a outsz) en out.
+static int read_reply(int sock, uint32_t *id, char *out, size_t outsz) {
+    uint32_t head[2];
+    if (readn(sock, head, sizeof(head)) != sizeof(head)) return -1;
+    *id = ntohl(head[0]);
+    uint32_t len = ntohl(head[1]), keep = len < outsz ? len : (uint32_t)outsz - 1;
+    if (readn(sock, out, keep) != (ssize_t)keep) return -1;
+    out[keep] = '\0';
+    char skip[512];
+    for (uint32_t left = len - keep; left > 0; ) {
+        size_t n = left < sizeof(skip) ? left : sizeof(skip);
+        if (readn(sock, skip, n) != (ssize_t)n) return -1;
+        left -= (uint32_t)n;
+    }
+    return 0;
+}
+
+// Un registro nuevo en cada llamada (único también entre corridas).
+static int send_insert(Client *c, int slot) {
+    uint32_t id = ++c->next_id;
+    char line[512];
+    snprintf(line, sizeof(line),
+             "\"bi%ld.%d.%u\",\"S\",\"A\",\"Bench %ld %d %u\",\"abs\",\"cs.ZZ\",\"\",\"\",\"10.8888/bi%ld.%d.%u\",\"\",\"cc-by\",\"%s\",\"1\",\"x\"",
+             g_pid, c->k, id, g_pid, c->k, id, g_pid, c->k, id, g_date);
+    c->ids[slot] = id;
+    c->sent[slot] = now();
+    return send_request(c->sock, CMD_INSERT, id, line);
+}
+
+static void lat_add(Client *c, double secs) {
+    if (c->n_lat == c->cap_lat) {
+        long cap = c->cap_lat ? c->cap_lat * 2 : 1024;
+        double *v = realloc(c->lat, sizeof(double) * cap);
+        if (!v) return;
+        c->lat = v;
+        c->cap_lat = cap;
+    }
+    c->lat[c->n_lat++] = secs;
+}
+
+static void *client(void *arg) {
+    Client *c = arg;
+    int inflight = 0;
+    for (; inflight < g_depth; inflight++)
+        if (send_insert(c, inflight) != 0) goto fail;
+
+    char reply[64];
+    while (inflight > 0) {
+        uint32_t id;
+        if (read_reply(c->sock, &id, reply, sizeof(reply)) != 0) goto fail;
+        int slot = 0;
+        while (slot < g_depth && c->ids[slot] != id) slot++;
+        if (slot == g_depth) {
+            fprintf(stderr, "bench_inserts: respuesta con id %u que no se pidió\n", id);
+            goto fail;
+        }
+        lat_add(c, now() - c->sent[slot]);
+        c->ids[slot] = 0;
+        inflight--;
+        if (strcmp(reply, "OK") == 0) c->ok++;
+        else c->failed++;
+        if (!g_stop) {
+            if (send_insert(c, slot) != 0) goto fail;
+            inflight++;
+        }
+    }
+    return NULL;
+
+fail:
+    perror("bench_inserts: se cortó la conexión");
+    c->failed += inflight;
+    return NULL;
+}
+
+// Lee de STATS los contadores del log.
+static int wal_stats(long *batches, long *batch_max) {
+    int sock = connect_v2();
+    char reply[REPLY_SZ];
+    uint32_t id;
+    if (sock < 0 || send_request(sock, CMD_STATS, 1, "") != 0 ||
+        read_reply(sock, &id, reply, sizeof(reply)) != 0) {
+        if (sock >= 0) close(sock);
+        return -1;
+    }
+    close(sock);
+    const char *p = strstr(reply, "wal_batches\t"), *q = strstr(reply, "wal_batch_max\t");
+    if (!p || !q) return -1;
+    *batches = atol(p + strlen("wal_batches\t"));
+    *batch_max = atol(q + strlen("wal_batch_max\t"));
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 16;
+    g_depth = argc > 2 ? atoi(argv[2]) : 1;
+    double secs = argc > 3 ? atof(argv[3]) : 5;
+    if (n <= 0 || g_depth <= 0 || g_depth > MAX_DEPTH || secs <= 0) {
+        fprintf(stderr, "uso: %s [conexiones] [en_vuelo (1..%d)] [segundos]\n", argv[0], MAX_DEPTH);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    g_pid = (long)getpid();
+    time_t t = time(NULL);
+    strftime(g_date, sizeof(g_date), "%Y-%m-%d", localtime(&t));
+
+    Client *cs = calloc(n, sizeof(Client));
+    pthread_t *th = calloc(n, sizeof(pthread_t));
+    if (!cs || !th) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < n; i++) {
+        cs[i].k = i;
+        cs[i].sock = connect_v2();
+        if (cs[i].sock < 0) {
+            perror("bench_inserts: no se pudo conectar con el servidor");
+            return 1;
+        }
+    }
+    long batches0 = 0, batches1 = 0, batch_max = 0;
+    int have_stats = wal_stats(&batches0, &batch_max) == 0;
+
+    double t0 = now();
+    for (int i = 0; i < n; i++) pthread_create(&th[i], NULL, client, &cs[i]);
+    struct timespec d = { (time_t)secs, (long)((secs - (time_t)secs) * 1e9) };
+    nanosleep(&d, NULL);
+    g_stop = 1;
+    for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+    double elapsed = now() - t0;
+    have_stats = have_stats && wal_stats(&batches1, &batch_max) == 0;
+
+    long ok = 0, failed = 0, n_lat = 0;
+    for (int i = 0; i < n; i++) {
+        ok += cs[i].ok;
+        failed += cs[i].failed;
+        n_lat += cs[i].n_lat;
+    }
+    double *lat = malloc(sizeof(double) * (n_lat ? n_lat : 1));
+    long at = 0;
+    for (int i = 0; i < n; i++) {
+        if (lat) memcpy(lat + at, cs[i].lat, sizeof(double) * cs[i].n_lat);
+        at += cs[i].n_lat;
+        free(cs[i].lat);
+        close(cs[i].sock);
+    }
+    if (lat) qsort(lat, n_lat, sizeof(double), cmp_double);
+
+    printf("%d conexiones x %d en vuelo: %ld inserciones en %.2f s -> %.0f/s (errores %ld)\n",
+           n, g_depth, ok, elapsed, ok / elapsed, failed);
+    if (lat && n_lat)
+        printf("latencia p50 %.2f ms  p99 %.2f ms  max %.2f ms\n",
+               lat[n_lat / 2] * 1e3, lat[n_lat * 99 / 100] * 1e3, lat[n_lat - 1] * 1e3);
+    if (have_stats && batches1 > batches0)
+        printf("lotes del log %ld: %.1f inserciones por fdatasync (máximo desde que arrancó: %ld)\n",
+               batches1 - batches0, (double)(ok + failed) / (batches1 - batches0), batch_max);
+    free(lat);
+    free(cs);
+    free(th);
+    return failed ? 1 : 0;
+}
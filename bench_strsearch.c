@@ -0,0 +1,128 @@
+/* bench_strsearch.c
+ *
+ * Microbenchmark de strsearch.c contra el ci_strcasestr() que usaba
+ * p2-search.c (strlen + strncasecmp en cada posición).
+ *   make bench              (usa arxiv.csv si está en el directorio)
+ *   ./bench_strsearch [csv]
+ *
+ * Dos casos:
+ *  - títulos: cada título del CSV contra varias consultas (lo que hace la
+ *    búsqueda por buckets vecinos, muchas cadenas cortas)
+ *  - texto largo: un bloque contiguo del CSV con una aguja que no está
+ *    (lo que hace el SCAN); el ci_strcasestr viejo es cuadrático, así que
+ *    a él se le da un bloque más chico.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "csv.h"
+#include "fmap.h"
+#include "strsearch.h"
+
+#define MAX_TITLES 200000
+#define OLD_LONG_BYTES (128L << 10)     // al viejo, con más de 128 KB, le lleva segundos
+
+// Versión anterior (p2-search.c)
+static char *old_ci_strcasestr(const char *haystack, const char *needle) {
+    if (!haystack || !needle) return NULL;
+    size_t needle_len = strlen(needle);
+    if (needle_len == 0) return (char *)haystack;
+    for (const char *p = haystack; *p; ++p) {
+        size_t rem = strlen(p);
+        if (rem < needle_len) return NULL;
+        if (strncasecmp(p, needle, needle_len) == 0) return (char *)p;
+    }
+    return NULL;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+typedef const char *(*StrFn)(const char *, const char *);
+static const char *old_fn(const char *h, const char *n) { return old_ci_strcasestr(h, n); }
+
+// Todas las consultas contra todos los títulos; devuelve aciertos y deja el tiempo en *secs.
+static long run_titles(StrFn fn, char **titles, long n, const char **queries, int nq, double *secs) {
+    long hits = 0;
+    double t0 = now();
+    for (int q = 0; q < nq; q++)
+        for (long i = 0; i < n; i++) hits += fn(titles[i], queries[q]) != NULL;
+    *secs = now() - t0;
+    return hits;
+}
+
+int main(int argc, char **argv) {
+    const char *csv_path = argc > 1 ? argv[1] : "arxiv.csv";
+    FileMap csv;
+    if (fmap_open(&csv, csv_path) != 0 || csv.size == 0) {
+        fprintf(stderr, "bench: no se pudo mapear %s\n", csv_path);
+        return 1;
+    }
+    const char *base = (const char *)csv.base, *end = base + csv.size;
+
+    // Títulos (columna 4), copiados como cadenas
+    char **titles = malloc(sizeof(char *) * MAX_TITLES);
+    long n_titles = 0;
+    const char *nl = memchr(base, '\n', csv.size);
+    for (const char *line = nl ? nl + 1 : end; line < end && n_titles < MAX_TITLES; ) {
+        nl = memchr(line, '\n', (size_t)(end - line));
+        const char *stop = nl ? nl : end;
+        size_t len;
+        const char *title = csv_field_span(line, stop, 4, &len);
+        if (title) titles[n_titles++] = strndup(title, len);
+        line = stop + 1;
+    }
+    const char *queries[] = { "network", "Quantum Field", "learning", "zz-no-existe", "of" };
+    int nq = (int)(sizeof(queries) / sizeof(queries[0]));
+
+    printf("strsearch: %s (mejor disponible)\n", strsearch_impl());
+    printf("\n-- %ld títulos x %d consultas --\n", n_titles, nq);
+    double secs, old_secs;
+    long old_hits = run_titles(old_fn, titles, n_titles, queries, nq, &old_secs);
+    printf("  %-8s %8.1f ms  %ld aciertos\n", "viejo", old_secs * 1e3, old_hits);
+    const char *names[] = { "scalar", "sse2", "avx2" };
+    for (int i = 0; i < 3; i++) {
+        if (strsearch_use(names[i]) != 0) continue;
+        long hits = run_titles(strsearch_ci_str, titles, n_titles, queries, nq, &secs);
+        printf("  %-8s %8.1f ms  %ld aciertos  x%.1f%s\n", names[i], secs * 1e3, hits,
+               secs > 0 ? old_secs / secs : 0.0, hits == old_hits ? "" : "  ¡DISTINTO!");
+    }
+
+    // Texto largo: hasta 64 MB del CSV como una sola cadena
+    size_t long_len = csv.size < (64UL << 20) ? csv.size : (64UL << 20);
+    char *text = malloc(long_len + 1);
+    memcpy(text, base, long_len);
+    text[long_len] = '\0';
+    const char *missing = "zz-no-existe";
+    printf("\n-- texto largo sin coincidencias --\n");
+
+    char saved = text[OLD_LONG_BYTES < (long)long_len ? OLD_LONG_BYTES : (long)long_len];
+    text[OLD_LONG_BYTES < (long)long_len ? OLD_LONG_BYTES : (long)long_len] = '\0';
+    double t0 = now();
+    old_ci_strcasestr(text, missing);
+    old_secs = now() - t0;
+    size_t old_len = strlen(text);
+    text[old_len] = saved;
+    printf("  %-8s %8.1f ms  %6.1f MB/s (%zu KB)\n", "viejo", old_secs * 1e3,
+           old_secs > 0 ? old_len / old_secs / 1e6 : 0.0, old_len >> 10);
+    for (int i = 0; i < 3; i++) {
+        if (strsearch_use(names[i]) != 0) continue;
+        t0 = now();
+        const char *hit = strsearch_ci(text, long_len, missing, strlen(missing));
+        secs = now() - t0;
+        printf("  %-8s %8.1f ms  %6.1f MB/s (%zu MB)%s\n", names[i], secs * 1e3,
+               secs > 0 ? long_len / secs / 1e6 : 0.0, long_len >> 20, hit ? "  ¡DISTINTO!" : "");
+    }
+
+    for (long i = 0; i < n_titles; i++) free(titles[i]);
+    free(titles);
+    free(text);
+    fmap_close(&csv);
+    return 0;
+}
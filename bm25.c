@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "csv.h"
+#include "fmap.h"
+#include "bm25.h"
+
+// --- Construcción ---
+// Una pasada por el CSV mapeado: cada línea es un documento y su abstract
+// se tokeniza directo desde el mapeo, sin copiarlo.
+int bm25_build(const char *csv_path, const char *out_path) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    FileMap csv;
+    if (fmap_open(&csv, csv_path) != 0) return -1;
+    madvise(csv.base, csv.size, MADV_SEQUENTIAL);
+
+    WordBuilder b;
+    wordidx_builder_init(&b, 1);
+    int failed = 0;
+    const char *base = (const char *)csv.base;
+    const char *end = base + csv.size;
+
+    // El primer registro es la cabecera (id,submitter,...)
+    const char *line = csv_skip_header(base, end);
+
+    while (!failed && line < end) {
+        const char *stop = csv_record_end(line, end);
+        size_t len;
+        const char *abs = csv_field_span(line, stop, ABSTRACT_COLUMN, &len);
+        if (abs) failed = wordidx_builder_add(&b, (long)(line - base), abs, len) != 0;
+        line = stop + 1;
+    }
+    if (!failed) failed = wordidx_builder_write(&b, out_path, (long)csv.size) != 0;
+
+    long n_docs = b.n_docs, n_words = b.n_words, total = b.total_words;
+    wordidx_builder_free(&b);
+    fmap_close(&csv);
+
+    if (failed) {
+        fprintf(stderr, "[BM25] Error construyendo %s\n", out_path);
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("[BM25] %ld abstracts, %ld palabras distintas, %ld palabras, %.3f s\n", n_docs, n_words, total,
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    return 0;
+}
+
+// Agrega a la cola del índice el abstract de la línea [line, end).
+int bm25_add_line(WordIndex *w, const char *line, const char *end, long csv_offset) {
+    size_t len;
+    const char *abs = csv_field_span(line, end, ABSTRACT_COLUMN, &len);
+    if (!abs) return 0;
+    char *text = strndup(abs, len);
+    if (!text) return -1;
+    int r = wordidx_add(w, text, csv_offset);
+    free(text);
+    return r;
+}
+
+// --- Top-k ---
+// Min-heap de k resultados: la raíz es el peor, y su puntaje es el umbral
+// que un documento tiene que superar para entrar.
+
+typedef struct {
+    Bm25Hit *hits;
+    long n, k;
+} TopK;
+
+static void topk_push(TopK *t, long csv_offset, double score) {
+    if (t->n == t->k) {
+        if (score <= t->hits[0].score) return;
+        t->hits[0].csv_offset = csv_offset;
+        t->hits[0].score = score;
+        long i = 0;
+        for (;;) {
+            long l = 2 * i + 1, r = l + 1, m = i;
+            if (l < t->n && t->hits[l].score < t->hits[m].score) m = l;
+            if (r < t->n && t->hits[r].score < t->hits[m].score) m = r;
+            if (m == i) break;
+            Bm25Hit tmp = t->hits[i]; t->hits[i] = t->hits[m]; t->hits[m] = tmp;
+            i = m;
+        }
+        return;
+    }
+    long i = t->n++;
+    t->hits[i].csv_offset = csv_offset;
+    t->hits[i].score = score;
+    while (i > 0 && t->hits[(i - 1) / 2].score > t->hits[i].score) {
+        Bm25Hit tmp = t->hits[i]; t->hits[i] = t->hits[(i - 1) / 2]; t->hits[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+
+static double topk_threshold(const TopK *t) {
+    return t->n == t->k ? t->hits[0].score : -1.0;
+}
+
+static int hit_cmp(const void *a, const void *b) {
+    const Bm25Hit *x = a, *y = b;
+    if (x->score != y->score) return x->score < y->score ? 1 : -1;
+    return (x->csv_offset > y->csv_offset) - (x->csv_offset < y->csv_offset);
+}
+
+typedef struct {
+    char word[WORD_MAX + 1];
+    const WordDisk *disk;
+    PostingCursor c;
+    double idf;
+    double ub;              // idf * peso máximo de la lista
+} Bm25Term;
+
+static int term_ub_cmp(const void *a, const void *b) {
+    double x = ((const Bm25Term *)a)->ub, y = ((const Bm25Term *)b)->ub;
+    return (x > y) - (x < y);
+}
+
+static unsigned tail_tf(const char *text, const char *word, unsigned *doc_len) {
+    char w[WORD_MAX + 1];
+    size_t i = 0, len = strlen(text);
+    unsigned tf = 0, n = 0;
+    while (wordidx_next_word(text, len, &i, w) > 0) {
+        n++;
+        if (strcmp(w, word) == 0) tf++;
+    }
+    *doc_len = n;
+    return tf;
+}
+
+// Deja en hits los (hasta) k documentos de mayor puntaje BM25, ordenados
+// de mayor a menor. Devuelve cuántos hay.
+//
+// Max-score: los términos se ordenan por su cota superior. Los de menor
+// cota cuya suma no alcanza el umbral actual no pueden, solos, meter un
+// documento en el top-k: son "no esenciales" y no proponen candidatos;
+// solo se consultan (con saltos) para completar el puntaje de los
+// candidatos de los esenciales, y se deja de consultar en cuanto ni
+// sumando lo que falta se llegaría al umbral.
+long bm25_search(const WordIndex *w, const char *query, Bm25Hit *hits, long k) {
+    if (k <= 0) return 0;
+    Bm25Term terms[WORD_QUERY_TERMS];
+    int nt = 0;
+
+    size_t qi = 0, qlen = strlen(query);
+    char word[WORD_MAX + 1];
+    while (nt < WORD_QUERY_TERMS && wordidx_next_word(query, qlen, &qi, word) > 0) {
+        int dup = 0;
+        for (int j = 0; j < nt && !dup; j++) dup = strcmp(terms[j].word, word) == 0;
+        if (dup) continue;
+        strcpy(terms[nt].word, word);
+        terms[nt].disk = w->docs ? wordidx_lookup(w, word, strlen(word)) : NULL;
+        nt++;
+    }
+
+    // --- idf con los documentos del índice más los de la cola ---
+    long n_docs = (w->docs ? w->h.n_docs : 0) + w->tail_n;
+    if (n_docs == 0) return 0;
+    double avg_len = w->docs && w->h.n_docs > 0 ? (double)w->h.total_words / w->h.n_docs : 1.0;
+    if (avg_len <= 0.0) avg_len = 1.0;
+
+    for (int j = 0; j < nt; j++) {
+        long df = terms[j].disk ? terms[j].disk->count : 0;
+        for (long i = 0; i < w->tail_n; i++) {
+            unsigned dl;
+            if (tail_tf(w->tail_text[i], terms[j].word, &dl) > 0) df++;
+        }
+        terms[j].idf = log(1.0 + (n_docs - df + 0.5) / (df + 0.5));
+        terms[j].ub = terms[j].disk ? terms[j].idf * terms[j].disk->max_weight : 0.0;
+        if (terms[j].disk) wordidx_cursor(w, terms[j].disk, &terms[j].c);
+    }
+
+    // Solo los términos que están en el índice, de menor a mayor cota
+    Bm25Term *ts[WORD_QUERY_TERMS];
+    int n = 0;
+    qsort(terms, nt, sizeof(Bm25Term), term_ub_cmp);
+    for (int j = 0; j < nt; j++) {
+        if (terms[j].disk) ts[n++] = &terms[j];
+    }
+    double prefix[WORD_QUERY_TERMS];       // prefix[i] = cota de los términos 0..i
+    for (int j = 0; j < n; j++) prefix[j] = ts[j]->ub + (j ? prefix[j - 1] : 0.0);
+
+    TopK top = { hits, 0, k };
+    for (int j = 0; j < n; j++) postings_next(&ts[j]->c);
+
+    int first_essential = 0;
+    for (;;) {
+        // Próximo candidato: el menor documento entre los esenciales
+        int have = 0;
+        unsigned doc = 0;
+        for (int j = first_essential; j < n; j++) {
+            PostingCursor *c = &ts[j]->c;
+            if (c->index < c->count && (!have || c->doc < doc)) { doc = c->doc; have = 1; }
+        }
+        if (!have) break;
+
+        unsigned dl = w->lengths[doc];
+        double score = 0.0;
+        for (int j = first_essential; j < n; j++) {
+            PostingCursor *c = &ts[j]->c;
+            if (c->index < c->count && c->doc == doc) {
+                score += ts[j]->idf * wordidx_bm25_weight(c->tf, dl, avg_len);
+                postings_next(c);
+            }
+        }
+
+        // Completar con los no esenciales, de mayor a menor cota
+        double theta = topk_threshold(&top);
+        for (int j = first_essential - 1; j >= 0; j--) {
+            if (score + prefix[j] <= theta) break;
+            PostingCursor *c = &ts[j]->c;
+            if (postings_advance(c, doc) && c->doc == doc)
+                score += ts[j]->idf * wordidx_bm25_weight(c->tf, dl, avg_len);
+        }
+
+        if (score > theta) {
+            topk_push(&top, w->docs[doc], score);
+            theta = topk_threshold(&top);
+            while (first_essential < n && prefix[first_essential] <= theta) first_essential++;
+        }
+    }
+
+    // Lo insertado después de construir el índice se puntúa directo
+    for (long i = 0; i < w->tail_n; i++) {
+        double score = 0.0;
+        for (int j = 0; j < nt; j++) {
+            unsigned dl;
+            unsigned tf = tail_tf(w->tail_text[i], terms[j].word, &dl);
+            if (tf) score += terms[j].idf * wordidx_bm25_weight(tf, dl, avg_len);
+        }
+        if (score > 0.0) topk_push(&top, w->tail_csv[i], score);
+    }
+
+    qsort(hits, top.n, sizeof(Bm25Hit), hit_cmp);
+    return top.n;
+}
@@ -0,0 +1,23 @@
+#ifndef BM25_H
+#define BM25_H
+
+#include <stddef.h>
+#include "wordidx.h"
+
+#define ABSTRACTS_FILE "abstracts.bin"
+#define ABSTRACT_COLUMN 5
+
+/* Búsqueda con ranking BM25 sobre los abstracts. abstracts.bin es un
+   words.bin con frecuencias (tf), largos de documento y el peso máximo de
+   cada lista, construido leyendo la columna 5 del CSV. */
+
+typedef struct {
+    long csv_offset;
+    double score;
+} Bm25Hit;
+
+int  bm25_build(const char *csv_path, const char *out_path);
+int  bm25_add_line(WordIndex *w, const char *line, const char *end, long csv_offset);
+long bm25_search(const WordIndex *w, const char *query, Bm25Hit *hits, long k);
+
+#endif
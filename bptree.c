@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "bptree.h"
+
+#define BPT_FILL 90     // % de llenado de las páginas al construir (deja lugar para insertar)
+#define BPT_MAX_HEIGHT 32
+
+// --- Disposición de las páginas ---
+
+static int leaf_cap(int ks)  { return (int)((BPT_PAGE_SIZE - sizeof(BptPage)) / (ks + sizeof(long))); }
+static int inner_cap(int ks) { return (int)((BPT_PAGE_SIZE - sizeof(BptPage) - sizeof(long)) / (ks + 2 * sizeof(long))); }
+
+static unsigned char *leaf_entry(unsigned char *pg, int ks, int i) {
+    return pg + sizeof(BptPage) + (size_t)i * (ks + sizeof(long));
+}
+
+static unsigned char *inner_entry(unsigned char *pg, int ks, int i) {
+    return pg + sizeof(BptPage) + sizeof(long) + (size_t)i * (ks + 2 * sizeof(long));
+}
+
+static long get_long(const unsigned char *p) { long v; memcpy(&v, p, sizeof(v)); return v; }
+static void put_long(unsigned char *p, long v) { memcpy(p, &v, sizeof(v)); }
+
+// Hijo i de una página interna (0 = el de más a la izquierda).
+static long inner_child(unsigned char *pg, int ks, int i) {
+    if (i == 0) return get_long(pg + sizeof(BptPage));
+    return get_long(inner_entry(pg, ks, i - 1) + ks + sizeof(long));
+}
+
+// Compara el par (k1, v1) con el guardado en e (clave y luego valor).
+static int cmp_entry(const unsigned char *k1, long v1, const unsigned char *e, int ks) {
+    int c = memcmp(k1, e, ks);
+    if (c) return c;
+    long v2 = get_long(e + ks);
+    return (v1 > v2) - (v1 < v2);
+}
+
+// En una interna: cuántos separadores son <= (k, v), es decir, a qué hijo bajar.
+static int inner_find(unsigned char *pg, int ks, const unsigned char *k, long v) {
+    const BptPage *hd = (const BptPage *)pg;
+    int lo = 0, hi = hd->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cmp_entry(k, v, inner_entry(pg, ks, mid), ks) >= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// En una hoja: primera posición con un par > (k, v) si upper, >= si no.
+static int leaf_find(unsigned char *pg, int ks, const unsigned char *k, long v, int upper) {
+    const BptPage *hd = (const BptPage *)pg;
+    int lo = 0, hi = hd->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int c = cmp_entry(k, v, leaf_entry(pg, ks, mid), ks);
+        if (c > 0 || (upper && c == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int bpt_pair_cmp(const void *a, const void *b) {
+    const BptPair *x = a, *y = b;
+    int c = memcmp(x->key, y->key, BPT_KEY_MAX);
+    if (c) return c;
+    return (x->value > y->value) - (x->value < y->value);
+}
+
+// --- Construcción desde pares ordenados ---
+// Las hojas se llenan de izquierda a derecha y después cada nivel interno
+// se arma con el primer par de cada página del nivel de abajo.
+
+typedef struct {
+    unsigned char key[BPT_KEY_MAX];
+    long value;
+    long page;
+} BptChild;
+
+int bpt_build(const char *path, int key_size, const BptPair *pairs, long n, long csv_end) {
+    if (key_size <= 0 || key_size > BPT_KEY_MAX) return -1;
+    int ks = key_size;
+    int per_leaf = leaf_cap(ks) * BPT_FILL / 100;
+    int per_inner = inner_cap(ks) * BPT_FILL / 100;
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) return -1;
+
+    BptHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = BPT_MAGIC;
+    h.version = BPT_VERSION;
+    h.key_size = ks;
+    h.csv_end = csv_end;
+    h.n_keys = n;
+
+    unsigned char pg[BPT_PAGE_SIZE];
+    int failed = 0;
+    memset(pg, 0, sizeof(pg));
+    failed |= fwrite(pg, 1, BPT_PAGE_SIZE, out) != BPT_PAGE_SIZE;   // lugar del header
+    long next_page = 1;
+
+    // --- Hojas ---
+    long n_leaves = n > 0 ? (n + per_leaf - 1) / per_leaf : 1;
+    BptChild *level = malloc(sizeof(BptChild) * n_leaves);
+    if (!level) failed = 1;
+    for (long l = 0; !failed && l < n_leaves; l++) {
+        memset(pg, 0, sizeof(pg));
+        BptPage *hd = (BptPage *)pg;
+        long first = l * per_leaf, cnt = n - first < per_leaf ? n - first : per_leaf;
+        if (cnt < 0) cnt = 0;
+        hd->is_leaf = 1;
+        hd->n = (unsigned short)cnt;
+        hd->next = l + 1 < n_leaves ? next_page + 1 : -1;
+        for (long i = 0; i < cnt; i++) {
+            unsigned char *e = leaf_entry(pg, ks, (int)i);
+            memcpy(e, pairs[first + i].key, ks);
+            put_long(e + ks, pairs[first + i].value);
+        }
+        memset(level[l].key, 0, BPT_KEY_MAX);
+        if (cnt > 0) memcpy(level[l].key, pairs[first].key, ks);
+        level[l].value = cnt > 0 ? pairs[first].value : LONG_MIN;
+        level[l].page = next_page++;
+        failed |= fwrite(pg, 1, BPT_PAGE_SIZE, out) != BPT_PAGE_SIZE;
+    }
+
+    // --- Niveles internos hasta que quede una sola página ---
+    long n_level = n_leaves;
+    h.height = 1;
+    while (!failed && n_level > 1) {
+        long n_up = (n_level + per_inner) / (per_inner + 1);
+        BptChild *up = malloc(sizeof(BptChild) * n_up);
+        if (!up) { failed = 1; break; }
+        for (long u = 0; !failed && u < n_up; u++) {
+            long first = u * (per_inner + 1);
+            long cnt = n_level - first < per_inner + 1 ? n_level - first : per_inner + 1;
+            memset(pg, 0, sizeof(pg));
+            BptPage *hd = (BptPage *)pg;
+            hd->n = (unsigned short)(cnt - 1);
+            hd->next = -1;
+            put_long(pg + sizeof(BptPage), level[first].page);
+            for (long i = 1; i < cnt; i++) {
+                unsigned char *e = inner_entry(pg, ks, (int)(i - 1));
+                memcpy(e, level[first + i].key, ks);
+                put_long(e + ks, level[first + i].value);
+                put_long(e + ks + sizeof(long), level[first + i].page);
+            }
+            up[u] = level[first];
+            up[u].page = next_page++;
+            failed |= fwrite(pg, 1, BPT_PAGE_SIZE, out) != BPT_PAGE_SIZE;
+        }
+        free(level);
+        level = up;
+        n_level = n_up;
+        h.height++;
+    }
+
+    if (!failed) {
+        h.root = level[0].page;
+        h.n_pages = next_page;
+        memset(pg, 0, sizeof(pg));
+        memcpy(pg, &h, sizeof(h));
+        failed |= fseek(out, 0, SEEK_SET) != 0 || fwrite(pg, 1, BPT_PAGE_SIZE, out) != BPT_PAGE_SIZE;
+    }
+    free(level);
+    if (fclose(out) != 0) failed = 1;
+    if (!failed && rename(tmp_path, path) != 0) failed = 1;
+    if (failed) remove(tmp_path);
+    return failed ? -1 : 0;
+}
+
+// --- Apertura ---
+
+int bpt_open(BPTree *t, const char *path) {
+    memset(t, 0, sizeof(*t));
+    t->fd = open(path, O_RDWR);
+    if (t->fd < 0) { t->map.fd = -1; return -1; }
+    if (fmap_open(&t->map, path) != 0) {
+        close(t->fd);
+        t->fd = -1;
+        return -1;
+    }
+    if (t->map.size < BPT_PAGE_SIZE) { bpt_close(t); return -1; }
+    memcpy(&t->h, t->map.base, sizeof(BptHeader));
+    if (t->h.magic != BPT_MAGIC || t->h.version != BPT_VERSION ||
+        t->h.key_size <= 0 || t->h.key_size > BPT_KEY_MAX || t->h.height < 1 ||
+        t->h.height > BPT_MAX_HEIGHT || t->h.root <= 0 || t->h.root >= t->h.n_pages ||
+        (size_t)t->h.n_pages * BPT_PAGE_SIZE > t->map.size) {
+        bpt_close(t);
+        return -1;
+    }
+    return 0;
+}
+
+void bpt_close(BPTree *t) {
+    fmap_close(&t->map);
+    if (t->fd >= 0) close(t->fd);
+    memset(t, 0, sizeof(*t));
+    t->fd = -1;
+    t->map.fd = -1;
+}
+
+// Página p dentro del mapeo (NULL si está fuera del archivo).
+static unsigned char *map_page(const BPTree *t, long p) {
+    if (p <= 0 || p >= t->h.n_pages || (size_t)(p + 1) * BPT_PAGE_SIZE > t->map.size) return NULL;
+    return t->map.base + (size_t)p * BPT_PAGE_SIZE;
+}
+
+// --- Rangos ---
+// Recorre en orden los pares con from <= clave y clave <= to, donde to se
+// compara solo en sus to_len bytes ("2020" cubre todo 2020). NULL en
+// from o to deja ese extremo abierto.
+int bpt_range(const BPTree *t, const void *from, size_t from_len, const void *to, size_t to_len,
+              BptFn fn, void *arg) {
+    int ks = t->h.key_size;
+    unsigned char k[BPT_KEY_MAX];
+    memset(k, 0, sizeof(k));
+    if (from) memcpy(k, from, from_len < (size_t)ks ? from_len : (size_t)ks);
+    if (to_len > (size_t)ks) to_len = ks;
+
+    long p = t->h.root;
+    unsigned char *pg = map_page(t, p);
+    for (int lvl = t->h.height; pg && lvl > 1; lvl--)
+        pg = map_page(t, inner_child(pg, ks, inner_find(pg, ks, k, LONG_MIN)));
+    if (!pg) return -1;
+
+    int i = leaf_find(pg, ks, k, LONG_MIN, 0);
+    while (pg) {
+        const BptPage *hd = (const BptPage *)pg;
+        for (; i < hd->n; i++) {
+            const unsigned char *e = leaf_entry(pg, ks, i);
+            if (to && memcmp(e, to, to_len) > 0) return 0;
+            if (fn(e, get_long(e + ks), arg)) return 0;
+        }
+        pg = hd->next > 0 ? map_page(t, hd->next) : NULL;
+        i = 0;
+    }
+    return 0;
+}
+
+// --- Inserción ---
+
+static int read_page(BPTree *t, long p, unsigned char *pg) {
+    return pread(t->fd, pg, BPT_PAGE_SIZE, (off_t)p * BPT_PAGE_SIZE) == BPT_PAGE_SIZE ? 0 : -1;
+}
+
+static int write_page(BPTree *t, long p, const unsigned char *pg) {
+    return pwrite(t->fd, pg, BPT_PAGE_SIZE, (off_t)p * BPT_PAGE_SIZE) == BPT_PAGE_SIZE ? 0 : -1;
+}
+
+static int write_header(BPTree *t) {
+    if (pwrite(t->fd, &t->h, sizeof(t->h), 0) != (ssize_t)sizeof(t->h)) return -1;
+    return fmap_refresh(&t->map);
+}
+
+int bpt_set_csv_end(BPTree *t, long csv_end) {
+    t->h.csv_end = csv_end;
+    return write_header(t);
+}
+
+// Inserta (clave, valor). Si la hoja se llena se parte en dos y el primer
+// par de la nueva sube al padre, que a su vez puede partirse; si se parte
+// la raíz, el árbol crece un nivel.
+int bpt_insert(BPTree *t, const void *key, size_t key_len, long value) {
+    int ks = t->h.key_size;
+    unsigned char k[BPT_KEY_MAX];
+    memset(k, 0, sizeof(k));
+    memcpy(k, key, key_len < (size_t)ks ? key_len : (size_t)ks);
+
+    // --- Bajar hasta la hoja recordando el camino ---
+    long path[BPT_MAX_HEIGHT];
+    int depth = 0;
+    unsigned char pg[BPT_PAGE_SIZE];
+    long p = t->h.root;
+    for (int lvl = t->h.height; lvl > 1; lvl--) {
+        if (read_page(t, p, pg) != 0) return -1;
+        path[depth++] = p;
+        p = inner_child(pg, ks, inner_find(pg, ks, k, value));
+    }
+    if (read_page(t, p, pg) != 0) return -1;
+
+    // --- Insertar en la hoja ---
+    BptPage *hd = (BptPage *)pg;
+    size_t le = ks + sizeof(long);
+    int pos = leaf_find(pg, ks, k, value, 1);
+    unsigned char sep[BPT_KEY_MAX + sizeof(long)];  // par que sube al padre
+    long sep_child = -1;
+
+    if (hd->n < leaf_cap(ks)) {
+        unsigned char *e = leaf_entry(pg, ks, pos);
+        memmove(e + le, e, (hd->n - pos) * le);
+        memcpy(e, k, ks);
+        put_long(e + ks, value);
+        hd->n++;
+        if (write_page(t, p, pg) != 0) return -1;
+    } else {
+        // Todas las entradas más la nueva, en orden, y mitad para cada hoja
+        int total = hd->n + 1;
+        unsigned char *all = malloc(total * le);
+        if (!all) return -1;
+        memcpy(all, leaf_entry(pg, ks, 0), pos * le);
+        memcpy(all + pos * le, k, ks);
+        put_long(all + pos * le + ks, value);
+        memcpy(all + (pos + 1) * le, leaf_entry(pg, ks, pos), (hd->n - pos) * le);
+
+        int left = total / 2;
+        unsigned char right[BPT_PAGE_SIZE];
+        memset(right, 0, sizeof(right));
+        BptPage *rh = (BptPage *)right;
+        long rp = t->h.n_pages++;
+        rh->is_leaf = 1;
+        rh->n = (unsigned short)(total - left);
+        rh->next = hd->next;
+        memcpy(leaf_entry(right, ks, 0), all + left * le, (total - left) * le);
+        hd->n = (unsigned short)left;
+        hd->next = rp;
+        memcpy(leaf_entry(pg, ks, 0), all, left * le);
+        memcpy(sep, all + left * le, le);
+        free(all);
+        if (write_page(t, rp, right) != 0 || write_page(t, p, pg) != 0) return -1;
+        sep_child = rp;
+    }
+
+    // --- Subir el separador mientras haya particiones ---
+    size_t ie = ks + 2 * sizeof(long);
+    while (sep_child >= 0 && depth > 0) {
+        p = path[--depth];
+        if (read_page(t, p, pg) != 0) return -1;
+        hd = (BptPage *)pg;
+        int at = inner_find(pg, ks, sep, get_long(sep + ks));
+
+        if (hd->n < inner_cap(ks)) {
+            unsigned char *e = inner_entry(pg, ks, at);
+            memmove(e + ie, e, (hd->n - at) * ie);
+            memcpy(e, sep, le);
+            put_long(e + le, sep_child);
+            hd->n++;
+            if (write_page(t, p, pg) != 0) return -1;
+            sep_child = -1;
+            break;
+        }
+
+        // Interna llena: el par del medio sube y el resto se reparte
+        int total = hd->n + 1;
+        unsigned char *all = malloc(total * ie);
+        if (!all) return -1;
+        memcpy(all, inner_entry(pg, ks, 0), at * ie);
+        memcpy(all + at * ie, sep, le);
+        put_long(all + at * ie + le, sep_child);
+        memcpy(all + (at + 1) * ie, inner_entry(pg, ks, at), (hd->n - at) * ie);
+
+        int mid = total / 2;
+        unsigned char right[BPT_PAGE_SIZE];
+        memset(right, 0, sizeof(right));
+        BptPage *rh = (BptPage *)right;
+        long rp = t->h.n_pages++;
+        rh->n = (unsigned short)(total - mid - 1);
+        rh->next = -1;
+        put_long(right + sizeof(BptPage), get_long(all + mid * ie + le));
+        memcpy(inner_entry(right, ks, 0), all + (mid + 1) * ie, (total - mid - 1) * ie);
+        hd->n = (unsigned short)mid;
+        memcpy(inner_entry(pg, ks, 0), all, mid * ie);
+        memcpy(sep, all + mid * ie, le);
+        free(all);
+        if (write_page(t, rp, right) != 0 || write_page(t, p, pg) != 0) return -1;
+        sep_child = rp;
+    }
+
+    // --- Se partió la raíz: nueva raíz con dos hijos ---
+    if (sep_child >= 0) {
+        if (t->h.height >= BPT_MAX_HEIGHT) return -1;
+        unsigned char root[BPT_PAGE_SIZE];
+        memset(root, 0, sizeof(root));
+        BptPage *rh = (BptPage *)root;
+        rh->n = 1;
+        rh->next = -1;
+        put_long(root + sizeof(BptPage), t->h.root);
+        unsigned char *e = inner_entry(root, ks, 0);
+        memcpy(e, sep, le);
+        put_long(e + le, sep_child);
+        long np = t->h.n_pages++;
+        if (write_page(t, np, root) != 0) return -1;
+        t->h.root = np;
+        t->h.height++;
+    }
+
+    t->h.n_keys++;
+    return write_header(t);
+}
@@ -0,0 +1,65 @@
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stddef.h>
+#include "fmap.h"
+
+#define BPT_MAGIC 0x54505442u       /* "BTPT" */
+#define BPT_VERSION 1
+#define BPT_PAGE_SIZE 4096
+#define BPT_KEY_MAX 64
+
+/* Árbol B+ en disco con claves de tamaño fijo (key_size bytes, rellenas
+   con '\0') y un long como valor (offset en el CSV). Las claves pueden
+   repetirse: dentro del árbol se ordena por (clave, valor), así que cada
+   par es único y las particiones no tienen casos especiales.
+
+   La página 0 es el header. Cada página es:
+     BptPage                     hoja o interna, n entradas
+     hoja:    n * (clave, valor)
+     interna: hijo0, n * (clave, valor, hijo)   el separador es el primer
+                                                par del hijo derecho */
+typedef struct {
+    unsigned int magic;
+    int version;
+    int key_size;
+    int height;             /* 1 = la raíz es una hoja */
+    long root;              /* número de página */
+    long n_pages;
+    long n_keys;
+    long csv_end;           /* tamaño del CSV cubierto (lo usa quien lo construye) */
+} BptHeader;
+
+typedef struct {
+    unsigned short is_leaf;
+    unsigned short n;
+    int pad;
+    long next;              /* hoja siguiente (-1 en la última) */
+} BptPage;
+
+/* Árbol abierto: se lee del archivo mapeado y se escribe con pwrite */
+typedef struct {
+    FileMap map;
+    int fd;                 /* lectura/escritura, para insertar */
+    BptHeader h;
+} BPTree;
+
+/* Para recorrer rangos: devolver != 0 corta el recorrido */
+typedef int (*BptFn)(const unsigned char *key, long value, void *arg);
+
+/* Pares ya ordenados para la construcción */
+typedef struct {
+    unsigned char key[BPT_KEY_MAX];
+    long value;
+} BptPair;
+
+int  bpt_pair_cmp(const void *a, const void *b);
+int  bpt_build(const char *path, int key_size, const BptPair *pairs, long n, long csv_end);
+int  bpt_open(BPTree *t, const char *path);
+void bpt_close(BPTree *t);
+int  bpt_insert(BPTree *t, const void *key, size_t key_len, long value);
+int  bpt_set_csv_end(BPTree *t, long csv_end);
+int  bpt_range(const BPTree *t, const void *from, size_t from_len, const void *to, size_t to_len,
+               BptFn fn, void *arg);
+
+#endif
@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "csv.h"
+#include "fmap.h"
+#include "catidx.h"
+
+#define CATIDX_MAX_NAME 255
+
+// Orden de las claves: por campo y después por nombre sin mayúsculas.
+static int key_cmp(int field, const char *name, size_t len, const CatIdxKey *k) {
+    if (field != k->field) return field < k->field ? -1 : 1;
+    int c = strncasecmp(name, k->name, len);
+    if (c != 0) return c;
+    return k->name[len] == '\0' ? 0 : -1;
+}
+
+// Posición de la clave, o -(posición donde iría) - 1.
+static long find_key(const CatIndex *c, int field, const char *name, size_t len) {
+    long lo = 0, hi = c->n_keys;
+    while (lo < hi) {
+        long mid = (lo + hi) / 2;
+        int cmp = key_cmp(field, name, len, &c->keys[mid]);
+        if (cmp == 0) return mid;
+        if (cmp > 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return -lo - 1;
+}
+
+// Conjunto de la clave (field, name[0..len)), creándola si no existe.
+static Roaring *key_set(CatIndex *c, int field, const char *name, size_t len) {
+    long i = find_key(c, field, name, len);
+    if (i >= 0) return &c->keys[i].docs;
+
+    i = -i - 1;
+    if (c->n_keys == c->keys_cap) {
+        long new_cap = c->keys_cap ? c->keys_cap * 2 : 64;
+        CatIdxKey *tmp = realloc(c->keys, sizeof(CatIdxKey) * new_cap);
+        if (!tmp) return NULL;
+        c->keys = tmp;
+        c->keys_cap = new_cap;
+    }
+    char *copy = strndup(name, len);
+    if (!copy) return NULL;
+    memmove(c->keys + i + 1, c->keys + i, sizeof(CatIdxKey) * (c->n_keys - i));
+    c->keys[i].field = field;
+    c->keys[i].name = copy;
+    roaring_init(&c->keys[i].docs);
+    c->n_keys++;
+    return &c->keys[i].docs;
+}
+
+static int add_value(CatIndex *c, int field, const char *name, size_t len, unsigned int doc) {
+    if (len == 0) return 0;
+    if (len > CATIDX_MAX_NAME) len = CATIDX_MAX_NAME;
+    Roaring *set = key_set(c, field, name, len);
+    return set ? roaring_add(set, doc) : -1;
+}
+
+// --- Inserción ---
+
+// Agrega la línea [line, end) como un documento nuevo con sus categorías,
+// su licencia y su año. Las líneas ya indexadas (offset no mayor que el último) se ignoran.
+int catidx_add_line(CatIndex *c, const char *line, const char *end, long csv_offset) {
+    if (c->n_docs > 0 && csv_offset <= c->docs[c->n_docs - 1]) return 0;
+    if (line == end) return 0;
+
+    if (c->n_docs == c->docs_cap) {
+        long new_cap = c->docs_cap ? c->docs_cap * 2 : 65536;
+        long *tmp = realloc(c->docs, sizeof(long) * new_cap);
+        if (!tmp) return -1;
+        c->docs = tmp;
+        c->docs_cap = new_cap;
+    }
+    unsigned int doc = (unsigned int)c->n_docs;
+    c->docs[c->n_docs++] = csv_offset;
+
+    size_t len;
+    const char *cats = csv_field_span(line, end, CATEGORY_COLUMN, &len);
+    for (size_t i = 0; cats && i < len; ) {
+        while (i < len && isspace((unsigned char)cats[i])) i++;
+        size_t start = i;
+        while (i < len && !isspace((unsigned char)cats[i])) i++;
+        if (add_value(c, CATIDX_CATEGORY, cats + start, i - start, doc) != 0) return -1;
+    }
+
+    const char *license = csv_field_span(line, end, LICENSE_COLUMN, &len);
+    if (license && add_value(c, CATIDX_LICENSE, license, len, doc) != 0) return -1;
+
+    const char *date = csv_field_span(line, end, YEAR_COLUMN, &len);
+    if (date && len >= 4 && add_value(c, CATIDX_YEAR, date, 4, doc) != 0) return -1;
+    return 0;
+}
+
+// Agrega los registros del CSV que el índice todavía no cubre.
+int catidx_catch_up(CatIndex *c, const char *csv_base, size_t csv_size) {
+    const char *end = csv_base + csv_size;
+    const char *line = csv_base + c->csv_end;
+    if (c->csv_end == 0) line = csv_skip_header(csv_base, end);
+
+    while (line < end) {
+        const char *stop = csv_record_end(line, end);
+        if (catidx_add_line(c, line, stop, (long)(line - csv_base)) != 0) return -1;
+        line = stop + 1;
+    }
+    c->csv_end = (long)csv_size;
+    return 0;
+}
+
+// --- Archivo ---
+
+// Escribe el índice completo (en un .tmp que después se renombra).
+int catidx_write(const CatIndex *c, const char *path) {
+    CatIdxHeader h = { .magic = CATIDX_MAGIC, .version = CATIDX_VERSION, .n_docs = c->n_docs,
+                       .n_keys = c->n_keys, .csv_end = c->csv_end, .offset_docs = sizeof(CatIdxHeader) };
+    CatIdxKeyDisk *dir = malloc(sizeof(CatIdxKeyDisk) * (c->n_keys ? c->n_keys : 1));
+    if (!dir) return -1;
+
+    long heap = 0, sets = 0;
+    for (long i = 0; i < c->n_keys; i++) {
+        dir[i].field = c->keys[i].field;
+        dir[i].name_len = (unsigned int)strlen(c->keys[i].name);
+        dir[i].name_offset = heap;
+        dir[i].set_offset = sets;
+        dir[i].set_size = (long)roaring_size(&c->keys[i].docs);
+        heap += dir[i].name_len;
+        sets += dir[i].set_size;
+    }
+    h.offset_keys = h.offset_docs + (long)sizeof(long) * c->n_docs;
+    h.offset_heap = h.offset_keys + (long)sizeof(CatIdxKeyDisk) * c->n_keys;
+    h.offset_sets = h.offset_heap + heap;
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) {
+        free(dir);
+        return -1;
+    }
+    int failed = fwrite(&h, sizeof(h), 1, out) != 1 ||
+                 (c->n_docs > 0 && fwrite(c->docs, sizeof(long), (size_t)c->n_docs, out) != (size_t)c->n_docs) ||
+                 (c->n_keys > 0 && fwrite(dir, sizeof(CatIdxKeyDisk), (size_t)c->n_keys, out) != (size_t)c->n_keys);
+    for (long i = 0; !failed && i < c->n_keys; i++)
+        failed = fwrite(c->keys[i].name, 1, dir[i].name_len, out) != dir[i].name_len;
+
+    unsigned char *buf = NULL;
+    size_t buf_cap = 0;
+    for (long i = 0; !failed && i < c->n_keys; i++) {
+        size_t size = (size_t)dir[i].set_size;
+        if (size > buf_cap) {
+            unsigned char *tmp = realloc(buf, size);
+            if (!tmp) { failed = 1; break; }
+            buf = tmp;
+            buf_cap = size;
+        }
+        roaring_write(&c->keys[i].docs, buf);
+        failed = fwrite(buf, 1, size, out) != size;
+    }
+    free(buf);
+    free(dir);
+
+    if (fclose(out) != 0) failed = 1;
+    if (!failed && rename(tmp_path, path) != 0) failed = 1;
+    if (failed) remove(tmp_path);
+    return failed ? -1 : 0;
+}
+
+// Una pasada por el CSV (columnas 6, 11 y 12) y se escribe el archivo.
+int catidx_build(const char *csv_path, const char *out_path) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    FileMap csv;
+    if (fmap_open(&csv, csv_path) != 0) return -1;
+    madvise(csv.base, csv.size, MADV_SEQUENTIAL);
+
+    CatIndex c = {0};
+    int failed = catidx_catch_up(&c, (const char *)csv.base, csv.size) != 0 ||
+                 catidx_write(&c, out_path) != 0;
+    fmap_close(&csv);
+
+    if (failed) {
+        fprintf(stderr, "[CATS] Error construyendo %s\n", out_path);
+        catidx_close(&c);
+        return -1;
+    }
+    long per_field[CATIDX_N_FIELDS] = {0};
+    for (long i = 0; i < c.n_keys; i++) per_field[c.keys[i].field]++;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("[CATS] %ld documentos, %ld categorías, %ld licencias, %ld años, %.3f s\n",
+           c.n_docs, per_field[CATIDX_CATEGORY], per_field[CATIDX_LICENSE], per_field[CATIDX_YEAR],
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    catidx_close(&c);
+    return 0;
+}
+
+// Carga el archivo completo en memoria (se copia todo: el archivo queda cerrado).
+int catidx_open(CatIndex *c, const char *path) {
+    memset(c, 0, sizeof(*c));
+    FileMap m;
+    if (fmap_open(&m, path) != 0) return -1;
+
+    const unsigned char *base = m.base;
+    CatIdxHeader h;
+    int failed = m.size < sizeof(h);
+    if (!failed) {
+        memcpy(&h, base, sizeof(h));
+        failed = h.magic != CATIDX_MAGIC || h.version != CATIDX_VERSION ||
+                 h.n_docs < 0 || h.n_keys < 0 ||
+                 h.offset_docs + (long)sizeof(long) * h.n_docs > (long)m.size ||
+                 h.offset_keys + (long)sizeof(CatIdxKeyDisk) * h.n_keys > (long)m.size ||
+                 h.offset_heap > (long)m.size || h.offset_sets > (long)m.size;
+    }
+
+    if (!failed && h.n_docs > 0) {
+        c->docs = malloc(sizeof(long) * h.n_docs);
+        failed = !c->docs;
+        if (!failed) memcpy(c->docs, base + h.offset_docs, sizeof(long) * h.n_docs);
+        c->n_docs = c->docs_cap = h.n_docs;
+    }
+    if (!failed && h.n_keys > 0) {
+        c->keys = calloc((size_t)h.n_keys, sizeof(CatIdxKey));
+        failed = !c->keys;
+        c->keys_cap = h.n_keys;
+    }
+    for (long i = 0; !failed && i < h.n_keys; i++) {
+        CatIdxKeyDisk d;
+        memcpy(&d, base + h.offset_keys + sizeof(d) * i, sizeof(d));
+        if (h.offset_heap + d.name_offset + (long)d.name_len > h.offset_sets ||
+            d.set_offset < 0 || d.set_size < 0 || h.offset_sets + d.set_offset + d.set_size > (long)m.size) {
+            failed = 1;
+            break;
+        }
+        if (d.field < 0 || d.field >= CATIDX_N_FIELDS) {
+            failed = 1;
+            break;
+        }
+        c->keys[i].field = d.field;
+        c->keys[i].name = strndup((const char *)base + h.offset_heap + d.name_offset, d.name_len);
+        if (!c->keys[i].name ||
+            roaring_read(&c->keys[i].docs, base + h.offset_sets + d.set_offset, (size_t)d.set_size) != 0) {
+            free(c->keys[i].name);
+            failed = 1;
+            break;
+        }
+        c->n_keys++;
+    }
+    fmap_close(&m);
+
+    if (failed) {
+        catidx_close(c);
+        return -1;
+    }
+    c->csv_end = h.csv_end;
+    c->file_docs = h.n_docs;
+    c->loaded = 1;
+    return 0;
+}
+
+void catidx_close(CatIndex *c) {
+    for (long i = 0; i < c->n_keys; i++) {
+        free(c->keys[i].name);
+        roaring_free(&c->keys[i].docs);
+    }
+    free(c->keys);
+    free(c->docs);
+    memset(c, 0, sizeof(*c));
+}
+
+// --- Consultas ---
+
+// Número de documento del registro que empieza en csv_offset, o -1.
+long catidx_doc(const CatIndex *c, long csv_offset) {
+    long lo = 0, hi = c->n_docs;
+    while (lo < hi) {
+        long mid = (lo + hi) / 2;
+        if (c->docs[mid] < csv_offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < c->n_docs && c->docs[lo] == csv_offset ? lo : -1;
+}
+
+// Conjunto de una categoría o licencia (sin distinguir mayúsculas), o NULL.
+const Roaring *catidx_get(const CatIndex *c, int field, const char *name) {
+    long i = find_key(c, field, name, strlen(name));
+    return i >= 0 ? &c->keys[i].docs : NULL;
+}
+
+static int contains_ci(const char *haystack, const char *needle) {
+    size_t n = strlen(needle);
+    for (; *haystack; haystack++)
+        if (strncasecmp(haystack, needle, n) == 0) return 1;
+    return n == 0;
+}
+
+static int set_card_cmp(const void *a, const void *b) {
+    long x = roaring_cardinality(*(const Roaring *const *)a);
+    long y = roaring_cardinality(*(const Roaring *const *)b);
+    return (x > y) - (x < y);
+}
+
+// Deja en out los documentos que tienen todas las categorías de categories
+// (separadas por espacios o comas) y la licencia license. La licencia se
+// busca exacta y, si no hay ninguna así, vale cualquiera que la contenga
+// ("by-nc-sa" junta todas las versiones). NULL o "" no filtra por ese campo;
+// sin ningún filtro out queda vacío.
+// Los conjuntos se cruzan del más chico al más grande.
+int catidx_filter(const CatIndex *c, const char *categories, const char *license, Roaring *out) {
+    roaring_init(out);
+    const Roaring *sets[64];
+    int n_sets = 0;
+    Roaring licenses;
+    roaring_init(&licenses);
+
+    for (const char *p = categories ? categories : ""; *p; ) {
+        while (*p == ' ' || *p == ',') p++;
+        const char *start = p;
+        while (*p && *p != ' ' && *p != ',') p++;
+        if (p == start) continue;
+        long i = find_key(c, CATIDX_CATEGORY, start, (size_t)(p - start));
+        if (i < 0) return 0;                    // categoría desconocida: nada
+        if (n_sets < (int)(sizeof(sets) / sizeof(sets[0])) - 1) sets[n_sets++] = &c->keys[i].docs;
+    }
+
+    if (license && *license) {
+        const Roaring *exact = catidx_get(c, CATIDX_LICENSE, license);
+        if (exact) sets[n_sets++] = exact;
+        else {
+            for (long i = 0; i < c->n_keys; i++) {
+                if (c->keys[i].field != CATIDX_LICENSE || !contains_ci(c->keys[i].name, license)) continue;
+                Roaring merged;
+                if (roaring_or(&licenses, &c->keys[i].docs, &merged) != 0) {
+                    roaring_free(&licenses);
+                    return -1;
+                }
+                roaring_free(&licenses);
+                licenses = merged;
+            }
+            if (licenses.n == 0) return 0;
+            sets[n_sets++] = &licenses;
+        }
+    }
+    if (n_sets == 0) return 0;
+
+    qsort(sets, (size_t)n_sets, sizeof(sets[0]), set_card_cmp);
+    int rc = roaring_copy(sets[0], out);
+    for (int i = 1; rc == 0 && i < n_sets && out->n > 0; i++) {
+        Roaring next;
+        rc = roaring_and(out, sets[i], &next);
+        roaring_free(out);
+        if (rc == 0) *out = next;
+    }
+    roaring_free(&licenses);
+    return rc;
+}
+
+// --- Facetas ---
+
+static int facet_cmp(const void *a, const void *b) {
+    const FacetCount *x = a, *y = b;
+    if (x->field != y->field) return x->field - y->field;
+    if (x->field == CATIDX_YEAR) return strcmp(x->name, y->name);
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return strcasecmp(x->name, y->name);
+}
+
+// Deja en *out (malloc) el conteo de cada categoría, licencia y año: el
+// tamaño de su conjunto, o con within el de su intersección con within
+// (sin armarla). Ordenados por campo; dentro de cada campo de mayor a menor
+// conteo, salvo los años que van en orden. Se omiten los conteos en 0.
+// Devuelve la cantidad, o -1 si falla.
+long catidx_facets(const CatIndex *c, const Roaring *within, FacetCount **out) {
+    FacetCount *f = malloc(sizeof(FacetCount) * (c->n_keys ? c->n_keys : 1));
+    if (!f) return -1;
+    long n = 0;
+    for (long i = 0; i < c->n_keys; i++) {
+        const Roaring *set = &c->keys[i].docs;
+        long count = within ? roaring_and_cardinality(set, within) : roaring_cardinality(set);
+        if (count == 0) continue;
+        f[n].field = c->keys[i].field;
+        f[n].name = c->keys[i].name;
+        f[n].count = count;
+        n++;
+    }
+    qsort(f, (size_t)n, sizeof(FacetCount), facet_cmp);
+    *out = f;
+    return n;
+}
@@ -0,0 +1,87 @@
+#ifndef CATIDX_H
+#define CATIDX_H
+
+#include <stddef.h>
+#include "roaring.h"
+
+#define CATEGORIES_FILE "categories.bin"
+#define CATIDX_MAGIC 0x53544143u    /* "CATS" */
+#define CATIDX_VERSION 2
+#define CATEGORY_COLUMN 6           /* categories: "cs.AI math.CO ..." */
+#define LICENSE_COLUMN 11           /* license */
+#define YEAR_COLUMN 12              /* update_date: se usa el año */
+
+enum { CATIDX_CATEGORY = 0, CATIDX_LICENSE = 1, CATIDX_YEAR = 2, CATIDX_N_FIELDS };
+
+/* Índice de categorías, licencias y años: un conjunto roaring (roaring.h)
+   de números de documento por cada categoría (cada palabra de la columna
+   6), por cada licencia (la columna 11 completa) y por cada año de
+   update_date. Los documentos son los registros del CSV en orden, así que
+   su número crece con el offset. El tamaño de cada conjunto es además el
+   conteo de esa faceta (catidx_facets).
+
+   Disposición de categories.bin:
+     CatIdxHeader
+     long[n_docs]                offset en el CSV de cada documento
+     CatIdxKeyDisk[n_keys]       ordenadas por (field, nombre sin mayúsculas)
+     heap de nombres             sin '\0'
+     conjuntos serializados      (roaring_write)
+
+   Al abrirlo se carga completo en memoria: las inserciones agregan el
+   documento a sus conjuntos y el archivo se vuelve a escribir cuando lo
+   agregado ya es mucho (como abstracts.bin). */
+typedef struct {
+    unsigned int magic;
+    int version;
+    long n_docs;
+    long n_keys;
+    long csv_end;           /* tamaño del CSV cubierto */
+    long offset_docs;
+    long offset_keys;
+    long offset_heap;
+    long offset_sets;
+} CatIdxHeader;
+
+typedef struct {
+    int field;              /* CATIDX_CATEGORY, CATIDX_LICENSE o CATIDX_YEAR */
+    unsigned int name_len;
+    long name_offset;       /* relativo al heap */
+    long set_offset;        /* relativo al inicio de los conjuntos */
+    long set_size;
+} CatIdxKeyDisk;
+
+typedef struct {
+    int field;
+    char *name;
+    Roaring docs;
+} CatIdxKey;
+
+typedef struct {
+    long *docs;             /* offset en el CSV de cada documento */
+    long n_docs, docs_cap;
+    CatIdxKey *keys;        /* ordenadas como en el archivo */
+    long n_keys, keys_cap;
+    long csv_end;
+    long file_docs;         /* documentos que ya estaban en el archivo */
+    int loaded;
+} CatIndex;
+
+/* Conteo de una faceta: name apunta al nombre guardado en el índice. */
+typedef struct {
+    int field;
+    const char *name;
+    long count;
+} FacetCount;
+
+int   catidx_build(const char *csv_path, const char *out_path);
+int   catidx_open(CatIndex *c, const char *path);
+int   catidx_write(const CatIndex *c, const char *path);
+void  catidx_close(CatIndex *c);
+int   catidx_add_line(CatIndex *c, const char *line, const char *end, long csv_offset);
+int   catidx_catch_up(CatIndex *c, const char *csv_base, size_t csv_size);
+long  catidx_doc(const CatIndex *c, long csv_offset);
+const Roaring *catidx_get(const CatIndex *c, int field, const char *name);
+int   catidx_filter(const CatIndex *c, const char *categories, const char *license, Roaring *out);
+long  catidx_facets(const CatIndex *c, const Roaring *within, FacetCount **out);
+
+#endif
@@ -0,0 +1,311 @@
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "csv.h"
+
+// Elimina espacios en blanco al inicio y al final de una cadena,
+// modificando directamente el mismo string (in-place)
+void trim_inplace(char *s) {
+    if (!s) return;
+    char *a = s;
+
+    // Avanza a mientras haya espacios al inicio
+    while (*a && isspace((unsigned char)*a)) a++;
+
+    if (a != s) memmove(s, a, strlen(a)+1); // Copiar a en s
+    size_t n = strlen(s);
+
+    // Mientras haya espacios al final pone un fin de cadena
+    while (n > 0 && isspace((unsigned char)s[n-1])) {
+        s[n-1] = '\0';
+        n--;
+    }
+}
+
+// ============================================================================
+// Tokenizador (RFC 4180)
+//
+// El texto se procesa en bloques de 64 bytes. Por bloque se arman tres
+// máscaras de 64 bits (bit i = el byte i es '"', ',' o '\n'); con SSE2 son
+// cuatro comparaciones de 16 bytes cada una. El XOR prefijo de la máscara de
+// comillas marca los bytes que están dentro de un campo entre comillas (una
+// comilla abre, la siguiente cierra; la comilla escapada "" abre y cierra en
+// el mismo lugar, así que no cambia nada). Las comas y saltos que no están
+// dentro de comillas son los separadores. El estado "dentro de comillas"
+// pasa de un bloque al siguiente.
+
+#define CSV_BLOCK 64
+
+typedef struct {
+    const char *block;      // inicio del bloque actual
+    const char *end;
+    uint64_t seps;          // separadores del bloque aún no entregados
+    uint64_t newlines;      // los que son '\n'
+    uint64_t inside;        // todo 1 si el bloque anterior terminó dentro de comillas
+} CsvScanner;
+
+static void block_masks(const char *p, uint64_t *quote, uint64_t *comma, uint64_t *nl) {
+#ifdef __SSE2__
+    const __m128i vq = _mm_set1_epi8('"'), vc = _mm_set1_epi8(','), vn = _mm_set1_epi8('\n');
+    uint64_t q = 0, c = 0, n = 0;
+    for (int k = 0; k < 4; k++) {
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+        q |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(b, vq)) << (16 * k);
+        c |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(b, vc)) << (16 * k);
+        n |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(b, vn)) << (16 * k);
+    }
+    *quote = q; *comma = c; *nl = n;
+#else
+    uint64_t q = 0, c = 0, n = 0;
+    for (int i = 0; i < CSV_BLOCK; i++) {
+        q |= (uint64_t)(p[i] == '"') << i;
+        c |= (uint64_t)(p[i] == ',') << i;
+        n |= (uint64_t)(p[i] == '\n') << i;
+    }
+    *quote = q; *comma = c; *nl = n;
+#endif
+}
+
+// Bit i = XOR de los bits 0..i
+static uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+static void scanner_load(CsvScanner *s) {
+    char tmp[CSV_BLOCK];
+    const char *p = s->block;
+    size_t avail = (size_t)(s->end - p);
+    if (avail < CSV_BLOCK) {
+        // Último bloque: copiado y completado con ceros para no leer fuera
+        memcpy(tmp, p, avail);
+        memset(tmp + avail, 0, CSV_BLOCK - avail);
+        p = tmp;
+    }
+    uint64_t quote, comma, nl;
+    block_masks(p, &quote, &comma, &nl);
+    uint64_t in = prefix_xor(quote) ^ s->inside;
+    s->inside = (uint64_t)((int64_t)in >> 63);
+    s->seps = (comma | nl) & ~in;
+    s->newlines = nl & ~in;
+}
+
+static void scanner_init(CsvScanner *s, const char *p, const char *end) {
+    s->block = p;
+    s->end = end;
+    s->inside = 0;
+    s->seps = s->newlines = 0;
+    if (p < end) scanner_load(s);
+}
+
+// Próximo ',' o '\n' fuera de comillas, o end si no hay más.
+static const char *scanner_next(CsvScanner *s) {
+    while (!s->seps) {
+        if (s->end - s->block <= CSV_BLOCK) return s->end;
+        s->block += CSV_BLOCK;
+        scanner_load(s);
+    }
+    int bit = __builtin_ctzll(s->seps);
+    s->seps &= s->seps - 1;
+    s->newlines &= ~((uint64_t)1 << bit);
+    return s->block + bit;
+}
+
+// Próximo '\n' fuera de comillas (saltando las comas), o end.
+static const char *scanner_next_newline(CsvScanner *s) {
+    while (!s->newlines) {
+        if (s->end - s->block <= CSV_BLOCK) return s->end;
+        s->block += CSV_BLOCK;
+        scanner_load(s);
+    }
+    int bit = __builtin_ctzll(s->newlines);
+    s->newlines &= s->newlines - 1;
+    s->seps &= ~(((uint64_t)2 << bit) - 1);
+    return s->block + bit;
+}
+
+// Campo [start, stop) -> contenido sin las comillas de afuera ni el '\r' final
+static void field_set(CsvField *f, const char *start, const char *stop) {
+    if (start < stop && *start == '"') {
+        // Lo que viene después de la comilla de cierre (no debería haber
+        // nada) se descarta, como antes
+        const char *close = stop;
+        while (close > start + 1 && close[-1] != '"') close--;
+        f->start = start + 1;
+        f->len = close > start + 1 ? (size_t)(close - 1 - f->start) : (size_t)(stop - f->start);
+        f->quoted = 1;
+    } else {
+        while (stop > start && stop[-1] == '\r') stop--;
+        f->start = start;
+        f->len = (size_t)(stop - start);
+        f->quoted = 0;
+    }
+}
+
+// Fin del registro que empieza en p: el primer '\n' que no está entre
+// comillas, o end. Un registro puede ocupar varias líneas.
+const char *csv_record_end(const char *p, const char *end) {
+    CsvScanner s;
+    scanner_init(&s, p, end);
+    return scanner_next_newline(&s);
+}
+
+// Salta la cabecera (id,submitter,...) si el CSV empieza con ella, con o
+// sin comillas. Devuelve dónde empieza el primer registro.
+const char *csv_skip_header(const char *base, const char *end) {
+    size_t len;
+    const char *first = csv_field_span(base, end, 1, &len);
+    if (!first || len != 2 || memcmp(first, "id", 2) != 0) return base;
+    const char *stop = csv_record_end(base, end);
+    return stop < end ? stop + 1 : end;
+}
+
+// Parte el registro que empieza en line en a lo sumo max_fields campos (sin
+// copiar nada). Devuelve cuántos campos dejó en fields; en *record_end (si
+// no es NULL) queda el fin del registro ('\n' o end).
+int csv_split_record(const char *line, const char *end, CsvField *fields, int max_fields,
+                     const char **record_end) {
+    CsvScanner s;
+    scanner_init(&s, line, end);
+    const char *start = line, *sep;
+    int n = 0;
+    for (;;) {
+        if (n == max_fields) {
+            sep = scanner_next_newline(&s);
+            break;
+        }
+        sep = scanner_next(&s);
+        field_set(&fields[n++], start, sep);
+        if (sep == end || *sep == '\n') break;
+        start = sep + 1;
+    }
+    if (record_end) *record_end = sep;
+    return n;
+}
+
+// Copia el campo a out (hasta out_sz - 1 bytes) cambiando "" por " y
+// termina en '\0'. Devuelve el largo copiado.
+size_t csv_field_copy(const CsvField *f, char *out, size_t out_sz) {
+    if (out_sz == 0) return 0;
+    size_t pos = 0;
+    if (!f->quoted) {
+        pos = f->len < out_sz - 1 ? f->len : out_sz - 1;
+        memcpy(out, f->start, pos);
+    } else {
+        const char *p = f->start, *end = f->start + f->len;
+        while (p < end && pos + 1 < out_sz) {
+            const char *q = memchr(p, '"', (size_t)(end - p));
+            size_t chunk = (size_t)((q ? q : end) - p);
+            if (chunk > out_sz - 1 - pos) chunk = out_sz - 1 - pos;
+            memcpy(out + pos, p, chunk);
+            pos += chunk;
+            p += chunk;
+            if (p < end && *p == '"' && pos + 1 < out_sz) {
+                out[pos++] = '"';
+                p += (p + 1 < end && p[1] == '"') ? 2 : 1;
+            }
+        }
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+static void put_byte(char *out, size_t out_sz, size_t *n, char c) {
+    if (*n + 1 < out_sz) out[*n] = c;
+    (*n)++;
+}
+
+// Escribe s en out como campo entre comillas, con cada " doblada. Como
+// snprintf: escribe a lo sumo out_sz - 1 bytes más '\0' y devuelve el largo
+// completo que hubiera necesitado.
+size_t csv_quote_field(const char *s, char *out, size_t out_sz) {
+    size_t n = 0;
+    put_byte(out, out_sz, &n, '"');
+    for (; *s; s++) {
+        if (*s == '"') put_byte(out, out_sz, &n, '"');
+        put_byte(out, out_sz, &n, *s);
+    }
+    put_byte(out, out_sz, &n, '"');
+    if (out_sz > 0) out[n < out_sz ? n : out_sz - 1] = '\0';
+    return n;
+}
+
+// Parte la cadena s (un registro) en campos dentro del mismo buffer: cada
+// fields[i] apunta al contenido ya sin comillas ni "" y terminado en '\0'.
+// Devuelve la cantidad de campos.
+int csv_split_inplace(char *s, char *fields[], int max_fields) {
+    CsvField spans[CSV_MAX_FIELDS];
+    if (max_fields > CSV_MAX_FIELDS) max_fields = CSV_MAX_FIELDS;
+    int n = csv_split_record(s, s + strlen(s), spans, max_fields, NULL);
+    // Cada campo se desescapa dentro de su propio espacio, que es más largo
+    // que el resultado; el '\0' cae sobre la comilla de cierre o el separador
+    for (int i = 0; i < n; i++) {
+        char *dst = (char *)spans[i].start;
+        size_t len = spans[i].len;
+        if (spans[i].quoted) {
+            const char *src = dst, *end = dst + len;
+            char *w = dst;
+            while (src < end) {
+                if (*src == '"' && src + 1 < end && src[1] == '"') src++;
+                *w++ = *src++;
+            }
+            len = (size_t)(w - dst);
+        }
+        dst[len] = '\0';
+        fields[i] = dst;
+    }
+    return n;
+}
+
+// ============================================================================
+
+// Campo target_col (desde 1) del registro [line, end). Devuelve 0 si el
+// registro no tiene esa columna.
+static int field_at(const char *line, const char *end, int target_col, CsvField *f) {
+    if (target_col < 1 || line >= end || *line == '\n') return 0;
+    CsvScanner s;
+    scanner_init(&s, line, end);
+    const char *start = line;
+    for (int col = 1; col < target_col; col++) {
+        const char *sep = scanner_next(&s);
+        if (sep == end || *sep == '\n') return 0;
+        start = sep + 1;
+    }
+    field_set(f, start, scanner_next(&s));
+    return 1;
+}
+
+// Extrae el contenido de una columna específica (target_col) de un registro
+// CSV terminado en '\0'. Devuelve 1 si logró obtener la columna, 0 si no.
+int csv_get_column(const char *line, int target_col, char *out, size_t out_sz) {
+    CsvField f;
+    if (!field_at(line, line + strlen(line), target_col, &f)) {
+        out[0] = '\0';
+        return 0;
+    }
+    csv_field_copy(&f, out, out_sz);
+    trim_inplace(out); // Quita espacios iniciales y finales en out
+    return 1;
+}
+
+// Como csv_get_column pero sin copiar: devuelve un puntero al contenido de
+// la columna dentro del registro [line, end) y su largo en *len. Las
+// comillas que rodean el campo no se incluyen; las escapadas ("") quedan tal
+// cual. Devuelve NULL si el registro no tiene esa columna.
+const char *csv_field_span(const char *line, const char *end, int target_col, size_t *len) {
+    CsvField f;
+    if (!field_at(line, end, target_col, &f)) {
+        *len = 0;
+        return NULL;
+    }
+    *len = f.len;
+    return f.start;
+}
@@ -0,0 +1,35 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+
+/* Lectura de registros del CSV según RFC 4180: los campos pueden ir entre
+   comillas, con "" como comilla escapada, y un campo entre comillas puede
+   tener comas y saltos de línea (el registro ocupa entonces varias líneas).
+   Todas las funciones usan el mismo tokenizador por bloques de 64 bytes
+   (SSE2 si está disponible), que ubica comillas, comas y saltos con
+   máscaras de bits y no copia nada. */
+
+#define CSV_MAX_FIELDS 64
+
+/* Un campo dentro del texto original: sin las comillas de afuera, con las
+   "" todavía dobles si quoted. */
+typedef struct {
+    const char *start;
+    size_t len;
+    int quoted;
+} CsvField;
+
+void trim_inplace(char *s);
+int csv_get_column(const char *line, int target_col, char *out, size_t out_sz);
+const char *csv_field_span(const char *line, const char *end, int target_col, size_t *len);
+
+const char *csv_record_end(const char *p, const char *end);
+const char *csv_skip_header(const char *base, const char *end);
+int csv_split_record(const char *line, const char *end, CsvField *fields, int max_fields,
+                     const char **record_end);
+size_t csv_field_copy(const CsvField *f, char *out, size_t out_sz);
+int csv_split_inplace(char *s, char *fields[], int max_fields);
+size_t csv_quote_field(const char *s, char *out, size_t out_sz);
+
+#endif
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "csv.h"
+#include "fmap.h"
+#include "dateidx.h"
+
+// --- Construcción ---
+// Una pasada por el CSV juntando (fecha, offset), se ordenan y el árbol
+// se arma de abajo hacia arriba.
+int dateidx_build(const char *csv_path, const char *out_path) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    FileMap csv;
+    if (fmap_open(&csv, csv_path) != 0) return -1;
+    madvise(csv.base, csv.size, MADV_SEQUENTIAL);
+
+    BptPair *pairs = NULL;
+    long n = 0, cap = 0;
+    int failed = 0;
+    const char *base = (const char *)csv.base;
+    const char *end = base + csv.size;
+
+    for (const char *line = csv_skip_header(base, end); !failed && line < end; ) {
+        const char *stop = csv_record_end(line, end);
+        size_t len;
+        const char *date = csv_field_span(line, stop, DATE_COLUMN, &len);
+        if (date && len > 0) {
+            if (n == cap) {
+                long new_cap = cap ? cap * 2 : 4096;
+                BptPair *tmp = realloc(pairs, sizeof(BptPair) * new_cap);
+                if (!tmp) { failed = 1; break; }
+                pairs = tmp;
+                cap = new_cap;
+            }
+            memset(pairs[n].key, 0, sizeof(pairs[n].key));
+            memcpy(pairs[n].key, date, len < DATE_KEY_SIZE ? len : DATE_KEY_SIZE);
+            pairs[n].value = (long)(line - base);
+            n++;
+        }
+        line = stop + 1;
+    }
+
+    if (!failed) {
+        qsort(pairs, n, sizeof(BptPair), bpt_pair_cmp);
+        failed = bpt_build(out_path, DATE_KEY_SIZE, pairs, n, (long)csv.size) != 0;
+    }
+    free(pairs);
+    fmap_close(&csv);
+
+    if (failed) {
+        fprintf(stderr, "[DATES] Error construyendo %s\n", out_path);
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("[DATES] %ld fechas, %.3f s\n", n,
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    return 0;
+}
+
+// Inserta en el árbol la fecha de la línea [line, end). Sin fecha no hace nada.
+int dateidx_add_line(BPTree *t, const char *line, const char *end, long csv_offset) {
+    size_t len;
+    const char *date = csv_field_span(line, end, DATE_COLUMN, &len);
+    if (!date || len == 0) return 0;
+    return bpt_insert(t, date, len, csv_offset);
+}
+
+// Inserta los registros del CSV que el árbol todavía no cubre y avanza csv_end.
+int dateidx_catch_up(BPTree *t, const char *csv_base, size_t csv_size) {
+    const char *end = csv_base + csv_size;
+    const char *line = csv_base + t->h.csv_end;
+    if (t->h.csv_end == 0) line = csv_skip_header(csv_base, end);
+
+    while (line < end) {
+        const char *stop = csv_record_end(line, end);
+        if (dateidx_add_line(t, line, stop, (long)(line - csv_base)) != 0) return -1;
+        line = stop + 1;
+    }
+    return (long)csv_size == t->h.csv_end ? 0 : bpt_set_csv_end(t, (long)csv_size);
+}
+
+// Agrega a la cola en memoria la fecha de la línea [line, end). Sin fecha
+// no hace nada.
+int dateidx_tail_add(DateTail *q, const char *line, const char *end, long csv_offset) {
+    size_t len;
+    const char *date = csv_field_span(line, end, DATE_COLUMN, &len);
+    if (!date || len == 0) return 0;
+    if (q->n == q->cap) {
+        long new_cap = q->cap ? q->cap * 2 : 256;
+        BptPair *tmp = realloc(q->pairs, sizeof(BptPair) * new_cap);
+        if (!tmp) return -1;
+        q->pairs = tmp;
+        q->cap = new_cap;
+    }
+    BptPair *p = &q->pairs[q->n++];
+    memset(p->key, 0, sizeof(p->key));
+    memcpy(p->key, date, len < DATE_KEY_SIZE ? len : DATE_KEY_SIZE);
+    p->value = csv_offset;
+    return 0;
+}
+
+void dateidx_tail_free(DateTail *q) {
+    free(q->pairs);
+    memset(q, 0, sizeof(*q));
+}
+
+// --- Rangos ---
+
+typedef struct {
+    long *offsets;
+    long n, cap;
+    int failed;
+} OffsetList;
+
+static int push_offset(const unsigned char *key, long value, void *arg) {
+    (void)key;
+    OffsetList *l = arg;
+    if (l->n == l->cap) {
+        long new_cap = l->cap ? l->cap * 2 : 256;
+        long *tmp = realloc(l->offsets, sizeof(long) * new_cap);
+        if (!tmp) { l->failed = 1; return 1; }
+        l->offsets = tmp;
+        l->cap = new_cap;
+    }
+    l->offsets[l->n++] = value;
+    return 0;
+}
+
+static int long_cmp(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// Deja en *out (malloc) los offsets de los registros con from <= fecha <= to,
+// del árbol y de la cola q (puede ser NULL), ordenados por offset para poder
+// intersectarlos con otros candidatos. to puede ser un prefijo ("2020" o
+// "2020-03"); NULL o "" deja el extremo abierto. Devuelve la cantidad, o -1
+// si falla.
+long dateidx_collect(const BPTree *t, const DateTail *q, const char *from, const char *to, long **out) {
+    OffsetList l = { NULL, 0, 0, 0 };
+    if (from && !*from) from = NULL;
+    if (to && !*to) to = NULL;
+    if (bpt_range(t, from, from ? strlen(from) : 0, to, to ? strlen(to) : 0, push_offset, &l) != 0 ||
+        l.failed) {
+        free(l.offsets);
+        return -1;
+    }
+
+    // La cola se compara igual que el árbol: from completado con '\0' y to
+    // solo en sus primeros bytes
+    int ks = t->h.key_size;
+    unsigned char lo[BPT_KEY_MAX];
+    memset(lo, 0, sizeof(lo));
+    if (from) memcpy(lo, from, strlen(from) < (size_t)ks ? strlen(from) : (size_t)ks);
+    size_t to_len = to ? strlen(to) : 0;
+    if (to_len > (size_t)ks) to_len = ks;
+    for (long i = 0; q && i < q->n && !l.failed; i++) {
+        const unsigned char *k = q->pairs[i].key;
+        if (from && memcmp(k, lo, ks) < 0) continue;
+        if (to && memcmp(k, to, to_len) > 0) continue;
+        push_offset(k, q->pairs[i].value, &l);
+    }
+    if (l.failed) {
+        free(l.offsets);
+        return -1;
+    }
+    qsort(l.offsets, l.n, sizeof(long), long_cmp);
+    *out = l.offsets;
+    return l.n;
+}
@@ -0,0 +1,29 @@
+#ifndef DATEIDX_H
+#define DATEIDX_H
+
+#include <stddef.h>
+#include "bptree.h"
+
+#define DATES_FILE "dates.bin"
+#define DATE_COLUMN 12              /* update_date */
+#define DATE_KEY_SIZE 10            /* "YYYY-MM-DD" */
+
+/* Índice secundario por update_date: un árbol B+ (bptree.h) de
+   (fecha, offset en el CSV). Como en los índices de títulos, lo insertado
+   con el servidor andando queda en una cola en memoria (DateTail) y el
+   archivo no se toca mientras se lee; al abrirlo la próxima vez,
+   dateidx_catch_up le agrega lo que su csv_end no cubre. */
+
+typedef struct {
+    BptPair *pairs;     /* en orden de inserción */
+    long n, cap;
+} DateTail;
+
+int  dateidx_build(const char *csv_path, const char *out_path);
+int  dateidx_add_line(BPTree *t, const char *line, const char *end, long csv_offset);
+int  dateidx_catch_up(BPTree *t, const char *csv_base, size_t csv_size);
+int  dateidx_tail_add(DateTail *q, const char *line, const char *end, long csv_offset);
+void dateidx_tail_free(DateTail *q);
+long dateidx_collect(const BPTree *t, const DateTail *q, const char *from, const char *to, long **out);
+
+#endif
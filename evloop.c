@@ -0,0 +1,402 @@
+#define _GNU_SOURCE     // accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "evloop.h"
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void put_u32(char *p, uint32_t v) {
+    uint32_t net = htonl(v);
+    memcpy(p, &net, 4);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    uint32_t net;
+    memcpy(&net, p, 4);
+    return ntohl(net);
+}
+
+// Enmarca msg como respuesta de r: (len, bytes) en versión 1 y
+// (id, len, bytes) en versión 2
+static int frame_reply(EvRequest *r, const char *msg) {
+    size_t len = strlen(msg), head = r->version >= 2 ? 8 : 4;
+    r->out = malloc(head + len);
+    if (!r->out) {
+        perror("malloc");
+        return -1;
+    }
+    if (r->version >= 2) put_u32(r->out, r->id);
+    put_u32(r->out + head - 4, (uint32_t)len);
+    memcpy(r->out + head, msg, len);
+    r->out_len = head + len;
+    return 0;
+}
+
+static void free_request(EvRequest *r) {
+    free(r->payload);
+    free(r->out);
+    free(r);
+}
+
+// --- Conexiones ---
+
+static void accept_all(EvLoop *l);
+
+// Una petición de c ya no está pendiente (se escribió o se descartó). Si c
+// estaba cerrada y era la última, c se libera al terminar la vuelta.
+static void request_done(EvLoop *l, EvConn *c, EvRequest *r) {
+    free_request(r);
+    if (--c->inflight == 0 && c->closed) {
+        c->next = l->dead;
+        l->dead = c;
+    }
+}
+
+static void conn_close(EvLoop *l, EvConn *c) {
+    if (c->closed) return;
+    close(c->fd);           // también la saca del epoll
+    c->closed = 1;
+    if (c->req) {
+        free_request(c->req);
+        c->req = NULL;
+    }
+    // Las respuestas por escribir se descartan (la última que se descarta la
+    // manda a liberar); las que están en un hilo o esperando uno, al volver
+    if (c->inflight == 0) {
+        c->next = l->dead;
+        l->dead = c;
+    }
+    while (c->out_head) {
+        EvRequest *r = c->out_head;
+        c->out_head = r->next;
+        request_done(l, c, r);
+    }
+    c->out_tail = NULL;
+
+    pthread_mutex_lock(&l->lock);
+    l->open--;
+    pthread_mutex_unlock(&l->lock);
+    if (l->accept_full) accept_all(l);
+}
+
+static void free_dead(EvLoop *l) {
+    while (l->dead) {
+        EvConn *c = l->dead;
+        l->dead = c->next;
+        free(c);
+    }
+}
+
+// Pasa la petición a dispatch o, si no la toma, a la cola de espera (en
+// orden de llegada, detrás de las que ya esperan)
+static void request_dispatch(EvLoop *l, EvRequest *r) {
+    if (!l->wait_head && l->dispatch(r, l->arg) == 0) return;
+    r->next = NULL;
+    if (l->wait_tail) l->wait_tail->next = r;
+    else l->wait_head = r;
+    l->wait_tail = r;
+    pthread_mutex_lock(&l->lock);
+    l->waiting++;
+    pthread_mutex_unlock(&l->lock);
+}
+
+static void retry_waiting(EvLoop *l) {
+    while (l->wait_head) {
+        EvRequest *r = l->wait_head;
+        EvRequest *next = r->next;      // una vez entregada, r->next es del hilo que la atiende
+        if (r->conn->closed) request_done(l, r->conn, r);   // nadie espera la respuesta
+        else if (l->dispatch(r, l->arg) != 0) return;
+        l->wait_head = next;
+        if (!next) l->wait_tail = NULL;
+        pthread_mutex_lock(&l->lock);
+        l->waiting--;
+        pthread_mutex_unlock(&l->lock);
+    }
+}
+
+// Escribe las respuestas pendientes que el socket acepte. Devuelve -1 si
+// hay que cerrar la conexión (falló, o terminó todo lo que tenía que hacer).
+static int conn_flush(EvLoop *l, EvConn *c) {
+    while (c->out_head) {
+        EvRequest *r = c->out_head;
+        while (c->out_sent < r->out_len) {
+            ssize_t w = send(c->fd, r->out + c->out_sent, r->out_len - c->out_sent, MSG_NOSIGNAL);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;     // sigue con el próximo EPOLLOUT
+                return -1;
+            }
+            c->out_sent += (size_t)w;
+        }
+        c->out_head = r->next;
+        if (!c->out_head) c->out_tail = NULL;
+        c->out_sent = 0;
+        request_done(l, c, r);
+    }
+    // Versión 1 después de su única petición, o versión 2 después de que el
+    // cliente cerró: se cierra cuando no queda nada por responder
+    return c->state == EV_READ_DONE && c->inflight == 0 ? -1 : 0;
+}
+
+static int conn_reply(EvLoop *l, EvConn *c, EvRequest *r) {
+    r->next = NULL;
+    if (c->out_tail) c->out_tail->next = r;
+    else c->out_head = r;
+    c->out_tail = r;
+    return c->out_head == r ? conn_flush(l, c) : 0;
+}
+
+// HELLO: se responde acá mismo, en versión 1, con la versión que se va a usar
+static int conn_hello(EvLoop *l, EvConn *c, EvRequest *r) {
+    // En versión 1 ya se dejó de leer; si pasa a la 2 se sigue
+    if (c->version < 2 && atoi(r->payload) >= 2) {
+        c->version = EV_PROTO_MAX;
+        c->state = EV_READ_HEAD;
+    }
+    char msg[16];
+    snprintf(msg, sizeof(msg), "%d", c->version);
+    if (frame_reply(r, msg) != 0) return -1;
+    return conn_reply(l, c, r);
+}
+
+// Cabecera completa: prepara la petición para leer su payload
+static int start_request(EvLoop *l, EvConn *c) {
+    EvRequest *r = calloc(1, sizeof(*r));
+    if (!r) {
+        perror("calloc");
+        return -1;
+    }
+    r->conn = c;
+    r->version = c->version;
+    r->cmd = get_u32(c->head);
+    if (c->version >= 2) r->id = get_u32(c->head + 4);
+    r->len = get_u32(c->head + (c->version >= 2 ? 8 : 4));
+    if (r->len > EV_MAX_PAYLOAD) {
+        fprintf(stderr, "Servidor: petición de %u bytes, se cierra la conexión\n", r->len);
+        free(r);
+        return -1;
+    }
+    r->payload = malloc((size_t)r->len + 1);
+    if (!r->payload) {
+        perror("malloc");
+        free(r);
+        return -1;
+    }
+    c->req = r;
+    c->payload_got = 0;
+    c->state = EV_READ_BODY;
+    pthread_mutex_lock(&l->lock);
+    l->requests++;
+    pthread_mutex_unlock(&l->lock);
+    return 0;
+}
+
+// Lee lo que haya (edge-triggered: hasta EAGAIN) y avanza la máquina de
+// estados. Devuelve -1 si hay que cerrar la conexión.
+static int conn_read(EvLoop *l, EvConn *c) {
+    for (;;) {
+        if (c->state == EV_READ_DONE) return 0;
+        size_t head_len = c->version >= 2 ? 12 : 8;
+        if (c->state == EV_READ_HEAD && c->head_got == head_len && start_request(l, c) != 0) return -1;
+        if (c->state == EV_READ_BODY && c->payload_got == c->req->len) {
+            EvRequest *r = c->req;
+            r->payload[r->len] = '\0';
+            c->req = NULL;
+            c->head_got = 0;
+            // Versión 1: una petición por conexión, no se lee más
+            c->state = c->version >= 2 ? EV_READ_HEAD : EV_READ_DONE;
+            c->inflight++;
+            if (r->cmd == EV_CMD_HELLO) {
+                if (conn_hello(l, c, r) != 0) return -1;
+            } else {
+                request_dispatch(l, r);
+            }
+            continue;
+        }
+        // Con muchas sin responder se deja de leer; take_done retoma
+        if (c->inflight >= EV_MAX_INFLIGHT) {
+            c->paused = 1;
+            return 0;
+        }
+
+        ssize_t n;
+        if (c->state == EV_READ_HEAD) n = read(c->fd, c->head + c->head_got, head_len - c->head_got);
+        else n = read(c->fd, c->req->payload + c->payload_got, c->req->len - c->payload_got);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;     // falta que llegue el resto
+            return -1;
+        }
+        if (n == 0) {
+            if (c->state == EV_READ_BODY || c->head_got > 0) {
+                fprintf(stderr, "Servidor: conexión cortada a mitad de una petición\n");
+                return -1;
+            }
+            // El cliente terminó de mandar: se responde lo pendiente y se cierra
+            c->state = EV_READ_DONE;
+            return c->inflight == 0 ? -1 : 0;
+        }
+        if (c->state == EV_READ_HEAD) c->head_got += (size_t)n;
+        else c->payload_got += (size_t)n;
+    }
+}
+
+// Respuestas que dejaron los hilos: se empiezan a escribir, y como se
+// liberó lugar se reintenta con las peticiones en espera
+static void take_done(EvLoop *l) {
+    uint64_t n;
+    while (read(l->wake_fd, &n, sizeof(n)) < 0 && errno == EINTR) {}
+
+    pthread_mutex_lock(&l->lock);
+    EvRequest *r = l->done_head;
+    l->done_head = l->done_tail = NULL;
+    pthread_mutex_unlock(&l->lock);
+
+    while (r) {
+        EvRequest *next = r->next;
+        EvConn *c = r->conn;
+        free(r->payload);
+        r->payload = NULL;
+        if (c->closed) {
+            request_done(l, c, r);
+        } else if (!r->out) {
+            // Versión 1 sin respuesta (comando desconocido): se cierra como siempre
+            request_done(l, c, r);
+            conn_close(l, c);
+        } else if (conn_reply(l, c, r) != 0) {
+            conn_close(l, c);
+        } else if (c->paused && c->inflight < EV_MAX_INFLIGHT) {
+            c->paused = 0;
+            if (conn_read(l, c) != 0) conn_close(l, c);
+        }
+        r = next;
+    }
+    retry_waiting(l);
+}
+
+static void accept_all(EvLoop *l) {
+    l->accept_full = 0;
+    for (;;) {
+        int fd = accept4(l->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                // Las pendientes siguen en el backlog y con edge-triggered no
+                // vuelve a avisar: se reintenta cuando se cierre alguna
+                if (!l->accept_full) fprintf(stderr, "Servidor: sin descriptores para aceptar más conexiones\n");
+                l->accept_full = 1;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            return;
+        }
+
+        EvConn *c = calloc(1, sizeof(*c));
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = c };
+        if (!c || epoll_ctl(l->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            perror("Servidor: no se pudo registrar la conexión");
+            close(fd);
+            free(c);
+            continue;
+        }
+        // Si la petición ya llegó, el EPOLL_CTL_ADD igual genera el evento
+        c->fd = fd;
+        c->version = 1;
+        c->state = EV_READ_HEAD;
+        pthread_mutex_lock(&l->lock);
+        l->accepted++;
+        if (++l->open > l->open_max) l->open_max = l->open;
+        pthread_mutex_unlock(&l->lock);
+    }
+}
+
+// --- API ---
+
+// Prepara el bucle sobre listen_fd (que ya escucha). Devuelve 0, o -1 si falla.
+int evloop_init(EvLoop *l, int listen_fd, EvDispatch dispatch, void *arg) {
+    memset(l, 0, sizeof(*l));
+    l->listen_fd = listen_fd;
+    l->dispatch = dispatch;
+    l->arg = arg;
+    pthread_mutex_init(&l->lock, NULL);
+
+    l->epfd = epoll_create1(EPOLL_CLOEXEC);
+    l->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLET, .data.ptr = &l->listen_fd };
+    struct epoll_event wake = { .events = EPOLLIN | EPOLLET, .data.ptr = &l->wake_fd };
+    if (l->epfd < 0 || l->wake_fd < 0 || set_nonblocking(listen_fd) != 0 ||
+        epoll_ctl(l->epfd, EPOLL_CTL_ADD, listen_fd, &ev) != 0 ||
+        epoll_ctl(l->epfd, EPOLL_CTL_ADD, l->wake_fd, &wake) != 0) {
+        perror("Servidor: no se pudo preparar epoll");
+        if (l->epfd >= 0) close(l->epfd);
+        if (l->wake_fd >= 0) close(l->wake_fd);
+        pthread_mutex_destroy(&l->lock);
+        return -1;
+    }
+    return 0;
+}
+
+// Atiende eventos hasta que epoll falle. Devuelve -1.
+int evloop_run(EvLoop *l) {
+    struct epoll_event events[EV_MAX_EVENTS];
+    for (;;) {
+        int n = epoll_wait(l->epfd, events, EV_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &l->listen_fd) { accept_all(l); continue; }
+            if (ptr == &l->wake_fd) { take_done(l); continue; }
+
+            EvConn *c = ptr;
+            if (c->closed) continue;
+            if ((events[i].events & EPOLLERR) ||
+                (c->out_head && conn_flush(l, c) != 0) ||
+                conn_read(l, c) != 0) conn_close(l, c);
+        }
+        free_dead(l);
+    }
+}
+
+// La llama el hilo que atendió r: deja la respuesta msg para que el bucle
+// la escriba. Con NULL (comando desconocido) en versión 1 la conexión se
+// cierra sin responder, como siempre; en versión 2 se responde
+// EV_UNKNOWN_REPLY para no dejar al cliente esperando ese id.
+void evloop_complete(EvLoop *l, EvRequest *r, const char *msg) {
+    if (!msg && r->version >= 2) msg = EV_UNKNOWN_REPLY;
+    if (msg) frame_reply(r, msg);
+
+    pthread_mutex_lock(&l->lock);
+    r->next = NULL;
+    if (l->done_tail) l->done_tail->next = r;
+    else l->done_head = r;
+    l->done_tail = r;
+    pthread_mutex_unlock(&l->lock);
+
+    uint64_t one = 1;
+    if (write(l->wake_fd, &one, sizeof(one)) < 0) perror("eventfd");
+}
+
+void evloop_stats(EvLoop *l, EvStats *s) {
+    pthread_mutex_lock(&l->lock);
+    s->open = l->open;
+    s->open_max = l->open_max;
+    s->accepted = l->accepted;
+    s->waiting = l->waiting;
+    s->requests = l->requests;
+    pthread_mutex_unlock(&l->lock);
+}
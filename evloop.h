@@ -0,0 +1,98 @@
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define EV_MAX_PAYLOAD (16u << 20)  /* una petición más larga cierra la conexión */
+#define EV_MAX_EVENTS 256           /* eventos por epoll_wait */
+#define EV_MAX_INFLIGHT 64          /* peticiones sin responder por conexión; con más se deja de leer */
+
+#define EV_CMD_HELLO 12             /* negociación de versión (la atiende el bucle) */
+#define EV_PROTO_MAX 2
+
+/* Bucle de eventos del servidor: un solo hilo con epoll (edge-triggered)
+   y sockets no bloqueantes atiende todas las conexiones.
+   Cada conexión es una máquina de estados que lee cabecera y payload a
+   medida que llegan; cada petición completa se le pasa a dispatch (que la
+   manda a un hilo de cómputo). El hilo que la atendió llama a
+   evloop_complete con la respuesta, que vuelve al bucle por una cola y un
+   eventfd, y el bucle la escribe de a pedazos cuando el socket acepta más.
+   Un cliente lento solo ocupa su propia conexión, no un hilo.
+
+   Protocolo:
+   - versión 1 (la de siempre, sin negociar): petición (cmd u32, len u32,
+     payload), respuesta (len u32, bytes), y el servidor cierra.
+   - HELLO: petición de versión 1 con cmd EV_CMD_HELLO y como payload la
+     versión que quiere el cliente ("2"). Responde, en versión 1, la que se
+     va a usar ("2", o "1" si no la soporta; con "1" cierra como siempre).
+     Un servidor viejo cierra sin responder: el cliente sigue en versión 1.
+   - versión 2: la conexión queda abierta. Petición (cmd u32, id u32,
+     len u32, payload), respuesta (id u32, len u32, bytes). Se pueden
+     mandar varias sin esperar (pipelining); las respuestas salen a medida
+     que terminan, no necesariamente en orden, con el id de su petición.
+     Un comando desconocido responde EV_UNKNOWN_REPLY. Cierra el cliente.
+   Todos los enteros van en big-endian. */
+
+#define EV_UNKNOWN_REPLY "ERROR: comando desconocido"
+
+typedef struct EvConn EvConn;
+typedef struct EvRequest EvRequest;
+
+struct EvRequest {
+    EvConn *conn;
+    int version;                /* la de la conexión al leerla (así se enmarca la respuesta) */
+    uint32_t cmd, id, len;
+    char *payload;              /* len bytes + '\0' */
+    char *out;                  /* respuesta ya enmarcada */
+    size_t out_len;
+    EvRequest *next;            /* en la cola de espera, de terminadas o de salida */
+};
+
+enum { EV_READ_HEAD, EV_READ_BODY, EV_READ_DONE };
+
+struct EvConn {
+    int fd;
+    int version;                /* 1 o 2 */
+    int state;                  /* lectura: EV_READ_* */
+    int closed;                 /* fd cerrado; se libera al volver sus peticiones */
+    unsigned char head[12];     /* cmd, [id,] len */
+    size_t head_got;
+    EvRequest *req;             /* la que se está leyendo */
+    size_t payload_got;
+    int inflight;               /* leídas y todavía sin escribir */
+    int paused;                 /* se dejó de leer por EV_MAX_INFLIGHT */
+    EvRequest *out_head, *out_tail;     /* respuestas por escribir, en orden de llegada */
+    size_t out_sent;            /* de out_head */
+    EvConn *next;               /* en la lista de cerradas */
+};
+
+/* dispatch: entrega una petición completa. Devuelve 0 si la tomó, o -1 si
+   ahora no puede (se reintenta cuando termine alguna otra). */
+typedef int (*EvDispatch)(EvRequest *r, void *arg);
+
+typedef struct {
+    int epfd, listen_fd, wake_fd;
+    EvDispatch dispatch;
+    void *arg;
+
+    pthread_mutex_t lock;       /* protege done y los contadores */
+    EvRequest *done_head, *done_tail;   /* respuestas listas (las deja evloop_complete) */
+    EvRequest *wait_head, *wait_tail;   /* peticiones que dispatch no pudo tomar */
+    EvConn *dead;               /* para liberar al final de la vuelta: puede
+                                   quedar otro evento suyo en el lote */
+    int accept_full;            /* accept falló por falta de descriptores */
+    long open, open_max, accepted, waiting, requests;
+} EvLoop;
+
+typedef struct {
+    long open, open_max, accepted, waiting, requests;
+} EvStats;
+
+int  evloop_init(EvLoop *l, int listen_fd, EvDispatch dispatch, void *arg);
+int  evloop_run(EvLoop *l);
+void evloop_complete(EvLoop *l, EvRequest *r, const char *msg);
+void evloop_stats(EvLoop *l, EvStats *s);
+
+#endif
@@ -0,0 +1,72 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fmap.h"
+
+#define FMAP_MIN_SLACK ((size_t)64 << 20)  /* al menos 64 MB libres para crecer */
+
+// Reserva el doble del tamaño actual (o tamaño + 64 MB), redondeado a página.
+static size_t fmap_reserve_for(size_t size) {
+    size_t slack = size > FMAP_MIN_SLACK ? size : FMAP_MIN_SLACK;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + slack + page - 1) / page * page;
+}
+
+// Mapea en solo lectura y compartido: lo que se escribe con write/pwrite en
+// el archivo se ve en el mapeo (misma caché de páginas). Acceder a páginas
+// por encima del fin de archivo daría SIGBUS, por eso solo se lee hasta size.
+static int fmap_map(FileMap *m, size_t size) {
+    size_t reserve = fmap_reserve_for(size);
+    void *p;
+    if (m->base) p = mremap(m->base, m->reserved, reserve, MREMAP_MAYMOVE);
+    else p = mmap(NULL, reserve, PROT_READ, MAP_SHARED, m->fd, 0);
+    if (p == MAP_FAILED) return -1;
+
+    m->base = p;
+    m->reserved = reserve;
+    m->size = size;
+    madvise(m->base, m->reserved, MADV_RANDOM);
+    return 0;
+}
+
+int fmap_open(FileMap *m, const char *path) {
+    memset(m, 0, sizeof(*m));
+    m->fd = open(path, O_RDONLY);
+    if (m->fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(m->fd, &st) != 0 || fmap_map(m, (size_t)st.st_size) != 0) {
+        int e = errno;
+        close(m->fd);
+        m->fd = -1;
+        errno = e;
+        return -1;
+    }
+    return 0;
+}
+
+// Actualiza el tamaño visible tras una escritura; remapea solo si el
+// archivo ya no entra en lo reservado.
+int fmap_refresh(FileMap *m) {
+    struct stat st;
+    if (m->fd < 0 || fstat(m->fd, &st) != 0) return -1;
+    size_t size = (size_t)st.st_size;
+    if (size <= m->reserved) {
+        m->size = size;
+        return 0;
+    }
+    m->remaps++;
+    return fmap_map(m, size);
+}
+
+void fmap_close(FileMap *m) {
+    if (m->base) munmap(m->base, m->reserved);
+    if (m->fd >= 0) close(m->fd);
+    memset(m, 0, sizeof(*m));
+    m->fd = -1;
+}
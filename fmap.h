@@ -0,0 +1,23 @@
+#ifndef FMAP_H
+#define FMAP_H
+
+#include <stddef.h>
+
+/* Archivo mapeado en memoria que puede crecer.
+   Se reserva más espacio de direcciones que el tamaño del archivo para que
+   las escrituras al final (inserciones) no obliguen a remapear: basta
+   fmap_refresh() para ver el nuevo tamaño. Solo se remapea cuando el
+   archivo supera lo reservado. */
+typedef struct {
+    int fd;
+    unsigned char *base;    /* NULL si el archivo está vacío */
+    size_t size;            /* bytes válidos (tamaño del archivo al último refresh) */
+    size_t reserved;        /* bytes de espacio de direcciones mapeados */
+    int remaps;             /* cuántas veces hubo que remapear */
+} FileMap;
+
+int  fmap_open(FileMap *m, const char *path);
+int  fmap_refresh(FileMap *m);
+void fmap_close(FileMap *m);
+
+#endif
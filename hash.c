@@ -1,3 +1,5 @@
+#include <ctype.h>
+#include <string.h>
 #include "hash.h"
 
 /* Implementación de la función hash djb2 */
@@ -9,3 +11,57 @@ unsigned long hash_string(const char *str) {
     return hash;
 }
 
+/* FNV-1a de 32 bits sobre los bytes pasados a minúscula */
+unsigned int hash_fold32(const char *str) {
+    unsigned int hash = 2166136261u;
+    int c;
+    while ((c = (unsigned char)*str++)) {
+        hash ^= (unsigned int)tolower(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Pasa a minúscula las letras ASCII de los 8 bytes de w a la vez: a cada
+   byte entre 'A' y 'Z' (sin el bit alto) se le prende el bit 0x20. */
+static unsigned long fold8(unsigned long w) {
+    const unsigned long ones = 0x0101010101010101ul, high = 0x8080808080808080ul;
+    unsigned long low7 = w & ~high;
+    unsigned long ge_a = low7 + ones * (0x80 - 'A');        // bit alto si >= 'A'
+    unsigned long gt_z = low7 + ones * (0x80 - 'Z' - 1);    // bit alto si > 'Z'
+    unsigned long upper = ge_a & ~gt_z & ~w & high;
+    return w | (upper >> 2);
+}
+
+static unsigned long mix64(unsigned long a, unsigned long b) {
+    unsigned __int128 r = (unsigned __int128)a * b;
+    return (unsigned long)r ^ (unsigned long)(r >> 64);
+}
+
+/* Multiplicación 64x64->128 plegada por cada palabra de 8 bytes y un
+   finalizador tipo murmur3 para que los bits bajos (los del bucket)
+   dependan de todos los de la clave. */
+unsigned long hash_fold64(const char *str) {
+    const unsigned long k0 = 0x9e3779b97f4a7c15ul, k1 = 0xbf58476d1ce4e5b9ul;
+    size_t len = strlen(str);
+    unsigned long h = k0 ^ len;
+    const char *p = str;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        unsigned long w;
+        memcpy(&w, p, 8);
+        h = mix64(h ^ fold8(w), k1);
+    }
+    if (len > 0) {
+        unsigned long w = 0;
+        memcpy(&w, p, len);
+        h = mix64(h ^ fold8(w), k1);
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdul;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ul;
+    h ^= h >> 33;
+    return h;
+}
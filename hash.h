@@ -4,4 +4,14 @@
 /* Prototipo de la función hash (solo declaración). */
 unsigned long hash_string(const char *str);
 
+/* Hash de 32 bits sin distinguir mayúsculas (fingerprint de entradas). */
+unsigned int hash_fold32(const char *str);
+
+/* Hash de 64 bits sin distinguir mayúsculas (ASCII), 8 bytes por paso.
+   index.bin (formato 4) lo usa para el bucket y su mitad alta como
+   fingerprint: "Quantum" y "QUANTUM" caen en el mismo bucket. */
+unsigned long hash_fold64(const char *str);
+
+#define HASH_FINGERPRINT(h) ((unsigned int)((unsigned long)(h) >> 32))
+
 #endif 
@@ -3,30 +3,182 @@
 
 #include <stdio.h>
 
-#define N_BUCKETS 1000      /* usamos módulo 1000 */
+#define N_BUCKETS 1000      /* buckets iniciales (n_initial) */
 #define KEY_SIZE 256        /* títulos largos */
 
+#define INDEX_KEY_MAX 1024  /* tope de clave en el formato compacto */
+
+#define INDEX_MAGIC   0x58493250u  /* "P2IX" */
+#define INDEX_VERSION_FIXED_KEYS 1  /* EntryDisk con clave fija de KEY_SIZE */
+#define INDEX_VERSION_COMPACT    2  /* EntryDisk2 + heap de claves */
+#define INDEX_VERSION_BLOCKS     3  /* 2 + un bloque contiguo por bucket */
+#define INDEX_VERSION_FOLD64     4  /* 3 con hash_fold64 (sin mayúsculas) para bucket y fingerprint */
+#define INDEX_VERSION_RFC4180    5  /* 4 con las claves leídas según RFC 4180 (comillas, "" y comas) */
+#define INDEX_VERSION INDEX_VERSION_RFC4180  /* formato que escribe build_index */
+#define INDEX_BUILD_LOAD 2  /* entradas por bucket al construir */
+#define INDEX_MAX_LOAD   4  /* al superar este promedio se parte un bucket */
+#define INDEX_COMPACT_RATIO 10  /* compactar si overflow > n_entries / 10 */
+
+/* Índices secundarios de coincidencia exacta: mismo formato que index.bin,
+   construidos en la misma pasada por el CSV. Para indexar otra columna
+   basta agregarla a INDEX_SECONDARY. */
+#define INDEX_ID_FILE  "index_id.bin"
+#define INDEX_DOI_FILE "index_doi.bin"
+#define INDEX_ID_COLUMN  1
+#define INDEX_DOI_COLUMN 9
+#define INDEX_SECONDARY { { INDEX_ID_COLUMN, INDEX_ID_FILE }, { INDEX_DOI_COLUMN, INDEX_DOI_FILE } }
+#define INDEX_N_SECONDARY 2
+
 /* Estructuras que se guardan en disco */
+/* Los tres primeros campos conservan su posición. La tabla de buckets crece
+   por hashing lineal: n_buckets = n_initial * 2^level + split. */
 typedef struct {
-    int n_buckets;
-    long offset_buckets;
+    int n_buckets;          /* buckets activos */
+    long offset_buckets;    /* la tabla puede reubicarse al final del archivo */
     long offset_entries;
+    unsigned int magic;
+    int version;
+    int n_initial;
+    int level;
+    long split;             /* próximo bucket a partir */
+    long bucket_capacity;   /* slots reservados en la tabla de buckets */
+    long n_entries;
+    /* desde el formato 3 */
+    long offset_blocks;     /* tabla de BlockDisk paralela a la de buckets */
+    long n_overflow;        /* entradas insertadas desde la última compactación */
 } IndexHeader;
 
+/* En el formato 3 es la cabeza de la cadena de overflow (lo insertado
+   después de la última compactación). */
 typedef struct {
     long first_entry_offset;    /* -1 si el bucket está vacío */
 } BucketDisk;
 
+/* Formato 3: las entradas de cada bucket escritas en el build (o en la
+   compactación) quedan juntas, [count x EntryDisk2][claves], y se leen con
+   un solo pread de `bytes` bytes. */
+typedef struct {
+    long offset;
+    unsigned int count;
+    unsigned int bytes;
+} BlockDisk;
+
+/* Formato 1: clave de tamaño fijo dentro de la entrada */
 typedef struct {
     char key[KEY_SIZE];         /* título del paper */
     long csv_offset;            /* posición del registro en el CSV */
     long next_entry;            /* offset al siguiente EntryDisk */
 } EntryDisk;
 
+/* Formato 2: la clave vive en un heap aparte (key_offset es absoluto en el
+   archivo, terminada en '\0') y la entrada lleva un fingerprint para
+   descartar candidatos sin leer la clave. */
+typedef struct {
+    unsigned int fingerprint;   /* hash_fold32 de la clave (formato 4: mitad alta de hash_fold64) */
+    unsigned int key_len;       /* sin contar el '\0' */
+    long key_offset;
+    long csv_offset;
+    long next_entry;
+} EntryDisk2;
+
+/* Entrada leída de cualquiera de los dos formatos */
+typedef struct {
+    unsigned int fingerprint;
+    unsigned int key_len;
+    long key_offset;
+    long csv_offset;
+    long next_entry;
+    int has_key;
+    char key[INDEX_KEY_MAX];    /* solo si has_key */
+} IndexEntry;
+
+/* Recorrido de un bucket: cadena de overflow y después el bloque.
+   Abierto con index_cursor_open_map lee del índice mapeado en memoria
+   (sin copias ni syscalls) y el FILE* de index_cursor_next se ignora.
+   Solo entrega las entradas cuyo hash cae en `bucket`: si el proceso se
+   cayó confirmando una partición, el bucket original todavía tiene lo que
+   pasó al nuevo. Con -1 entrega todo (una búsqueda exacta ya descarta esas
+   claves al comparar). */
+typedef struct {
+    long bucket;
+    long overflow;
+    unsigned char *block;       /* copia del bloque (solo sin mapeo) */
+    size_t block_cap;
+    const unsigned char *data;  /* bloque actual: block o dentro de map */
+    const unsigned char *map;
+    size_t map_size;
+    long block_offset;
+    unsigned int block_bytes;
+    unsigned int block_count;
+    unsigned int block_pos;
+} IndexCursor;
+
+/* Todas las claves de index.bin, ordenadas por offset en el CSV (para
+   construir los índices secundarios en el orden del archivo) */
+typedef struct {
+    long csv_offset;
+    long key_pos;               /* posición en keys (sin '\0') */
+    unsigned int key_len;
+} IndexKeyRef;
+
+typedef struct {
+    IndexKeyRef *refs;
+    long n, cap;
+    char *keys;
+    size_t keys_len, keys_cap;
+} IndexKeyList;
+
+typedef struct {
+    int column;             /* columna del CSV (desde 1) */
+    const char *path;
+} IndexColumn;
+
+/* Inserción en dos pasos, para que quien lee el índice mapeado no vea nada
+   a medias. index_txn_insert escribe lo nuevo al final del archivo, donde
+   nadie lee todavía. Las pocas palabras que lo enlazan con lo que ya estaba
+   (cabezas de bucket y la cabecera) quedan en memoria hasta
+   index_txn_commit, que solo escribe esas palabras. Varias inserciones
+   pueden ir en la misma transacción. */
+typedef struct {
+    long at;                    /* offset en el archivo */
+    unsigned int len;
+    unsigned char bytes[sizeof(BlockDisk)];
+} IndexPatch;
+
+typedef struct {
+    FILE *idx;
+    IndexHeader h;              /* cabecera con lo insertado */
+    IndexPatch *patches;        /* una por posición, en orden */
+    int n_patches, cap_patches;
+} IndexTxn;
+
 /* Prototipos públicos */
 // index.h
 int build_index(const char *csv_path, const char *index_path);
+int build_index_parallel(const char *csv_path, const char *index_path, int nthreads);
 long search_in_index(const char *key, const char *index_path);
+long index_find_exact_map(const unsigned char *map, size_t map_size, const IndexHeader *h, const char *key,
+                          int (*fn)(long csv_offset, void *arg), void *arg);
+long index_bucket_for(const IndexHeader *h, unsigned long hash);
+unsigned long index_key_hash(const IndexHeader *h, const char *key);
+unsigned int index_key_fingerprint(const IndexHeader *h, const char *key);
+int index_read_header(FILE *idx, IndexHeader *h);
+int index_read_entry(FILE *idx, const IndexHeader *h, long off, IndexEntry *e, int with_key);
+int index_read_key(FILE *idx, IndexEntry *e);
+int index_map_header(const unsigned char *map, size_t map_size, IndexHeader *h);
+int index_cursor_open(FILE *idx, const IndexHeader *h, long bucket, IndexCursor *c);
+int index_cursor_open_map(const unsigned char *map, size_t map_size, const IndexHeader *h, long bucket, IndexCursor *c);
+int index_cursor_next(FILE *idx, const IndexHeader *h, IndexCursor *c, IndexEntry *e, int with_key);
+void index_cursor_close(IndexCursor *c);
+int index_compact(const char *index_path);
+int index_for_each(const char *index_path, int (*fn)(const IndexEntry *e, void *arg), void *arg);
+int index_collect_keys(const char *index_path, IndexKeyList *l);
+void index_key_list_free(IndexKeyList *l);
+long index_insert(const char *index_path, const char *key, long csv_offset, long *bucket_out);
+int  index_txn_begin(IndexTxn *t, const char *index_path);
+long index_txn_insert(IndexTxn *t, const char *key, long csv_offset, long *bucket_out);
+int  index_txn_commit(IndexTxn *t);
+void index_txn_close(IndexTxn *t);
 void append_and_reindex_bin(
     const char *csv_path,
     const char *id,
@@ -2,11 +2,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stddef.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include "index.h"
 #include "hash.h"
+#include "offsets.h"
+#include "csv.h"
+#include "fmap.h"
+#include "strsearch.h"
 
 #define RANGE 12  // rango para búsqueda parcial
+#define BUILD_MAX_THREADS 64
+#define BUILD_MIN_CHUNK (1L << 20)  // no partir en tramos de menos de 1 MB
 
 void trim_newline(char *str) {
     if (!str) return;
@@ -16,81 +27,1235 @@ void trim_newline(char *str) {
 }
 
 
-// --- Función para limpiar texto ---
-void limpiar_texto(char *s) {
-    if (!s) return;
-    size_t len = strlen(s);
-    if (len == 0) return;
+// --- Estado del constructor en memoria ---
+// Guardamos las claves en un único arena y, por cada entrada, su offset en el
+// CSV, su hash y su bucket. Con eso index.bin se escribe al final agrupado
+// por bucket.
+typedef struct {
+    char  *keys;        // arena de claves terminadas en '\0'
+    size_t keys_len;
+    size_t keys_cap;
+    size_t *key_pos;    // posición de cada clave dentro del arena
+    long  *csv_offset;  // offset del registro en el CSV
+    unsigned long *hash;
+    long  *bucket;      // bucket de cada entrada (se calcula al fijar la geometría)
+    long   count;
+    long   cap;
+} IndexBuilder;
 
-    if (s[0] == '"') memmove(s, s + 1, len--);
-    if (len > 0 && s[len - 1] == '"') s[len - 1] = '\0';
+static int builder_push(IndexBuilder *b, const char *key, long csv_offset, unsigned long h) {
+    size_t klen = strlen(key);
+    if (klen > INDEX_KEY_MAX - 1) klen = INDEX_KEY_MAX - 1;
 
-    len = strlen(s);
-    while (len > 0 && isspace((unsigned char)s[len - 1])) {
-        s[len - 1] = '\0';
-        len--;
+    if (b->count == b->cap) {
+        long ncap = b->cap ? b->cap * 2 : 65536;
+        size_t *kp = realloc(b->key_pos, ncap * sizeof(size_t));
+        if (!kp) return -1;
+        b->key_pos = kp;
+        long *co = realloc(b->csv_offset, ncap * sizeof(long));
+        if (!co) return -1;
+        b->csv_offset = co;
+        unsigned long *hs = realloc(b->hash, ncap * sizeof(unsigned long));
+        if (!hs) return -1;
+        b->hash = hs;
+        long *bk = realloc(b->bucket, ncap * sizeof(long));
+        if (!bk) return -1;
+        b->bucket = bk;
+        b->cap = ncap;
     }
+    if (b->keys_len + klen + 1 > b->keys_cap) {
+        size_t ncap = b->keys_cap ? b->keys_cap * 2 : (size_t)1 << 22;
+        while (ncap < b->keys_len + klen + 1) ncap *= 2;
+        char *nk = realloc(b->keys, ncap);
+        if (!nk) return -1;
+        b->keys = nk;
+        b->keys_cap = ncap;
+    }
+
+    memcpy(b->keys + b->keys_len, key, klen);
+    b->keys[b->keys_len + klen] = '\0';
+    b->key_pos[b->count] = b->keys_len;
+    b->keys_len += klen + 1;
+    b->csv_offset[b->count] = csv_offset;
+    b->hash[b->count] = h;
+    b->bucket[b->count] = -1;
+    b->count++;
+    return 0;
+}
+
+static void builder_free(IndexBuilder *b) {
+    free(b->keys);
+    free(b->key_pos);
+    free(b->csv_offset);
+    free(b->hash);
+    free(b->bucket);
+}
+
+static double elapsed_since(const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+// --- Geometría del hashing lineal ---
+// Hay n_initial * 2^level buckets "completos" más los `split` primeros ya
+// partidos al nivel siguiente. Un hash cae en h mod (n_initial * 2^level);
+// si ese bucket ya se partió, se usa h mod (n_initial * 2^(level+1)).
+long index_bucket_for(const IndexHeader *h, unsigned long hash) {
+    unsigned long m = (unsigned long)h->n_initial << h->level;
+    unsigned long b = hash % m;
+    if ((long)b < h->split) b = hash % (m << 1);
+    return (long)b;
+}
+
+// Hash de la clave según el formato: desde el 4 no distingue mayúsculas,
+// así que una búsqueda exacta sin mayúsculas mira un solo bucket.
+unsigned long index_key_hash(const IndexHeader *h, const char *key) {
+    return h->version >= INDEX_VERSION_FOLD64 ? hash_fold64(key) : hash_string(key);
+}
+
+unsigned int index_key_fingerprint(const IndexHeader *h, const char *key) {
+    return h->version >= INDEX_VERSION_FOLD64 ? HASH_FINGERPRINT(hash_fold64(key)) : hash_fold32(key);
+}
+
+// Lee el header y verifica que sea de un formato conocido (1 a 5).
+// Devuelve 0 si es válido, -1 si no se pudo leer o es de un formato anterior.
+static int index_check_header(IndexHeader *h) {
+    if (h->magic != INDEX_MAGIC) return -1;
+    if (h->version < INDEX_VERSION_FIXED_KEYS || h->version > INDEX_VERSION) return -1;
+    if (h->n_initial <= 0 || h->n_buckets <= 0 || h->n_buckets > h->bucket_capacity) return -1;
+    // Antes del formato 3 el header terminaba en n_entries
+    if (h->version < INDEX_VERSION_BLOCKS) {
+        h->offset_blocks = 0;
+        h->n_overflow = h->n_entries;
+    }
+    return 0;
+}
+
+int index_read_header(FILE *idx, IndexHeader *h) {
+    if (fseek(idx, 0, SEEK_SET) != 0 || fread(h, sizeof(IndexHeader), 1, idx) != 1) return -1;
+    return index_check_header(h);
+}
+
+// Igual que index_read_header pero desde el índice mapeado.
+int index_map_header(const unsigned char *map, size_t map_size, IndexHeader *h) {
+    if (!map || map_size < sizeof(IndexHeader)) return -1;
+    memcpy(h, map, sizeof(IndexHeader));
+    return index_check_header(h);
+}
+
+// Lee la entrada en `off` de cualquiera de los formatos. Con with_key=0 en el
+// formato compacto no se toca el heap (basta el fingerprint para descartar);
+// la clave se puede leer después con index_read_key.
+int index_read_entry(FILE *idx, const IndexHeader *h, long off, IndexEntry *e, int with_key) {
+    if (fseek(idx, off, SEEK_SET) != 0) return -1;
+
+    if (h->version == INDEX_VERSION_FIXED_KEYS) {
+        EntryDisk d;
+        if (fread(&d, sizeof(EntryDisk), 1, idx) != 1) return -1;
+        d.key[KEY_SIZE - 1] = '\0';
+        memcpy(e->key, d.key, KEY_SIZE);
+        e->key_len = (unsigned int)strlen(e->key);
+        e->fingerprint = hash_fold32(e->key);
+        e->key_offset = off;
+        e->csv_offset = d.csv_offset;
+        e->next_entry = d.next_entry;
+        e->has_key = 1;
+        return 0;
+    }
+
+    EntryDisk2 d;
+    if (fread(&d, sizeof(EntryDisk2), 1, idx) != 1) return -1;
+    e->fingerprint = d.fingerprint;
+    e->key_len = d.key_len < INDEX_KEY_MAX ? d.key_len : INDEX_KEY_MAX - 1;
+    e->key_offset = d.key_offset;
+    e->csv_offset = d.csv_offset;
+    e->next_entry = d.next_entry;
+    e->key[0] = '\0';
+    e->has_key = 0;
+    return with_key ? index_read_key(idx, e) : 0;
+}
+
+int index_read_key(FILE *idx, IndexEntry *e) {
+    if (e->has_key) return 0;
+    if (fseek(idx, e->key_offset, SEEK_SET) != 0 || fread(e->key, 1, e->key_len, idx) != e->key_len) return -1;
+    e->key[e->key_len] = '\0';
+    e->has_key = 1;
+    return 0;
+}
+
+// Bytes del header en disco según la versión (antes del formato 3 terminaba
+// en n_entries); al reescribirlo no hay que pisar la tabla de buckets.
+static size_t index_header_size(const IndexHeader *h) {
+    return h->version < INDEX_VERSION_BLOCKS ? offsetof(IndexHeader, offset_blocks) : sizeof(IndexHeader);
+}
+
+static long bucket_disk_offset(const IndexHeader *h, long bucket) {
+    return h->offset_buckets + bucket * (long)sizeof(BucketDisk);
+}
+
+static long block_disk_offset(const IndexHeader *h, long bucket) {
+    return h->offset_blocks + bucket * (long)sizeof(BlockDisk);
+}
+
+// --- Recorrido de un bucket ---
+// Primero la cadena de overflow (lo insertado después de la última
+// compactación, más reciente primero) y luego el bloque contiguo, que se
+// lee entero (entradas + claves) con un solo pread.
+// Deja el cursor al principio del bucket dada su cabeza y su bloque
+// (blk NULL en los formatos sin bloques).
+static int cursor_load(FILE *idx, long bucket, const BucketDisk *b, const BlockDisk *blk, IndexCursor *c) {
+    c->bucket = bucket;
+    c->overflow = b->first_entry_offset;
+    c->block_count = c->block_pos = 0;
+    c->map = NULL;
+    if (!blk || blk->count == 0) return 0;
+
+    if (blk->bytes > c->block_cap) {
+        unsigned char *nb = realloc(c->block, blk->bytes);
+        if (!nb) return -1;
+        c->block = nb;
+        c->block_cap = blk->bytes;
+    }
+    if (pread(fileno(idx), c->block, blk->bytes, blk->offset) != (ssize_t)blk->bytes) return -1;
+    c->data = c->block;
+    c->block_offset = blk->offset;
+    c->block_bytes = blk->bytes;
+    c->block_count = blk->count;
+    return 0;
+}
+
+int index_cursor_open(FILE *idx, const IndexHeader *h, long bucket, IndexCursor *c) {
+    c->overflow = -1;
+    c->block_count = c->block_pos = 0;
+
+    BucketDisk b;
+    BlockDisk blk;
+    if (pread(fileno(idx), &b, sizeof(b), bucket_disk_offset(h, bucket)) != (ssize_t)sizeof(b)) return -1;
+    if (h->offset_blocks &&
+        pread(fileno(idx), &blk, sizeof(blk), block_disk_offset(h, bucket)) != (ssize_t)sizeof(blk)) return -1;
+    return cursor_load(idx, bucket, &b, h->offset_blocks ? &blk : NULL, c);
+}
+
+// Copia `len` bytes del mapeo en `off`, verificando que estén dentro del archivo.
+static int map_read(const IndexCursor *c, long off, void *dst, size_t len) {
+    if (off < 0 || (size_t)off > c->map_size || len > c->map_size - (size_t)off) return -1;
+    memcpy(dst, c->map + off, len);
+    return 0;
+}
+
+// Versión sobre el índice mapeado: el bloque no se copia, se apunta.
+int index_cursor_open_map(const unsigned char *map, size_t map_size, const IndexHeader *h, long bucket, IndexCursor *c) {
+    c->bucket = bucket;
+    c->overflow = -1;
+    c->block_count = c->block_pos = 0;
+    c->map = map;
+    c->map_size = map_size;
+
+    BucketDisk b;
+    if (map_read(c, bucket_disk_offset(h, bucket), &b, sizeof(b)) != 0) return -1;
+    c->overflow = b.first_entry_offset;
+
+    if (!h->offset_blocks) return 0;
+    BlockDisk blk;
+    if (map_read(c, block_disk_offset(h, bucket), &blk, sizeof(blk)) != 0) return -1;
+    if (blk.count == 0) return 0;
+    if (blk.offset < 0 || (size_t)blk.offset + blk.bytes > map_size) return -1;
+
+    c->data = map + blk.offset;
+    c->block_offset = blk.offset;
+    c->block_bytes = blk.bytes;
+    c->block_count = blk.count;
+    return 0;
+}
+
+// Entrada de la cadena de overflow leída del mapeo (formatos 1 a 3).
+static int map_read_entry(const IndexCursor *c, const IndexHeader *h, long off, IndexEntry *e) {
+    if (h->version == INDEX_VERSION_FIXED_KEYS) {
+        EntryDisk d;
+        if (map_read(c, off, &d, sizeof(d)) != 0) return -1;
+        d.key[KEY_SIZE - 1] = '\0';
+        memcpy(e->key, d.key, KEY_SIZE);
+        e->key_len = (unsigned int)strlen(e->key);
+        e->fingerprint = hash_fold32(e->key);
+        e->key_offset = off;
+        e->csv_offset = d.csv_offset;
+        e->next_entry = d.next_entry;
+        e->has_key = 1;
+        return 0;
+    }
+
+    EntryDisk2 d;
+    if (map_read(c, off, &d, sizeof(d)) != 0) return -1;
+    e->fingerprint = d.fingerprint;
+    e->key_len = d.key_len < INDEX_KEY_MAX ? d.key_len : INDEX_KEY_MAX - 1;
+    e->key_offset = d.key_offset;
+    e->csv_offset = d.csv_offset;
+    e->next_entry = d.next_entry;
+    if (map_read(c, d.key_offset, e->key, e->key_len) != 0) return -1;
+    e->key[e->key_len] = '\0';
+    e->has_key = 1;
+    return 0;
+}
+
+// Siguiente entrada del bucket, sea o no de él.
+static int cursor_step(FILE *idx, const IndexHeader *h, IndexCursor *c, IndexEntry *e, int with_key) {
+    if (c->overflow != -1) {
+        long off = c->overflow;
+        if (c->map) {
+            if (map_read_entry(c, h, off, e) != 0) return -1;
+        } else if (index_read_entry(idx, h, off, e, with_key) != 0) return -1;
+        c->overflow = e->next_entry;
+        return 1;
+    }
+    if (c->block_pos >= c->block_count) return 0;
+
+    EntryDisk2 d;
+    memcpy(&d, c->data + (size_t)c->block_pos * sizeof(EntryDisk2), sizeof(d));
+    c->block_pos++;
+    e->fingerprint = d.fingerprint;
+    e->key_len = d.key_len < INDEX_KEY_MAX ? d.key_len : INDEX_KEY_MAX - 1;
+    e->key_offset = d.key_offset;
+    e->csv_offset = d.csv_offset;
+    e->next_entry = -1;
+
+    // La clave ya está en memoria: se copia siempre
+    long rel = d.key_offset - c->block_offset;
+    if (rel < 0 || rel + e->key_len > (long)c->block_bytes) return -1;
+    memcpy(e->key, c->data + rel, e->key_len);
+    e->key[e->key_len] = '\0';
+    e->has_key = 1;
+    return 1;
+}
+
+// Una partición reemplaza el bucket de origen por lo que se queda, pero si
+// el proceso se cayó al confirmarla (ver index_txn_commit) el origen
+// conserva lo que se copió al nuevo: es de este bucket solo si su hash cae
+// acá. Las claves se hashean tal como se guardan (recortadas, si eran
+// largas), así que toda entrada se puede volver a ubicar.
+static int entry_in_bucket(const IndexHeader *h, const IndexEntry *e, long bucket) {
+    return bucket < 0 || !e->has_key || index_bucket_for(h, index_key_hash(h, e->key)) == bucket;
+}
+
+// Devuelve 1 si dejó una entrada en *e, 0 al terminar el bucket, -1 si hubo error.
+int index_cursor_next(FILE *idx, const IndexHeader *h, IndexCursor *c, IndexEntry *e, int with_key) {
+    int r;
+    while ((r = cursor_step(idx, h, c, e, with_key)) == 1 && !entry_in_bucket(h, e, c->bucket)) {}
+    return r;
+}
+
+void index_cursor_close(IndexCursor *c) {
+    free(c->block);
+    c->block = NULL;
+    c->block_cap = 0;
+}
+
+// Geometría inicial para n entradas: al menos N_BUCKETS buckets y carga
+// promedio INDEX_BUILD_LOAD, dejando margen antes de la primera partición.
+static void index_geometry_for(IndexHeader *h, long n_entries) {
+    long want = (n_entries + INDEX_BUILD_LOAD - 1) / INDEX_BUILD_LOAD;
+    if (want < N_BUCKETS) want = N_BUCKETS;
+    int level = 0;
+    while (((long)N_BUCKETS << (level + 1)) <= want) level++;
+
+    memset(h, 0, sizeof(*h));
+    h->magic = INDEX_MAGIC;
+    h->version = INDEX_VERSION;
+    h->n_initial = N_BUCKETS;
+    h->level = level;
+    h->split = want - ((long)N_BUCKETS << level);
+    h->n_buckets = (int)want;
+    h->bucket_capacity = (long)N_BUCKETS << (level + 1);
+    h->n_entries = n_entries;
+    h->n_overflow = 0;
+    h->offset_buckets = sizeof(IndexHeader);
+    h->offset_blocks = h->offset_buckets + sizeof(BucketDisk) * h->bucket_capacity;
+    h->offset_entries = h->offset_blocks + sizeof(BlockDisk) * h->bucket_capacity;
+}
+
+// --- Trabajo de un hilo del constructor ---
+// Cada hilo procesa los registros que EMPIEZAN en [start, end); una vez
+// fijada la geometría cuenta cuántas entradas y bytes de clave aporta a cada
+// bucket y después copia las suyas a su lugar dentro de cada bloque.
+typedef struct {
+    const char *csv;        // CSV mapeado (compartido por todos los hilos)
+    long csv_size;
+    long start, end;
+    long next;              // dónde terminó el último registro del rango (+1)
+    long rows;
+    int  failed;
+    IndexBuilder b;
+    const IndexHeader *header;
+    long *n_in_bucket;      // entradas por bucket -> luego, próxima posición de entrada
+    long *key_bytes;        // bytes de clave por bucket -> luego, próxima posición de clave
+    unsigned char *out;     // index.bin mapeado en memoria
+    long *lines;            // inicio de cada registro del rango (para offsets.bin)
+    long n_lines, lines_cap;
+    IndexBuilder secondary[INDEX_N_SECONDARY];  // claves de los índices secundarios
+} BuildPart;
+
+static const IndexColumn secondary_indexes[INDEX_N_SECONDARY] = INDEX_SECONDARY;
+
+#define TITLE_COLUMN 4
+
+// Clave del índice a partir de un campo: sin comillas, con "" -> " y sin
+// espacios en los extremos (lo mismo que hace una inserción con su título).
+static void field_key(const CsvField *f, char key[INDEX_KEY_MAX]) {
+    csv_field_copy(f, key, INDEX_KEY_MAX);
+    trim_inplace(key);
+}
+
+static void *build_part_parse(void *arg) {
+    BuildPart *part = arg;
+    const char *file_end = part->csv + part->csv_size;
+
+    // Solo hacen falta los campos hasta la última columna indexada; el
+    // resto del registro se salta buscando solo su fin
+    int want = TITLE_COLUMN;
+    for (int k = 0; k < INDEX_N_SECONDARY; k++)
+        if (secondary_indexes[k].column > want) want = secondary_indexes[k].column;
+
+    // Un registro por vuelta con el tokenizador de csv.c: respeta comillas,
+    // así que un título con comas no corre las columnas siguientes y un
+    // campo con saltos de línea no parte el registro
+    const char *line = part->csv + part->start;
+    while (line < part->csv + part->end) {
+        long this_start = (long)(line - part->csv);
+        CsvField fields[CSV_MAX_FIELDS];
+        const char *stop;
+        int n = csv_split_record(line, file_end, fields, want, &stop);
+        line = stop < file_end ? stop + 1 : file_end;
+        part->rows++;
+
+        if (part->n_lines == part->lines_cap) {
+            long ncap = part->lines_cap ? part->lines_cap * 2 : 65536;
+            long *nl = realloc(part->lines, sizeof(long) * ncap);
+            if (!nl) { part->failed = 1; break; }
+            part->lines = nl;
+            part->lines_cap = ncap;
+        }
+        part->lines[part->n_lines++] = this_start;
+
+        char key[INDEX_KEY_MAX];
+        for (int k = 0; k < INDEX_N_SECONDARY; k++) {
+            int col = secondary_indexes[k].column;
+            if (col > n || fields[col - 1].len == 0) continue;
+            field_key(&fields[col - 1], key);
+            if (builder_push(&part->secondary[k], key, this_start, hash_fold64(key)) != 0) {
+                part->failed = 1;
+                break;
+            }
+        }
+        if (part->failed) break;
+
+        if (n < TITLE_COLUMN) continue;
+        field_key(&fields[TITLE_COLUMN - 1], key);
+        if (!key[0]) continue;
+        if (builder_push(&part->b, key, this_start, hash_fold64(key)) != 0) { part->failed = 1; break; }
+    }
+    part->next = (long)(line - part->csv);
+    return NULL;
+}
+
+static void *build_part_count(void *arg) {
+    BuildPart *part = arg;
+    IndexBuilder *b = &part->b;
+    long nb = part->header->n_buckets;
+    part->n_in_bucket = calloc(nb, sizeof(long));
+    part->key_bytes = calloc(nb, sizeof(long));
+    if (!part->n_in_bucket || !part->key_bytes) { part->failed = 1; return NULL; }
+
+    for (long i = 0; i < b->count; i++) {
+        long bucket = index_bucket_for(part->header, b->hash[i]);
+        b->bucket[i] = bucket;
+        part->n_in_bucket[bucket]++;
+        long next = (i + 1 < b->count) ? (long)b->key_pos[i + 1] : (long)b->keys_len;
+        part->key_bytes[bucket] += next - (long)b->key_pos[i];
+    }
+    return NULL;
+}
+
+static void *build_part_place(void *arg) {
+    BuildPart *part = arg;
+    IndexBuilder *b = &part->b;
+
+    for (long i = 0; i < b->count; i++) {
+        long bucket = b->bucket[i];
+        const char *key = b->keys + b->key_pos[i];
+        size_t klen = strlen(key);
+
+        EntryDisk2 e;
+        e.fingerprint = HASH_FINGERPRINT(b->hash[i]);
+        e.key_len = (unsigned int)klen;
+        e.key_offset = part->key_bytes[bucket];
+        e.csv_offset = b->csv_offset[i];
+        e.next_entry = -1;
+
+        memcpy(part->out + part->n_in_bucket[bucket], &e, sizeof(e));
+        memcpy(part->out + e.key_offset, key, klen + 1);
+        part->n_in_bucket[bucket] += sizeof(EntryDisk2);
+        part->key_bytes[bucket] += (long)klen + 1;
+    }
+    return NULL;
+}
+
+// Corre fn sobre cada parte en su propio hilo. Si un hilo no se puede
+// crear, esa parte corre en este mismo hilo (las partes son
+// independientes); solo se esperan los hilos que arrancaron.
+static void run_parts(BuildPart *parts, pthread_t *tids, int n, void *(*fn)(void *)) {
+    char started[BUILD_MAX_THREADS];
+    for (int t = 0; t < n; t++) {
+        started[t] = pthread_create(&tids[t], NULL, fn, &parts[t]) == 0;
+        if (!started[t]) fn(&parts[t]);
+    }
+    for (int t = 0; t < n; t++)
+        if (started[t]) pthread_join(tids[t], NULL);
+}
+
+// Escribe index.bin (formato 4) a partir de las entradas ya parseadas.
+// Cada bucket queda como un bloque contiguo [entradas][claves], con las
+// entradas de cada hilo en orden de archivo; las cadenas de overflow
+// quedan vacías. El archivo se arma mapeado en memoria.
+static int index_write_blocks(const char *index_path, BuildPart *parts, pthread_t *tids,
+                              int nthreads, IndexHeader *header) {
+    long total = 0;
+    for (int t = 0; t < nthreads; t++) total += parts[t].b.count;
+    index_geometry_for(header, total);
+    for (int t = 0; t < nthreads; t++) parts[t].header = header;
+
+    // --- Cuántas entradas y bytes aporta cada hilo a cada bucket ---
+    run_parts(parts, tids, nthreads, build_part_count);
+    for (int t = 0; t < nthreads; t++)
+        if (parts[t].failed) return -1;
+
+    BucketDisk *buckets = malloc(sizeof(BucketDisk) * header->bucket_capacity);
+    BlockDisk *blocks = calloc(header->bucket_capacity, sizeof(BlockDisk));
+    if (!buckets || !blocks) { free(buckets); free(blocks); return -1; }
+
+    // --- Offsets de cada bloque y de cada tramo de hilo dentro del bloque ---
+    long off = header->offset_entries;
+    for (long bkt = 0; bkt < header->bucket_capacity; bkt++) {
+        buckets[bkt].first_entry_offset = -1;
+        if (bkt >= header->n_buckets) continue;
+
+        long count = 0, kbytes = 0;
+        for (int t = 0; t < nthreads; t++) {
+            count += parts[t].n_in_bucket[bkt];
+            kbytes += parts[t].key_bytes[bkt];
+        }
+        blocks[bkt].offset = off;
+        blocks[bkt].count = (unsigned int)count;
+        blocks[bkt].bytes = (unsigned int)(count * (long)sizeof(EntryDisk2) + kbytes);
+
+        long epos = off, kpos = off + count * (long)sizeof(EntryDisk2);
+        for (int t = 0; t < nthreads; t++) {
+            long n = parts[t].n_in_bucket[bkt], kb = parts[t].key_bytes[bkt];
+            parts[t].n_in_bucket[bkt] = epos;
+            parts[t].key_bytes[bkt] = kpos;
+            epos += n * (long)sizeof(EntryDisk2);
+            kpos += kb;
+        }
+        off += blocks[bkt].bytes;
+    }
+    size_t file_size = (size_t)off;
+
+    // --- Archivo mapeado: cada hilo copia sus entradas en su lugar ---
+    int failed = 0;
+    int fd = open(index_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { perror("Error creando índice"); failed = 1; }
+    if (!failed && ftruncate(fd, (off_t)file_size) != 0) failed = 1;
+
+    unsigned char *out = MAP_FAILED;
+    if (!failed) {
+        out = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (out == MAP_FAILED) failed = 1;
+    }
+    if (!failed) {
+        memcpy(out, header, sizeof(IndexHeader));
+        memcpy(out + header->offset_buckets, buckets, sizeof(BucketDisk) * header->bucket_capacity);
+        memcpy(out + header->offset_blocks, blocks, sizeof(BlockDisk) * header->bucket_capacity);
+        for (int t = 0; t < nthreads; t++) parts[t].out = out;
+        run_parts(parts, tids, nthreads, build_part_place);
+        if (munmap(out, file_size) != 0) failed = 1;
+    }
+    if (fd >= 0 && close(fd) != 0) failed = 1;
+
+    free(buckets);
+    free(blocks);
+    return failed ? -1 : 0;
+}
+
+static void build_parts_free(BuildPart *parts, int nthreads) {
+    for (int t = 0; t < nthreads; t++) {
+        builder_free(&parts[t].b);
+        free(parts[t].n_in_bucket);
+        free(parts[t].key_bytes);
+        free(parts[t].lines);
+        for (int k = 0; k < INDEX_N_SECONDARY; k++) builder_free(&parts[t].secondary[k]);
+    }
+}
+
+// Escribe cada índice secundario con las mismas partes: se pone su builder
+// en el lugar del de títulos y se repite la escritura por bloques.
+static void write_secondary_indexes(BuildPart *parts, pthread_t *tids, int nthreads) {
+    for (int k = 0; k < INDEX_N_SECONDARY; k++) {
+        for (int t = 0; t < nthreads; t++) {
+            IndexBuilder tmp = parts[t].b;
+            parts[t].b = parts[t].secondary[k];
+            parts[t].secondary[k] = tmp;
+            free(parts[t].n_in_bucket);
+            free(parts[t].key_bytes);
+            parts[t].n_in_bucket = parts[t].key_bytes = NULL;
+        }
+        IndexHeader h;
+        if (index_write_blocks(secondary_indexes[k].path, parts, tids, nthreads, &h) != 0)
+            fprintf(stderr, "[INDEX] No se pudo escribir %s\n", secondary_indexes[k].path);
+        else
+            printf("[INDEX] %s: %ld entradas (columna %d)\n", secondary_indexes[k].path, h.n_entries,
+                   secondary_indexes[k].column);
+    }
+}
+
+// offsets.bin sale de la misma pasada: los rangos de los hilos están en
+// orden de archivo, así que basta concatenar sus inicios de registro.
+static int write_record_offsets(BuildPart *parts, int nthreads, long csv_size) {
+    long n = 0;
+    for (int t = 0; t < nthreads; t++) n += parts[t].n_lines;
+    long *all = malloc(sizeof(long) * (n > 0 ? n : 1));
+    if (!all) return -1;
+    long k = 0;
+    for (int t = 0; t < nthreads; t++) {
+        memcpy(all + k, parts[t].lines, sizeof(long) * parts[t].n_lines);
+        k += parts[t].n_lines;
+    }
+    int r = offsets_write(OFFSETS_FILE, all, n, csv_size);
+    free(all);
+    return r;
+}
+
+// Inicio de la primera línea que empieza en pos o después (el byte
+// siguiente a un '\n'). Es solo una suposición: si el '\n' estaba dentro de
+// un campo entre comillas el rango anterior lo va a pasar de largo, y eso se
+// detecta al terminar (BuildPart.next).
+static long align_to_record(const char *csv, long size, long pos) {
+    const char *nl = memchr(csv + pos - 1, '\n', (size_t)(size - pos + 1));
+    return nl ? (long)(nl - csv) + 1 : size;
+}
+
+// --- Construcción paralela del índice ---
+// El CSV (mapeado) se parte en rangos de bytes alineados a inicio de línea;
+// cada hilo parsea su rango, y cuando ya se sabe cuántas entradas hay se
+// fija la geometría y se escribe un bloque contiguo por bucket. Dentro de
+// cada bloque las entradas quedan en orden de archivo, igual que en un
+// recorrido secuencial.
+int build_index_parallel(const char *csv_path, const char *index_path, int nthreads) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    FileMap map;
+    if (fmap_open(&map, csv_path) != 0) { perror("Error abriendo CSV"); return -1; }
+    const char *csv = (const char *)map.base;
+    long csv_size = (long)map.size;
+    if (map.base) madvise(map.base, map.size, MADV_SEQUENTIAL);
+
+    // --- Saltar encabezado ---
+    long data_start = 0;
+    if (csv_size > 0) {
+        const char *stop = csv_record_end(csv, csv + csv_size);
+        data_start = stop < csv + csv_size ? (long)(stop - csv) + 1 : csv_size;
+    }
+
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > BUILD_MAX_THREADS) nthreads = BUILD_MAX_THREADS;
+    long data_len = csv_size - data_start;
+    if (data_len < (long)nthreads * BUILD_MIN_CHUNK) nthreads = (int)(data_len / BUILD_MIN_CHUNK) + 1;
+
+    BuildPart *parts = calloc(nthreads, sizeof(BuildPart));
+    pthread_t *tids = calloc(nthreads, sizeof(pthread_t));
+    if (!parts || !tids) {
+        perror("calloc"); free(parts); free(tids); fmap_close(&map);
+        return -1;
+    }
+
+    // --- Rangos alineados a inicio de línea ---
+    long prev = data_start;
+    for (int t = 0; t < nthreads; t++) {
+        long end = (t == nthreads - 1) ? csv_size
+                 : align_to_record(csv, csv_size, data_start + data_len / nthreads * (t + 1));
+        if (end < prev) end = prev;
+        parts[t].csv = csv;
+        parts[t].csv_size = csv_size;
+        parts[t].start = prev;
+        parts[t].end = end;
+        prev = end;
+    }
+
+    // --- Fase 1: cada hilo parsea su rango ---
+    run_parts(parts, tids, nthreads, build_part_parse);
+
+    long rows = 0;
+    int failed = 0, misaligned = 0;
+    for (int t = 0; t < nthreads; t++) {
+        failed |= parts[t].failed;
+        rows += parts[t].rows;
+        // Un registro con saltos de línea cruzó el corte: el rango siguiente
+        // empezó en medio de un campo
+        if (t + 1 < nthreads && parts[t].next != parts[t + 1].start) misaligned = 1;
+    }
+    if (!failed && misaligned) {
+        build_parts_free(parts, nthreads);
+        free(parts);
+        free(tids);
+        fmap_close(&map);
+        printf("[BUILD] Un registro de varias líneas cruzó el corte entre hilos; se repite con un hilo\n");
+        return build_index_parallel(csv_path, index_path, 1);
+    }
+
+    // --- Fase 2: geometría y escritura por bloques ---
+    IndexHeader header;
+    if (!failed && index_write_blocks(index_path, parts, tids, nthreads, &header) != 0) failed = 1;
+    if (!failed && write_record_offsets(parts, nthreads, csv_size) != 0)
+        fprintf(stderr, "[OFFSETS] No se pudo escribir %s\n", OFFSETS_FILE);
+    if (!failed) write_secondary_indexes(parts, tids, nthreads);
+
+    build_parts_free(parts, nthreads);
+    free(parts);
+    free(tids);
+    fmap_close(&map);
+
+    if (failed) { fprintf(stderr, "Error construyendo el índice\n"); return -1; }
+
+    double secs = elapsed_since(&t0);
+    printf("Índice generado correctamente con %d buckets (nivel %d, split %ld).\n",
+           header.n_buckets, header.level, header.split);
+    printf("[BUILD] %ld filas, %ld entradas, %d hilo(s) en %.3f s (%.0f filas/s)\n",
+           rows, header.n_entries, nthreads, secs, secs > 0 ? rows / secs : (double)rows);
+    return 0;
 }
 
 // --- Función que construye el índice si no existe ---
+// Usa un hilo por núcleo disponible.
 int build_index(const char *csv_path, const char *index_path) {
-    FILE *csv = fopen(csv_path, "r");
-    if (!csv) { perror("Error abriendo CSV"); return -1; }
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    return build_index_parallel(csv_path, index_path, ncpu > 0 ? (int)ncpu : 1);
+}
 
-    FILE *idx = fopen(index_path, "wb+");
-    if (!idx) { perror("Error creando índice"); fclose(csv); return -1; }
+// --- Compactación ---
+typedef struct {
+    long csv_offset;
+    size_t key_pos;
+} CompactItem;
 
-    // --- Header ---
-    IndexHeader header = { N_BUCKETS, sizeof(IndexHeader), sizeof(IndexHeader) + sizeof(BucketDisk) * N_BUCKETS };
-    fwrite(&header, sizeof(IndexHeader), 1, idx);
+static int compact_item_cmp(const void *a, const void *b) {
+    long x = ((const CompactItem *)a)->csv_offset, y = ((const CompactItem *)b)->csv_offset;
+    return (x > y) - (x < y);
+}
 
-    // --- Buckets vacíos ---
-    BucketDisk empty = { .first_entry_offset = -1 };
-    for (int i = 0; i < N_BUCKETS; i++)
-        fwrite(&empty, sizeof(BucketDisk), 1, idx);
+// Reescribe index.bin con un bloque contiguo por bucket: las entradas de
+// overflow vuelven a sus bloques y se descarta el espacio muerto (tablas
+// reubicadas, bloques viejos de buckets partidos). Las entradas se ordenan
+// por offset en el CSV, igual que en un build desde cero.
+int index_compact(const char *index_path) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
 
-    // --- Leer CSV ---
-    char line[4096];
-    long line_start;
-    fgets(line, sizeof(line), csv); // saltar encabezado
-
-    while ((line_start = ftell(csv)), fgets(line, sizeof(line), csv)) {
-        char *token = strtok(line, ",\n\r");
-        char *key = NULL;
-        int col = 1;
-        while (token) {
-            if (col == 4) { key = token; break; }
-            token = strtok(NULL, ",\n\r");
-            col++;
+    FILE *idx = fopen(index_path, "rb");
+    if (!idx) return -1;
+    IndexHeader h;
+    if (index_read_header(idx, &h) != 0) { fclose(idx); return -1; }
+
+    // --- Leer todas las entradas (bloques + overflow) ---
+    IndexBuilder all = {0};
+    CompactItem *items = malloc(sizeof(CompactItem) * (h.n_entries > 0 ? h.n_entries : 1));
+    long n = 0, cap = h.n_entries > 0 ? h.n_entries : 1;
+    int failed = !items;
+
+    IndexCursor cur = {0};
+    IndexEntry e;
+    for (long bkt = 0; !failed && bkt < h.n_buckets; bkt++) {
+        if (index_cursor_open(idx, &h, bkt, &cur) != 0) { failed = 1; break; }
+        int r;
+        while ((r = index_cursor_next(idx, &h, &cur, &e, 1)) == 1) {
+            if (n == cap) {
+                CompactItem *ni = realloc(items, sizeof(CompactItem) * (cap *= 2));
+                if (!ni) { failed = 1; break; }
+                items = ni;
+            }
+            items[n].csv_offset = e.csv_offset;
+            items[n].key_pos = all.keys_len;
+            if (builder_push(&all, e.key, e.csv_offset, 0) != 0) { failed = 1; break; }
+            n++;
+        }
+        if (r < 0) failed = 1;
+    }
+    index_cursor_close(&cur);
+    fclose(idx);
+
+    // --- Reordenar por offset del CSV y reconstruir ---
+    BuildPart part = {0};
+    if (!failed) {
+        qsort(items, n, sizeof(CompactItem), compact_item_cmp);
+        for (long i = 0; i < n && !failed; i++) {
+            const char *key = all.keys + items[i].key_pos;
+            if (builder_push(&part.b, key, items[i].csv_offset, hash_fold64(key)) != 0) failed = 1;
+        }
+    }
+    builder_free(&all);
+    free(items);
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.compact", index_path);
+    pthread_t tid;
+    IndexHeader nh;
+    if (!failed && index_write_blocks(tmp_path, &part, &tid, 1, &nh) != 0) failed = 1;
+    if (!failed && rename(tmp_path, index_path) != 0) failed = 1;
+    if (failed) unlink(tmp_path);
+    build_parts_free(&part, 1);
+
+    if (failed) { fprintf(stderr, "[INDEX] Error compactando %s\n", index_path); return -1; }
+    printf("[INDEX] Compactado: %ld entradas (%ld de overflow) en %d buckets, %.3f s\n",
+           nh.n_entries, h.n_overflow, nh.n_buckets, elapsed_since(&t0));
+    return 0;
+}
+
+// Recorre todas las entradas del índice (bucket por bucket, sin orden) y
+// llama a fn con cada una, con la clave ya leída. Si fn devuelve distinto
+// de 0 se corta el recorrido (si es negativo, además se devuelve -1).
+int index_for_each(const char *index_path, int (*fn)(const IndexEntry *e, void *arg), void *arg) {
+    FILE *idx = fopen(index_path, "rb");
+    if (!idx) return -1;
+    IndexHeader h;
+    if (index_read_header(idx, &h) != 0) { fclose(idx); return -1; }
+
+    IndexCursor cur = {0};
+    IndexEntry e;
+    int r = 0, stop = 0;
+    for (long bkt = 0; !stop && bkt < h.n_buckets; bkt++) {
+        if (index_cursor_open(idx, &h, bkt, &cur) != 0) { r = -1; break; }
+        while (!stop && (r = index_cursor_next(idx, &h, &cur, &e, 1)) == 1)
+            stop = fn(&e, arg);
+        if (r < 0 || stop < 0) { r = -1; break; }
+        r = 0;
+    }
+    index_cursor_close(&cur);
+    fclose(idx);
+    return r;
+}
+
+static int collect_key(const IndexEntry *e, void *arg) {
+    IndexKeyList *l = arg;
+    if (l->n == l->cap) {
+        long ncap = l->cap ? l->cap * 2 : 1 << 16;
+        IndexKeyRef *nr = realloc(l->refs, sizeof(IndexKeyRef) * ncap);
+        if (!nr) return -1;
+        l->refs = nr;
+        l->cap = ncap;
+    }
+    if (l->keys_len + e->key_len > l->keys_cap) {
+        size_t ncap = l->keys_cap ? l->keys_cap * 2 : 1 << 20;
+        while (ncap < l->keys_len + e->key_len) ncap *= 2;
+        char *nk = realloc(l->keys, ncap);
+        if (!nk) return -1;
+        l->keys = nk;
+        l->keys_cap = ncap;
+    }
+    memcpy(l->keys + l->keys_len, e->key, e->key_len);
+    l->refs[l->n].csv_offset = e->csv_offset;
+    l->refs[l->n].key_pos = (long)l->keys_len;
+    l->refs[l->n].key_len = e->key_len;
+    l->keys_len += e->key_len;
+    l->n++;
+    return 0;
+}
+
+static int key_ref_cmp(const void *a, const void *b) {
+    const IndexKeyRef *x = a, *y = b;
+    if (x->csv_offset != y->csv_offset) return (x->csv_offset > y->csv_offset) - (x->csv_offset < y->csv_offset);
+    return (x->key_pos > y->key_pos) - (x->key_pos < y->key_pos);
+}
+
+// Lee todas las claves del índice y las ordena por offset en el CSV.
+int index_collect_keys(const char *index_path, IndexKeyList *l) {
+    memset(l, 0, sizeof(*l));
+    if (index_for_each(index_path, collect_key, l) != 0) {
+        index_key_list_free(l);
+        return -1;
+    }
+    qsort(l->refs, l->n, sizeof(IndexKeyRef), key_ref_cmp);
+    return 0;
+}
+
+void index_key_list_free(IndexKeyList *l) {
+    free(l->refs);
+    free(l->keys);
+    memset(l, 0, sizeof(*l));
+}
+
+// --- Inserción con partición de buckets ---
+// Todo lo nuevo (entradas, bloques de buckets partidos, tablas que crecen)
+// se escribe al final del archivo, donde nadie lee todavía. Lo único que se
+// escribe sobre lo que ya estaba son las cabezas de los buckets y la
+// cabecera: la transacción las guarda en memoria (y las lecturas de la
+// propia transacción las ven) hasta index_txn_commit.
+
+// Lee len bytes en at, con lo que la transacción todavía no escribió.
+static int txn_read(IndexTxn *t, long at, void *dst, size_t len) {
+    if (pread(fileno(t->idx), dst, len, at) != (ssize_t)len) return -1;
+    for (int i = 0; i < t->n_patches; i++)
+        if (t->patches[i].at == at && t->patches[i].len == len) memcpy(dst, t->patches[i].bytes, len);
+    return 0;
+}
+
+// Anota que en at van estos len bytes (la última escritura en at gana).
+static int txn_patch(IndexTxn *t, long at, const void *src, size_t len) {
+    int i = 0;
+    while (i < t->n_patches && !(t->patches[i].at == at && t->patches[i].len == len)) i++;
+    if (i == t->n_patches) {
+        if (t->n_patches == t->cap_patches) {
+            int ncap = t->cap_patches ? t->cap_patches * 2 : 16;
+            IndexPatch *np = realloc(t->patches, sizeof(IndexPatch) * ncap);
+            if (!np) return -1;
+            t->patches = np;
+            t->cap_patches = ncap;
         }
-        if (!key) continue;
-        limpiar_texto(key);
+        t->n_patches++;
+        t->patches[i].at = at;
+        t->patches[i].len = (unsigned int)len;
+    }
+    memcpy(t->patches[i].bytes, src, len);
+    return 0;
+}
 
-        unsigned long h = hash_string(key) % N_BUCKETS;
-        long bucket_offset = sizeof(IndexHeader) + sizeof(BucketDisk) * h;
+static int txn_cursor_open(IndexTxn *t, long bucket, IndexCursor *c) {
+    BucketDisk b;
+    BlockDisk blk;
+    if (txn_read(t, bucket_disk_offset(&t->h, bucket), &b, sizeof(b)) != 0) return -1;
+    if (t->h.offset_blocks && txn_read(t, block_disk_offset(&t->h, bucket), &blk, sizeof(blk)) != 0) return -1;
+    return cursor_load(t->idx, bucket, &b, t->h.offset_blocks ? &blk : NULL, c);
+}
 
-        BucketDisk b;
-        fseek(idx, bucket_offset, SEEK_SET);
-        fread(&b, sizeof(BucketDisk), 1, idx);
+// Si la tabla de buckets está llena, la copia (junto con la de bloques) al
+// final del archivo con el doble de capacidad. El espacio viejo queda sin
+// usar hasta la próxima compactación.
+static int grow_table(IndexTxn *t, long *table_offset, long old_cap, long new_cap,
+                      size_t elem, const void *empty) {
+    FILE *idx = t->idx;
+    unsigned char *tab = malloc(elem * new_cap);
+    if (!tab) return -1;
+    long old_end = *table_offset + (long)(elem * old_cap);
+    if (pread(fileno(idx), tab, elem * old_cap, *table_offset) != (ssize_t)(elem * old_cap)) {
+        free(tab);
+        return -1;
+    }
+    for (int i = 0; i < t->n_patches; i++) {   // la copia lleva lo pendiente
+        const IndexPatch *p = &t->patches[i];
+        if (p->at >= *table_offset && p->at + (long)p->len <= old_end)
+            memcpy(tab + (p->at - *table_offset), p->bytes, p->len);
+    }
+    for (long i = old_cap; i < new_cap; i++) memcpy(tab + elem * i, empty, elem);
 
-        EntryDisk entry = {0};
+    if (fseek(idx, 0, SEEK_END) != 0) { free(tab); return -1; }
+    long new_off = ftell(idx);
+    int ok = fwrite(tab, elem, new_cap, idx) == (size_t)new_cap;
+    free(tab);
+    if (!ok || fflush(idx) != 0) return -1;
+    *table_offset = new_off;
+    return 0;
+}
+
+static int index_grow_bucket_table(IndexTxn *t) {
+    IndexHeader *h = &t->h;
+    long new_cap = h->bucket_capacity * 2;
+    BucketDisk empty_bucket = { .first_entry_offset = -1 };
+    BlockDisk empty_block = { 0, 0, 0 };
+    if (grow_table(t, &h->offset_buckets, h->bucket_capacity, new_cap, sizeof(BucketDisk), &empty_bucket) != 0)
+        return -1;
+    if (h->offset_blocks &&
+        grow_table(t, &h->offset_blocks, h->bucket_capacity, new_cap, sizeof(BlockDisk), &empty_block) != 0)
+        return -1;
+    h->bucket_capacity = new_cap;
+    return 0;
+}
+
+// Copia al final del archivo las entradas de src que el hash del nivel
+// siguiente manda a `to` (src o el bucket nuevo), en el orden en que se
+// recorren. Con bloques quedan como el bloque contiguo de `to` (*blk) y sin
+// cadena; en los formatos 1 y 2, como una cadena nueva que empieza en *head.
+static int copy_bucket_part(IndexTxn *t, long src, long to, unsigned long modulus,
+                            long *head, BlockDisk *blk) {
+    FILE *idx = t->idx;
+    const IndexHeader *h = &t->h;
+    int fixed = h->version == INDEX_VERSION_FIXED_KEYS;
+    size_t esz = fixed ? sizeof(EntryDisk) : sizeof(EntryDisk2);
+    IndexCursor cur = {0};
+    IndexEntry e;
+    *head = -1;
+    memset(blk, 0, sizeof(*blk));
+
+    // Primera pasada: cuántas y cuánto ocupan
+    unsigned int count = 0;
+    size_t bytes = 0;
+    int r;
+    if (txn_cursor_open(t, src, &cur) != 0) return -1;
+    while ((r = index_cursor_next(idx, h, &cur, &e, 1)) == 1) {
+        if (index_key_hash(h, e.key) % modulus != (unsigned long)to) continue;
+        count++;
+        bytes += esz + (fixed ? 0 : e.key_len + 1);
+    }
+    if (r < 0 || count == 0) {
+        index_cursor_close(&cur);
+        return r < 0 ? -1 : 0;
+    }
+
+    long base = -1;
+    unsigned char *buf = calloc(1, bytes);
+    if (!buf || fseek(idx, 0, SEEK_END) != 0 || (base = ftell(idx)) == -1 ||
+        txn_cursor_open(t, src, &cur) != 0) {
+        free(buf);
+        index_cursor_close(&cur);
+        return -1;
+    }
+
+    // Segunda pasada: la copia, con los offsets ya absolutos
+    size_t epos = 0, kpos = (size_t)count * esz;
+    unsigned int i = 0;
+    while (i < count && (r = index_cursor_next(idx, h, &cur, &e, 1)) == 1) {
+        if (index_key_hash(h, e.key) % modulus != (unsigned long)to) continue;
+        int last = ++i == count;
+        if (fixed) {
+            EntryDisk d;
+            memset(&d, 0, sizeof(d));
+            memcpy(d.key, e.key, e.key_len < KEY_SIZE ? e.key_len : KEY_SIZE - 1);
+            d.csv_offset = e.csv_offset;
+            d.next_entry = last ? -1 : base + (long)(epos + esz);
+            memcpy(buf + epos, &d, esz);
+            epos += esz;
+            continue;
+        }
+        EntryDisk2 d = { e.fingerprint, e.key_len, 0, e.csv_offset, -1 };
+        if (h->offset_blocks) {             // [entradas][claves]
+            d.key_offset = base + (long)kpos;
+            memcpy(buf + kpos, e.key, e.key_len + 1);
+            kpos += e.key_len + 1;
+            memcpy(buf + epos, &d, esz);
+            epos += esz;
+        } else {                            // entrada y su clave, encadenadas
+            d.key_offset = base + (long)(epos + esz);
+            d.next_entry = last ? -1 : d.key_offset + (long)e.key_len + 1;
+            memcpy(buf + epos, &d, esz);
+            memcpy(buf + epos + esz, e.key, e.key_len + 1);
+            epos += esz + e.key_len + 1;
+        }
+    }
+    index_cursor_close(&cur);
+
+    // (el cursor movió la posición del FILE al leer la cadena)
+    int failed = r < 0 || i < count || fseek(idx, base, SEEK_SET) != 0 ||
+                 fwrite(buf, 1, bytes, idx) != bytes || fflush(idx) != 0;
+    free(buf);
+    if (failed) return -1;
+    if (h->offset_blocks) *blk = (BlockDisk){ base, count, (unsigned int)bytes };
+    else *head = base;
+    return 0;
+}
+
+// Parte el bucket h->split: sus entradas se copian al final del archivo en
+// dos partes, las que por el hash del nivel siguiente van al bucket nuevo
+// (split + n_initial * 2^level) y las que se quedan. Las del nuevo se
+// apuntan desde su lugar en la tabla, que hasta ahora nadie usaba (ni quien
+// lee con la cabecera publicada); las que se quedan reemplazan al bucket de
+// origen con la cabeza y el bloque que index_txn_commit escribe después de
+// la cabecera. Así el origen no arrastra lo que se fue y ningún bucket pasa
+// de INDEX_MAX_LOAD entradas por mucho. Lo viejo del origen queda sin usar
+// hasta la próxima compactación.
+static int index_split_bucket(IndexTxn *t) {
+    IndexHeader *h = &t->h;
+    if (h->n_buckets >= h->bucket_capacity && index_grow_bucket_table(t) != 0) return -1;
+
+    long m = (long)h->n_initial << h->level;
+    long src = h->split;
+    long dst = src + m;
+
+    BucketDisk head, src_head;
+    BlockDisk blk, src_blk;
+    if (copy_bucket_part(t, src, dst, (unsigned long)(m << 1), &head.first_entry_offset, &blk) != 0 ||
+        copy_bucket_part(t, src, src, (unsigned long)(m << 1), &src_head.first_entry_offset, &src_blk) != 0 ||
+        pwrite(fileno(t->idx), &head, sizeof(head), bucket_disk_offset(h, dst)) != (ssize_t)sizeof(head) ||
+        (h->offset_blocks &&
+         pwrite(fileno(t->idx), &blk, sizeof(blk), block_disk_offset(h, dst)) != (ssize_t)sizeof(blk)))
+        return -1;
+    if (txn_patch(t, bucket_disk_offset(h, src), &src_head, sizeof(src_head)) != 0 ||
+        (h->offset_blocks && txn_patch(t, block_disk_offset(h, src), &src_blk, sizeof(src_blk)) != 0))
+        return -1;
+
+    h->n_buckets++;
+    if (++h->split == m) {
+        h->level++;
+        h->split = 0;
+    }
+    return 0;
+}
+
+int index_txn_begin(IndexTxn *t, const char *index_path) {
+    memset(t, 0, sizeof(*t));
+    t->idx = fopen(index_path, "r+b");
+    if (!t->idx) return -1;
+    if (index_read_header(t->idx, &t->h) != 0) {
+        fclose(t->idx);
+        t->idx = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Agrega (key, csv_offset) a la transacción y parte un bucket si la carga
+// promedio supera INDEX_MAX_LOAD. La entrada va a la cadena de overflow del
+// bucket hasta la próxima compactación. Devuelve el offset de la nueva
+// entrada (y el bucket en *bucket_out) o -1 si hubo error.
+long index_txn_insert(IndexTxn *t, const char *key, long csv_offset, long *bucket_out) {
+    IndexHeader *h = &t->h;
+    FILE *idx = t->idx;
+
+    // El hash sale de la clave tal como se guarda (recortada si es más
+    // larga que el formato), así una partición la vuelve a ubicar
+    char stored[INDEX_KEY_MAX];
+    size_t max = h->version == INDEX_VERSION_FIXED_KEYS ? KEY_SIZE - 1 : INDEX_KEY_MAX - 1;
+    size_t klen = strlen(key);
+    if (klen > max) {
+        memcpy(stored, key, max);
+        stored[max] = '\0';
+        key = stored;
+        klen = max;
+    }
+    long bucket_id = index_bucket_for(h, index_key_hash(h, key));
+    long bucket_offset = bucket_disk_offset(h, bucket_id);
+    if (bucket_out) *bucket_out = bucket_id;
+
+    BucketDisk bucket;
+    if (txn_read(t, bucket_offset, &bucket, sizeof(bucket)) != 0) return -1;
+
+    // La entrada nueva va al final del archivo; en el formato compacto su
+    // clave va justo detrás (el heap crece intercalado con las entradas).
+    long new_entry_offset;
+    if (fseek(idx, 0, SEEK_END) != 0 || (new_entry_offset = ftell(idx)) == -1) return -1;
+    int ok;
+    if (h->version == INDEX_VERSION_FIXED_KEYS) {
+        EntryDisk entry;
+        memset(&entry, 0, sizeof(EntryDisk));
         strncpy(entry.key, key, KEY_SIZE - 1);
-        entry.csv_offset = line_start;
-        entry.next_entry = b.first_entry_offset;
+        entry.csv_offset = csv_offset;
+        entry.next_entry = bucket.first_entry_offset;
+        ok = fwrite(&entry, sizeof(EntryDisk), 1, idx) == 1;
+    } else {
+        EntryDisk2 entry;
+        entry.fingerprint = index_key_fingerprint(h, key);
+        entry.key_len = (unsigned int)klen;
+        entry.key_offset = new_entry_offset + (long)sizeof(EntryDisk2);
+        entry.csv_offset = csv_offset;
+        entry.next_entry = bucket.first_entry_offset;
+        ok = fwrite(&entry, sizeof(EntryDisk2), 1, idx) == 1 &&
+             fwrite(key, 1, klen, idx) == klen &&
+             fputc('\0', idx) != EOF;
+    }
+    // la partición y txn_read usan pread: vaciamos antes el buffer de stdio
+    if (!ok || fflush(idx) != 0) return -1;
 
-        fseek(idx, 0, SEEK_END);
-        long new_entry_offset = ftell(idx);
-        fwrite(&entry, sizeof(EntryDisk), 1, idx);
+    bucket.first_entry_offset = new_entry_offset;
+    if (txn_patch(t, bucket_offset, &bucket, sizeof(bucket)) != 0) return -1;
+    h->n_entries++;
+    h->n_overflow++;
+    if (h->n_entries > (long)INDEX_MAX_LOAD * h->n_buckets && index_split_bucket(t) != 0)
+        fprintf(stderr, "[INDEX] no se pudo partir el bucket %ld\n", h->split);
+    return new_entry_offset;
+}
 
-        b.first_entry_offset = new_entry_offset;
-        fseek(idx, bucket_offset, SEEK_SET);
-        fwrite(&b, sizeof(BucketDisk), 1, idx);
+// Escribe la cabecera, que hace valer las particiones (los buckets nuevos
+// ya están en el archivo), y después las cabezas y bloques pendientes. Son
+// unas pocas palabras: todo lo demás ya está escrito. Quien lee el índice
+// mapeado no debe leer en el medio (el servidor lo hace con las búsquedas
+// excluidas). Si el proceso se cae entre la cabecera y el resto, se pierden
+// a lo sumo los enlaces de las entradas nuevas (el log de inserciones las
+// vuelve a agregar) y un bucket partido conserva lo que se fue, que los
+// cursores saltean hasta la próxima compactación.
+int index_txn_commit(IndexTxn *t) {
+    int fd = fileno(t->idx);
+    size_t hsize = index_header_size(&t->h);
+    if (pwrite(fd, &t->h, hsize, 0) != (ssize_t)hsize) return -1;
+    for (int i = 0; i < t->n_patches; i++) {
+        const IndexPatch *p = &t->patches[i];
+        if (pwrite(fd, p->bytes, p->len, p->at) != (ssize_t)p->len) return -1;
     }
+    t->n_patches = 0;
+    return 0;
+}
 
-    fclose(csv);
+void index_txn_close(IndexTxn *t) {
+    if (t->idx) fclose(t->idx);
+    free(t->patches);
+    memset(t, 0, sizeof(*t));
+}
+
+// Inserta (key, csv_offset) en el índice: una transacción de una entrada.
+long index_insert(const char *index_path, const char *key, long csv_offset, long *bucket_out) {
+    IndexTxn t;
+    if (index_txn_begin(&t, index_path) != 0) return -1;
+    long off = index_txn_insert(&t, key, csv_offset, bucket_out);
+    if (off >= 0 && index_txn_commit(&t) != 0) off = -1;
+    index_txn_close(&t);
+    return off;
+}
+
+// --- Búsqueda exacta ---
+// Desde el formato 4 todas las variantes de mayúsculas de un título caen
+// en el mismo bucket: basta recorrer ese bucket comparando primero el
+// fingerprint, y la clave (strcasecmp) solo si coincide. En formatos
+// anteriores solo se encuentra la clave con las mismas mayúsculas.
+
+// Devuelve el offset en el CSV del primer registro cuyo título es key
+// (sin distinguir mayúsculas), o -1 si no está.
+long search_in_index(const char *key, const char *index_path) {
+    FILE *idx = fopen(index_path, "rb");
+    if (!idx) return -1;
+
+    IndexHeader h;
+    long found = -1;
+    if (index_read_header(idx, &h) == 0) {
+        IndexCursor cur = {0};
+        IndexEntry e;
+        unsigned int fp = index_key_fingerprint(&h, key);
+        if (index_cursor_open(idx, &h, index_bucket_for(&h, index_key_hash(&h, key)), &cur) == 0) {
+            cur.bucket = -1;    // la clave se compara entera
+            while (found == -1 && index_cursor_next(idx, &h, &cur, &e, 0) == 1) {
+                if (e.fingerprint == fp && (e.has_key || index_read_key(idx, &e) == 0) &&
+                    strcasecmp(e.key, key) == 0) found = e.csv_offset;
+            }
+        }
+        index_cursor_close(&cur);
+    }
     fclose(idx);
-    printf("Índice generado correctamente con %d buckets.\n", N_BUCKETS);
-    return 0;
+    return found;
+}
+
+// Igual, sobre el índice mapeado y con todas las coincidencias (puede haber
+// títulos repetidos): llama a fn con cada offset hasta que devuelva != 0.
+// Devuelve la cantidad de coincidencias entregadas, o -1 si hubo error.
+long index_find_exact_map(const unsigned char *map, size_t map_size, const IndexHeader *h, const char *key,
+                          int (*fn)(long csv_offset, void *arg), void *arg) {
+    IndexCursor cur = {0};
+    IndexEntry e;
+    unsigned int fp = index_key_fingerprint(h, key);
+    if (index_cursor_open_map(map, map_size, h, index_bucket_for(h, index_key_hash(h, key)), &cur) != 0) return -1;
+    cur.bucket = -1;    // la clave se compara entera
+
+    long found = 0;
+    int r;
+    while ((r = index_cursor_next(NULL, h, &cur, &e, 1)) == 1) {
+        if (e.fingerprint != fp || strcasecmp(e.key, key) != 0) continue;
+        found++;
+        if (fn(e.csv_offset, arg)) break;
+    }
+    index_cursor_close(&cur);
+    return r < 0 ? -1 : found;
 }
 
 // --- Función de búsqueda híbrida ---
@@ -133,46 +1298,14 @@ void append_and_reindex_bin(
     fclose(fcsv);
     printf("[CSV] Nuevo registro añadido (offset=%ld)\n", csv_offset);
 
-    // 3️⃣ Abrir índice binario
-    FILE *findex = fopen("index.bin", "r+b");
-    if (!findex) {
-        perror("No se pudo abrir index.bin");
+    // 3️⃣ Insertar en el índice (puede partir un bucket si la carga crece)
+    long bucket_id = -1;
+    long new_entry_offset = index_insert("index.bin", title, csv_offset, &bucket_id);
+    if (new_entry_offset < 0) {
+        fprintf(stderr, "No se pudo actualizar index.bin\n");
         return;
     }
-
-    // 4️⃣ Leer header
-    IndexHeader header;
-    fread(&header, sizeof(IndexHeader), 1, findex);
-
-    // 5️⃣ Calcular bucket
-    unsigned long h = hash_string(title);
-    int bucket_id = h % header.n_buckets;
-    long bucket_offset = header.offset_buckets + bucket_id * sizeof(BucketDisk);
-
-    // 6️⃣ Leer bucket existente
-    fseek(findex, bucket_offset, SEEK_SET);
-    BucketDisk bucket;
-    fread(&bucket, sizeof(BucketDisk), 1, findex);
-
-    // 7️⃣ Crear nueva entrada
-    EntryDisk entry;
-    memset(&entry, 0, sizeof(EntryDisk));
-    strncpy(entry.key, title, KEY_SIZE - 1);
-    entry.csv_offset = csv_offset;
-    entry.next_entry = bucket.first_entry_offset;
-
-    // 8️⃣ Guardar nueva entrada al final
-    fseek(findex, 0, SEEK_END);
-    long new_entry_offset = ftell(findex);
-    fwrite(&entry, sizeof(EntryDisk), 1, findex);
-
-    // 9️⃣ Actualizar bucket
-    bucket.first_entry_offset = new_entry_offset;
-    fseek(findex, bucket_offset, SEEK_SET);
-    fwrite(&bucket, sizeof(BucketDisk), 1, findex);
-
-    fclose(findex);
-    printf("[INDEX] '%s' insertado en bucket %d (entry_offset=%ld)\n",
+    printf("[INDEX] '%s' insertado en bucket %ld (entry_offset=%ld)\n",
            title, bucket_id, new_entry_offset);
 }
 
@@ -189,47 +1322,47 @@ void search_by_keyword2(const char *keyword, int exact, const char *index_file)
     }
 
     clock_t start = clock();
-    unsigned long h = hash_string(keyword);
     IndexHeader header;
-    fread(&header, sizeof(IndexHeader), 1, idx);
-
-    int bucket_id = h % header.n_buckets;
-    long bucket_offset = header.offset_buckets + bucket_id * sizeof(BucketDisk);
+    if (index_read_header(idx, &header) != 0) {
+        fprintf(stderr, "index.bin inválido o de un formato anterior\n");
+        fclose(idx);
+        fclose(csv);
+        return;
+    }
 
-    fseek(idx, bucket_offset, SEEK_SET);
-    BucketDisk b;
-    fread(&b, sizeof(BucketDisk), 1, idx);
+    long bucket_id = index_bucket_for(&header, index_key_hash(&header, keyword));
 
-    long current = b.first_entry_offset;
-    EntryDisk entry;
+    IndexCursor cur = {0};
+    IndexEntry entry;
+    unsigned int fp = index_key_fingerprint(&header, keyword);
     int found = 0;
 
-    while (current != -1) {
-        fseek(idx, current, SEEK_SET);
-        fread(&entry, sizeof(EntryDisk), 1, idx);
-
-        int match = 0;
-        if (exact) {
-            if (strcasecmp(entry.key, keyword) == 0) match = 1;
-        } else {
-            if (strcasestr(entry.key, keyword)) match = 1;
-        }
+    // En búsqueda exacta el fingerprint descarta sin leer la clave
+    if (index_cursor_open(idx, &header, bucket_id, &cur) == 0) {
+        while (index_cursor_next(idx, &header, &cur, &entry, !exact) == 1) {
+            int match = 0;
+            if (exact) {
+                if (entry.fingerprint == fp && index_read_key(idx, &entry) == 0 &&
+                    strcasecmp(entry.key, keyword) == 0) match = 1;
+            } else {
+                if (strsearch_ci_str(entry.key, keyword)) match = 1;
+            }
 
-        if (match) {
-            found++;
-            fseek(csv, entry.csv_offset, SEEK_SET);
-            char line[4096];
-            if (fgets(line, sizeof(line), csv))
-                printf("%s", line);
+            if (match) {
+                found++;
+                fseek(csv, entry.csv_offset, SEEK_SET);
+                char line[4096];
+                if (fgets(line, sizeof(line), csv))
+                    printf("%s", line);
 
-            if (found >= 50) {
-                printf("\nMostrando solo las primeras 50 coincidencias.\n");
-                break;
+                if (found >= 50) {
+                    printf("\nMostrando solo las primeras 50 coincidencias.\n");
+                    break;
+                }
             }
         }
-
-        current = entry.next_entry;
     }
+    index_cursor_close(&cur);
 
     double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
     if (!found)
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "csv.h"
+#include "fmap.h"
+#include "offsets.h"
+
+// Escribe offsets.bin completo (en un .tmp que después se renombra).
+int offsets_write(const char *path, const long *offs, long n, long csv_end) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) return -1;
+
+    OffsetsHeader h = { OFFSETS_MAGIC, OFFSETS_VERSION, n, csv_end };
+    int failed = fwrite(&h, sizeof(h), 1, out) != 1 ||
+                 (n > 0 && fwrite(offs, sizeof(long), (size_t)n, out) != (size_t)n);
+    if (fclose(out) != 0) failed = 1;
+    if (!failed && rename(tmp_path, path) != 0) failed = 1;
+    if (failed) remove(tmp_path);
+    return failed ? -1 : 0;
+}
+
+// Sin index.bin nuevo (el índice ya existía): una pasada por el CSV
+// mapeado buscando los '\n'.
+int offsets_build(const char *csv_path, const char *out_path) {
+    FileMap csv;
+    if (fmap_open(&csv, csv_path) != 0) return -1;
+    madvise(csv.base, csv.size, MADV_SEQUENTIAL);
+
+    const char *base = (const char *)csv.base, *end = base + csv.size;
+    const char *line = csv_skip_header(base, end);
+
+    long *offs = NULL, n = 0, cap = 0;
+    int failed = 0;
+    while (line < end) {
+        if (n == cap) {
+            long ncap = cap ? cap * 2 : 65536;
+            long *no = realloc(offs, sizeof(long) * ncap);
+            if (!no) { failed = 1; break; }
+            offs = no;
+            cap = ncap;
+        }
+        offs[n++] = (long)(line - base);
+        const char *stop = csv_record_end(line, end);
+        line = stop < end ? stop + 1 : end;
+    }
+    if (!failed) failed = offsets_write(out_path, offs, n, (long)csv.size) != 0;
+    free(offs);
+    fmap_close(&csv);
+
+    if (failed) {
+        fprintf(stderr, "[OFFSETS] Error construyendo %s\n", out_path);
+        return -1;
+    }
+    printf("[OFFSETS] %ld registros\n", n);
+    return 0;
+}
+
+int offsets_open(OffsetsFile *o, const char *path) {
+    o->fd = open(path, O_RDWR);
+    if (o->fd < 0) return -1;
+    off_t size = lseek(o->fd, 0, SEEK_END);
+    if (pread(o->fd, &o->h, sizeof(o->h), 0) != (ssize_t)sizeof(o->h) ||
+        o->h.magic != OFFSETS_MAGIC || o->h.version != OFFSETS_VERSION || o->h.n_records < 0 ||
+        (off_t)(sizeof(OffsetsHeader) + sizeof(long) * (size_t)o->h.n_records) > size) {
+        offsets_close(o);
+        return -1;
+    }
+    return 0;
+}
+
+void offsets_close(OffsetsFile *o) {
+    if (o->fd >= 0) close(o->fd);
+    memset(o, 0, sizeof(*o));
+    o->fd = -1;
+}
+
+// Agrega el registro que empieza en csv_offset; csv_end es el nuevo tamaño del CSV.
+int offsets_append(OffsetsFile *o, long csv_offset, long csv_end) {
+    return offsets_stage(o, &csv_offset, 1, csv_end, &o->h);
+}
+
+// Escribe al final los offsets de n registros nuevos y la cabecera que los
+// cuenta, pero deja o->h como estaba: offsets_range sigue viendo los
+// registros de antes hasta que quien llama copia *next en o->h.
+int offsets_stage(OffsetsFile *o, const long *offs, long n, long csv_end, OffsetsHeader *next) {
+    OffsetsHeader h = o->h;
+    off_t at = (off_t)(sizeof(OffsetsHeader) + sizeof(long) * (size_t)h.n_records);
+    ssize_t bytes = (ssize_t)(sizeof(long) * (size_t)n);
+    if (n > 0 && pwrite(o->fd, offs, (size_t)bytes, at) != bytes) return -1;
+    h.n_records += n;
+    h.csv_end = csv_end;
+    if (pwrite(o->fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) return -1;
+    *next = h;
+    return 0;
+}
+
+// Descarta los registros que empiezan en csv_end o después (para volver a
+// agregarlos con offsets_catch_up): lo escrito después del último
+// checkpoint del log de inserciones puede haber quedado a medias.
+int offsets_truncate(OffsetsFile *o, long csv_end) {
+    if (csv_end >= o->h.csv_end) return 0;
+    long lo = 0, hi = o->h.n_records;     // primer registro con offset >= csv_end
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2, off;
+        off_t at = (off_t)(sizeof(OffsetsHeader) + sizeof(long) * (size_t)mid);
+        if (pread(o->fd, &off, sizeof(off), at) != (ssize_t)sizeof(off)) return -1;
+        if (off < csv_end) lo = mid + 1;
+        else hi = mid;
+    }
+    o->h.n_records = lo;
+    o->h.csv_end = csv_end;
+    return pwrite(o->fd, &o->h, sizeof(o->h), 0) == (ssize_t)sizeof(o->h) ? 0 : -1;
+}
+
+// Agrega los registros del CSV posteriores a csv_end (escritos mientras el
+// servidor no estaba corriendo).
+int offsets_catch_up(OffsetsFile *o, const char *csv_base, size_t csv_size) {
+    const char *end = csv_base + csv_size;
+    for (const char *line = csv_base + o->h.csv_end; line < end; ) {
+        const char *stop = csv_record_end(line, end);
+        const char *next = stop < end ? stop + 1 : end;
+        if (offsets_append(o, (long)(line - csv_base), (long)(next - csv_base)) != 0) return -1;
+        line = next;
+    }
+    return 0;
+}
+
+// Deja en bounds[0..n] los límites de los registros first..first+n-1
+// (numerados desde 1) con un solo pread: el registro first+i ocupa
+// [bounds[i], bounds[i+1]). Recorta el rango a los registros existentes y
+// devuelve cuántos quedaron (0 si ninguno, -1 si falla la lectura).
+long offsets_range(const OffsetsFile *o, long first, long count, long *bounds) {
+    if (first < 1 || first > o->h.n_records || count <= 0) return 0;
+    if (count > o->h.n_records - first + 1) count = o->h.n_records - first + 1;
+
+    int has_next = first + count <= o->h.n_records;
+    size_t want = (size_t)(count + has_next);
+    off_t at = (off_t)(sizeof(OffsetsHeader) + sizeof(long) * (size_t)(first - 1));
+    if (pread(o->fd, bounds, sizeof(long) * want, at) != (ssize_t)(sizeof(long) * want)) return -1;
+    if (!has_next) bounds[count] = o->h.csv_end;
+    return count;
+}
@@ -0,0 +1,41 @@
+#ifndef OFFSETS_H
+#define OFFSETS_H
+
+#include <stddef.h>
+
+#define OFFSETS_FILE "offsets.bin"
+#define OFFSETS_MAGIC 0x5346464fu   /* "OFFS" */
+#define OFFSETS_VERSION 1
+
+/* Número de registro -> offset en el CSV, para leer el registro N sin
+   recorrer el archivo. Los registros se numeran desde 1 (la cabecera no
+   cuenta) y el registro N ocupa [off[N-1], off[N]) (el último termina en
+   csv_end).
+
+   Disposición de offsets.bin:
+     OffsetsHeader
+     long[n_records]             creciente */
+typedef struct {
+    unsigned int magic;
+    int version;
+    long n_records;
+    long csv_end;           /* tamaño del CSV cubierto */
+} OffsetsHeader;
+
+/* Abierto para lectura y para agregar al final */
+typedef struct {
+    int fd;
+    OffsetsHeader h;
+} OffsetsFile;
+
+int  offsets_write(const char *path, const long *offs, long n, long csv_end);
+int  offsets_build(const char *csv_path, const char *out_path);
+int  offsets_open(OffsetsFile *o, const char *path);
+void offsets_close(OffsetsFile *o);
+int  offsets_append(OffsetsFile *o, long csv_offset, long csv_end);
+int  offsets_stage(OffsetsFile *o, const long *offs, long n, long csv_end, OffsetsHeader *next);
+int  offsets_truncate(OffsetsFile *o, long csv_end);
+int  offsets_catch_up(OffsetsFile *o, const char *csv_base, size_t csv_size);
+long offsets_range(const OffsetsFile *o, long first, long count, long *bounds);
+
+#endif
@@ -88,6 +88,11 @@ int read_key(void) {
 }
 
 // ---------------------- CONEXION AL SERVIDOR ----------------------
+#define CMD_HELLO 12              // negocia la versión 2 (conexión persistente)
+static int g_sock = -1;           // conexión persistente, -1 si no hay
+static int g_version = 0;         // 0: sin negociar, 1: una conexión por comando, 2: persistente
+static uint32_t g_next_id = 0;    // id de la próxima petición (versión 2)
+
 // Abre un socket TCP y conecta con SERVER_IP:SERVER_PORT
 int connect_server(void) {
     int sock = socket(AF_INET, SOCK_STREAM, 0);         // socket TCP IPv4
@@ -105,52 +110,212 @@ int connect_server(void) {
     return sock;                                        // devuelvo fd del socket
 }
 
-// Protocolo app muy simple: mando (cmd:uint32_be)(len:uint32_be)(payload bytes)
-// El server responde: (resp_len:uint32_be)(resp_bytes)
-int send_command_and_receive(int cmd, const char *payload, char *out, size_t outsz) {
-    if(!payload) payload="";                            // payload nulo -> vacío
-    int sock = connect_server();                        // abro conexión
-    if(sock<0) return -1;
+// Lee el cuerpo de una respuesta de len bytes en 'out'. Si no entra, guarda lo que
+// cabe y descarta el resto, para que la conexión quede lista para la siguiente
+int read_reply_body(int sock, uint32_t len, char *out, size_t outsz){
+    uint32_t keep = len < outsz ? len : (uint32_t)outsz-1;  // garantizo espacio para '\0'
+    if(readn(sock,out,keep)!=(ssize_t)keep) return -1;
+    out[keep]='\0';                                      // aseguro cadena terminada
+    char skip[512];
+    for(uint32_t left=len-keep; left>0; ){              // lo que sobra
+        size_t n = left<sizeof(skip) ? left : sizeof(skip);
+        if(readn(sock,skip,n)!=(ssize_t)n) return -1;
+        left -= (uint32_t)n;
+    }
+    return 0;
+}
 
-    uint32_t cmd_net = htonl(cmd);                      // convierto a big-endian de red
-    uint32_t len_net = htonl((uint32_t)strlen(payload));
+// Versión 1 del protocolo: mando (cmd:uint32_be)(len:uint32_be)(payload bytes)
+// El server responde: (resp_len:uint32_be)(resp_bytes) y cierra
+int request_v1(int sock, int cmd, const char *payload, char *out, size_t outsz){
+    uint32_t head[2] = { htonl(cmd), htonl((uint32_t)strlen(payload)) }; // big-endian de red
     // envío cabecera y payload (si hay)
-    if(writen(sock,&cmd_net,sizeof(cmd_net))!=sizeof(cmd_net) ||
-       writen(sock,&len_net,sizeof(len_net))!=sizeof(len_net) ||
+    if(writen(sock,head,sizeof(head))!=sizeof(head) ||
        (strlen(payload)>0 && writen(sock,payload,strlen(payload))!=(ssize_t)strlen(payload))) {
-        perror("send_command"); close(sock); return -1; // error en envío
+        perror("send_command"); return -1;              // error en envío
+    }
+    uint32_t resp_len_net;                              // leo primero el tamaño de la respuesta
+    if(readn(sock,&resp_len_net,sizeof(resp_len_net))!=sizeof(resp_len_net)) return -1;
+    return read_reply_body(sock,ntohl(resp_len_net),out,outsz);
+}
+
+// Versión 2: mando (cmd)(id)(len)(payload) y el server responde (id)(resp_len)(resp_bytes)
+// sin cerrar. Se pueden mandar varias peticiones sin esperar (pipelining): las
+// respuestas llegan en cualquier orden y cada una va a su petición por el id
+#define MAX_INFLIGHT 64           // peticiones sin respuesta (el server deja de leer en 64)
+typedef struct {
+    uint32_t id;
+    char *out; size_t outsz;      // dónde va la respuesta
+    int done, status;             // status: 0 si llegó bien
+} Pending;
+static Pending *g_inflight[MAX_INFLIGHT];   // enviadas y sin respuesta
+static int g_ninflight = 0;
+
+// Corta la conexión: las peticiones en vuelo quedan terminadas con error
+void drop_connection(void){
+    for(int i=0;i<g_ninflight;i++){ g_inflight[i]->done=1; g_inflight[i]->status=-1; }
+    g_ninflight=0;
+    if(g_sock>=0) close(g_sock);
+    g_sock=-1;
+}
+
+// Manda una petición por la conexión persistente sin esperar la respuesta.
+// p queda en vuelo hasta que request_collect la complete (p y out deben vivir hasta entonces)
+int request_send(Pending *p, int cmd, const char *payload, char *out, size_t outsz){
+    if(g_sock<0 || g_ninflight==MAX_INFLIGHT) return -1;
+    p->id=++g_next_id; p->out=out; p->outsz=outsz; p->done=0; p->status=-1;
+    uint32_t head[3] = { htonl(cmd), htonl(p->id), htonl((uint32_t)strlen(payload)) };
+    if(writen(g_sock,head,sizeof(head))!=sizeof(head) ||
+       (strlen(payload)>0 && writen(g_sock,payload,strlen(payload))!=(ssize_t)strlen(payload))){
+        drop_connection(); return -1;
     }
+    g_inflight[g_ninflight++]=p;
+    return 0;
+}
 
-    // leo primero el tamaño de la respuesta
-    uint32_t resp_len_net;
-    if(readn(sock,&resp_len_net,sizeof(resp_len_net))!=sizeof(resp_len_net)){ close(sock); return -1; }
-    uint32_t resp_len = ntohl(resp_len_net);            // paso a endianness host
+// Espera la respuesta de p. Las que lleguen antes se guardan en su propia petición
+int request_collect(Pending *p){
+    while(!p->done){
+        uint32_t resp_head[2];                          // id y tamaño
+        if(readn(g_sock,resp_head,sizeof(resp_head))!=sizeof(resp_head)){ drop_connection(); break; }
+        uint32_t id=ntohl(resp_head[0]), len=ntohl(resp_head[1]);
+        int i=0;
+        while(i<g_ninflight && g_inflight[i]->id!=id) i++;
+        if(i==g_ninflight){                             // nadie la pidió: el stream ya no es confiable
+            fprintf(stderr,"Respuesta con id %u que no se pidió\n",id); drop_connection(); break;
+        }
+        Pending *q=g_inflight[i];
+        g_inflight[i]=g_inflight[--g_ninflight];        // sale de la tabla
+        q->done=1;
+        q->status=read_reply_body(g_sock,len,q->out,q->outsz);
+        if(q->status!=0){ drop_connection(); break; }
+    }
+    return p->status;
+}
 
-    // evito overflow en 'out' y garantizo espacio para '\0'
-    if(resp_len >= outsz) resp_len = (uint32_t)outsz-1;
+// Una petición y su respuesta
+int request_v2(int cmd, const char *payload, char *out, size_t outsz){
+    Pending p;
+    if(request_send(&p,cmd,payload,out,outsz)!=0) return -1;
+    return request_collect(&p);
+}
 
-    // leo la respuesta en 'out'
-    if(readn(sock,out,resp_len)!=(ssize_t)resp_len){ close(sock); return -1; }
-    out[resp_len]='\0';                                 // aseguro cadena terminada
-    close(sock);                                        // cierro socket (protocolo por-request)
-    return 0;                                           // OK
+// Abre la conexión persistente: conecta y manda HELLO pidiendo la versión 2.
+// Un server viejo cierra sin responder (o responde "1"): sigo con la versión 1
+int open_persistent(void){
+    int sock = connect_server();
+    if(sock<0) return -1;                               // server caído: se vuelve a negociar después
+    char reply[16];
+    if(request_v1(sock,CMD_HELLO,"2",reply,sizeof(reply))==0 && atoi(reply)==2){
+        g_sock = sock; g_version = 2; return 0;
+    }
+    close(sock); g_version = 1; return -1;
+}
+
+// Manda un comando y deja la respuesta en 'out'. Usa la conexión persistente
+// si el server la soporta; si no, abre una por comando (protocolo viejo)
+int send_command_and_receive(int cmd, const char *payload, char *out, size_t outsz) {
+    if(!payload) payload="";                            // payload nulo -> vacío
+    if(g_version==0) open_persistent();                 // primera vez: negocio la versión
+    if(g_version==2){
+        // Si el server se reinició la conexión ya no sirve: reconecto una vez.
+        // Una inserción no se reintenta (podría quedar guardada dos veces)
+        for(int attempt=0; attempt<2; attempt++){
+            if(g_sock<0 && open_persistent()!=0) break;
+            if(g_version!=2) break;                     // el server nuevo es viejo
+            if(request_v2(cmd,payload,out,outsz)==0) return 0;
+            drop_connection();
+            if(cmd==2) return -1;
+        }
+        if(g_version==2) return -1;
+    }
+    if(g_version==0) return -1;                         // no hay server
+    int sock = connect_server();                        // versión 1: una conexión por comando
+    if(sock<0) return -1;
+    int r = request_v1(sock,cmd,payload,out,outsz);
+    close(sock);                                        // el server cierra igual
+    return r;
+}
+
+// Manda n comandos iguales con distintos payloads y deja las respuestas en
+// out[i]. Con la versión 2 van todos juntos (de a MAX_INFLIGHT) y se esperan
+// al final; si no, uno por uno. Devuelve -1 si alguno falló
+int send_many(int cmd, char **payloads, int n, char out[][RECV_BUF_SZ]){
+    if(g_version==0) open_persistent();                 // primera vez: negocio la versión
+    if(g_version!=2 || (g_sock<0 && open_persistent()!=0)){
+        for(int i=0;i<n;i++) if(send_command_and_receive(cmd,payloads[i],out[i],RECV_BUF_SZ)!=0) return -1;
+        return 0;
+    }
+    Pending p[MAX_INFLIGHT];
+    for(int from=0; from<n; from+=MAX_INFLIGHT){
+        int k = n-from < MAX_INFLIGHT ? n-from : MAX_INFLIGHT;
+        int sent=0, failed=0;
+        while(sent<k && request_send(&p[sent],cmd,payloads[from+sent],out[from+sent],RECV_BUF_SZ)==0) sent++;
+        if(sent<k) failed=1;                            // se cortó la conexión
+        for(int i=0;i<sent;i++) if(request_collect(&p[i])!=0) failed=1;  // cada respuesta a su buffer
+        if(failed){ drop_connection(); return -1; }
+    }
+    return 0;
 }
 
 // ---------------------- BÚSQUEDA INTERACTIVA ----------------------
-void search_interactive(const char *q) {
+void show_results(char *reply, double elapsed);
+
+// cmd=1: búsqueda en títulos, cmd=3: búsqueda con ranking en abstracts
+void search_interactive(int cmd, const char *q) {
     char reply[RECV_BUF_SZ];                            // buffer respuesta
 
     struct timespec start, end;                         // medir duración
     clock_gettime(CLOCK_MONOTONIC, &start);             // tiempo inicio
 
-    // cmd=1: “Buscar”. payload = query 'q'
-    if (send_command_and_receive(1, q, reply, sizeof(reply)) != 0) {
+    // payload = query 'q'
+    if (send_command_and_receive(cmd, q, reply, sizeof(reply)) != 0) {
         printf("Error consultando al servidor.\n");
         return;
     }
 
     clock_gettime(CLOCK_MONOTONIC, &end);               // tiempo fin
-    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9;
+    show_results(reply, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9);
+}
+
+// Búsqueda exacta de varias claves separadas por espacios (ids o DOIs):
+// se piden todas juntas y los resultados se muestran en el orden pedido
+void search_many(int cmd, char *list) {
+    char *keys[MAX_INFLIGHT*4];
+    int n = 0;
+    for(char *k=strtok(list," \t"); k && n<(int)(sizeof(keys)/sizeof(keys[0])); k=strtok(NULL," \t")) keys[n++]=k;
+    if(n<=1){ search_interactive(cmd, n ? keys[0] : list); return; }
+
+    char (*replies)[RECV_BUF_SZ] = malloc((size_t)n*RECV_BUF_SZ);
+    char *all = malloc(RECV_BUF_SZ);
+    if(!replies || !all){ free(replies); free(all); printf("Sin memoria.\n"); return; }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(send_many(cmd, keys, n, replies) != 0){
+        printf("Error consultando al servidor.\n");
+        free(replies); free(all); return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    size_t len = 0; all[0] = '\0';
+    for(int i=0;i<n;i++){                               // una respuesta tras otra, con su salto
+        size_t r = strlen(replies[i]);
+        if(r==0) continue;
+        if(len+r+2 > RECV_BUF_SZ){                      // el resto no entra en la paginación
+            printf("(se muestran las primeras %d de %d claves)\n", i, n); break;
+        }
+        memcpy(all+len, replies[i], r); len += r;
+        if(all[len-1]!='\n') all[len++]='\n';
+        all[len]='\0';
+    }
+    free(replies);
+    show_results(all, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9);
+    free(all);
+}
+
+// Muestra la respuesta de a una línea, con ← → para moverse
+void show_results(char *reply, double elapsed) {
     printf("[Búsqueda realizada en %.3f segundos]\n", elapsed);
 
     // Parto la respuesta por líneas para paginarlas con ← →
@@ -186,6 +351,22 @@ void search_interactive(const char *q) {
 }
 
 // ---------------------- CSV ----------------------
+// escribe c en dst[n] si entra (dejando lugar para el '\0'); devuelve n+1
+size_t put_char(char *dst, size_t dst_sz, size_t n, char c){
+    if(n+1<dst_sz) dst[n]=c;
+    return n+1;
+}
+
+// agrega s a dst[n..] entre comillas, doblando las " de adentro (RFC 4180); devuelve el nuevo largo
+size_t put_quoted(char *dst, size_t dst_sz, size_t n, const char *s){
+    n=put_char(dst,dst_sz,n,'"');
+    for(;*s;s++){
+        if(*s=='"') n=put_char(dst,dst_sz,n,'"');                   // " -> ""
+        n=put_char(dst,dst_sz,n,*s);
+    }
+    return put_char(dst,dst_sz,n,'"');
+}
+
 // Arma una línea CSV con 14 campos, ya con comillas y separadas por comas
 void make_csv_line(char *dst, size_t dst_sz,
                    const char *id, const char *submitter, const char *authors,
@@ -193,23 +374,94 @@ void make_csv_line(char *dst, size_t dst_sz,
                    const char *comments, const char *journal_ref, const char *doi,
                    const char *report_no, const char *license, const char *update_date,
                    const char *versions_count, const char *versions_last_created){
-    snprintf(dst,dst_sz,"\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"",
-             id,submitter,authors,title,abstract,categories,comments,journal_ref,doi,report_no,license,update_date,versions_count,versions_last_created);
+    const char *fields[14]={id,submitter,authors,title,abstract,categories,comments,journal_ref,doi,
+                            report_no,license,update_date,versions_count,versions_last_created};
+    size_t n=0;
+    for(int i=0;i<14;i++){
+        if(i>0) n=put_char(dst,dst_sz,n,',');                        // separador
+        n=put_quoted(dst,dst_sz,n,fields[i]);
+    }
+    if(dst_sz>0) dst[n<dst_sz?n:dst_sz-1]='\0';
+}
+
+// ---------------------- FILTROS DE BÚSQUEDA ----------------------
+// Pide título, fechas, categorías y licencia y arma el payload de Buscar:
+// solo el título, o "q=<título>|date=..|cat=..|lic=.." si hay filtros.
+// Devuelve -1 si se cerró la entrada.
+int read_find_payload(char *payload, size_t sz){
+    char q[512], dates[64], cats[128], lic[128];
+    printf("Ingrese palabra clave: "); if(!fgets(q,sizeof(q),stdin)) return -1;                 // leo query
+    trim_newline(q);
+    printf("Fechas desde..hasta (vacío = todas): "); if(!fgets(dates,sizeof(dates),stdin)) return -1;
+    trim_newline(dates);
+    printf("Categorías, ej. cs.AI math.CO (vacío = todas): "); if(!fgets(cats,sizeof(cats),stdin)) return -1;
+    trim_newline(cats);
+    printf("Licencia, ej. by-nc-sa (vacío = todas): "); if(!fgets(lic,sizeof(lic),stdin)) return -1;
+    trim_newline(lic);
+    if(strlen(dates)==0 && strlen(cats)==0 && strlen(lic)==0){ snprintf(payload,sz,"%s",q); return 0; } // solo título
+    size_t n=(size_t)snprintf(payload,sz,"q=%s",q);                                          // título + filtros
+    if(strlen(dates) && n<sz) n+=(size_t)snprintf(payload+n,sz-n,"|date=%s",dates);
+    if(strlen(cats) && n<sz)  n+=(size_t)snprintf(payload+n,sz-n,"|cat=%s",cats);
+    if(strlen(lic) && n<sz)   snprintf(payload+n,sz-n,"|lic=%s",lic);
+    return 0;
+}
+
+// Estadísticas (cmd 11): el server responde "nombre\tvalor" por contador y
+// "worker\tn\ttareas\tsegundos\tuso%" por cada hilo del pool
+void show_stats(void){
+    char reply[RECV_BUF_SZ];
+    if(send_command_and_receive(11, "", reply, sizeof(reply)) != 0){ printf("Error consultando al servidor.\n"); return; }
+    if(strcmp(reply,"NA")==0){ printf("El servidor no tiene estadísticas.\n"); return; }
+
+    int header = 0;
+    for(char *line=strtok(reply,"\n"); line; line=strtok(NULL,"\n")){
+        int id; long tasks; double busy, util;
+        if(sscanf(line,"worker\t%d\t%ld\t%lf\t%lf",&id,&tasks,&busy,&util)==4){
+            if(!header){ printf("\n%-6s %10s %12s %8s\n","hilo","tareas","ocupado (s)","uso"); header=1; }
+            printf("%-6d %10ld %12.3f %7.1f%%\n",id,tasks,busy,util);
+            continue;
+        }
+        char *value = strchr(line,'\t'); if(!value) continue;
+        *value++ = '\0';
+        printf("%-10s %s\n", line, value);
+    }
+}
+
+// Conteos (cmd 9): el server responde "campo\tnombre\tconteo" por línea
+void show_facets(const char *payload){
+    char reply[RECV_BUF_SZ];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(send_command_and_receive(9, payload, reply, sizeof(reply)) != 0){ printf("Error consultando al servidor.\n"); return; }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("[Conteos en %.3f segundos]\n", (end.tv_sec-start.tv_sec) + (end.tv_nsec-start.tv_nsec)/1e9);
+    if(strcmp(reply,"NA")==0){ printf("El servidor no tiene índice de categorías.\n"); return; }
+
+    const char *last_field = "";
+    for(char *line=strtok(reply,"\n"); line; line=strtok(NULL,"\n")){
+        char *name = strchr(line,'\t'); if(!name) continue;
+        *name++ = '\0';
+        char *count = strchr(name,'\t'); if(!count) continue;
+        *count++ = '\0';
+        if(strcmp(line,"total")==0){ printf("Total: %s registros\n", count); continue; }
+        if(strcmp(line,last_field)!=0){ printf("\n== %s ==\n", line); last_field=line; }   // encabezado por campo
+        printf("  %-50s %10s\n", name[0] ? name : "(vacío)", count);
+    }
 }
 
 // ---------------------- MAIN ----------------------
 int main(void){
     while(1){                                                      // loop menú
-        printf("\n===== CLIENTE UI =====\n1) Buscar\n2) Insertar\n3) Salir\nElija opción: ");
+        printf("\n===== CLIENTE UI =====\n1) Buscar\n2) Insertar\n3) Salir\n4) Buscar en abstracts (ranking)\n5) Buscar por inicio del título\n6) Buscar título exacto\n7) Leer por número de registro\n8) Buscar por id\n9) Buscar por DOI\n10) Conteos por categoría/licencia/año\n11) Buscar texto en una columna (recorre todo el CSV)\n12) Estadísticas del servidor\nElija opción: ");
         int opt=0;
         if(scanf("%d",&opt)!=1){ while(getchar()!='\n'); continue; } // leo opción; limpio basura si falla
         while(getchar()!='\n');                                      // consumo el '\n' que queda
 
         if(opt==1){
-            char q[512];
-            printf("Ingrese palabra clave: "); if(!fgets(q,sizeof(q),stdin)) continue; // leo query
-            trim_newline(q); if(strlen(q)==0){ printf("Cadena vacía.\n"); continue; }  // valido
-            search_interactive(q);                                                     // ejecuto búsqueda
+            char payload[1024];
+            if(read_find_payload(payload,sizeof(payload))!=0) continue;                // leo título y filtros
+            if(strlen(payload)==0){ printf("Cadena vacía.\n"); continue; }            // valido
+            search_interactive(1, payload);                                            // ejecuto búsqueda
         }
         else if(opt==2){
             // buffers para cada campo del registro nuevo
@@ -247,6 +499,56 @@ int main(void){
         else if(opt==3){
             printf("Saliendo...\n"); break;        // salgo del while(1)
         }
+        else if(opt==4){
+            char q[512];
+            printf("Ingrese palabras a buscar: "); if(!fgets(q,sizeof(q),stdin)) continue; // leo query
+            trim_newline(q); if(strlen(q)==0){ printf("Cadena vacía.\n"); continue; }     // valido
+            search_interactive(3, q);                                                     // mejores primero
+        }
+        else if(opt==5){
+            char q[512];
+            printf("Ingrese el comienzo del título: "); if(!fgets(q,sizeof(q),stdin)) continue; // leo prefijo
+            trim_newline(q);                                                                 // vacío = todos
+            search_interactive(4, q);                                                        // en orden alfabético
+        }
+        else if(opt==6){
+            char q[512];
+            printf("Ingrese el título completo: "); if(!fgets(q,sizeof(q),stdin)) continue; // leo título
+            trim_newline(q); if(strlen(q)==0){ printf("Cadena vacía.\n"); continue; }     // valido
+            search_interactive(5, q);                                                     // un solo bucket
+        }
+        else if(opt==7){
+            char q[64];
+            printf("Número de registro (N o N..M): "); if(!fgets(q,sizeof(q),stdin)) continue; // leo rango
+            trim_newline(q); if(strlen(q)==0){ printf("Cadena vacía.\n"); continue; }       // valido
+            search_interactive(6, q);                                                       // READIDX
+        }
+        else if(opt==8 || opt==9){
+            char q[4096];
+            printf(opt==8 ? "Ingrese el id (varios separados por espacios): " : "Ingrese el DOI (varios separados por espacios): ");
+            if(!fgets(q,sizeof(q),stdin)) continue;
+            trim_newline(q); if(strlen(q)==0){ printf("Cadena vacía.\n"); continue; }      // valido
+            search_many(opt==8 ? 7 : 8, q);                                                // búsqueda exacta
+        }
+        else if(opt==10){
+            char payload[1024];
+            printf("(todo vacío = conteos de todo el dataset)\n");
+            if(read_find_payload(payload,sizeof(payload))!=0) continue;                // mismos filtros que Buscar
+            show_facets(payload);
+        }
+        else if(opt==11){
+            char col[64], q[256], payload[400];
+            printf("Columna (authors, abstract, comments...; vacío = toda la línea): "); if(!fgets(col,sizeof(col),stdin)) continue;
+            trim_newline(col);
+            printf("Texto a buscar: "); if(!fgets(q,sizeof(q),stdin)) continue;
+            trim_newline(q); if(strlen(q)==0){ printf("Cadena vacía.\n"); continue; }   // valido
+            if(strlen(col)==0) snprintf(payload,sizeof(payload),"%s",q);                   // toda la línea
+            else snprintf(payload,sizeof(payload),"col=%s|q=%s",col,q);                   // una columna
+            search_interactive(10, payload);
+        }
+        else if(opt==12){
+            show_stats();
+        }
         else printf("Opción inválida.\n");         // validación sencilla
     }
     return 0;                                       // fin normal
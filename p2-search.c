@@ -4,11 +4,26 @@
  * Búsqueda por SUBCADENA (case-insensitive) en title + filtro opcional update_date (col 12).
  *
  * Requisitos:
- *  - index.h (IndexHeader, BucketDisk, EntryDisk, KEY_SIZE, N_BUCKETS)
- *  - hash.h / hash.c (hash_string)
+ *  - index.h (IndexHeader, BucketDisk, IndexEntry, index_bucket_for, index_read_entry)
+ *  - hash.h / hash.c (hash_fold64: bucket y fingerprint sin mayúsculas)
  *  - build_index(...) en index2.c
+ *  - fmap.h / fmap.c (index.bin y arxiv.csv mapeados en memoria)
+ *  - trigram.h / trigram.c (índice de trigramas de títulos, trigram.bin)
+ *  - wordidx.h / wordidx.c / postings.c (palabras de títulos, words.bin)
+ *  - bm25.h / bm25.c (ranking BM25 sobre abstracts, abstracts.bin)
+ *  - bptree.h / bptree.c / dateidx.c (árbol B+ por update_date, dates.bin)
+ *  - titletree.h / titletree.c (títulos ordenados para prefijos, titles.bin)
+ *  - swiss.h / swiss.c (tabla de títulos en memoria, con --memtable)
+ *  - offsets.h / offsets.c (número de registro -> offset, offsets.bin)
+ *  - roaring.h / roaring.c / catidx.c (categorías y licencias, categories.bin)
+ *  - scan.h / scan.c (recorrido completo del CSV en paralelo, sin índice)
+ *  - strsearch.h / strsearch.c (subcadenas sin mayúsculas con SIMD)
+ *  - csv.h / csv.c (tokenizador RFC 4180 por bloques, el mismo que usa index2.c)
+ *  - pool.h / pool.c (hilos que atienden las peticiones, --workers N)
+ *  - evloop.h / evloop.c (bucle epoll que lee y escribe todas las conexiones)
  */
 
+#define _GNU_SOURCE     // PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
 #define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,8 +36,11 @@
 #include <errno.h>
 #include <time.h>
 #include <signal.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include <sys/socket.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -33,6 +51,21 @@
 
 #include "index.h"
 #include "hash.h"
+#include "fmap.h"
+#include "csv.h"
+#include "trigram.h"
+#include "wordidx.h"
+#include "bm25.h"
+#include "dateidx.h"
+#include "titletree.h"
+#include "swiss.h"
+#include "offsets.h"
+#include "catidx.h"
+#include "scan.h"
+#include "strsearch.h"
+#include "pool.h"
+#include "evloop.h"
+#include "wal.h"
 
 #ifndef KEY_SIZE // ifndef significa “if not defined”
 #define KEY_SIZE 256 // max tamaño de título
@@ -46,46 +79,46 @@
 
 #define PORT 12345 // puerto que usaremos
 #define SEM_NAME "/socket_sync_sem" // nombre del semáforo
-#define BACKLOG 10 // longitud máxima de la cola de conexiones pendientes
+#define BACKLOG 4096 // longitud máxima de la cola de conexiones pendientes (el kernel la recorta a somaxconn)
+#define RESP_SZ 8192 // respuesta de una búsqueda
+#define FACETS_RESP_SZ 16384 // respuesta de FACETS (hay muchas categorías)
+#define QUEUE_PER_WORKER 16 // peticiones que esperan hilo, por hilo del pool (las demás esperan en el bucle)
 
 static int listen_fd = -1; // descriptor de archivo de socket que escucha
 static sem_t *sem = NULL; // inicializamos puntero al semáforo
+static OffsetsFile g_offsets = { .fd = -1 }; // offsets.bin (commit_inserts le agrega cada registro)
+static Wal g_wal = { .fd = -1 };            // inserts.wal (log de inserciones, wal.h)
+
+// Las búsquedas toman g_data_lock para leer y corren en paralelo. Las
+// inserciones pasan por el log, que las ordena y las escribe de a lotes: el
+// lote va al log, al CSV y a los índices sin excluir a las búsquedas (todo
+// lo nuevo se escribe al final de cada archivo, fuera de lo que ven hasta
+// que se publica). g_data_lock se toma para escribir solo para publicarlo:
+// unas pocas palabras por registro que enganchan lo nuevo en los índices
+// (cabezas de bucket y cabeceras, que quedan en el page cache), los
+// tamaños mapeados y las colas en memoria. Sin abrir, leer ni sincronizar
+// archivos.
+// El lock prefiere al escritor: con el de glibc por defecto una ráfaga de
+// búsquedas podría dejar esperando sin fin al líder del log, que mientras
+// tanto retiene el CSV y a todas las inserciones. Así, cuando el líder pide
+// el lock no entran búsquedas nuevas y espera solo a las que ya corren (las
+// búsquedas no toman el lock dos veces, que con esta preferencia trabaría).
+// El costo: una búsqueda que llega en ese momento sí espera a una inserción
+// en curso, lo que tarden las que ya corren más la publicación, que agrega
+// los registros a las colas en memoria (trigramas, palabras, títulos,
+// BM25, categorías y fechas). Con lotes de uno o dos registros eso son
+// unos 30 µs (100 µs en el percentil 99); sacarlo de acá pediría armar
+// cada cola aparte y cambiarla de un golpe, y se prefirió no hacerlo.
+static pthread_rwlock_t g_data_lock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
 
 int build_index(const char *csv_path, const char *index_path);
-static void trim_inplace(char *s);
+static void on_record_appended(const char *title, long csv_offset);
 
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 
-/* parse_csv_line_inplace: deja punteros dentro de tmp (que debes free) */
-int parse_csv_line_inplace(char *tmp, char *fields[], int max_fields) {
-    char *p = tmp;
-    int idx = 0;
-    while (*p && idx < max_fields) {
-        if (*p == '"') {
-            char *src = p + 1;
-            char *dst = p + 1;
-            fields[idx++] = dst;
-            while (*src) {
-                if (*src == '"') {
-                    if (src[1] == '"') { *dst++ = '"'; src += 2; }
-                    else { src++; break; }
-                } else *dst++ = *src++;
-            }
-            *dst = '\0';
-            while (*src && *src != ',') ++src;
-            if (*src == ',') ++src;
-            p = src;
-        } else {
-            fields[idx++] = p;
-            while (*p && *p != ',') ++p;
-            if (*p == ',') { *p = '\0'; ++p; }
-        }
-    }
-    return idx;
-}
-
+static int g_debug = 0;     // --debug: cada inserción se muestra en stderr
 
 void debug_print_input(const char *str) {
     if (!str) {
@@ -130,8 +163,10 @@ void debug_print_input(const char *str) {
 
 /* Mantén tus definiciones de IndexHeader, BucketDisk, EntryDisk y hash_string */
 
-/* Debug / robust write + index update */
-void append_and_reindex_bin2(
+/* Arma la línea del registro y la manda al log de inserciones: vuelve
+   cuando el lote en el que entró ya está en el log (en disco), en el CSV y
+   en los índices (commit_inserts). Devuelve 0, o -1 si no se pudo guardar. */
+int append_and_reindex_bin2(
     const char *csv_path,
     const char *id,
     const char *submitter,
@@ -148,182 +183,53 @@ void append_and_reindex_bin2(
     const char *versions_count,
     const char *versions_last_created
 ) {
-    fprintf(stderr, "[CSV_DEBUG] csv_path='%s'\n", csv_path ? csv_path : "<NULL>");
-
-    /* 1) Abrir CSV en modo append binario (más claro para solo añadir) */
-    FILE *fcsv = fopen(csv_path, "ab+");
-    if (!fcsv) {
-        fprintf(stderr, "[CSV_DEBUG] fopen('%s') falló: %s\n", csv_path, strerror(errno));
-        return;
-    }
-
-    /* Obtener offset antes de escribir (seek al final) */
-    if (fseek(fcsv, 0, SEEK_END) != 0) {
-        fprintf(stderr, "[CSV_DEBUG] fseek(SEEK_END) fallo: %s\n", strerror(errno));
-        /* pero seguimos intentándolo */
-    }
-    long csv_offset = ftell(fcsv);
-    if (csv_offset == -1L) {
-        fprintf(stderr, "[CSV_DEBUG] ftell fallo: %s\n", strerror(errno));
-        csv_offset = 0;
-    }
-    fprintf(stderr, "[CSV_DEBUG] offset actual (start write) = %ld\n", csv_offset);
-
-    /* 2) Formar la línea CSV */
-    char line[8192];
-    int n = snprintf(line, sizeof(line),
-        "\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"\n",
-        id ? id : "",
-        submitter ? submitter : "",
-        authors ? authors : "",
-        title ? title : "",
-        abstract ? abstract : "",
-        categories ? categories : "",
-        comments ? comments : "",
-        journal_ref ? journal_ref : "",
-        doi ? doi : "",
-        report_no ? report_no : "",
-        license ? license : "",
-        update_date ? update_date : "",
-        versions_count ? versions_count : "",
-        versions_last_created ? versions_last_created : ""
-    );
-
-    if (n < 0) {
-        fprintf(stderr, "[CSV_DEBUG] snprintf fallo\n");
-        fclose(fcsv);
-        return;
-    }
-    if ((size_t)n >= sizeof(line)) {
-        fprintf(stderr, "[CSV_DEBUG] AVISO: línea truncada (longitud necesaria=%d, buf=%zu)\n", n, sizeof(line));
-    }
-    size_t line_len = (size_t) (n < (int)sizeof(line) ? n : sizeof(line)-1);
-
-    /* Mostrar qué vamos a escribir (útil para detectar comillas extra, NULs, CR/LF) */
-    fprintf(stderr, "[CSV_DEBUG] LINE (len=%zu):\n", line_len);
-    /* imprime escapado para ver \n \r y \0 */
-    for (size_t i = 0; i < line_len; ++i) {
-        unsigned char c = (unsigned char)line[i];
-        if (c == '\n') fprintf(stderr, "\\n");
-        else if (c == '\r') fprintf(stderr, "\\r");
-        else if (c == '\t') fprintf(stderr, "\\t");
-        else if (c == '\0') fprintf(stderr, "\\0");
-        else fputc(c, stderr);
+    if (g_debug) fprintf(stderr, "[CSV_DEBUG] csv_path='%s'\n", csv_path ? csv_path : "<NULL>");
+
+    /* 1) Formar la línea CSV: cada campo entre comillas, con las comillas
+       internas dobladas ("") para que el tokenizador de csv.c lo lea igual */
+    const char *values[14] = {
+        id, submitter, authors, title, abstract, categories, comments,
+        journal_ref, doi, report_no, license, update_date, versions_count,
+        versions_last_created
+    };
+    size_t need = 14;   // 13 comas + '\n'
+    for (int i = 0; i < 14; ++i) need += csv_quote_field(values[i] ? values[i] : "", NULL, 0);
+    char *line = malloc(need + 1);
+    if (!line) {
+        perror("malloc");
+        return -1;
     }
-    fprintf(stderr, "\n");
-
-    /* 3) Escribir y comprobar retorno */
-    size_t wrote = fwrite(line, 1, line_len, fcsv);
-    if (wrote != line_len) {
-        fprintf(stderr, "[CSV_DEBUG] fwrite escribió %zu/%zu bytes: %s\n", wrote, line_len, strerror(errno));
-        /* intentamos flush y seguir para no dejar inconsistencia */
-    } else {
-        fprintf(stderr, "[CSV_DEBUG] fwrite OK (%zu bytes)\n", wrote);
+    size_t line_len = 0;
+    for (int i = 0; i < 14; ++i) {
+        if (i > 0) line[line_len++] = ',';
+        line_len += csv_quote_field(values[i] ? values[i] : "", line + line_len, need + 1 - line_len);
     }
-
-    /* Asegurarnos que los buffers del stdio se vacíen y se sincronicen en disco */
-    if (fflush(fcsv) != 0) {
-        fprintf(stderr, "[CSV_DEBUG] fflush fallo: %s\n", strerror(errno));
-    } else {
-        /* fsync para forzar al kernel a persistir en disco (opcional pero útil para debug) */
-        int fd = fileno(fcsv);
-        if (fd >= 0) {
-            if (fsync(fd) != 0) {
-                fprintf(stderr, "[CSV_DEBUG] fsync fallo: %s\n", strerror(errno));
-            }
-        } else {
-            fprintf(stderr, "[CSV_DEBUG] fileno(fcsv) fallo\n");
+    line[line_len++] = '\n';
+    line[line_len] = '\0';
+
+    /* Con --debug, mostrar qué vamos a escribir (útil para detectar comillas extra, NULs, CR/LF) */
+    if (g_debug) {
+        fprintf(stderr, "[CSV_DEBUG] LINE (len=%zu):\n", line_len);
+        /* imprime escapado para ver \n \r y \0 */
+        for (size_t i = 0; i < line_len; ++i) {
+            unsigned char c = (unsigned char)line[i];
+            if (c == '\n') fprintf(stderr, "\\n");
+            else if (c == '\r') fprintf(stderr, "\\r");
+            else if (c == '\t') fprintf(stderr, "\\t");
+            else if (c == '\0') fprintf(stderr, "\\0");
+            else fputc(c, stderr);
         }
+        fprintf(stderr, "\n");
     }
 
-    /* Obtener nuevo tamaño del archivo (stat) para confirmar escritura */
-    struct stat st;
-    if (fstat(fileno(fcsv), &st) == 0) {
-        fprintf(stderr, "[CSV_DEBUG] tamaño de archivo tras escritura: %lld bytes\n", (long long)st.st_size);
-    } else {
-        fprintf(stderr, "[CSV_DEBUG] fstat fallo: %s\n", strerror(errno));
-    }
-
-    /* Cerrar CSV */
-    if (fclose(fcsv) != 0) {
-        fprintf(stderr, "[CSV_DEBUG] fclose fallo: %s\n", strerror(errno));
-    } else {
-        fprintf(stderr, "[CSV_DEBUG] CSV cerrado correctamente. offset inicial=%ld\n", csv_offset);
-    }
-
-    /* 4) ----------------- seguir con index.bin (no debería borrar lo escrito) ------------- */
-    FILE *findex = fopen("index.bin", "r+b");
-    if (!findex) {
-        fprintf(stderr, "[INDEX_DEBUG] No se pudo abrir index.bin: %s\n", strerror(errno));
-        /* NOTA: no retornamos aquí para no perder la info de que ya escribimos el CSV,
-           pero si la indexación es crítica podrías decidir manejarlo distinto. */
-        return;
-    }
-
-    IndexHeader header;
-    if (fread(&header, sizeof(IndexHeader), 1, findex) != 1) {
-        fprintf(stderr, "[INDEX_DEBUG] fread(header) fallo (o archivo vacio): %s\n", strerror(errno));
-        fclose(findex);
-        return;
-    }
-
-    unsigned long h = hash_string(title ? title : "");
-    int bucket_id = (header.n_buckets > 0) ? (h % header.n_buckets) : 0;
-    long bucket_offset = header.offset_buckets + bucket_id * sizeof(BucketDisk);
-
-    if (fseek(findex, bucket_offset, SEEK_SET) != 0) {
-        fprintf(stderr, "[INDEX_DEBUG] fseek(bucket) fallo: %s\n", strerror(errno));
-        fclose(findex);
-        return;
-    }
-
-    BucketDisk bucket;
-    if (fread(&bucket, sizeof(BucketDisk), 1, findex) != 1) {
-        fprintf(stderr, "[INDEX_DEBUG] fread(bucket) fallo: %s\n", strerror(errno));
-        fclose(findex);
-        return;
-    }
-
-    EntryDisk entry;
-    memset(&entry, 0, sizeof(EntryDisk));
-    strncpy(entry.key, title ? title : "", sizeof(entry.key)-1);
-    entry.csv_offset = csv_offset;
-    entry.next_entry = bucket.first_entry_offset;
-
-    if (fseek(findex, 0, SEEK_END) != 0) {
-        fprintf(stderr, "[INDEX_DEBUG] fseek(end) fallo: %s\n", strerror(errno));
-        fclose(findex);
-        return;
-    }
-    long new_entry_offset = ftell(findex);
-    if (new_entry_offset == -1L) {
-        fprintf(stderr, "[INDEX_DEBUG] ftell nuevo entry fallo: %s\n", strerror(errno));
-        fclose(findex);
-        return;
-    }
-
-    if (fwrite(&entry, sizeof(EntryDisk), 1, findex) != 1) {
-        fprintf(stderr, "[INDEX_DEBUG] fwrite(entry) fallo: %s\n", strerror(errno));
-        fclose(findex);
-        return;
-    }
-
-    /* actualizar bucket */
-    bucket.first_entry_offset = new_entry_offset;
-    if (fseek(findex, bucket_offset, SEEK_SET) != 0) {
-        fprintf(stderr, "[INDEX_DEBUG] fseek para escribir bucket fallo: %s\n", strerror(errno));
-        fclose(findex);
-        return;
-    }
-    if (fwrite(&bucket, sizeof(BucketDisk), 1, findex) != 1) {
-        fprintf(stderr, "[INDEX_DEBUG] fwrite(bucket) fallo: %s\n", strerror(errno));
-        fclose(findex);
-        return;
-    }
-
-    fclose(findex);
-    fprintf(stderr, "[INDEX_DEBUG] '%s' insertado en bucket %d (entry_offset=%ld)\n",
-           title ? title : "<NULL>", bucket_id, new_entry_offset);
+    /* 2) Log de inserciones: se junta con las que lleguen a la vez en un
+       lote con un solo fsync */
+    WalRecord rec = { .data = line, .len = line_len };
+    int status = wal_commit(&g_wal, &rec);
+    if (status == 0 && g_debug)
+        fprintf(stderr, "[CSV_DEBUG] Registro guardado. offset inicial=%ld\n", rec.csv_offset);
+    free(line);
+    return status;
 }
 
 
@@ -331,21 +237,21 @@ void append_and_reindex_bin2(
 // Guarda un nuevo registro en el CSV y reindexa después
 int save_new_register(const char *str) {
     if (!str) return -1;
-    debug_print_input(str);
+    if (g_debug) debug_print_input(str);
 
     char *fields[14];
     char *tmp = strdup(str);
     if (!tmp) return -1;
 
-    int n = parse_csv_line_inplace(tmp, fields, 14);
+    int n = csv_split_inplace(tmp, fields, 14);
     for (int i = n; i < 14; ++i) fields[i] = NULL;
     for (int i = 0; i < 14; ++i) {
         if (fields[i]) trim_inplace(fields[i]);
     }
-    /* debug */
-    for (int i = 0; i < 14; ++i) fprintf(stderr, "[FIELDS] %d: \"%s\"\n", i, fields[i] ? fields[i] : "<NULL>");
+    if (g_debug)
+        for (int i = 0; i < 14; ++i) fprintf(stderr, "[FIELDS] %d: \"%s\"\n", i, fields[i] ? fields[i] : "<NULL>");
 
-    append_and_reindex_bin2(
+    int status = append_and_reindex_bin2(
         CSV_FILE,
         fields[0], fields[1], fields[2], fields[3],
         fields[4], fields[5], fields[6], fields[7],
@@ -353,7 +259,7 @@ int save_new_register(const char *str) {
         fields[12], fields[13]
     );
     free(tmp);
-    return 0;
+    return status;
 }
 
 
@@ -374,428 +280,1339 @@ void handle_sigint(int sig) {
 
 // ============================================================================
 
-// Lee n bytes de fd y los pone en buf
-// Devuelve la cantidad de bytes leídos, o -1 en error
-// Lee hasta terminar o hasta que ocurra un error no recuperable
-ssize_t readn(int fd, void *buf, size_t n) {
+// Compara dos cadenas, ignorando mayúsculas/minúsculas
+// (case-insensitive) y espacios al inicio o al final
+// Devuelve 1 si son iguales, 0 si son diferentes
+
+// static int field_is(const char *field, const char *target) {
+
+//     if (!field || !target) return 0; // Si alguno es NULL, devuelve 0
 
-    size_t left = n; // left lleva la cuenta de cuántos bytes faltan por leer
-    char *p = buf; // el puntero p apunta al inicio del buffer buf
+//     char a[128], b[128];
 
-    while (left > 0) {
+//     strncpy(a, field, sizeof(a)-1); // Copiar field en a
+//     a[sizeof(a)-1] = '\0';
+//     trim_inplace(a);
+
+//     strncpy(b, target, sizeof(b)-1); // Copiar target en a
+//     b[sizeof(b)-1] = '\0';
+//     trim_inplace(b);
 
-        // Lee left bytes de fd y los pone en p (buf)
-        ssize_t r = read(fd, p, left);
-        if (r < 0) {
+//     return strcasecmp(a, b) == 0; // strcasecmp devuelve 0 si son iguales
+// }
 
-            // Error por interrupción de señal, volver a intentar
-            if (errno == EINTR) continue;
+// ============================================================================
 
-            // Error de otro tipo
-            return -1;
+// --- Archivos mapeados ---
+// index.bin y arxiv.csv se abren y mapean una vez y quedan abiertos mientras
+// vive el servidor: una búsqueda ya no hace open/fseek/fread/close, solo lee
+// memoria. El mapeo reserva espacio de sobra, así que tras una inserción
+// basta refrescar el tamaño (fmap_refresh) y solo se remapea si el archivo
+// crece más allá de lo reservado.
+
+static FileMap g_index = { .fd = -1 };
+static FileMap g_csv = { .fd = -1 };
+static FileMap g_index_id = { .fd = -1 };    // index_id.bin (columna 1)
+static FileMap g_index_doi = { .fd = -1 };   // index_doi.bin (columna 9)
+static int g_index_rebuilt = 0;             // index.bin se reconstruyó: rehacer lo que sale de sus claves
+static TrigramIndex g_trigram = { .map = { .fd = -1 } };
+static WordIndex g_words = { .map = { .fd = -1 } };
+static WordIndex g_abstracts = { .map = { .fd = -1 } };
+static BPTree g_dates = { .map = { .fd = -1 }, .fd = -1 };
+static DateTail g_date_tail;        // fechas insertadas desde que se abrió dates.bin
+static TitleTree g_titles = { .map = { .fd = -1 } };
+static CatIndex g_cats;              // categories.bin, cargado en memoria (loaded == 0 si no)
+static SwissTable g_memtable;       // solo con --memtable (ctrl == NULL si no)
+
+// --- Log de inserciones: claves, checkpoint y recuperación ---
+
+#define RECORD_TITLE_COLUMN 4
+
+// Claves de un registro para index.bin, index_id.bin e index_doi.bin, igual
+// que las saca build_index (sin comillas y sin espacios en los extremos).
+static void record_keys(const char *line, size_t len, char title[INDEX_KEY_MAX],
+                        char id[INDEX_KEY_MAX], char doi[INDEX_KEY_MAX]) {
+    CsvField fields[INDEX_DOI_COLUMN];
+    int n = csv_split_record(line, line + len, fields, INDEX_DOI_COLUMN, NULL);
+    char *keys[3] = { title, id, doi };
+    const int cols[3] = { RECORD_TITLE_COLUMN, INDEX_ID_COLUMN, INDEX_DOI_COLUMN };
+    for (int i = 0; i < 3; i++) {
+        keys[i][0] = '\0';
+        if (n >= cols[i]) {
+            csv_field_copy(&fields[cols[i] - 1], keys[i], INDEX_KEY_MAX);
+            trim_inplace(keys[i]);
         }
-        if (r == 0) break; // Si r=0 entonces read devolvió EOF 
-        left -= r;
-        p += r;
     }
-    return (n - left);
 }
 
-// ============================================================================
+// Checkpoint: sincroniza a disco el CSV y los índices que cambian con cada
+// inserción y vacía el log. Lo llama el líder del log (no hay ninguna
+// inserción a medias) o el arranque.
+static void checkpoint(void) {
+    static const char *files[] = { CSV_FILE, INDEX_FILE, INDEX_ID_FILE, INDEX_DOI_FILE, OFFSETS_FILE, DATES_FILE };
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        int fd = open(files[i], O_RDONLY);
+        if (fd < 0) {
+            if (errno != ENOENT) failed = 1;
+            continue;
+        }
+        if (fsync(fd) != 0) failed = 1;
+        close(fd);
+    }
+    if (failed) fprintf(stderr, "[WAL] Checkpoint fallido, el log se conserva: %s\n", strerror(errno));
+    else if (wal_reset(&g_wal) != 0) perror("[WAL] No se pudo vaciar el log");
+}
 
-// Escribe n bytes de buf en fd
-// Devuelve la cantidad de bytes escritos, o -1 en error
-// Escribe hasta terminar o hasta que ocurra un error no recuperable
-ssize_t writen(int fd, const void *buf, size_t n) {
+// Al arrancar, lo que quedó en el log después del último checkpoint se
+// vuelve a aplicar: primero al CSV (antes de mapearlo) y después a cada
+// índice que se escribe en cada inserción. Cada paso mira si el registro ya
+// está, así que da igual hasta dónde llegó antes de caerse.
+static long g_wal_from = -1;    // offset del primer registro del log (-1: log vacío)
+static long g_wal_count = 0;    // registros del log que están en el CSV
+static long g_wal_rewritten = 0;
 
-    size_t left = n; // left lleva la cuenta de cuántos bytes faltan por escribir
-    const char *p = buf; // el puntero p apunta al inicio del buffer buf
+static int redo_csv(const WalRecord *r, void *arg) {
+    int fd = *(int *)arg;
+    struct stat st;
+    if (fstat(fd, &st) != 0) return 1;
+    if (r->csv_offset > (long)st.st_size) {
+        fprintf(stderr, "[WAL] El CSV termina en %lld, antes del registro del log en %ld: no se recupera\n",
+                (long long)st.st_size, r->csv_offset);
+        return 1;
+    }
+    if (g_wal_from < 0) g_wal_from = r->csv_offset;
+
+    char *have = malloc(r->len);
+    int present = have && pread(fd, have, r->len, r->csv_offset) == (ssize_t)r->len &&
+                  memcmp(have, r->data, r->len) == 0;
+    free(have);
+    if (!present) {
+        if (pwrite(fd, r->data, r->len, r->csv_offset) != (ssize_t)r->len) {
+            perror("[WAL] No se pudo reescribir el CSV");
+            return 1;
+        }
+        g_wal_rewritten++;
+    }
+    g_wal_count++;
+    return 0;
+}
 
-    while (left > 0) {
+static void recover_csv(void) {
+    static int done = 0;
+    if (done || g_wal.fd < 0) return;
+    done = 1;
+    int fd = open(CSV_FILE, O_RDWR);
+    if (fd < 0) return;
+    if (wal_replay(&g_wal, redo_csv, &fd) < 0) perror("[WAL] No se pudo leer el log");
+    close(fd);
+}
 
-        // Escribe left bytes de p (buf) en fd
-        ssize_t w = write(fd, p, left);
+typedef struct {
+    long want;
+    int hit;
+} OffsetProbe;
 
-        if (w <= 0) {
+static int probe_offset(long csv_offset, void *arg) {
+    OffsetProbe *p = arg;
+    p->hit = csv_offset == p->want;
+    return p->hit;
+}
 
-            // Error por interrupción de señal, volver a intentar
-            if (w < 0 && errno == EINTR) continue;
+// Inserta (key, csv_offset) en un índice con el formato de index.bin si no está.
+static void redo_exact(FileMap *m, const char *path, const char *key, long csv_offset) {
+    IndexHeader h;
+    OffsetProbe probe = { csv_offset, 0 };
+    if (m->fd < 0 || index_map_header(m->base, m->size, &h) != 0) return;
+    if (index_find_exact_map(m->base, m->size, &h, key, probe_offset, &probe) > 0 && probe.hit) return;
+    if (index_insert(path, key, csv_offset, NULL) < 0 || fmap_refresh(m) != 0)
+        fprintf(stderr, "[WAL] No se pudo recuperar '%s' en %s\n", key, path);
+}
 
-            // Error de otro tipo
-            return -1;
-        }
-        left -= w;
-        p += w;
+static int redo_exact_indexes(const WalRecord *r, void *arg) {
+    long *left = arg;
+    if ((*left)-- <= 0) return 1;
+    char title[INDEX_KEY_MAX], id[INDEX_KEY_MAX], doi[INDEX_KEY_MAX];
+    record_keys(r->data, r->len, title, id, doi);
+    redo_exact(&g_index, INDEX_FILE, title, r->csv_offset);
+    if (*id) redo_exact(&g_index_id, INDEX_ID_FILE, id, r->csv_offset);
+    if (*doi) redo_exact(&g_index_doi, INDEX_DOI_FILE, doi, r->csv_offset);
+    return 0;
+}
+
+// dates.bin: los registros que ya cubre su csv_end (los demás los agrega
+// dateidx_catch_up) pueden haber quedado sin su fecha.
+typedef struct {
+    long left;
+    int failed;
+} DateRedo;
+
+static int redo_date(const WalRecord *r, void *arg) {
+    DateRedo *d = arg;
+    if (d->left-- <= 0) return 1;
+    if (r->csv_offset >= g_dates.h.csv_end) return 0;
+
+    size_t len;
+    const char *span = csv_field_span(r->data, r->data + r->len, DATE_COLUMN, &len);
+    if (!span || len == 0) return 0;
+    char date[DATE_KEY_SIZE + 1];
+    if (len > DATE_KEY_SIZE) len = DATE_KEY_SIZE;
+    memcpy(date, span, len);
+    date[len] = '\0';
+
+    long *offs = NULL;
+    long n = dateidx_collect(&g_dates, NULL, date, date, &offs);
+    int present = 0;
+    for (long i = 0; i < n && !present; i++) present = offs[i] == r->csv_offset;
+    if (n > 0) free(offs);
+    d->failed = n < 0 || (!present && bpt_insert(&g_dates, date, len, r->csv_offset) != 0);
+    return d->failed;
+}
+
+static int redo_dates(void) {
+    DateRedo d = { g_wal_count, 0 };
+    if (g_wal_count == 0 || g_dates.h.csv_end <= g_wal_from) return 0;
+    return wal_replay(&g_wal, redo_date, &d) < 0 || d.failed ? -1 : 0;
+}
+
+// Abre trigram.bin; si no existe o no cubre todo el CSV (hubo inserciones
+// desde que se construyó) lo reconstruye a partir de index.bin.
+static void open_trigram_index(void) {
+    if (!g_index_rebuilt && trigram_open(&g_trigram, TRIGRAM_FILE) == 0 && g_trigram.h.csv_end == (long)g_csv.size) return;
+    trigram_close(&g_trigram);
+
+    if (trigram_build(INDEX_FILE, TRIGRAM_FILE, (long)g_csv.size) != 0 ||
+        trigram_open(&g_trigram, TRIGRAM_FILE) != 0) {
+        fprintf(stderr, "Servidor: sin %s, se buscará solo en buckets vecinos\n", TRIGRAM_FILE);
+        trigram_close(&g_trigram);
     }
-    return n;
 }
 
-// ============================================================================
+// Igual para titles.bin (búsqueda por prefijo en orden alfabético).
+static void open_title_tree(void) {
+    if (!g_index_rebuilt && titletree_open(&g_titles, TITLES_FILE) == 0 && g_titles.h.csv_end == (long)g_csv.size) return;
+    titletree_close(&g_titles);
+
+    if (titletree_build(INDEX_FILE, TITLES_FILE, (long)g_csv.size) != 0 ||
+        titletree_open(&g_titles, TITLES_FILE) != 0) {
+        fprintf(stderr, "Servidor: sin %s, no hay búsqueda por prefijo\n", TITLES_FILE);
+        titletree_close(&g_titles);
+    }
+}
 
-// Busca una subcadena (needle) dentro de otra cadena (haystack),
-// sin distinguir entre mayúsculas y minúsculas (case-insensitive)
-static char *ci_strcasestr(const char *haystack, const char *needle) {
-    if (!haystack || !needle) return NULL;
-    size_t needle_len = strlen(needle);
-    if (needle_len == 0) return (char *)haystack;
-    for (const char *p = haystack; *p; ++p) {
+// Agrega a la cola de abstracts.bin los registros del CSV a partir de from.
+static void abstracts_catch_up(long from) {
+    const char *base = (const char *)g_csv.base, *end = base + g_csv.size;
+    for (const char *line = base + from; line < end; ) {
+        const char *stop = csv_record_end(line, end);
+        if (bm25_add_line(&g_abstracts, line, stop, (long)(line - base)) != 0) break;
+        line = stop + 1;
+    }
+}
 
-        // si no hay suficiente espacio de ahí en adelante,
-        // de una dice que no se encontró la subcadena
-        size_t rem = strlen(p);
-        if (rem < needle_len) return NULL;
+// abstracts.bin recorre todo el CSV, así que no se reconstruye por cada
+// inserción: lo agregado desde la última construcción se lee al arrancar
+// a la cola en memoria, salvo que ya sea más de 1/INDEX_COMPACT_RATIO del CSV.
+static void open_abstracts_index(void) {
+    long size = (long)g_csv.size;
+    if (wordidx_open(&g_abstracts, ABSTRACTS_FILE) == 0 && g_abstracts.h.with_tf &&
+        g_abstracts.h.csv_end <= size &&
+        (size - g_abstracts.h.csv_end) * INDEX_COMPACT_RATIO <= size) {
+        abstracts_catch_up(g_abstracts.h.csv_end);
+        return;
+    }
+    wordidx_close(&g_abstracts);
 
-        // strncasecmp compara las dos cadenas, devuelve 0 si son iguales
-        if (strncasecmp(p, needle, needle_len) == 0) return (char *)p; 
+    if (bm25_build(CSV_FILE, ABSTRACTS_FILE) != 0 || wordidx_open(&g_abstracts, ABSTRACTS_FILE) != 0) {
+        fprintf(stderr, "Servidor: sin %s, no hay búsqueda en abstracts\n", ABSTRACTS_FILE);
+        wordidx_close(&g_abstracts);
     }
-    return NULL;
 }
 
-// ============================================================================
+// Igual para words.bin (consultas booleanas por palabras).
+static void open_word_index(void) {
+    if (!g_index_rebuilt && wordidx_open(&g_words, WORDS_FILE) == 0 && g_words.h.csv_end == (long)g_csv.size) return;
+    wordidx_close(&g_words);
 
-// Elimina espacios en blanco al inicio y al final de una cadena,
-// modificando directamente el mismo string (in-place)
-static void trim_inplace(char *s) {
-    if (!s) return;
-    char *a = s;
+    if (wordidx_build(INDEX_FILE, WORDS_FILE, (long)g_csv.size) != 0 ||
+        wordidx_open(&g_words, WORDS_FILE) != 0) {
+        fprintf(stderr, "Servidor: sin %s, no hay consultas AND/OR/NOT\n", WORDS_FILE);
+        wordidx_close(&g_words);
+    }
+}
 
-    // Avanza a mientras haya espacios al inicio
-    while (*a && isspace((unsigned char)*a)) a++;
+// Lo insertado con el servidor andando queda en g_date_tail y no en
+// dates.bin, así que al abrirlo dateidx_catch_up le agrega lo que el CSV
+// tiene después de su csv_end (o se reconstruye si no existe o no
+// corresponde a este CSV).
+static void open_date_index(void) {
+    if (bpt_open(&g_dates, DATES_FILE) == 0 && g_dates.h.key_size == DATE_KEY_SIZE &&
+        g_dates.h.csv_end <= (long)g_csv.size && redo_dates() == 0 &&
+        dateidx_catch_up(&g_dates, (const char *)g_csv.base, g_csv.size) == 0) return;
+    bpt_close(&g_dates);
+
+    if (dateidx_build(CSV_FILE, DATES_FILE) != 0 || bpt_open(&g_dates, DATES_FILE) != 0) {
+        fprintf(stderr, "Servidor: sin %s, las fechas se filtran leyendo el CSV\n", DATES_FILE);
+        bpt_close(&g_dates);
+    }
+}
 
-    if (a != s) memmove(s, a, strlen(a)+1); // Copiar a en s
-    size_t n = strlen(s);
+// categories.bin se carga entero en memoria; lo que el CSV tenga de más
+// (inserciones de otra ejecución) se agrega y el archivo se vuelve a escribir.
+static void open_category_index(void) {
+    if (catidx_open(&g_cats, CATEGORIES_FILE) == 0 && g_cats.csv_end <= (long)g_csv.size &&
+        catidx_catch_up(&g_cats, (const char *)g_csv.base, g_csv.size) == 0) {
+        if (g_cats.n_docs > g_cats.file_docs && catidx_write(&g_cats, CATEGORIES_FILE) != 0)
+            fprintf(stderr, "[CATS] No se pudo actualizar %s\n", CATEGORIES_FILE);
+        return;
+    }
+    catidx_close(&g_cats);
 
-    // Mientras haya espacios al final pone un fin de cadena
-    while (n > 0 && isspace((unsigned char)s[n-1])) {
-        s[n-1] = '\0';
-        n--;
+    if (catidx_build(CSV_FILE, CATEGORIES_FILE) != 0 || catidx_open(&g_cats, CATEGORIES_FILE) != 0) {
+        fprintf(stderr, "Servidor: sin %s, cat=/lic= se filtran leyendo el CSV\n", CATEGORIES_FILE);
+        catidx_close(&g_cats);
     }
 }
 
-// ============================================================================
+// Mapea un índice con el formato de index.bin (id o doi).
+static int open_exact_index(FileMap *m, const char *path) {
+    IndexHeader header;
+    if (fmap_open(m, path) != 0) return -1;
+    if (index_map_header(m->base, m->size, &header) != 0 || header.version < INDEX_VERSION_RFC4180) {
+        fmap_close(m);
+        return -1;
+    }
+    return 0;
+}
 
-// Extrae el contenido de una columna específica (target_col) de una línea CSV.
-// Devuelve 1 si logró obtener la columna, 0 si no.
-static int csv_get_column(const char *line, int target_col, char *out, size_t out_sz) {
-    int col = 1;
-    const char *p = line;
-
-    // Itera hasta final de cadena o hasta una nueva línea
-    while (*p && *p != '\n' && *p != '\r') {
-
-        // Si estamos en la columna deseada...
-        if (col == target_col) {
-            
-            // Campo con comillas: 
-            if (*p == '"') {
-                p++; // Saltarse la comilla de apertura
-                size_t pos = 0; // pos es el índice para escribir en out
-
-                while (*p) { 
-                    if (*p == '"') {    // Si hay una comilla
-
-                        if (*(p+1) == '"') {  // Si hay dos comillas (Hay una 
-                                              // comilla escapada en el CSV)
-
-                            // Escribe una comilla en out[pos] e incrementa pos
-                            if (pos + 1 < out_sz) out[pos++] = '"'; 
-                            p += 2;
-                            continue;
-                        }
-
-                        // Una sola comilla indica el final del campo en el csv
-                        else { p++; break; } 
-                    }
-
-                    // Si el caracter actual no es una comilla, lo guardamos en out[pos]
-                    if (pos + 1 < out_sz) out[pos++] = *p;
-                    p++;
-                }
-                out[pos] = '\0'; // Cierra la cadena out
-                trim_inplace(out); // Quita espacios iniciales y finales en out
-                return 1;
-            }
-            
-            // Campo sin comillas: copiar hasta la próxima coma o fin de línea
-            else {
-                const char *start = p;
+// offsets.bin se construye junto con index.bin; si falta (índice de antes)
+// o no corresponde a este CSV se arma con una pasada por el CSV, y si solo
+// le faltan registros del final se le agregan. Lo posterior al último
+// checkpoint del log se descarta y se vuelve a agregar.
+static void open_offsets(void) {
+    if (offsets_open(&g_offsets, OFFSETS_FILE) == 0 && g_offsets.h.csv_end <= (long)g_csv.size &&
+        (g_wal_count == 0 || offsets_truncate(&g_offsets, g_wal_from) == 0) &&
+        offsets_catch_up(&g_offsets, (const char *)g_csv.base, g_csv.size) == 0) return;
+    offsets_close(&g_offsets);
+
+    if (offsets_build(CSV_FILE, OFFSETS_FILE) != 0 || offsets_open(&g_offsets, OFFSETS_FILE) != 0) {
+        fprintf(stderr, "Servidor: sin %s, no se puede leer por número de registro\n", OFFSETS_FILE);
+        offsets_close(&g_offsets);
+    }
+}
 
-                // Bucle que avanza p hasta el final del campo
-                while (*p && *p != ',' && *p != '\n' && *p != '\r') p++;
+// Abre y mapea los dos archivos si no lo estaban. Si index.bin no existe o
+// es de un formato desconocido, lo construye primero.
+static int open_data_files_locked(void) {
+    if (g_index.fd >= 0 && g_csv.fd >= 0) return 0;
 
-                size_t len = (size_t)(p - start);
-                if (len >= out_sz) len = out_sz - 1;
+    if (g_csv.fd < 0) recover_csv();
+    if (g_csv.fd < 0 && fmap_open(&g_csv, CSV_FILE) != 0) {
+        perror("Servidor: no se pudo mapear " CSV_FILE);
+        return -1;
+    }
 
-                // Copia el contenido del campo en out
-                memcpy(out, start, len);
+    if (g_index.fd < 0) {
+        // index.bin y los secundarios salen de la misma construcción: si
+        // falta cualquiera se reconstruyen todos. Antes del formato 5 las
+        // claves salían de strtok (un título con comas quedaba cortado), así
+        // que esos índices también se reconstruyen.
+        IndexHeader header;
+        if (fmap_open(&g_index, INDEX_FILE) == 0 &&
+            (index_map_header(g_index.base, g_index.size, &header) != 0 ||
+             header.version < INDEX_VERSION_RFC4180 ||
+             open_exact_index(&g_index_id, INDEX_ID_FILE) != 0 ||
+             open_exact_index(&g_index_doi, INDEX_DOI_FILE) != 0)) {
+            fmap_close(&g_index);
+            fmap_close(&g_index_id);
+            fmap_close(&g_index_doi);
+        }
 
-                out[len] = '\0'; // Cierra la cadena out
-                trim_inplace(out); // Quita espacios iniciales y finales en out
-                return 1;
+        if (g_index.fd < 0) {
+            // No existe o no es válido: se (re)construye desde el CSV
+            if (build_index(CSV_FILE, INDEX_FILE) != 0 || fmap_open(&g_index, INDEX_FILE) != 0) {
+                perror("Servidor: no se pudo mapear " INDEX_FILE);
+                return -1;
             }
+            g_index_rebuilt = 1;
+            if (open_exact_index(&g_index_id, INDEX_ID_FILE) != 0 ||
+                open_exact_index(&g_index_doi, INDEX_DOI_FILE) != 0)
+                fprintf(stderr, "Servidor: sin índices por id/doi\n");
         }
+        if (g_wal_count > 0) {
+            long left = g_wal_count;
+            wal_replay(&g_wal, redo_exact_indexes, &left);
+        }
+        open_trigram_index();
+        open_word_index();
+        open_abstracts_index();
+        open_date_index();
+        open_title_tree();
+        open_offsets();
+        open_category_index();
+        g_index_rebuilt = 0;
+
+        if (g_wal_count > 0) {
+            printf("Servidor: %ld registro(s) recuperados del log (%ld reescritos en el CSV)\n",
+                   g_wal_count, g_wal_rewritten);
+            checkpoint();
+            g_wal_count = 0;
+            g_wal_from = -1;
+        }
+    }
+    return 0;
+}
 
-        // No estamos en la columna deseada...
-        // Queremos saltarnos esa columna
+// Abrir los datos puede reconstruir index.bin, que el líder del log
+// escribe sin g_data_lock: g_open_lock lo excluye a él (commit_inserts lo
+// toma con cada lote) y g_data_lock para escribir, a las búsquedas.
+static pthread_mutex_t g_open_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// La abre main al arrancar y, si entonces falló, el primer hilo del pool
+// que la necesite (handle_request, sin g_data_lock tomado): de a uno.
+static int open_data_files(void) {
+    pthread_mutex_lock(&g_open_lock);
+    pthread_rwlock_wrlock(&g_data_lock);
+    int r = open_data_files_locked();
+    pthread_rwlock_unlock(&g_data_lock);
+    pthread_mutex_unlock(&g_open_lock);
+    return r;
+}
 
-        // Campo con comillas:
-        if (*p == '"') {
-            p++;
+// Con g_data_lock tomado (para leer alcanza): los datos ya están mapeados.
+static int data_files_open(void) {
+    return g_index.fd >= 0 && g_csv.fd >= 0;
+}
 
-            while (*p) {
-                if (*p == '"' && *(p+1) != '"') { // Si hay 1 sola comilla
-                    p++;    // Avanza 1 caracter
-                    break;  // Sale porque ya llegó al final del campo
-                }
+// Refresca un mapeo. Si no se puede (mremap sin lugar), queda el anterior,
+// que sigue valiendo hasta el tamaño viejo: lo agregado después no se ve y
+// las búsquedas que lo alcancen fallan por su cuenta (leen con límites),
+// hasta que el próximo lote lo vuelva a intentar. Cerrarlo haría que la
+// próxima búsqueda reconstruyera el índice.
+static void refresh_map(FileMap *m, const char *path) {
+    if (m->fd >= 0 && fmap_refresh(m) != 0)
+        fprintf(stderr, "Servidor: no se pudo volver a mapear %s: %s\n", path, strerror(errno));
+}
 
-                if (*p == '"' && *(p+1) == '"') { // Si hay dos comillas (Hay una 
-                    p += 2;                       // comilla escapada en el CSV)
-                }   
-                                              
-                else p++; // Si no hay una comilla, avanza 1 caracter
-            }
+// Después de agregar registros al CSV y a los índices exactos: los mapeos
+// pasan a cubrir lo agregado.
+static void refresh_maps(void) {
+    refresh_map(&g_index, INDEX_FILE);
+    refresh_map(&g_csv, CSV_FILE);
+    refresh_map(&g_index_id, INDEX_ID_FILE);
+    refresh_map(&g_index_doi, INDEX_DOI_FILE);
+}
 
-            // En CSV la coma es el separador de campos
-            // Si estamos en la coma, ya nos saltamos el campo exitosamente
-            if (*p == ',') {
-                p++;
-                col++;
-            }
-        } 
-
-        // Campo sin comillas:
-        else { 
-            // Saltar el caracter si no es coma o salto de línea
-            while (*p && *p != ',' && *p != '\n' && *p != '\r') p++;
-
-            // En CSV la coma es el separador de campos
-            // Si estamos en la coma, ya nos saltamos el campo exitosamente
-            if (*p == ',') {
-                p++;
-                col++;
-            }
+// Suma un registro ya mapeado (refresh_maps) a las colas en memoria de los
+// demás índices.
+static void on_record_appended(const char *title, long csv_offset) {
+    if (g_trigram.docs && trigram_add(&g_trigram, title, csv_offset) != 0)
+        fprintf(stderr, "[TRIGRAM] No se pudo agregar '%s'\n", title);
+    if (g_words.docs && wordidx_add(&g_words, title, csv_offset) != 0)
+        fprintf(stderr, "[WORDS] No se pudo agregar '%s'\n", title);
+    if (g_titles.map.fd >= 0 && titletree_add(&g_titles, title, csv_offset) != 0)
+        fprintf(stderr, "[TITLES] No se pudo agregar '%s'\n", title);
+    if (g_memtable.ctrl && swiss_insert(&g_memtable, title, csv_offset) != 0)
+        fprintf(stderr, "[MEMTABLE] No se pudo agregar '%s'\n", title);
+    if (g_abstracts.docs && (size_t)csv_offset < g_csv.size) {
+        const char *line = (const char *)g_csv.base + csv_offset;
+        const char *end = csv_record_end(line, (const char *)g_csv.base + g_csv.size);
+        if (bm25_add_line(&g_abstracts, line, end, csv_offset) != 0)
+            fprintf(stderr, "[BM25] No se pudo agregar el abstract de '%s'\n", title);
+    }
+    if (g_dates.fd >= 0 && (size_t)csv_offset < g_csv.size) {
+        const char *line = (const char *)g_csv.base + csv_offset;
+        const char *end = csv_record_end(line, (const char *)g_csv.base + g_csv.size);
+        if (dateidx_tail_add(&g_date_tail, line, end, csv_offset) != 0) {
+            fprintf(stderr, "[DATES] No se pudo agregar la fecha de '%s'\n", title);
+            bpt_close(&g_dates);
         }
     }
-    out[0] = '\0';
-    return 0; // Devuelve 0 si no encontró la columna deseada
+    if (g_cats.loaded && (size_t)csv_offset < g_csv.size) {
+        const char *line = (const char *)g_csv.base + csv_offset;
+        const char *end = csv_record_end(line, (const char *)g_csv.base + g_csv.size);
+        if (catidx_add_line(&g_cats, line, end, csv_offset) != 0)
+            fprintf(stderr, "[CATS] No se pudieron agregar las categorías de '%s'\n", title);
+        g_cats.csv_end = (long)g_csv.size;
+    }
 }
 
-// ============================================================================
+// Lo que queda de un registro del lote para publicarlo.
+typedef struct {
+    char title[INDEX_KEY_MAX];
+    int indexed;                // entró en index.bin
+} StagedRecord;
+
+// Los índices exactos, en el orden de las transacciones de un lote.
+enum { TX_TITLE, TX_ID, TX_DOI, N_TX };
+static const char *const tx_files[N_TX] = { INDEX_FILE, INDEX_ID_FILE, INDEX_DOI_FILE };
+
+// Escribe los registros del lote, que ya están en el CSV, al final de los
+// índices exactos y de offsets.bin sin publicarlos: las búsquedas siguen
+// viendo lo de antes. Abre una transacción por índice (open[k] == 0 si no
+// se pudo) y deja en oh la cabecera de offsets.bin que los cuenta.
+static void stage_records(WalRecord *batch, long csv_end, StagedRecord *st,
+                          IndexTxn tx[N_TX], int open[N_TX], OffsetsHeader *oh) {
+    for (int k = 0; k < N_TX; k++) {
+        open[k] = index_txn_begin(&tx[k], tx_files[k]) == 0;
+        if (!open[k]) fprintf(stderr, "[INDEX_DEBUG] No se pudo actualizar %s: %s\n", tx_files[k], strerror(errno));
+    }
 
-// Compara dos cadenas, ignorando mayúsculas/minúsculas
-// (case-insensitive) y espacios al inicio o al final
-// Devuelve 1 si son iguales, 0 si son diferentes
+    long n = 0;
+    for (WalRecord *r = batch; r; r = r->next) n++;
+    long *offs = malloc(sizeof(long) * n);
+
+    long i = 0;
+    for (WalRecord *r = batch; r; r = r->next, i++) {
+        char id[INDEX_KEY_MAX], doi[INDEX_KEY_MAX];
+        record_keys(r->data, r->len, st[i].title, id, doi);
+        if (offs) offs[i] = r->csv_offset;
+
+        /* índices secundarios por id y doi (si el campo no está vacío) */
+        if (*id && open[TX_ID] && index_txn_insert(&tx[TX_ID], id, r->csv_offset, NULL) < 0)
+            fprintf(stderr, "[INDEX_DEBUG] No se pudo actualizar %s\n", INDEX_ID_FILE);
+        if (*doi && open[TX_DOI] && index_txn_insert(&tx[TX_DOI], doi, r->csv_offset, NULL) < 0)
+            fprintf(stderr, "[INDEX_DEBUG] No se pudo actualizar %s\n", INDEX_DOI_FILE);
+
+        /* index.bin: la entrada se encadena en su bucket y, si la carga
+           promedio supera INDEX_MAX_LOAD, se parte un bucket (hashing
+           lineal). Si falla, el registro queda en el CSV sin indexar (y la
+           próxima recuperación del log lo vuelve a intentar) */
+        long bucket_id = -1;
+        long entry = open[TX_TITLE] ? index_txn_insert(&tx[TX_TITLE], st[i].title, r->csv_offset, &bucket_id) : -1;
+        st[i].indexed = entry >= 0;
+        if (st[i].indexed && g_debug)
+            fprintf(stderr, "[INDEX_DEBUG] '%s' insertado en bucket %ld (entry_offset=%ld)\n", st[i].title, bucket_id, entry);
+        else if (!st[i].indexed && open[TX_TITLE])
+            fprintf(stderr, "[INDEX_DEBUG] No se pudo actualizar index.bin: %s\n", strerror(errno));
+    }
 
-// static int field_is(const char *field, const char *target) {
+    /* offsets.bin: los registros nuevos son los últimos */
+    *oh = g_offsets.h;
+    if (g_offsets.fd >= 0 && (!offs || offsets_stage(&g_offsets, offs, n, csv_end, oh) != 0)) {
+        fprintf(stderr, "[OFFSETS] No se pudo agregar el lote (offset=%ld)\n", batch->csv_offset);
+        *oh = g_offsets.h;
+    }
+    free(offs);
+}
 
-//     if (!field || !target) return 0; // Si alguno es NULL, devuelve 0
+// Publica lo que dejó stage_records (con g_data_lock tomado para escribir).
+static void publish_records(WalRecord *batch, const StagedRecord *st,
+                            IndexTxn tx[N_TX], const int open[N_TX], const OffsetsHeader *oh) {
+    for (int k = 0; k < N_TX; k++)
+        if (open[k] && index_txn_commit(&tx[k]) != 0)
+            fprintf(stderr, "[INDEX_DEBUG] No se pudo actualizar %s: %s\n", tx_files[k], strerror(errno));
+    g_offsets.h = *oh;
+
+    refresh_maps();
+    long i = 0;
+    for (WalRecord *r = batch; r; r = r->next, i++) {
+        if (st[i].indexed) on_record_appended(st[i].title, r->csv_offset);
+        r->status = 0;
+    }
+}
 
-//     char a[128], b[128];
+// Escribe un lote de inserciones. La llama commit_inserts (el líder del log),
+// de a un lote por vez:
+//   1) con el CSV bloqueado (fcntl, por si otro proceso escribe el dataset)
+//      le asigna a cada registro su offset al final del CSV;
+//   2) escribe el lote en el log: un fdatasync para todos;
+//   3) los agrega al CSV, ya sin fsync (si se pierden, están en el log);
+//   4) los escribe al final de los índices, sin publicarlos todavía;
+//   5) los publica, excluyendo a las búsquedas solo acá.
+// Cada registro que llegó al CSV queda con status 0.
+static void write_batch(WalRecord *batch) {
+    int fd = open(CSV_FILE, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "[CSV_DEBUG] open('%s') falló: %s\n", CSV_FILE, strerror(errno));
+        return;
+    }
+    struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET, .l_start = 0, .l_len = 0 };
+    while (fcntl(fd, F_SETLKW, &fl) != 0 && errno == EINTR) {}
 
-//     strncpy(a, field, sizeof(a)-1); // Copiar field en a
-//     a[sizeof(a)-1] = '\0';
-//     trim_inplace(a);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "[CSV_DEBUG] fstat falló: %s\n", strerror(errno));
+        close(fd);
+        return;
+    }
+    long end = (long)st.st_size, wal_size = g_wal.size;
+    for (WalRecord *r = batch; r; r = r->next) {
+        r->csv_offset = end;
+        end += (long)r->len;
+    }
 
-//     strncpy(b, target, sizeof(b)-1); // Copiar target en a
-//     b[sizeof(b)-1] = '\0';
-//     trim_inplace(b);
+    if (wal_write(&g_wal, batch) != 0) {
+        fprintf(stderr, "[WAL] No se pudo escribir el lote: %s\n", strerror(errno));
+        close(fd);
+        return;
+    }
 
-//     return strcasecmp(a, b) == 0; // strcasecmp devuelve 0 si son iguales
-// }
+    // Un lote que no entra entero en el CSV se saca también del log: si
+    // no, una recuperación lo escribiría encima de lo que venga después
+    for (WalRecord *r = batch; r; r = r->next) {
+        if (pwrite(fd, r->data, r->len, r->csv_offset) == (ssize_t)r->len) continue;
+        fprintf(stderr, "[CSV_DEBUG] No se pudo escribir el lote en el CSV: %s\n", strerror(errno));
+        if (ftruncate(fd, st.st_size) != 0 || wal_truncate(&g_wal, wal_size) != 0)
+            perror("[WAL] No se pudo deshacer el lote");
+        close(fd);
+        return;
+    }
 
-// ============================================================================
+    long n = 0;
+    for (WalRecord *r = batch; r; r = r->next) n++;
+    StagedRecord *staged = malloc(sizeof(StagedRecord) * n);
+    if (!staged) {
+        // Quedan en el CSV sin indexar, como si hubiera fallado index.bin
+        fprintf(stderr, "[INDEX_DEBUG] Sin memoria para indexar el lote\n");
+        for (WalRecord *r = batch; r; r = r->next) r->status = 0;
+        close(fd);
+        return;
+    }
+    IndexTxn tx[N_TX];
+    int open_tx[N_TX];
+    OffsetsHeader oh;
+    stage_records(batch, end, staged, tx, open_tx, &oh);
 
-// Busca en el CSV, en un rango de buckets vecinos [-12,+12]
-// Usa coincidencia de subcadena para el título. Filtro exacto para la fecha.
-// Guarda las líneas del CSV que coincidan en resp_buf (de tamaño resp_sz).
-// Devuelve: el número de coincidencias encontradas (>0)
-//           0 si no hay ninguna, o
-//           -1 si ocurre un error
-static int search_by_title_and_update(const char *title_value, const char *update_value,
-                                      char *resp_buf, size_t resp_sz) {
-    if (!title_value || resp_buf == NULL) return -1; // Devuelve -1 si alguno es NULL
+    pthread_rwlock_wrlock(&g_data_lock);
+    publish_records(batch, staged, tx, open_tx, &oh);
+    pthread_rwlock_unlock(&g_data_lock);
+
+    for (int k = 0; k < N_TX; k++)
+        if (open_tx[k]) index_txn_close(&tx[k]);
+    free(staged);
+    close(fd);  // libera el bloqueo fcntl
+
+    if (g_wal.size > WAL_CHECKPOINT_BYTES) checkpoint();
+}
+
+// La llama el líder del log con cada lote (ver write_batch).
+static void commit_inserts(WalRecord *batch, void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_open_lock);
+    write_batch(batch);
+    pthread_mutex_unlock(&g_open_lock);
+}
+
+// Copia en out el registro del CSV que empieza en off (puede ocupar varias
+// líneas si tiene saltos entre comillas), con su '\n' si entra.
+// Devuelve la cantidad de bytes copiados (0 si off está fuera del archivo).
+static size_t csv_map_line(long off, char *out, size_t out_sz) {
+    if (off < 0 || (size_t)off >= g_csv.size || out_sz == 0) return 0;
+
+    const char *p = (const char *)g_csv.base + off;
+    size_t avail = g_csv.size - (size_t)off;
+    if (avail > out_sz - 1) avail = out_sz - 1;
+
+    const char *stop = csv_record_end(p, p + avail);
+    size_t len = stop < p + avail ? (size_t)(stop - p) + 1 : avail;
+    memcpy(out, p, len);
+    out[len] = '\0';
+    return len;
+}
+
+// --- Resultados de una búsqueda ---
+// Cada candidato (offset en el CSV) pasa por los filtros de fecha y de
+// categoría/licencia y, si corresponde, su línea se copia al buffer de respuesta.
+typedef struct {
+    const char *date_from;      // rango de fechas (col 12); NULL = abierto
+    const char *date_to;        // se compara como prefijo: "2020" cubre todo el año
+    const long *date_offsets;   // registros del rango según dates.bin, ordenados (o NULL)
+    long n_dates;
+    const char *categories;     // categorías requeridas (col 6), separadas por espacios o comas
+    const char *license;        // licencia (col 11), exacta o contenida
+    const Roaring *facet_docs;  // documentos que pasan cat/lic según categories.bin (o NULL)
+    Roaring *matched_docs;      // FACETS: se juntan acá los documentos, sin límite (o NULL)
+    char *resp_buf;
+    size_t resp_sz;
+    size_t used;                // bytes ya ocupados en resp_buf
+    int found;                  // líneas del csv agregadas (o documentos juntados)
+    int full;                   // no entra otra línea
+    int failed;
+} SearchResults;
+
+static int offset_cmp(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
 
+// Sin dates.bin: la fecha se lee de la línea ya copiada del CSV.
+static int date_in_range(const char *date, const char *from, const char *to) {
+    if (from && strcmp(date, from) < 0) return 0;
+    if (to && strncmp(date, to, strlen(to)) > 0) return 0;
+    return 1;
+}
 
-    /* VERFICAR SI YA EXISTE EL ÍNDICE, SI NO ENTONCES CREARLO */
+// Sin categories.bin: cada categoría pedida tiene que estar entre las de
+// la línea y la licencia tiene que ser o contener la pedida.
+static int facets_in_line(const char *line, const char *categories, const char *license) {
+    char field[1024];
+    if (license && (!csv_get_column(line, LICENSE_COLUMN, field, sizeof(field)) || !strsearch_ci_str(field, license)))
+        return 0;
+    if (!categories) return 1;
+    if (!csv_get_column(line, CATEGORY_COLUMN, field, sizeof(field))) return 0;
+
+    for (const char *p = categories; *p; ) {
+        while (*p == ' ' || *p == ',') p++;
+        size_t len = strcspn(p, " ,");
+        if (len == 0) break;
+        int found = 0;
+        for (const char *f = field; *f && !found; ) {
+            while (*f == ' ') f++;
+            size_t flen = strcspn(f, " ");
+            found = flen == len && strncasecmp(f, p, len) == 0;
+            f += flen;
+        }
+        if (!found) return 0;
+        p += len;
+    }
+    return 1;
+}
 
-    // Verifica si se puede acceder a "index.bin"
-    // access devuelve 0 si la comprobación de acceso es exitosa
-    if (access(INDEX_FILE, F_OK) != 0) {  // F_OK solo pide comprobar la existencia del archivo
+// Suma el registro a r->matched_docs (por su número en categories.bin).
+static int add_matched_doc(SearchResults *r, long csv_offset) {
+    long doc = catidx_doc(&g_cats, csv_offset);
+    if (doc < 0) return 0;
+    if (roaring_add(r->matched_docs, (unsigned int)doc) != 0) {
+        r->failed = 1;
+        return 1;
+    }
+    r->found++;
+    return 0;
+}
 
-        // Si "index.bin" no existe, entonces lo crea con build_index
-        if (build_index(CSV_FILE, INDEX_FILE) != 0) return -1;
+// Devuelve distinto de 0 cuando ya no hay que seguir buscando.
+static int collect_match(long csv_offset, void *arg) {
+    SearchResults *r = arg;
+    char linebuf[MAX_LINE]; // Aquí se guardará una línea del csv
+    int date_filter = r->date_from || r->date_to;
+    int facet_filter = r->categories || r->license;
+
+    /* FILTRO DE FECHA (con dates.bin, sin leer el CSV) */
+    if (date_filter && r->date_offsets &&
+        !bsearch(&csv_offset, r->date_offsets, r->n_dates, sizeof(long), offset_cmp)) return 0;
+
+    /* FILTRO DE CATEGORÍA / LICENCIA (con categories.bin, sin leer el CSV) */
+    if (facet_filter && r->facet_docs) {
+        long doc = catidx_doc(&g_cats, csv_offset);
+        if (doc < 0 || !roaring_contains(r->facet_docs, (unsigned int)doc)) return 0;
     }
 
-    /* ABRIR ARCHIVOS */
+    // FACETS: sin filtros que lean el CSV, alcanza con el número de documento
+    int line_filter = (date_filter && !r->date_offsets) || (facet_filter && !r->facet_docs);
+    if (r->matched_docs && !line_filter) return add_matched_doc(r, csv_offset);
 
-    // idx es un puntero a "index.bin" abierto en modo lectura binaria
-    FILE *idx = fopen(INDEX_FILE, "rb"); 
+    // Copia la línea del csv mapeado que empieza en csv_offset
+    // (como fgets: hasta el '\n' incluido o hasta llenar linebuf)
+    size_t line_len = csv_map_line(csv_offset, linebuf, sizeof(linebuf));
+    if (line_len == 0) return 0;
 
-    // csv es un puntero a "arxiv.csv" abierto en modo lectura
-    FILE *csv = fopen(CSV_FILE, "r");
+    /* FILTRO DE FECHA (sin dates.bin) */
+    if (date_filter && !r->date_offsets) {
+        char parsed_update[64]; // aquí se guardará la fecha extraída del csv
 
-    // Verifica si alguno de los dos archivos no se pudo abrir
-    // (Si fopen falla devuelve NULL)
-    if (!idx || !csv) {
+        // extrae la columna 12; si no puede o no está en el rango, no pasa el filtro
+        if (!csv_get_column(linebuf, DATE_COLUMN, parsed_update, sizeof(parsed_update)) ||
+            !date_in_range(parsed_update, r->date_from, r->date_to)) return 0;
+    }
 
-        // Cierra los dos archivos porque hubo un error
-        if (idx) fclose(idx);
-        if (csv) fclose(csv);
-        return -1;
+    /* FILTRO DE CATEGORÍA / LICENCIA (sin categories.bin) */
+    if (facet_filter && !r->facet_docs &&
+        !facets_in_line(linebuf, r->categories, r->license)) return 0;
+
+    if (r->matched_docs) return add_matched_doc(r, csv_offset);
+
+    // Si no queda espacio en resp_buf, termina la búsqueda
+    if (r->used + line_len + 1 >= r->resp_sz) {
+        r->full = 1;
+        return 1;
     }
+    memcpy(r->resp_buf + r->used, linebuf, line_len);
+    r->used += line_len;
+    r->resp_buf[r->used] = '\0';
+    r->found++;
+    return r->found >= MAX_RESULTS;
+}
 
-    /* LEER HEADER */
+// Sin trigram.bin: heurística anterior, escanear los buckets vecinos
+// [-12,+12] del hash del título completo (puede no ver coincidencias).
+static void search_nearby_buckets(const char *title_value, SearchResults *r) {
+    IndexHeader header; // copia del header de "index.bin" (está al inicio del mapeo)
+    if (index_map_header(g_index.base, g_index.size, &header) != 0) return;
+
+    // h es el bucket del título buscado según la geometría actual del índice
+    long h = index_bucket_for(&header, index_key_hash(&header, title_value));
+
+    IndexCursor cursor = {0}; // recorre un bucket
+    IndexEntry entry;
+    int stop = 0;
+    for (int off = -BUCKET_RANGE; off <= BUCKET_RANGE && !stop; ++off) {
+        long bucket_idx = h + off;
+        if (bucket_idx < 0 || bucket_idx >= header.n_buckets) continue;
+
+        // El cursor apunta al bloque contiguo del bucket dentro del mapeo
+        // y además recorre la cadena de overflow de lo insertado después
+        if (index_cursor_open_map(g_index.base, g_index.size, &header, bucket_idx, &cursor) != 0) continue;
+        while (!stop && index_cursor_next(NULL, &header, &cursor, &entry, 1) == 1) {
+            if (strsearch_ci_str(entry.key, title_value)) stop = collect_match(entry.csv_offset, r);
+        }
+    }
+    index_cursor_close(&cursor);
+}
 
-    IndexHeader header; // Aquí guardaremos el header leído de "index.bin"
+static int collect_doc(unsigned int doc, void *arg) {
+    return collect_match(g_cats.docs[doc], arg);
+}
 
-    // fseek mueve el puntero idx 0 bytes desde el inicio, devuelve 0 si lo logra
-    // fread lee el index header de "index.bin" y lo guarda en header, devuelve el número de elementos leídos si lo logra 
-    if (fseek(idx, 0, SEEK_SET) != 0 || fread(&header, sizeof(IndexHeader), 1, idx) != 1) {
+// Resuelve la búsqueda de r (ya con sus filtros) pasando cada coincidencia
+// por collect_match. Devuelve 0, o -1 si ocurre un error.
+static int run_search(const char *title_value, SearchResults *r) {
+    Roaring facets;
+    roaring_init(&facets);
+    if ((r->categories || r->license) && g_cats.loaded) {
+        if (catidx_filter(&g_cats, r->categories, r->license, &facets) != 0) return -1;
+        if (facets.n == 0) return 0;
+        r->facet_docs = &facets;
+    }
 
-        // Cierra los dos archivos porque hubo un error
-        fclose(idx); fclose(csv);
+    long *dates = NULL;
+    if ((r->date_from || r->date_to) && g_dates.fd >= 0) {
+        r->n_dates = dateidx_collect(&g_dates, &g_date_tail, r->date_from, r->date_to, &dates);
+        if (r->n_dates <= 0) {
+            free(dates);
+            roaring_free(&facets);
+            return r->n_dates < 0 ? -1 : 0;
+        }
+        r->date_offsets = dates;
+    }
+
+    int rc = 0;
+    if (r->facet_docs && title_value[0] == '\0' &&
+        (!r->date_offsets || roaring_cardinality(r->facet_docs) < r->n_dates)) {
+        roaring_iterate(r->facet_docs, collect_doc, r);
+    } else if (r->date_offsets && title_value[0] == '\0') {
+        for (long i = 0; i < r->n_dates && !collect_match(dates[i], r); i++) ;
+    } else if (g_words.docs && wordidx_is_boolean(title_value)) {
+        // "neural AND network NOT graph": consulta booleana por palabras
+        if (wordidx_search(&g_words, title_value, collect_match, r) < 0) rc = -1;
+    } else if (g_trigram.docs) {
+        if (trigram_search(&g_trigram, title_value, collect_match, r) < 0) rc = -1;
+    } else {
+        search_nearby_buckets(title_value, r);
+    }
+    free(dates);
+    roaring_free(&facets);
+    r->facet_docs = NULL;
+    r->date_offsets = NULL;
+    return rc < 0 || r->failed ? -1 : 0;
+}
+
+// Busca los registros cuyo título contiene title_value (subcadena,
+// case-insensitive), con filtro opcional por rango de fechas [date_from,
+// date_to] (NULL = sin límite; date_to se compara como prefijo).
+// Con trigram.bin la búsqueda es completa: se intersectan las listas de
+// los trigramas de la consulta y se verifica cada candidato.
+// Si la consulta usa AND / OR / NOT (en mayúsculas) se resuelve con
+// words.bin, por palabras completas en vez de subcadenas.
+// Con dates.bin los registros del rango salen del árbol B+ y cada
+// candidato por título se descarta antes de leer su línea del CSV; con
+// título vacío se devuelven directamente los del rango.
+// categories / license (NULL = sin filtro) se resuelven igual con
+// categories.bin: la intersección de sus conjuntos descarta candidatos
+// sin leer el CSV y, con título vacío, es la lista de candidatos si es
+// más chica que el rango de fechas.
+// Guarda las líneas del CSV que coincidan en resp_buf (de tamaño resp_sz).
+// Devuelve: el número de coincidencias encontradas (>0)
+//           0 si no hay ninguna, o
+//           -1 si ocurre un error
+static int search_by_title_and_update(const char *title_value, const char *date_from, const char *date_to,
+                                      const char *categories, const char *license,
+                                      char *resp_buf, size_t resp_sz) {
+    if (!title_value || resp_buf == NULL) return -1; // Devuelve -1 si alguno es NULL
+
+    // Los archivos se abren y mapean una sola vez (al arrancar); si todavía
+    // no estaban disponibles se intenta ahora, construyendo el índice si hace falta
+    if (!data_files_open()) return -1;
+
+    SearchResults r = { .date_from = date_from && *date_from ? date_from : NULL,
+                        .date_to = date_to && *date_to ? date_to : NULL,
+                        .categories = categories && *categories ? categories : NULL,
+                        .license = license && *license ? license : NULL,
+                        .resp_buf = resp_buf, .resp_sz = resp_sz };
+    resp_buf[0] = '\0';
+    return run_search(title_value, &r) < 0 ? -1 : r.found;
+}
+
+// Separa el payload de FIND: "q=<título>|date=<desde>..<hasta>|cat=<categorías>|lic=<licencia>"
+// (los filtros son opcionales y en cualquier orden; en date cualquiera de
+// los dos extremos puede faltar y "date=2020" es un solo día/mes/año).
+// Un payload sin "q=" es solo el título, como antes.
+static void parse_find_payload(char *buf, const char **title, const char **from, const char **to,
+                               const char **categories, const char **license) {
+    *title = buf;
+    *from = *to = *categories = *license = NULL;
+    if (strncmp(buf, "q=", 2) != 0) return;
+    *title = buf + 2;
+
+    // Se buscan todas las marcas antes de cortar: cada '\0' termina el campo anterior
+    char *d = strstr(buf, "|date=");
+    char *c = strstr(buf, "|cat=");
+    char *l = strstr(buf, "|lic=");
+    if (c) { *c = '\0'; *categories = c + 5; }
+    if (l) { *l = '\0'; *license = l + 5; }
+    if (!d) return;
+    *d = '\0';
+    char *range = d + 6;
+    char *dots = strstr(range, "..");
+    if (dots) {
+        *dots = '\0';
+        *from = range;
+        *to = dots + 2;
+    } else {
+        *from = *to = range;
+    }
+}
+
+// FACETS: conteos por categoría, licencia y año de update_date. Con
+// payload vacío son los de todo el dataset (el tamaño de cada conjunto de
+// categories.bin, que las inserciones mantienen al día); con un payload de
+// FIND son los de todos los registros que esa búsqueda devuelve, sin el
+// límite de MAX_RESULTS (se juntan sus números de documento y se cruzan con
+// cada conjunto sin leer el CSV).
+// Responde "total\t\t<n>" y una línea "campo\tnombre\tconteo" por faceta.
+// Devuelve la cantidad de facetas, o -1 si no hay categories.bin.
+static int facet_counts(char *payload, char *resp_buf, size_t resp_sz) {
+    static const char *field_names[CATIDX_N_FIELDS] = { "category", "license", "year" };
+    if (!data_files_open() || !g_cats.loaded) return -1;
+
+    Roaring matched;
+    roaring_init(&matched);
+    const Roaring *within = NULL;
+    if (payload[0] != '\0') {
+        const char *title, *date_from, *date_to, *categories, *license;
+        parse_find_payload(payload, &title, &date_from, &date_to, &categories, &license);
+        SearchResults r = { .date_from = date_from && *date_from ? date_from : NULL,
+                            .date_to = date_to && *date_to ? date_to : NULL,
+                            .categories = categories && *categories ? categories : NULL,
+                            .license = license && *license ? license : NULL,
+                            .matched_docs = &matched };
+        if (run_search(title, &r) < 0) {
+            roaring_free(&matched);
+            return -1;
+        }
+        within = &matched;
+    }
+
+    FacetCount *f;
+    long n = catidx_facets(&g_cats, within, &f);
+    if (n < 0) {
+        roaring_free(&matched);
         return -1;
     }
+    size_t used = (size_t)snprintf(resp_buf, resp_sz, "total\t\t%ld\n",
+                                   within ? roaring_cardinality(within) : g_cats.n_docs);
+    for (long i = 0; i < n && used < resp_sz; i++)
+        used += (size_t)snprintf(resp_buf + used, resp_sz - used, "%s\t%s\t%ld\n",
+                                 field_names[f[i].field], f[i].name, f[i].count);
+    if (used >= resp_sz) {
+        // No entró todo: se corta en la última línea completa
+        size_t end = resp_sz - 1;
+        while (end > 0 && resp_buf[end - 1] != '\n') end--;
+        resp_buf[end] = '\0';
+    }
+    free(f);
+    roaring_free(&matched);
+    return (int)n;
+}
 
-    /* CALCULAR HASH DEL TÍTULO QUE QUEREMOS */
+// SCAN: búsqueda sin índice. Payload "col=<columna>|q=<texto>" (la columna
+// por nombre de la cabecera, p. ej. authors, o por número) o solo el texto
+// para buscar en la línea completa. Recorre el CSV mapeado en paralelo
+// (scan.h) y devuelve las primeras MAX_RESULTS líneas que contienen el
+// texto en esa columna, sin distinguir mayúsculas, en orden del archivo.
+// Devuelve la cantidad de líneas, 0 si no hay, o -1 si la columna no existe.
+static int scan_records(const char *payload, char *resp_buf, size_t resp_sz) {
+    if (!data_files_open() || g_csv.size == 0) return -1;
+
+    int column = 0;
+    const char *needle = payload;
+    if (strncmp(payload, "col=", 4) == 0) {
+        const char *q = strstr(payload, "|q=");
+        if (!q) return -1;
+        char name[64];
+        size_t len = (size_t)(q - (payload + 4));
+        if (len >= sizeof(name)) return -1;
+        memcpy(name, payload + 4, len);
+        name[len] = '\0';
+        column = scan_column_of((const char *)g_csv.base, g_csv.size, name);
+        if (column < 0) return -1;
+        needle = q + 3;
+    }
+    if (needle[0] == '\0') return -1;
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    ScanQuery q = { .base = (const char *)g_csv.base, .size = g_csv.size, .column = column,
+                    .needle = needle, .limit = MAX_RESULTS, .threads = ncpu > 0 ? (int)ncpu : 1 };
+    ScanResult res;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (scan_csv(&q, &res) != 0) return -1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("[SCAN] %ld coincidencias, %ld trozos, %.1f MB en %.3f s (%.2f GB/s, %d hilos)\n",
+           res.n, res.chunks, res.bytes / 1e6, secs, secs > 0 ? res.bytes / secs / 1e9 : 0.0, q.threads);
+
+    SearchResults r = { .resp_buf = resp_buf, .resp_sz = resp_sz };
+    resp_buf[0] = '\0';
+    for (long i = 0; i < res.n && !collect_match(res.offsets[i], &r); i++) ;
+    scan_result_free(&res);
+    return r.found;
+}
 
-    long n_buckets = header.n_buckets; // Trae el núm total de buckets en index.bin (1000)
-    if (n_buckets <= 0) n_buckets = N_BUCKETS; // Verifica si es un bucket válido
+// Búsqueda con ranking BM25 en los abstracts: las (hasta MAX_RESULTS)
+// líneas del CSV con mayor puntaje, de mayor a menor.
+// Devuelve la cantidad de líneas, o -1 si no hay índice de abstracts.
+static int search_abstracts_ranked(const char *query, char *resp_buf, size_t resp_sz) {
+    if (!query || resp_buf == NULL) return -1;
+    if (!data_files_open() || !g_abstracts.docs) return -1;
 
-    // h es el hash del título buscado, módulo 1000
-    unsigned long h = hash_string(title_value) % (unsigned long)n_buckets;
+    Bm25Hit hits[MAX_RESULTS];
+    long n = bm25_search(&g_abstracts, query, hits, MAX_RESULTS);
 
+    SearchResults r = { .resp_buf = resp_buf, .resp_sz = resp_sz };
+    resp_buf[0] = '\0';
+    for (long i = 0; i < n && !collect_match(hits[i].csv_offset, &r); i++) ;
+    return r.found;
+}
 
-    /* INICIALIZACIONES */
+// Títulos que empiezan con prefix (sin distinguir mayúsculas), en orden
+// alfabético: las primeras MAX_RESULTS líneas del CSV.
+// Devuelve la cantidad de líneas, o -1 si no hay titles.bin.
+static int search_title_prefix(const char *prefix, char *resp_buf, size_t resp_sz) {
+    if (!prefix || resp_buf == NULL) return -1;
+    if (!data_files_open() || g_titles.map.fd < 0) return -1;
+
+    SearchResults r = { .resp_buf = resp_buf, .resp_sz = resp_sz };
+    resp_buf[0] = '\0';
+    if (titletree_prefix(&g_titles, prefix, collect_match, &r) < 0) return -1;
+    return r.found;
+}
 
-    int found = 0; // found será la cantidad de líneas del csv encontradas
-    size_t used = 0; // used será la cantidad de bytes ya ocupados en resp_buf
-    resp_buf[0] = '\0'; // en resp_buf se guardarán las líneas del csv encontradas
+// Registros cuyo título es exactamente title (sin distinguir mayúsculas):
+// un solo bucket de index.bin (o de la tabla en memoria), descartando por
+// fingerprint.
+// Devuelve la cantidad de líneas, o -1 si hubo error.
+static int search_title_exact(const char *title, char *resp_buf, size_t resp_sz) {
+    if (!title || resp_buf == NULL) return -1;
+    if (!data_files_open()) return -1;
+
+    SearchResults r = { .resp_buf = resp_buf, .resp_sz = resp_sz };
+    resp_buf[0] = '\0';
+
+    // Con --memtable: un grupo de 16 bytes de control y el slot del candidato
+    if (g_memtable.ctrl) {
+        swiss_find(&g_memtable, title, collect_match, &r);
+        return r.found;
+    }
 
-    int off_start = -BUCKET_RANGE; // Buscaremos desde -12
-    int off_end   = BUCKET_RANGE;  // hasta +12
+    IndexHeader header;
+    if (index_map_header(g_index.base, g_index.size, &header) != 0) return -1;
+    if (index_find_exact_map(g_index.base, g_index.size, &header, title, collect_match, &r) < 0) return -1;
+    return r.found;
+}
 
-    char linebuf[MAX_LINE]; // Aquí se guardará una línea del csv 
+// Registros cuyo campo indexado en m (id o doi) es exactamente key, sin
+// distinguir mayúsculas: un solo bucket, como la búsqueda exacta por título.
+// Devuelve la cantidad de líneas, o -1 si no está el índice.
+static int search_exact_column(FileMap *m, const char *key, char *resp_buf, size_t resp_sz) {
+    if (!key || resp_buf == NULL) return -1;
+    if (!data_files_open() || m->fd < 0) return -1;
 
+    IndexHeader header;
+    if (index_map_header(m->base, m->size, &header) != 0) return -1;
+
+    SearchResults r = { .resp_buf = resp_buf, .resp_sz = resp_sz };
+    resp_buf[0] = '\0';
+    if (index_find_exact_map(m->base, m->size, &header, key, collect_match, &r) < 0) return -1;
+    return r.found;
+}
 
-    /* BUSCAAAAAARR */
+// READIDX: el registro N o los registros N..M (numerados desde 1), hasta
+// MAX_RESULTS. Los límites salen de offsets.bin con un pread y cada
+// registro se lee del CSV con otro, directo al buffer de respuesta.
+// Devuelve la cantidad de registros, o -1 si no hay offsets.bin o el
+// pedido no es válido.
+static int read_records(const char *spec, char *resp_buf, size_t resp_sz) {
+    if (!spec || resp_buf == NULL) return -1;
+    if (!data_files_open() || g_offsets.fd < 0) return -1;
+
+    char *end;
+    long first = strtol(spec, &end, 10), last = first;
+    if (end == spec) return -1;
+    if (strncmp(end, "..", 2) == 0) {
+        const char *m = end + 2;
+        last = strtol(m, &end, 10);
+        if (end == m) last = g_offsets.h.n_records;     // "N.." hasta el final
+    }
+    if (first < 1 || last < first) return -1;
+
+    long count = last - first + 1;
+    if (count > MAX_RESULTS) count = MAX_RESULTS;
+    long bounds[MAX_RESULTS + 1];
+    count = offsets_range(&g_offsets, first, count, bounds);
+    if (count <= 0) return (int)count;
+
+    size_t used = 0;
+    int found = 0;
+    resp_buf[0] = '\0';
+    for (long i = 0; i < count; i++) {
+        long len = bounds[i + 1] - bounds[i];
+        if (len <= 0 || used + (size_t)len + 2 >= resp_sz) break;
+        if (pread(g_csv.fd, resp_buf + used, (size_t)len, bounds[i]) != (ssize_t)len) return -1;
+        used += (size_t)len;
+        if (resp_buf[used - 1] != '\n') resp_buf[used++] = '\n';    // el último registro puede no tenerlo
+        resp_buf[used] = '\0';
+        found++;
+    }
+    return found;
+}
+
+// RSS actual del proceso en bytes (0 si no se puede leer /proc).
+static long rss_bytes(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    long size = 0, resident = 0;
+    int ok = fscanf(f, "%ld %ld", &size, &resident) == 2;
+    fclose(f);
+    return ok ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+// --memtable: carga index.bin en una tabla con direccionamiento abierto
+// (swiss.c) y reporta cuánto ocupa por millón de títulos.
+static void load_memtable(void) {
+    struct timespec t0, t1;
+    long rss0 = rss_bytes();
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (swiss_load_index(&g_memtable, INDEX_FILE) != 0) {
+        fprintf(stderr, "Servidor: no se pudo cargar %s en memoria, se usa el índice mapeado\n", INDEX_FILE);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double n_m = g_memtable.n > 0 ? g_memtable.n / 1e6 : 1.0;
+    double table_mb = swiss_bytes(&g_memtable) / (1024.0 * 1024.0);
+    double rss_mb = (rss_bytes() - rss0) / (1024.0 * 1024.0);
+    printf("[MEMTABLE] %ld títulos en %.3f s: tabla %.1f MB (%.1f MB por millón), RSS +%.1f MB (%.1f MB por millón)\n",
+           g_memtable.n, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9,
+           table_mb, table_mb / n_m, rss_mb, rss_mb / n_m);
+}
 
-    // Aquí iteramos por bucket
-    // Vamos a buscar desde el bucket h - 12 hasta el bucket h + 12
-    for (int off = off_start; off <= off_end && found < MAX_RESULTS; ++off) {
+// ============================================================================
 
 
-        /* CALCULAR OFFSET DEL BUCKET QUE QUEREMOS */
+// Al arrancar: si lo insertado desde la última compactación (cadenas de
+// overflow) supera 1/INDEX_COMPACT_RATIO del índice, o si se pidió con
+// --compact, se reescribe el índice con un bloque contiguo por bucket.
+// Vale para index.bin y para los secundarios (mismo formato).
+static void maybe_compact_index(const char *path, int force) {
+    FILE *idx = fopen(path, "rb");
+    if (!idx) return; // todavía no existe: se construye en la primera búsqueda
 
-        // bucket_idx es el número de bucket del bucket que queremos
-        long bucket_idx = (long)h + off; // hash calculado (h), más el offset
-        if (bucket_idx < 0 || bucket_idx >= n_buckets) continue; // si está fuera del rago de 0 a 1000, no se procesa ese bucket
+    IndexHeader header;
+    int valid = index_read_header(idx, &header) == 0;
+    fclose(idx);
+    if (!valid) return;
 
-        // Calculamos el offset del buccket que queremos leer
-        long bucket_offset = sizeof(IndexHeader) + sizeof(BucketDisk) * bucket_idx;
+    // Antes del formato 5 las claves pueden estar cortadas (y antes del 4 el
+    // bucket dependía de las mayúsculas): no se compacta, open_data_files
+    // reconstruye todo desde el CSV
+    if (header.version < INDEX_VERSION_RFC4180) return;
 
+    if (force || header.n_overflow * INDEX_COMPACT_RATIO > header.n_entries) {
+        printf("Servidor: compactando %s (%ld de %ld entradas en overflow)...\n",
+               path, header.n_overflow, header.n_entries);
+        index_compact(path);
+    }
+}
 
-        /* LEEMOS EL BUCKET */
+// ============================================================================
+// Atención de las conexiones: el bucle de eventos de main (evloop.c) lee y
+// escribe todas las conexiones sin bloquearse, y cada petición completa la
+// atiende un hilo del pool (--workers N, por defecto uno por núcleo).
+
+static ThreadPool g_pool;
+static EvLoop g_loop;
+
+// STATS: contadores de las conexiones, del pool y del log de inserciones.
+// Una línea "nombre\tvalor" por contador y después
+// "worker\t<n>\t<tareas>\t<segundos ocupado>\t<% de uso>" por hilo.
+static int server_stats(char *resp_buf, size_t resp_sz) {
+    PoolStats st;
+    PoolWorkerStats *w = calloc((size_t)(g_pool.n_workers > 0 ? g_pool.n_workers : 1), sizeof(PoolWorkerStats));
+    if (!w) return -1;
+    pool_stats(&g_pool, &st, w);
+    EvStats ev;
+    evloop_stats(&g_loop, &ev);
+    WalStats wal;
+    wal_stats(&g_wal, &wal);
+
+    size_t n = (size_t)snprintf(resp_buf, resp_sz,
+        "conns\t%ld\nconns_max\t%ld\naccepted\t%ld\nrequests\t%ld\nwaiting\t%ld\n"
+        "uptime\t%.1f\nworkers\t%d\nbusy\t%d\nqueue\t%d\nqueue_max\t%d\nqueue_cap\t%d\nsubmitted\t%ld\ncompleted\t%ld\n"
+        "inserts\t%ld\nwal_batches\t%ld\nwal_batch_max\t%ld\nwal_bytes\t%ld\nwal_sync_ms\t%.1f\n",
+        ev.open, ev.open_max, ev.accepted, ev.requests, ev.waiting,
+        st.uptime_secs, st.workers, st.busy_now, st.queue_depth, st.queue_max, st.queue_cap,
+        st.submitted, st.completed,
+        wal.records, wal.batches, wal.batch_max, wal.size, wal.sync_secs * 1e3);
+    for (int i = 0; i < st.workers && n < resp_sz; i++)
+        n += (size_t)snprintf(resp_buf + n, resp_sz - n, "worker\t%d\t%ld\t%.3f\t%.1f\n",
+                              i, w[i].tasks, w[i].busy_secs, w[i].utilization * 100.0);
+    free(w);
+    return st.workers;
+}
 
-        BucketDisk b; // aquí guardaremos el bucket leído
-        if (fseek(idx, bucket_offset, SEEK_SET) != 0) continue; // movemos idx al offset del bucket
-        if (fread(&b, sizeof(BucketDisk), 1, idx) != 1) continue; // leemos el bucket y lo guardamos en b
+// Atiende el comando cmd con el payload buf. Devuelve el mensaje a enviar
+// (resp o un texto fijo), o NULL si el comando no existe.
+static const char *run_command(uint32_t cmd, char *buf, char *resp, size_t resp_sz) {
 
+    /* OPCIÓN 1: REALIZAR BÚSQUEDA */
 
-        /* VAMOS A LEER LOS ENTRIEEES */
+    if (cmd == 1) {
+        printf("Buscando %s...\n", buf);
 
-        // current empieza siendo el offset del primer entry que queremos leer:
-        long current = b.first_entry_offset;
+        // BÚSQUEDA ("q=<título>|date=<desde>..<hasta>|cat=..|lic=.." o solo el título)
+        const char *title, *date_from, *date_to, *categories, *license;
+        parse_find_payload(buf, &title, &date_from, &date_to, &categories, &license);
+        int found = search_by_title_and_update(title, date_from, date_to, categories, license,
+                                               resp, RESP_SZ);
 
-        EntryDisk entry; // aquí guardaremos el entry que vamos leyendo
+        // Si no encontró resultados, envía NA
+        return found > 0 ? resp : "NA";
+    }
 
-        // current iterará para leer cada entry, current es el entry actual
-        // cuando current = -1 es cuando hemos llegado al final de la lista enlazada
-        while (current != -1 && found < MAX_RESULTS) {
+    /* OPCIÓN 2: GUARDAR NUEVO REGISTRO*/
 
-            if (fseek(idx, current, SEEK_SET) != 0) break; // movemos idx al offset del entry actual
-            if (fread(&entry, sizeof(EntryDisk), 1, idx) != 1) break; // leemos el entry y lo guardamos en entry
+    if (cmd == 2) {
+        // Un ACK (confirmación) si logró guardar el registro
+        return save_new_register(buf) == 0 ? "OK" : "ERROR: no se pudo guardar el registro";
+    }
 
-            // Busca el título que queremos (como subcadena) en el entry actual, case-insensitive
-            // Entra en el if si hay coincidencia
-            if (ci_strcasestr(entry.key, title_value)) {
+    /* OPCIÓN 3: BÚSQUEDA CON RANKING EN ABSTRACTS */
 
+    if (cmd == 3) {
+        printf("Buscando en abstracts %s...\n", buf);
+        int found = search_abstracts_ranked(buf, resp, RESP_SZ);
+        return found > 0 ? resp : "NA";
+    }
 
-                /* LEER EN EL CSV */
+    /* OPCIÓN 4: BÚSQUEDA POR PREFIJO DEL TÍTULO (en orden alfabético) */
 
-                // Mueve el puntero csv al offset que nos dice el entry, si tiene exito entra al if
-                if (fseek(csv, entry.csv_offset, SEEK_SET) == 0) {
+    if (cmd == 4) {
+        printf("Buscando títulos que empiezan con %s...\n", buf);
+        int found = search_title_prefix(buf, resp, RESP_SZ);
+        return found > 0 ? resp : "NA";
+    }
 
-                    // Trae una línea del csv y la guarda en linebuf, si tiene éxito entra en el if
-                    if (fgets(linebuf, sizeof(linebuf), csv)) {
+    /* OPCIÓN 5: TÍTULO EXACTO (sin distinguir mayúsculas) */
 
+    if (cmd == 5) {
+        printf("Buscando el título exacto %s...\n", buf);
+        int found = search_title_exact(buf, resp, RESP_SZ);
+        return found > 0 ? resp : "NA";
+    }
 
-                        /* FILTRO DE FECHA */
+    /* OPCIÓN 6: READIDX, LEER POR NÚMERO DE REGISTRO ("N" o "N..M") */
 
-                        // pass_update indicará si pasa el filtro de fecha o no
-                        int pass_update = 1;
+    if (cmd == 6) {
+        printf("Leyendo registro(s) %s...\n", buf);
+        int found = read_records(buf, resp, RESP_SZ);
+        return found > 0 ? resp : "NA";
+    }
 
-                        // Entra a este if solo si existe un valor de update_value
-                        if (update_value && update_value[0] != '\0') {
+    /* OPCIONES 7 Y 8: BÚSQUEDA EXACTA POR ID O POR DOI */
 
-                            // aquí se guardará la fecha extraída del csv
-                            char parsed_update[64];
+    if (cmd == 7 || cmd == 8) {
+        printf("Buscando %s %s...\n", cmd == 7 ? "id" : "doi", buf);
+        int found = search_exact_column(cmd == 7 ? &g_index_id : &g_index_doi, buf, resp, RESP_SZ);
+        return found > 0 ? resp : "NA";
+    }
 
-                            // extrae la columna 12 de linebuf y la guarda en parsed_update
-                            // solo entra el if si NO pudo extraer la columna
-                            if (!csv_get_column(linebuf, 12, parsed_update, sizeof(parsed_update))) {
-                                pass_update = 0; // no pasa el filtro de fecha
-                            }
-                            else {
+    /* OPCIÓN 9: FACETS, CONTEOS POR CATEGORÍA / LICENCIA / AÑO */
 
-                                // si pudo extraer la fecha, pero la fecha no coincide entonces
-                                // no pasa el filtro de fecha
-                                if (strcasecmp(parsed_update, update_value) != 0) pass_update = 0;
+    if (cmd == 9) {
+        printf("Conteos %s...\n", buf[0] ? buf : "de todo el dataset");
 
-                            }
-                        }
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int n = facet_counts(buf, resp, resp_sz);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        printf("[FACETS] %d facetas en %.3f ms\n", n,
+               ((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9) * 1e3);
+        return n >= 0 ? resp : "NA";
+    }
 
-                        // Si pasó el filtro de fecha:
-                        if (pass_update) {
+    /* OPCIÓN 10: SCAN, BÚSQUEDA SIN ÍNDICE EN UNA COLUMNA */
 
-                            // line_len es la longitud de linebuf
-                            size_t line_len = strnlen(linebuf, sizeof(linebuf));
+    if (cmd == 10) {
+        printf("Recorriendo el CSV: %s...\n", buf);
+        int found = scan_records(buf, resp, RESP_SZ);
+        return found > 0 ? resp : "NA";
+    }
 
-                            // Entra a este if si hay suficiente espacio en resp_buf
-                            if (used + line_len + 1 < resp_sz) {
+    /* OPCIÓN 11: STATS, CONTADORES DEL POOL DE HILOS */
 
-                                // Copia la línea del csv (linebuf) en resp_buf, desde el
-                                // punto en el que llenó resp_buf la última vez
-                                memcpy(resp_buf + used, linebuf, line_len);
+    if (cmd == 11) {
+        return server_stats(resp, resp_sz) >= 0 ? resp : "NA";
+    }
 
-                                used += line_len; // aumenta used (cantiad de bytes guardados en resp_buf)
-                                resp_buf[used] = '\0'; // pone fin de cadena al final
-                                found++; // aumenta el contador de líneas del csv encontradas
-                            }
-                            else {
-                                // No queda espacio en resp_buf, termina la búsqueda
-                                goto FINISH_SEARCH;
-                            }
-                        }
-                    } 
-                }
-            }
+    // El 12 (HELLO, versión del protocolo) no llega acá: lo responde el
+    // bucle de eventos (evloop.h)
+    return NULL;
+}
 
-            // Va al siguiente entry (el siguiente está enlazado 
-            // al actual, es una lista enlazada)
-            current = entry.next_entry;
+// Atiende una petición que el bucle de eventos ya leyó completa y le
+// devuelve la respuesta. Corre en un hilo del pool; la tarea es la petición.
+static void handle_request(void *task, int worker, void *arg) {
+    (void)worker;
+    (void)arg;
+    EvRequest *r = task;
+
+    // La respuesta se arma con el lock tomado y la escribe el bucle ya sin
+    // él, así que un cliente lento no frena una inserción. La inserción
+    // toma el lock ella misma, solo para publicar (commit_inserts)
+    char resp[FACETS_RESP_SZ];
+    resp[0] = '\0';
+    int reader = r->cmd != 2;
+    if (reader) {
+        pthread_rwlock_rdlock(&g_data_lock);
+        if (!data_files_open()) {
+            // Fallaron al arrancar: se reintenta sin el lock para leer
+            pthread_rwlock_unlock(&g_data_lock);
+            open_data_files();
+            pthread_rwlock_rdlock(&g_data_lock);
         }
-
     }
+    const char *msg = run_command(r->cmd, r->payload, resp, sizeof(resp));
+    if (reader) pthread_rwlock_unlock(&g_data_lock);
+
+    if (!msg) printf("Comando desconocido (%u) para '%s'\n", r->cmd, r->payload);
+    evloop_complete(&g_loop, r, msg);
+}
 
-// FINISH_SEARCH es una etiqueta de C, no ejecuta nada ella misma, solo
-// marca una posición en el código a la que se puede saltar.
-FINISH_SEARCH:
+// El bucle le pasa cada petición completa; si la cola del pool está llena
+// la guarda él y la reintenta cuando se libere lugar
+static int dispatch_request(EvRequest *r, void *arg) {
+    (void)arg;
+    return pool_try_submit(&g_pool, r);
+}
 
-    // Cierra los dos archivos y devuelve la cantidad de líneas encontradas
-    fclose(idx);
-    fclose(csv);
-    return found;
+// Sube el límite de descriptores abiertos al máximo permitido: cada
+// conexión es uno y el bucle sostiene miles a la vez
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur >= rl.rlim_max) return;
+    rl.rlim_cur = rl.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &rl) != 0) perror("setrlimit");
 }
 
 // ============================================================================
@@ -803,10 +1620,49 @@ FINISH_SEARCH:
 
 /* MAAAAAIN */
 
-int main(void) {
+int main(int argc, char **argv) {
+
+    // Opciones de línea de comandos
+    //   --compact   compacta index.bin antes de empezar a atender
+    //   --memtable  carga los títulos en una tabla en memoria para las búsquedas exactas
+    //   --workers N hilos que atienden conexiones (por defecto, uno por núcleo)
+    //   --debug     muestra en stderr cada inserción (la línea, sus campos y dónde quedó en index.bin)
+    int force_compact = 0, use_memtable = 0;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = ncpu > 0 ? (int)ncpu : 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--compact") == 0) force_compact = 1;
+        else if (strcmp(argv[i], "--memtable") == 0) use_memtable = 1;
+        else if (strcmp(argv[i], "--debug") == 0) g_debug = 1;
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) workers = atoi(argv[++i]);
+        else fprintf(stderr, "Opción desconocida: %s\n", argv[i]);
+    }
+
+    // Log de inserciones: lo que tenga de una ejecución anterior se vuelve
+    // a aplicar al abrir los datos
+    if (wal_open(&g_wal, WAL_FILE, commit_inserts, NULL) != 0) {
+        perror("Servidor: no se pudo abrir " WAL_FILE);
+        exit(EXIT_FAILURE);
+    }
+
+    maybe_compact_index(INDEX_FILE, force_compact);
+    maybe_compact_index(INDEX_ID_FILE, force_compact);
+    maybe_compact_index(INDEX_DOI_FILE, force_compact);
+
+    // Mapea index.bin y arxiv.csv (construyendo el índice si falta) para
+    // que las búsquedas lean directo de memoria
+    if (open_data_files() == 0)
+        printf("Servidor: %s (%zu bytes) y %s (%zu bytes) mapeados\n",
+               INDEX_FILE, g_index.size, CSV_FILE, g_csv.size);
+    if (use_memtable) load_memtable();
+
+    if (pool_init(&g_pool, workers, workers * QUEUE_PER_WORKER, handle_request, NULL) != 0) {
+        fprintf(stderr, "Servidor: no se pudieron crear los hilos\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("Servidor: %d hilo(s), cola de %d peticiones\n", g_pool.n_workers, g_pool.cap);
 
     struct sockaddr_in addr; // declaramos una estructura que se usa para describir direcciones IPv4
-    int client_fd; // descriptor del socket que hablará con un cliente en específico
 
 
     /* DEFINIR HANDLER PARA SIGINT (CNTRL+C)*/
@@ -909,155 +1765,25 @@ int main(void) {
     printf("Servidor: escuchando solicitudes en 127.0.0.1:%d\n", PORT);
 
 
-    /* BUCLE INFINITO: aceptar peticiones y procesarlas */
-
-    for (;;) {  
-
-        /* SEMÁFORO VERDE */
-
-        // Señalizamos al cliente (post) para que sepa que el servidor está listo
-        if (sem_post(sem) < 0) perror("sem_post");
-
-
-        /* ACEPTAR CONEXIÓN */
-
-        // En esta línea creamos el socket client_fd, que hablará con el cliente,
-        // ese nuevo socket es exclusivo para esa conexión con ese cliente
-        client_fd = accept(listen_fd, NULL, NULL);
-
-        if (client_fd < 0) {
-            if (errno == EINTR) continue; // error por interrupción
-            perror("accept"); // otro error
-            break;
-        }
-
+    /* BUCLE DE EVENTOS: aceptar, leer y responder sin bloquearse */
 
-        /* LEER PETICIÓN */
-
-        // Protocolo en el que envía el cliente:
-        // - 4 bytes para el comando (1 o 2)
-        // - 4 bytes para la longitud del string que viene a continuación
-        // - n bytes para el string
-
-        // uint32_t es un entero sin signo de 32 bits (4 bytes)
-        uint32_t cmd_net, len_net; // estará en big-endian
-        uint32_t cmd, len; // estará en little-endian
-
-        // LEER comando
-        if (readn(client_fd, &cmd_net, sizeof(cmd_net)) != sizeof(cmd_net)) {
-            fprintf(stderr, "Servidor: fallo leyendo comando\n");
-            close(client_fd);
-            continue;
-        }
-        
-        // LEER tamaño string
-        if (readn(client_fd, &len_net, sizeof(len_net)) != sizeof(len_net)) {
-            fprintf(stderr, "Servidor: fallo leyendo longitud\n");
-            close(client_fd);
-            continue;
-        }
-
-        // ntohl es network to host long
-        // aquí convertimos a little-endian
-        cmd = ntohl(cmd_net);
-        len = ntohl(len_net);
-
-        // Reserva (en el heap) len + 1 bytes de memoria
-        char *buf = malloc(len + 1); 
-
-        if (!buf) {
-
-            // Error en el malloc
-            perror("malloc");
-            close(client_fd);
-            continue;
-        }
-
-        // LEER string
-        if (readn(client_fd, buf, len) != (ssize_t)len) {
-            fprintf(stderr, "Servidor: fallo leyendo string\n");
-            free(buf);
-            close(client_fd);
-            continue;
-        }
-        buf[len] = '\0';
-
-
-        /* OPCIÓN 1: REALIZAR BÚSQUEDA */
-
-        if (cmd == 1) {
-            
-            printf("Buscando %s...\n", buf);
-
-            char resp[8192];
-
-            // BÚSQUEDA
-            int found = search_by_title_and_update(buf, NULL, resp, sizeof(resp));
-
-
-            /* ENVIAR RESPUESTA AL CLIENTE */
-
-            // Protocolo en el que envía el servidor: 
-            // - 4 bytes para el número de bytes del mensaje
-            // - n bytes para el mensaje
-
-            // Si no encontró resultados, envía NA
-            if (found <= 0) {
-                const char *na = "NA";
-                uint32_t na_len_net = htonl((uint32_t)strlen(na));
-                writen(client_fd, &na_len_net, sizeof(na_len_net)); // enviar tamaño mensaje
-                writen(client_fd, na, strlen(na)); // enviar mensaje
-            }
-
-            // Si encontró resultados, los envía
-            else {
-                uint32_t resp_len_net = htonl((uint32_t)strlen(resp));
-                writen(client_fd, &resp_len_net, sizeof(resp_len_net)); // enviar tamaño mensaje
-                writen(client_fd, resp, strlen(resp)); // enviar mensaje
-            }
-        }
-        
-
-        /* OPCIÓN 2: GUARDAR NUEVO REGISTRO*/
-    
-        else if (cmd == 2) {
-
-            // GUARDAR REGISTRO
-            int saved = save_new_register(buf);
-
-            /* ENVIAR RESPUESTA AL CLIENTE */
-
-            // Protocolo en el que envía el servidor: 
-            // - 4 bytes para el número de bytes del mensaje
-            // - n bytes para el mensaje
+    // Un solo hilo atiende todas las conexiones con epoll; las peticiones
+    // completas van al pool y las respuestas vuelven por un eventfd
+    raise_fd_limit();
+    if (evloop_init(&g_loop, listen_fd, dispatch_request, NULL) != 0) {
+        close(listen_fd);
+        sem_close(sem);
+        sem_unlink(SEM_NAME);
+        exit(EXIT_FAILURE);
+    }
 
-            // Si logró guardar el registro
-            if (saved == 0) {
-                // Enviar un ACK (confirmación)
-                const char *ack = "OK";
-                uint32_t ack_len_net = htonl((uint32_t)strlen(ack));
-                writen(client_fd, &ack_len_net, sizeof(ack_len_net)); // tamaño mensaje
-                writen(client_fd, ack, strlen(ack)); // mensaje
-            }
+    /* SEMÁFORO VERDE */
 
-            // Si no se pudo guardar el registro
-            else {
-                const char *err = "ERROR: no se pudo guardar el registro";
-                uint32_t err_len_net = htonl((uint32_t)strlen(err));
-                writen(client_fd, &err_len_net, sizeof(err_len_net)); // enviar tamaño mensaje
-                writen(client_fd, err, strlen(err)); // enviar mensaje
-            }
+    // Señalizamos al cliente (post) para que sepa que el servidor está listo
+    if (sem_post(sem) < 0) perror("sem_post");
 
-        }
-        
-        /* COMANDO DESCONOCIDO */
-        else {
-            printf("Comando desconocido (%u) para '%s'\n", cmd, buf);
-        }
-      
-        free(buf);
-        close(client_fd);
-    }
+    evloop_run(&g_loop);
 
+    pool_destroy(&g_pool);
     return 0;
 }
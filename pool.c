@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+static double secs_between(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static void *pool_worker(void *arg) {
+    PoolWorker *w = arg;
+    ThreadPool *p = w->pool;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->count == 0 && !p->stopping) pthread_cond_wait(&p->not_empty, &p->lock);
+        if (p->count == 0) break;   // stopping y sin tareas pendientes
+
+        void *task = p->queue[p->head];
+        p->head = (p->head + 1) % p->cap;
+        p->count--;
+        w->busy = 1;
+        clock_gettime(CLOCK_MONOTONIC, &w->busy_since);
+        pthread_cond_signal(&p->not_full);
+        pthread_mutex_unlock(&p->lock);
+
+        p->fn(task, w->id, p->arg);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        pthread_mutex_lock(&p->lock);
+        w->busy = 0;
+        w->busy_secs += secs_between(&w->busy_since, &now);
+        w->tasks++;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+// Arranca workers hilos con una cola de queue_cap tareas. Devuelve 0, o -1
+// si no se pudo crear ninguno.
+int pool_init(ThreadPool *p, int workers, int queue_cap, PoolFn fn, void *arg) {
+    memset(p, 0, sizeof(*p));
+    if (workers < 1) workers = 1;
+    if (queue_cap < 1) queue_cap = 1;
+    p->queue = malloc(sizeof(void *) * (size_t)queue_cap);
+    p->workers = calloc((size_t)workers, sizeof(PoolWorker));
+    if (!p->queue || !p->workers) {
+        free(p->queue);
+        free(p->workers);
+        return -1;
+    }
+    p->cap = queue_cap;
+    p->fn = fn;
+    p->arg = arg;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->not_empty, NULL);
+    pthread_cond_init(&p->not_full, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &p->started);
+
+    for (int i = 0; i < workers; i++) {
+        PoolWorker *w = &p->workers[p->n_workers];
+        w->pool = p;
+        w->id = p->n_workers;
+        if (pthread_create(&w->tid, NULL, pool_worker, w) != 0) {
+            perror("pthread_create");
+            break;
+        }
+        p->n_workers++;
+    }
+    if (p->n_workers == 0) {
+        pool_destroy(p);
+        return -1;
+    }
+    return 0;
+}
+
+static void enqueue_locked(ThreadPool *p, void *task) {
+    p->queue[(p->head + p->count) % p->cap] = task;
+    p->count++;
+    if (p->count > p->max_count) p->max_count = p->count;
+    p->submitted++;
+    pthread_cond_signal(&p->not_empty);
+}
+
+// Encola una tarea; espera mientras la cola está llena. Devuelve -1 si el
+// pool se está cerrando.
+int pool_submit(ThreadPool *p, void *task) {
+    pthread_mutex_lock(&p->lock);
+    while (p->count == p->cap && !p->stopping) pthread_cond_wait(&p->not_full, &p->lock);
+    if (p->stopping) {
+        pthread_mutex_unlock(&p->lock);
+        return -1;
+    }
+    enqueue_locked(p, task);
+    pthread_mutex_unlock(&p->lock);
+    return 0;
+}
+
+// Como pool_submit pero sin esperar: devuelve -1 si la cola está llena (o
+// el pool se está cerrando).
+int pool_try_submit(ThreadPool *p, void *task) {
+    pthread_mutex_lock(&p->lock);
+    int ok = p->count < p->cap && !p->stopping;
+    if (ok) enqueue_locked(p, task);
+    pthread_mutex_unlock(&p->lock);
+    return ok ? 0 : -1;
+}
+
+// Copia los contadores del pool en s y los de cada hilo en w (que debe
+// tener lugar para p->n_workers; puede ser NULL).
+void pool_stats(ThreadPool *p, PoolStats *s, PoolWorkerStats *w) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&p->lock);
+    memset(s, 0, sizeof(*s));
+    s->workers = p->n_workers;
+    s->queue_cap = p->cap;
+    s->queue_depth = p->count;
+    s->queue_max = p->max_count;
+    s->submitted = p->submitted;
+    s->uptime_secs = secs_between(&p->started, &now);
+    for (int i = 0; i < p->n_workers; i++) {
+        const PoolWorker *pw = &p->workers[i];
+        double busy = pw->busy_secs + (pw->busy ? secs_between(&pw->busy_since, &now) : 0.0);
+        s->busy_now += pw->busy;
+        s->completed += pw->tasks;
+        if (w) {
+            w[i].tasks = pw->tasks;
+            w[i].busy_secs = busy;
+            w[i].utilization = s->uptime_secs > 0 ? busy / s->uptime_secs : 0.0;
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Termina las tareas encoladas, espera a los hilos y libera el pool.
+void pool_destroy(ThreadPool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->stopping = 1;
+    pthread_cond_broadcast(&p->not_empty);
+    pthread_cond_broadcast(&p->not_full);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < p->n_workers; i++) pthread_join(p->workers[i].tid, NULL);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->not_empty);
+    pthread_cond_destroy(&p->not_full);
+    free(p->queue);
+    free(p->workers);
+    memset(p, 0, sizeof(*p));
+}
@@ -0,0 +1,67 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <time.h>
+
+/* Pool de hilos de tamaño fijo con una cola acotada de tareas.
+   Cada tarea es un puntero que el hilo que la toma le pasa a fn junto con
+   su número de hilo. pool_submit se bloquea mientras la cola está llena:
+   así la cola no crece sin límite y lo que sobra espera afuera.
+   pool_try_submit no espera, para quien no puede bloquearse (el bucle de
+   eventos del servidor deja esas peticiones en su propia cola).
+   Cuenta, para diagnóstico, la profundidad de la cola y cuánto tiempo
+   pasa ocupado cada hilo. */
+
+typedef void (*PoolFn)(void *task, int worker, void *arg);
+
+typedef struct ThreadPool ThreadPool;
+
+typedef struct {
+    ThreadPool *pool;
+    int id;
+    pthread_t tid;
+    long tasks;                 /* tareas terminadas */
+    double busy_secs;           /* tiempo en tareas terminadas */
+    int busy;                   /* atendiendo una tarea ahora */
+    struct timespec busy_since;
+} PoolWorker;
+
+struct ThreadPool {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+    void **queue;               /* circular: count tareas desde head */
+    int cap, head, count;
+    int max_count;              /* mayor profundidad vista */
+    long submitted;
+    int stopping;
+
+    PoolWorker *workers;
+    int n_workers;
+    PoolFn fn;
+    void *arg;
+    struct timespec started;
+};
+
+/* Foto de los contadores (pool_stats) */
+typedef struct {
+    int workers;
+    int queue_cap, queue_depth, queue_max;
+    int busy_now;               /* hilos atendiendo una tarea en este momento */
+    long submitted, completed;
+    double uptime_secs;
+} PoolStats;
+
+typedef struct {
+    long tasks;
+    double busy_secs;           /* incluye la tarea en curso */
+    double utilization;         /* busy_secs / uptime, de 0 a 1 */
+} PoolWorkerStats;
+
+int  pool_init(ThreadPool *p, int workers, int queue_cap, PoolFn fn, void *arg);
+int  pool_submit(ThreadPool *p, void *task);
+int  pool_try_submit(ThreadPool *p, void *task);
+void pool_stats(ThreadPool *p, PoolStats *s, PoolWorkerStats *w);
+void pool_destroy(ThreadPool *p);
+
+#endif
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+#include "postings.h"
+
+// --- Construcción ---
+
+static int put_varint(PostingWriter *w, unsigned int v) {
+    if (w->len + 5 > w->cap) {
+        size_t ncap = w->cap ? w->cap * 2 : 16;
+        unsigned char *nb = realloc(w->bytes, ncap);
+        if (!nb) return -1;
+        w->bytes = nb;
+        w->cap = ncap;
+    }
+    while (v >= 0x80) {
+        w->bytes[w->len++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    w->bytes[w->len++] = (unsigned char)v;
+    return 0;
+}
+
+int postings_add(PostingWriter *w, unsigned int doc, int with_tf, unsigned int tf) {
+    if (w->count > 0 && w->count % POSTINGS_BLOCK == 0) {
+        if (w->n_skips == w->skip_cap) {
+            long ncap = w->skip_cap ? w->skip_cap * 2 : 4;
+            PostingSkip *ns = realloc(w->skips, sizeof(PostingSkip) * ncap);
+            if (!ns) return -1;
+            w->skips = ns;
+            w->skip_cap = ncap;
+        }
+        w->skips[w->n_skips].doc = w->last;
+        w->skips[w->n_skips].pos = (unsigned int)w->len;
+        w->n_skips++;
+    }
+    if (put_varint(w, doc - w->last) != 0) return -1;
+    if (with_tf && put_varint(w, tf) != 0) return -1;
+    w->last = doc;
+    w->count++;
+    return 0;
+}
+
+size_t postings_size(const PostingWriter *w) {
+    return sizeof(PostingSkip) * (size_t)w->n_skips + w->len;
+}
+
+void postings_write(const PostingWriter *w, unsigned char *dst) {
+    memcpy(dst, w->skips, sizeof(PostingSkip) * (size_t)w->n_skips);
+    memcpy(dst + sizeof(PostingSkip) * (size_t)w->n_skips, w->bytes, w->len);
+}
+
+void postings_free(PostingWriter *w) {
+    free(w->bytes);
+    free(w->skips);
+    memset(w, 0, sizeof(*w));
+}
+
+// --- Recorrido ---
+
+void postings_open(PostingCursor *c, const unsigned char *list, long count, long n_skips,
+                   size_t bytes, int with_tf) {
+    c->skips = (const PostingSkip *)list;
+    c->n_skips = n_skips;
+    c->data = list + sizeof(PostingSkip) * (size_t)n_skips;
+    c->bytes = bytes;
+    c->count = count;
+    c->with_tf = with_tf;
+    c->index = -1;
+    c->pos = 0;
+    c->doc = 0;
+    c->tf = 0;
+}
+
+// Recorre una lista todavía en construcción (sin serializar).
+void postings_open_writer(PostingCursor *c, const PostingWriter *w, int with_tf) {
+    c->skips = w->skips;
+    c->n_skips = w->n_skips;
+    c->data = w->bytes;
+    c->bytes = w->len;
+    c->count = w->count;
+    c->with_tf = with_tf;
+    c->index = -1;
+    c->pos = 0;
+    c->doc = 0;
+    c->tf = 0;
+}
+
+static int get_varint(PostingCursor *c, unsigned int *v) {
+    unsigned int x = 0;
+    for (int shift = 0; shift < 35 && c->pos < c->bytes; shift += 7) {
+        unsigned char b = c->data[c->pos++];
+        x |= (unsigned int)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = x;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Pasa al siguiente documento. Devuelve 1 si hay, 0 al terminar la lista.
+int postings_next(PostingCursor *c) {
+    unsigned int delta, tf = 0;
+    if (c->index + 1 >= c->count ||
+        get_varint(c, &delta) != 0 ||
+        (c->with_tf && get_varint(c, &tf) != 0)) {
+        c->index = c->count;
+        return 0;
+    }
+    c->doc += delta;
+    c->tf = tf;
+    c->index++;
+    return 1;
+}
+
+// Se para en el primer documento >= target. Con los saltos se descartan
+// bloques enteros (búsqueda binaria) y solo se decodifica el último.
+int postings_advance(PostingCursor *c, unsigned int target) {
+    if (c->index >= c->count) return 0;
+    if (c->index >= 0 && c->doc >= target) return 1;
+
+    // El salto i lleva al comienzo del bloque i + 1
+    long lo = (c->index + 1) / POSTINGS_BLOCK, hi = c->n_skips, best = -1;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (c->skips[mid].doc < target) { best = mid; lo = mid + 1; }
+        else hi = mid;
+    }
+    if (best >= 0) {
+        c->index = (best + 1) * POSTINGS_BLOCK - 1;
+        c->doc = c->skips[best].doc;
+        c->pos = c->skips[best].pos;
+    }
+    while (postings_next(c)) {
+        if (c->doc >= target) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <stddef.h>
+
+/* Listas de documentos comprimidas (compartidas por los índices de palabras).
+   Los documentos van crecientes y se guardan como diferencias en varint
+   (7 bits por byte), opcionalmente seguidas de la frecuencia tf. Cada
+   POSTINGS_BLOCK documentos hay un salto {último doc del bloque, byte donde
+   empieza el siguiente}, así avanzar a un documento lejano no decodifica
+   todo lo anterior.
+
+   En disco una lista es: PostingSkip[n_skips] seguido de los bytes. */
+#define POSTINGS_BLOCK 128
+
+typedef struct {
+    unsigned int doc;       /* último documento del bloque anterior */
+    unsigned int pos;       /* byte donde empieza el bloque */
+} PostingSkip;
+
+/* Construcción en memoria (documentos agregados en orden creciente) */
+typedef struct {
+    unsigned char *bytes;
+    size_t len, cap;
+    PostingSkip *skips;
+    long n_skips, skip_cap;
+    long count;
+    unsigned int last;
+} PostingWriter;
+
+int    postings_add(PostingWriter *w, unsigned int doc, int with_tf, unsigned int tf);
+size_t postings_size(const PostingWriter *w);
+void   postings_write(const PostingWriter *w, unsigned char *dst);
+void   postings_free(PostingWriter *w);
+
+/* Recorrido de una lista en disco (o mapeada) */
+typedef struct {
+    const PostingSkip *skips;
+    long n_skips;
+    const unsigned char *data;
+    size_t bytes;
+    long count;
+    int with_tf;
+
+    long index;             /* posición del documento actual (count al terminar) */
+    size_t pos;             /* byte del próximo documento */
+    unsigned int doc, tf;
+} PostingCursor;
+
+void postings_open(PostingCursor *c, const unsigned char *list, long count, long n_skips,
+                   size_t bytes, int with_tf);
+void postings_open_writer(PostingCursor *c, const PostingWriter *w, int with_tf);
+int  postings_next(PostingCursor *c);
+int  postings_advance(PostingCursor *c, unsigned int target);
+
+#endif
@@ -0,0 +1,464 @@
+#include <stdlib.h>
+#include <string.h>
+#include "roaring.h"
+
+// --- Contenedores ---
+
+static void container_free(RoaringContainer *c) {
+    free(c->values);
+    free(c->words);
+    c->values = NULL;
+    c->words = NULL;
+}
+
+// Deja c como mapa de bits con los mismos valores.
+static int container_to_bitmap(RoaringContainer *c) {
+    unsigned long long *words = calloc(ROARING_BITMAP_WORDS, sizeof(unsigned long long));
+    if (!words) return -1;
+    for (unsigned int i = 0; i < c->card; i++)
+        words[c->values[i] >> 6] |= 1ULL << (c->values[i] & 63);
+    free(c->values);
+    c->values = NULL;
+    c->cap = 0;
+    c->words = words;
+    c->type = ROARING_BITMAP;
+    return 0;
+}
+
+// Deja c como arreglo (solo si card <= ROARING_ARRAY_MAX).
+static int container_to_array(RoaringContainer *c) {
+    unsigned short *values = malloc(sizeof(unsigned short) * (c->card ? c->card : 1));
+    if (!values) return -1;
+    unsigned int n = 0;
+    for (int w = 0; w < ROARING_BITMAP_WORDS; w++) {
+        for (unsigned long long bits = c->words[w]; bits; bits &= bits - 1)
+            values[n++] = (unsigned short)(w * 64 + __builtin_ctzll(bits));
+    }
+    free(c->words);
+    c->words = NULL;
+    c->values = values;
+    c->cap = c->card ? c->card : 1;
+    c->type = ROARING_ARRAY;
+    return 0;
+}
+
+// Mantiene la regla: arreglo hasta ROARING_ARRAY_MAX valores, mapa por encima.
+static int container_normalize(RoaringContainer *c) {
+    if (c->type == ROARING_BITMAP && c->card <= ROARING_ARRAY_MAX) return container_to_array(c);
+    if (c->type == ROARING_ARRAY && c->card > ROARING_ARRAY_MAX) return container_to_bitmap(c);
+    return 0;
+}
+
+static int container_contains(const RoaringContainer *c, unsigned short low) {
+    if (c->type == ROARING_BITMAP) return (c->words[low >> 6] >> (low & 63)) & 1;
+    unsigned int lo = 0, hi = c->card;
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        if (c->values[mid] < low) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < c->card && c->values[lo] == low;
+}
+
+static int container_add(RoaringContainer *c, unsigned short low) {
+    if (c->type == ROARING_BITMAP) {
+        unsigned long long bit = 1ULL << (low & 63);
+        if (!(c->words[low >> 6] & bit)) {
+            c->words[low >> 6] |= bit;
+            c->card++;
+        }
+        return 0;
+    }
+
+    // Posición en el arreglo; lo común es agregar al final (documentos en orden)
+    unsigned int pos = c->card;
+    if (c->card > 0 && c->values[c->card - 1] >= low) {
+        unsigned int lo = 0, hi = c->card;
+        while (lo < hi) {
+            unsigned int mid = (lo + hi) / 2;
+            if (c->values[mid] < low) lo = mid + 1;
+            else hi = mid;
+        }
+        if (c->values[lo] == low) return 0;
+        pos = lo;
+    }
+
+    if (c->card == ROARING_ARRAY_MAX) {
+        if (container_to_bitmap(c) != 0) return -1;
+        return container_add(c, low);
+    }
+    if (c->card == c->cap) {
+        unsigned int new_cap = c->cap ? c->cap * 2 : 4;
+        if (new_cap > ROARING_ARRAY_MAX) new_cap = ROARING_ARRAY_MAX;
+        unsigned short *tmp = realloc(c->values, sizeof(unsigned short) * new_cap);
+        if (!tmp) return -1;
+        c->values = tmp;
+        c->cap = new_cap;
+    }
+    memmove(c->values + pos + 1, c->values + pos, sizeof(unsigned short) * (c->card - pos));
+    c->values[pos] = low;
+    c->card++;
+    return 0;
+}
+
+// Posición del primer elemento >= x en v[from..n), avanzando a saltos
+// crecientes (galloping): barato cuando un arreglo es mucho más chico que el otro.
+static unsigned int gallop(const unsigned short *v, unsigned int from, unsigned int n, unsigned short x) {
+    unsigned int step = 1, lo = from, hi = from;
+    while (hi < n && v[hi] < x) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > n) hi = n;
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        if (v[mid] < x) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// out = a AND b (mismo key). out queda vacío (card 0) si no hay valores en común.
+static int container_and(const RoaringContainer *a, const RoaringContainer *b, RoaringContainer *out) {
+    memset(out, 0, sizeof(*out));
+    out->key = a->key;
+
+    if (a->type == ROARING_BITMAP && b->type == ROARING_BITMAP) {
+        out->words = malloc(sizeof(unsigned long long) * ROARING_BITMAP_WORDS);
+        if (!out->words) return -1;
+        out->type = ROARING_BITMAP;
+        for (int w = 0; w < ROARING_BITMAP_WORDS; w++) {
+            out->words[w] = a->words[w] & b->words[w];
+            out->card += (unsigned int)__builtin_popcountll(out->words[w]);
+        }
+        return container_normalize(out);
+    }
+
+    // Al menos uno es arreglo: el resultado cabe en el más chico
+    if (a->type == ROARING_BITMAP || (b->type == ROARING_ARRAY && b->card < a->card)) {
+        const RoaringContainer *t = a;
+        a = b;
+        b = t;
+    }
+    out->type = ROARING_ARRAY;
+    out->values = malloc(sizeof(unsigned short) * (a->card ? a->card : 1));
+    if (!out->values) return -1;
+    out->cap = a->card ? a->card : 1;
+
+    if (b->type == ROARING_BITMAP) {
+        for (unsigned int i = 0; i < a->card; i++)
+            if ((b->words[a->values[i] >> 6] >> (a->values[i] & 63)) & 1) out->values[out->card++] = a->values[i];
+    } else if (a->card * 32 < b->card) {
+        for (unsigned int i = 0, j = 0; i < a->card && j < b->card; i++) {
+            j = gallop(b->values, j, b->card, a->values[i]);
+            if (j < b->card && b->values[j] == a->values[i]) out->values[out->card++] = a->values[i];
+        }
+    } else {
+        unsigned int i = 0, j = 0;
+        while (i < a->card && j < b->card) {
+            if (a->values[i] < b->values[j]) i++;
+            else if (a->values[i] > b->values[j]) j++;
+            else { out->values[out->card++] = a->values[i]; i++; j++; }
+        }
+    }
+    return 0;
+}
+
+// |a AND b| (mismo key), sin armar el contenedor.
+static long container_and_card(const RoaringContainer *a, const RoaringContainer *b) {
+    long n = 0;
+    if (a->type == ROARING_BITMAP && b->type == ROARING_BITMAP) {
+        for (int w = 0; w < ROARING_BITMAP_WORDS; w++) n += __builtin_popcountll(a->words[w] & b->words[w]);
+        return n;
+    }
+    if (a->type == ROARING_BITMAP || (b->type == ROARING_ARRAY && b->card < a->card)) {
+        const RoaringContainer *t = a;
+        a = b;
+        b = t;
+    }
+    if (b->type == ROARING_BITMAP) {
+        for (unsigned int i = 0; i < a->card; i++)
+            n += (b->words[a->values[i] >> 6] >> (a->values[i] & 63)) & 1;
+    } else {
+        for (unsigned int i = 0, j = 0; i < a->card && j < b->card; i++) {
+            j = gallop(b->values, j, b->card, a->values[i]);
+            n += j < b->card && b->values[j] == a->values[i];
+        }
+    }
+    return n;
+}
+
+// out = a OR b (mismo key).
+static int container_or(const RoaringContainer *a, const RoaringContainer *b, RoaringContainer *out) {
+    memset(out, 0, sizeof(*out));
+    out->key = a->key;
+
+    if (a->type == ROARING_ARRAY && b->type == ROARING_ARRAY && a->card + b->card <= ROARING_ARRAY_MAX) {
+        out->type = ROARING_ARRAY;
+        out->cap = a->card + b->card ? a->card + b->card : 1;
+        out->values = malloc(sizeof(unsigned short) * out->cap);
+        if (!out->values) return -1;
+        unsigned int i = 0, j = 0;
+        while (i < a->card || j < b->card) {
+            if (j == b->card || (i < a->card && a->values[i] < b->values[j])) out->values[out->card++] = a->values[i++];
+            else if (i == a->card || b->values[j] < a->values[i]) out->values[out->card++] = b->values[j++];
+            else { out->values[out->card++] = a->values[i]; i++; j++; }
+        }
+        return 0;
+    }
+
+    out->type = ROARING_BITMAP;
+    out->words = calloc(ROARING_BITMAP_WORDS, sizeof(unsigned long long));
+    if (!out->words) return -1;
+    const RoaringContainer *src[2] = { a, b };
+    for (int s = 0; s < 2; s++) {
+        if (src[s]->type == ROARING_BITMAP) {
+            for (int w = 0; w < ROARING_BITMAP_WORDS; w++) out->words[w] |= src[s]->words[w];
+        } else {
+            for (unsigned int i = 0; i < src[s]->card; i++)
+                out->words[src[s]->values[i] >> 6] |= 1ULL << (src[s]->values[i] & 63);
+        }
+    }
+    for (int w = 0; w < ROARING_BITMAP_WORDS; w++) out->card += (unsigned int)__builtin_popcountll(out->words[w]);
+    return container_normalize(out);
+}
+
+static int container_copy(const RoaringContainer *src, RoaringContainer *out) {
+    *out = *src;
+    out->values = NULL;
+    out->words = NULL;
+    if (src->type == ROARING_BITMAP) {
+        out->words = malloc(sizeof(unsigned long long) * ROARING_BITMAP_WORDS);
+        if (!out->words) return -1;
+        memcpy(out->words, src->words, sizeof(unsigned long long) * ROARING_BITMAP_WORDS);
+    } else {
+        out->cap = src->card ? src->card : 1;
+        out->values = malloc(sizeof(unsigned short) * out->cap);
+        if (!out->values) return -1;
+        memcpy(out->values, src->values, sizeof(unsigned short) * src->card);
+    }
+    return 0;
+}
+
+// --- Conjuntos ---
+
+void roaring_init(Roaring *r) {
+    r->c = NULL;
+    r->n = r->cap = 0;
+}
+
+void roaring_free(Roaring *r) {
+    for (int i = 0; i < r->n; i++) container_free(&r->c[i]);
+    free(r->c);
+    roaring_init(r);
+}
+
+// Agrega el contenedor c (ya armado) al final de r; los keys deben venir crecientes.
+static int push_container(Roaring *r, RoaringContainer *c) {
+    if (r->n == r->cap) {
+        int new_cap = r->cap ? r->cap * 2 : 4;
+        RoaringContainer *tmp = realloc(r->c, sizeof(RoaringContainer) * new_cap);
+        if (!tmp) return -1;
+        r->c = tmp;
+        r->cap = new_cap;
+    }
+    r->c[r->n++] = *c;
+    return 0;
+}
+
+// Índice del contenedor con ese key, o -(posición donde iría) - 1.
+static int find_container(const Roaring *r, unsigned short key) {
+    if (r->n > 0 && r->c[r->n - 1].key == key) return r->n - 1;
+    int lo = 0, hi = r->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (r->c[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < r->n && r->c[lo].key == key ? lo : -lo - 1;
+}
+
+int roaring_add(Roaring *r, unsigned int value) {
+    unsigned short key = (unsigned short)(value >> 16);
+    int i = find_container(r, key);
+    if (i < 0) {
+        RoaringContainer c = { .key = key, .type = ROARING_ARRAY };
+        if (push_container(r, &c) != 0) return -1;
+        i = -i - 1;
+        memmove(r->c + i + 1, r->c + i, sizeof(RoaringContainer) * (r->n - 1 - i));
+        r->c[i] = c;
+    }
+    return container_add(&r->c[i], (unsigned short)(value & 0xffff));
+}
+
+int roaring_contains(const Roaring *r, unsigned int value) {
+    int i = find_container(r, (unsigned short)(value >> 16));
+    return i >= 0 && container_contains(&r->c[i], (unsigned short)(value & 0xffff));
+}
+
+long roaring_cardinality(const Roaring *r) {
+    long n = 0;
+    for (int i = 0; i < r->n; i++) n += r->c[i].card;
+    return n;
+}
+
+// out = a AND b. Solo se cruzan los contenedores con el mismo key.
+int roaring_and(const Roaring *a, const Roaring *b, Roaring *out) {
+    roaring_init(out);
+    for (int i = 0, j = 0; i < a->n && j < b->n; ) {
+        if (a->c[i].key < b->c[j].key) { i++; continue; }
+        if (a->c[i].key > b->c[j].key) { j++; continue; }
+        RoaringContainer c;
+        if (container_and(&a->c[i], &b->c[j], &c) != 0) {
+            container_free(&c);
+            roaring_free(out);
+            return -1;
+        }
+        if (c.card == 0) container_free(&c);
+        else if (push_container(out, &c) != 0) {
+            container_free(&c);
+            roaring_free(out);
+            return -1;
+        }
+        i++;
+        j++;
+    }
+    return 0;
+}
+
+// |a AND b|: para contar sin guardar la intersección.
+long roaring_and_cardinality(const Roaring *a, const Roaring *b) {
+    long n = 0;
+    for (int i = 0, j = 0; i < a->n && j < b->n; ) {
+        if (a->c[i].key < b->c[j].key) i++;
+        else if (a->c[i].key > b->c[j].key) j++;
+        else n += container_and_card(&a->c[i++], &b->c[j++]);
+    }
+    return n;
+}
+
+// out = a OR b.
+int roaring_or(const Roaring *a, const Roaring *b, Roaring *out) {
+    roaring_init(out);
+    for (int i = 0, j = 0; i < a->n || j < b->n; ) {
+        RoaringContainer c;
+        int rc;
+        if (j == b->n || (i < a->n && a->c[i].key < b->c[j].key)) rc = container_copy(&a->c[i++], &c);
+        else if (i == a->n || b->c[j].key < a->c[i].key) rc = container_copy(&b->c[j++], &c);
+        else rc = container_or(&a->c[i++], &b->c[j++], &c);
+
+        if (rc != 0 || push_container(out, &c) != 0) {
+            container_free(&c);
+            roaring_free(out);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int roaring_copy(const Roaring *src, Roaring *out) {
+    roaring_init(out);
+    for (int i = 0; i < src->n; i++) {
+        RoaringContainer c;
+        if (container_copy(&src->c[i], &c) != 0 || push_container(out, &c) != 0) {
+            container_free(&c);
+            roaring_free(out);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Recorre los valores en orden creciente. Devuelve 1 si fn cortó el recorrido.
+int roaring_iterate(const Roaring *r, RoaringFn fn, void *arg) {
+    for (int i = 0; i < r->n; i++) {
+        const RoaringContainer *c = &r->c[i];
+        unsigned int high = (unsigned int)c->key << 16;
+        if (c->type == ROARING_ARRAY) {
+            for (unsigned int k = 0; k < c->card; k++)
+                if (fn(high | c->values[k], arg)) return 1;
+        } else {
+            for (int w = 0; w < ROARING_BITMAP_WORDS; w++) {
+                for (unsigned long long bits = c->words[w]; bits; bits &= bits - 1)
+                    if (fn(high | (unsigned int)(w * 64 + __builtin_ctzll(bits)), arg)) return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// --- Serialización ---
+
+static size_t container_data_size(const RoaringContainer *c) {
+    return c->type == ROARING_BITMAP ? sizeof(unsigned long long) * ROARING_BITMAP_WORDS
+                                     : sizeof(unsigned short) * c->card;
+}
+
+// Bytes que ocupa r serializado.
+size_t roaring_size(const Roaring *r) {
+    size_t size = sizeof(unsigned int) + sizeof(RoaringContainerDisk) * r->n;
+    for (int i = 0; i < r->n; i++) size += container_data_size(&r->c[i]);
+    return size;
+}
+
+// Serializa r en out (de roaring_size(r) bytes).
+int roaring_write(const Roaring *r, unsigned char *out) {
+    unsigned int n = (unsigned int)r->n;
+    memcpy(out, &n, sizeof(n));
+    unsigned char *dir = out + sizeof(n);
+    unsigned char *data = dir + sizeof(RoaringContainerDisk) * r->n;
+    for (int i = 0; i < r->n; i++) {
+        const RoaringContainer *c = &r->c[i];
+        RoaringContainerDisk d = { c->key, c->type, c->card };
+        memcpy(dir + sizeof(d) * i, &d, sizeof(d));
+        size_t len = container_data_size(c);
+        memcpy(data, c->type == ROARING_BITMAP ? (const void *)c->words : (const void *)c->values, len);
+        data += len;
+    }
+    return 0;
+}
+
+// Lee en r (inicializado por esta función) un conjunto serializado con
+// roaring_write. Los datos se copian: buf puede liberarse después.
+int roaring_read(Roaring *r, const unsigned char *buf, size_t size) {
+    roaring_init(r);
+    unsigned int n;
+    if (size < sizeof(n)) return -1;
+    memcpy(&n, buf, sizeof(n));
+    if ((size - sizeof(n)) / sizeof(RoaringContainerDisk) < n) return -1;
+
+    const unsigned char *data = buf + sizeof(n) + sizeof(RoaringContainerDisk) * n;
+    const unsigned char *end = buf + size;
+    for (unsigned int i = 0; i < n; i++) {
+        RoaringContainerDisk d;
+        memcpy(&d, buf + sizeof(n) + sizeof(d) * i, sizeof(d));
+        RoaringContainer c = { .key = d.key, .type = d.type, .card = d.card };
+        size_t len = container_data_size(&c);
+        if ((d.type != ROARING_ARRAY && d.type != ROARING_BITMAP) ||
+            (d.type == ROARING_ARRAY && d.card > ROARING_ARRAY_MAX) ||
+            (size_t)(end - data) < len) {
+            roaring_free(r);
+            return -1;
+        }
+
+        void *copy = malloc(len ? len : 1);
+        if (!copy) {
+            roaring_free(r);
+            return -1;
+        }
+        memcpy(copy, data, len);
+        if (d.type == ROARING_BITMAP) c.words = copy;
+        else {
+            c.values = copy;
+            c.cap = d.card ? d.card : 1;
+        }
+        if (push_container(r, &c) != 0) {
+            container_free(&c);
+            roaring_free(r);
+            return -1;
+        }
+        data += len;
+    }
+    return 0;
+}
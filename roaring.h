@@ -0,0 +1,62 @@
+#ifndef ROARING_H
+#define ROARING_H
+
+#include <stddef.h>
+
+/* Conjunto comprimido de números de documento (unsigned de 32 bits), al
+   estilo roaring: los valores se agrupan por sus 16 bits altos y cada grupo
+   es un contenedor con los 16 bits bajos, guardado como
+     - arreglo ordenado de unsigned short, mientras tenga <= 4096 valores, o
+     - mapa de bits de 65536 bits (8 KB), cuando tiene más.
+   (Sin contenedores de corridas: los números de documento de una categoría
+   no suelen venir en tramos contiguos.)
+
+   Serializado (roaring_write / roaring_read):
+     unsigned n_containers
+     RoaringContainerDisk[n_containers]      ordenados por key
+     datos de cada contenedor, en el mismo orden
+       (card unsigned short si es arreglo, 1024 unsigned long long si es mapa) */
+
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_BITMAP_WORDS 1024
+
+enum { ROARING_ARRAY = 0, ROARING_BITMAP = 1 };
+
+typedef struct {
+    unsigned short key;         /* 16 bits altos */
+    unsigned short type;        /* ROARING_ARRAY o ROARING_BITMAP */
+    unsigned int card;
+} RoaringContainerDisk;
+
+typedef struct {
+    unsigned short key;
+    unsigned short type;
+    unsigned int card;
+    unsigned int cap;           /* capacidad de values (solo arreglos) */
+    unsigned short *values;     /* ROARING_ARRAY */
+    unsigned long long *words;  /* ROARING_BITMAP */
+} RoaringContainer;
+
+typedef struct {
+    RoaringContainer *c;        /* ordenados por key */
+    int n, cap;
+} Roaring;
+
+/* Se llama con cada valor, en orden creciente; devolver != 0 corta el recorrido. */
+typedef int (*RoaringFn)(unsigned int value, void *arg);
+
+void   roaring_init(Roaring *r);
+void   roaring_free(Roaring *r);
+int    roaring_add(Roaring *r, unsigned int value);
+int    roaring_contains(const Roaring *r, unsigned int value);
+long   roaring_cardinality(const Roaring *r);
+int    roaring_and(const Roaring *a, const Roaring *b, Roaring *out);
+long   roaring_and_cardinality(const Roaring *a, const Roaring *b);
+int    roaring_or(const Roaring *a, const Roaring *b, Roaring *out);
+int    roaring_copy(const Roaring *src, Roaring *out);
+int    roaring_iterate(const Roaring *r, RoaringFn fn, void *arg);
+size_t roaring_size(const Roaring *r);
+int    roaring_write(const Roaring *r, unsigned char *out);
+int    roaring_read(Roaring *r, const unsigned char *buf, size_t size);
+
+#endif
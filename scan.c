@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "csv.h"
+#include "strsearch.h"
+#include "scan.h"
+
+// --- Trozos ---
+
+typedef struct {
+    long *offsets;
+    long n, cap;
+    int failed;
+} ChunkMatches;
+
+typedef struct {
+    const ScanQuery *q;
+    char *lower;            /* aguja en minúsculas */
+    size_t lower_len;
+    long n_chunks;
+    ChunkMatches *chunks;
+    unsigned char *done;
+
+    pthread_mutex_t lock;
+    long next;              /* próximo trozo a tomar */
+    long stop;              /* no se toman trozos >= stop */
+    long prefix;            /* trozos [0, prefix) terminados */
+    long prefix_matches;    /* coincidencias en esos trozos */
+    long bytes;
+} ScanJob;
+
+static int push_match(ChunkMatches *c, long off) {
+    if (c->n == c->cap) {
+        long new_cap = c->cap ? c->cap * 2 : 64;
+        long *tmp = realloc(c->offsets, sizeof(long) * new_cap);
+        if (!tmp) { c->failed = 1; return -1; }
+        c->offsets = tmp;
+        c->cap = new_cap;
+    }
+    c->offsets[c->n++] = off;
+    return 0;
+}
+
+// Busca en los registros que empiezan dentro del trozo k. Devuelve los bytes recorridos.
+static long scan_chunk(ScanJob *job, long k) {
+    const ScanQuery *q = job->q;
+    const char *base = q->base, *file_end = base + q->size;
+    ChunkMatches *out = &job->chunks[k];
+
+    // Primera línea que empieza en el trozo (la 0 es la cabecera)
+    const char *begin = base + k * SCAN_CHUNK;
+    const char *limit = base + ((k + 1) * SCAN_CHUNK < (long)q->size ? (k + 1) * SCAN_CHUNK : (long)q->size);
+    const char *nl = memchr(k == 0 ? begin : begin - 1, '\n', (size_t)(file_end - (k == 0 ? begin : begin - 1)));
+    const char *p = nl ? nl + 1 : file_end;
+    // La última línea que empieza antes de limit puede terminar más allá
+    const char *region_end = limit < file_end ? memchr(limit - 1, '\n', (size_t)(file_end - limit + 1)) : NULL;
+    if (!region_end) region_end = file_end;
+    long scanned = (long)(region_end - p);
+
+    // rec: inicio del registro en curso. Se avanza de registro en registro
+    // (csv_record_end respeta comillas) solo hasta cada acierto, así que lo
+    // que no tiene coincidencias no se tokeniza
+    const char *rec = p;
+    while (p < limit && out->n < q->limit) {
+        const char *hit = strsearch_ci(p, (size_t)(region_end - p), job->lower, job->lower_len);
+        if (!hit) break;
+
+        // Registro del acierto (puede empezar varias líneas antes)
+        const char *rec_end = csv_record_end(rec, file_end);
+        while (rec_end < hit) {
+            rec = rec_end + 1;
+            rec_end = csv_record_end(rec, file_end);
+        }
+        if (rec >= limit) break;
+
+        int match = 1;
+        if (q->column > 0) {
+            size_t len;
+            const char *field = csv_field_span(rec, rec_end, q->column, &len);
+            match = field && strsearch_ci(field, len, job->lower, job->lower_len) != NULL;
+        }
+        if (match && push_match(out, (long)(rec - base)) != 0) break;
+        p = rec = rec_end + 1;
+    }
+    return scanned > 0 ? scanned : 0;
+}
+
+static void *scan_worker(void *arg) {
+    ScanJob *job = arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        if (job->next >= job->stop) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        long k = job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        long bytes = scan_chunk(job, k);
+
+        // Se avanza el prefijo terminado; con limit coincidencias en él, el
+        // resto del archivo ya no cambia el resultado
+        pthread_mutex_lock(&job->lock);
+        job->done[k] = 1;
+        job->bytes += bytes;
+        while (job->prefix < job->n_chunks && job->done[job->prefix]) {
+            job->prefix_matches += job->chunks[job->prefix].n;
+            job->prefix++;
+            if (job->prefix_matches >= job->q->limit && job->stop > job->prefix) job->stop = job->prefix;
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+    return NULL;
+}
+
+// --- API ---
+
+// Número de columna (desde 1) a partir del nombre en la cabecera del CSV
+// ("abstract", "authors", ...) o de un número. Devuelve -1 si no existe.
+int scan_column_of(const char *base, size_t size, const char *name) {
+    char *end;
+    long n = strtol(name, &end, 10);
+    if (*name && *end == '\0') return n >= 0 && n < 1000 ? (int)n : -1;
+
+    const char *nl = memchr(base, '\n', size);
+    const char *line_end = nl ? nl : base + size;
+    size_t name_len = strlen(name);
+    for (int col = 1; col < 1000; col++) {
+        size_t len;
+        const char *field = csv_field_span(base, line_end, col, &len);
+        if (!field) break;
+        if (len == name_len && strncasecmp(field, name, len) == 0) return col;
+    }
+    return -1;
+}
+
+// Recorre el CSV con q->threads hilos y deja en out las primeras q->limit
+// líneas que coinciden, en orden del archivo. Devuelve 0, o -1 si falla.
+int scan_csv(const ScanQuery *q, ScanResult *out) {
+    memset(out, 0, sizeof(*out));
+    if (q->size == 0 || q->limit <= 0) return 0;
+
+    ScanJob job = { .q = q };
+    job.lower_len = strlen(q->needle);
+    job.lower = malloc(job.lower_len + 1);
+    job.n_chunks = ((long)q->size + SCAN_CHUNK - 1) / SCAN_CHUNK;
+    job.chunks = calloc((size_t)job.n_chunks, sizeof(ChunkMatches));
+    job.done = calloc((size_t)job.n_chunks, 1);
+    job.stop = job.n_chunks;
+    if (!job.lower || !job.chunks || !job.done) {
+        free(job.lower);
+        free(job.chunks);
+        free(job.done);
+        return -1;
+    }
+    for (size_t i = 0; i <= job.lower_len; i++) job.lower[i] = (char)tolower((unsigned char)q->needle[i]);
+    pthread_mutex_init(&job.lock, NULL);
+
+    int threads = q->threads > 0 ? q->threads : 1;
+    if (threads > job.n_chunks) threads = (int)job.n_chunks;
+    pthread_t *tids = malloc(sizeof(pthread_t) * (size_t)threads);
+    int started = 0;
+    for (int t = 0; tids && t < threads; t++) {
+        if (pthread_create(&tids[t], NULL, scan_worker, &job) != 0) break;
+        started++;
+    }
+    if (started == 0) scan_worker(&job);      // sin hilos: lo hace este
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    free(tids);
+
+    // Resultado: los trozos [0, stop) en orden, hasta limit
+    int failed = 0;
+    for (long k = 0; k < job.stop && !failed; k++) {
+        ChunkMatches *c = &job.chunks[k];
+        if (c->failed) failed = 1;
+        for (long i = 0; i < c->n && out->n < q->limit && !failed; i++) {
+            if (out->n % 64 == 0) {
+                long *tmp = realloc(out->offsets, sizeof(long) * (out->n + 64));
+                if (!tmp) { failed = 1; break; }
+                out->offsets = tmp;
+            }
+            out->offsets[out->n++] = c->offsets[i];
+        }
+    }
+    for (long k = 0; k < job.n_chunks; k++) out->chunks += job.done[k];
+    out->bytes = job.bytes;
+
+    for (long k = 0; k < job.n_chunks; k++) free(job.chunks[k].offsets);
+    free(job.chunks);
+    free(job.done);
+    free(job.lower);
+    pthread_mutex_destroy(&job.lock);
+    if (failed) scan_result_free(out);
+    return failed ? -1 : 0;
+}
+
+void scan_result_free(ScanResult *r) {
+    free(r->offsets);
+    memset(r, 0, sizeof(*r));
+}
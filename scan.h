@@ -0,0 +1,40 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+#define SCAN_CHUNK (4L << 20)       /* bytes del CSV por tarea */
+
+/* Búsqueda sin índice: recorre el CSV mapeado completo buscando una
+   subcadena (sin distinguir mayúsculas) en una columna.
+   El archivo se parte en trozos de SCAN_CHUNK bytes que los hilos van
+   tomando en orden; cada trozo procesa las líneas que empiezan en él. La
+   subcadena se busca en todo el trozo de una vez (strsearch.h, con SIMD) y
+   solo en cada acierto se ubica la línea y la columna.
+   Cuando los trozos ya terminados desde el principio juntan `limit`
+   coincidencias, los hilos dejan de tomar trozos nuevos.
+   Cada trozo empieza en la primera línea después de su corte y de ahí en
+   adelante sigue los registros con csv_record_end (un registro puede
+   ocupar varias líneas); un registro de varias líneas que cruza el corte
+   entre dos trozos no se reconoce. */
+typedef struct {
+    const char *base;       /* CSV mapeado */
+    size_t size;
+    int column;             /* 1.. (como csv_field_span); 0 = toda la línea */
+    const char *needle;
+    long limit;             /* coincidencias a devolver (las primeras del archivo) */
+    int threads;
+} ScanQuery;
+
+typedef struct {
+    long *offsets;          /* inicio de cada registro que coincide, en orden del archivo */
+    long n;
+    long chunks;            /* trozos recorridos */
+    long bytes;             /* bytes recorridos */
+} ScanResult;
+
+int  scan_column_of(const char *base, size_t size, const char *name);
+int  scan_csv(const ScanQuery *q, ScanResult *out);
+void scan_result_free(ScanResult *r);
+
+#endif
@@ -0,0 +1,39 @@
+/* slowsync.c
+ *
+ * Le agrega una demora fija a fsync y fdatasync, para medir las
+ * inserciones como en un disco donde sincronizar cuesta (en uno con caché
+ * de escritura un fsync tarda menos de 0,1 ms y no se ve qué ahorra el
+ * commit en grupo). Se carga en el servidor con LD_PRELOAD:
+ *   make slowsync.so
+ *   SLOWSYNC_US=2000 LD_PRELOAD=./slowsync.so ./p2-search
+ * SLOWSYNC_US es la demora en microsegundos (2000 si no está).
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static void delay(void) {
+    static long us = -1;
+    if (us < 0) {
+        const char *env = getenv("SLOWSYNC_US");
+        us = env ? atol(env) : 2000;
+    }
+    struct timespec t = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&t, NULL);
+}
+
+int fsync(int fd) {
+    static int (*real)(int);
+    if (!real) real = (int (*)(int))dlsym(RTLD_NEXT, "fsync");
+    delay();
+    return real(fd);
+}
+
+int fdatasync(int fd) {
+    static int (*real)(int);
+    if (!real) real = (int (*)(int))dlsym(RTLD_NEXT, "fdatasync");
+    delay();
+    return real(fd);
+}
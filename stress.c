@@ -0,0 +1,397 @@
+/* stress.c
+ *
+ * Prueba de carga de p2-search: búsquedas e inserciones concurrentes
+ * contra un servidor que ya está andando (protocolo versión 2, una
+ * conexión persistente por hilo).
+ *   make stress             (4 hilos de búsqueda, 2 de inserción, 10 s)
+ *   ./stress_client [busquedas] [inserciones] [segundos]
+ *
+ * Qué verifica:
+ *  - cada respuesta trae el id de su petición;
+ *  - las búsquedas (por id, título exacto, FIND, BM25 y prefijo, armadas
+ *    con el primer registro del CSV) devuelven siempre lo mismo que la
+ *    primera vez: lo insertado no coincide con ellas, así que una
+ *    respuesta distinta es una lectura rota mientras se inserta;
+ *  - cada inserción confirmada ("OK") se encuentra enseguida por id, doi
+ *    y título exacto, y de nuevo al final, con todo ya insertado.
+ * Termina con 0 si no hubo errores. Inserta de verdad en el dataset: se
+ * corre sobre una copia.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <time.h>
+#include <netinet/in.h>
+#include "common.h"
+#include "csv.h"
+
+#define CMD_FIND 1
+#define CMD_INSERT 2
+#define CMD_BM25 3
+#define CMD_PREFIX 4
+#define CMD_TITLE 5
+#define CMD_READIDX 6
+#define CMD_ID 7
+#define CMD_DOI 8
+#define CMD_HELLO 12
+
+#define REPLY_SZ (64 << 10)     // lo que no entra se descarta (igual en todas las repeticiones)
+#define N_QUERIES 5
+#define MAX_REPORTED 10         // errores que se muestran (se cuentan todos)
+
+typedef struct {
+    int sock;
+    uint32_t next_id;
+} Conn;
+
+typedef struct {
+    double *v;
+    long n, cap;
+} Latencies;
+
+typedef struct {
+    int k;                      // número de hilo (dentro de su tipo)
+    Latencies lat;
+    long ops, inserted, errors;
+} Worker;
+
+typedef struct {
+    int cmd;
+    char payload[512];
+    char *expected;             // primera respuesta
+} Query;
+
+static Query g_queries[N_QUERIES];
+static volatile int g_stop = 0;
+static long g_pid;
+static char g_date[16];
+static pthread_mutex_t g_report_lock = PTHREAD_MUTEX_INITIALIZER;
+static long g_reported = 0;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char *fmt, const char *a, const char *b) {
+    pthread_mutex_lock(&g_report_lock);
+    if (g_reported++ < MAX_REPORTED) {
+        fprintf(stderr, fmt, a, b);
+        fputc('\n', stderr);
+    }
+    pthread_mutex_unlock(&g_report_lock);
+}
+
+static void lat_add(Latencies *l, double secs) {
+    if (l->n == l->cap) {
+        long cap = l->cap ? l->cap * 2 : 1024;
+        double *v = realloc(l->v, sizeof(double) * cap);
+        if (!v) return;
+        l->v = v;
+        l->cap = cap;
+    }
+    l->v[l->n++] = secs;
+}
+
+// --- Conexión ---
+
+// Conecta y negocia la versión 2 (HELLO va con el formato de la versión 1).
+static int conn_open(Conn *c) {
+    c->next_id = 0;
+    c->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->sock < 0) return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_PORT);
+    inet_pton(AF_INET, SERVER_IP, &addr.sin_addr);
+    if (connect(c->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) goto fail;
+
+    uint32_t head[2] = { htonl(CMD_HELLO), htonl(1) };
+    uint32_t len;
+    char v;
+    if (writen(c->sock, head, sizeof(head)) != sizeof(head) || writen(c->sock, "2", 1) != 1 ||
+        readn(c->sock, &len, sizeof(len)) != sizeof(len) || ntohl(len) != 1 ||
+        readn(c->sock, &v, 1) != 1 || v != '2') {
+        errno = EPROTO;
+        goto fail;
+    }
+    return 0;
+
+fail:
+    close(c->sock);
+    c->sock = -1;
+    return -1;
+}
+
+// Una petición y su respuesta (terminada en '\0' y, si no entra, cortada).
+// Devuelve -1 si se corta la conexión o la respuesta no es de esta petición.
+static int call(Conn *c, int cmd, const char *payload, char *out, size_t outsz) {
+    uint32_t id = ++c->next_id, plen = (uint32_t)strlen(payload);
+    uint32_t head[3] = { htonl(cmd), htonl(id), htonl(plen) };
+    // Cabecera y payload en un solo write: en dos, Nagle retiene el payload
+    // hasta el ACK de la cabecera, que el server demora (~40 ms)
+    char *msg = malloc(sizeof(head) + plen);
+    if (!msg) return -1;
+    memcpy(msg, head, sizeof(head));
+    memcpy(msg + sizeof(head), payload, plen);
+    ssize_t sent = writen(c->sock, msg, sizeof(head) + plen);
+    free(msg);
+    if (sent != (ssize_t)(sizeof(head) + plen)) return -1;
+
+    uint32_t resp[2];
+    if (readn(c->sock, resp, sizeof(resp)) != sizeof(resp) || ntohl(resp[0]) != id) return -1;
+    uint32_t len = ntohl(resp[1]), keep = len < outsz ? len : (uint32_t)outsz - 1;
+    if (readn(c->sock, out, keep) != (ssize_t)keep) return -1;
+    out[keep] = '\0';
+    char skip[4096];
+    for (uint32_t left = len - keep; left > 0; ) {
+        size_t n = left < sizeof(skip) ? left : sizeof(skip);
+        if (readn(c->sock, skip, n) != (ssize_t)n) return -1;
+        left -= (uint32_t)n;
+    }
+    return 0;
+}
+
+// --- Búsquedas ---
+
+// Arma las consultas con el primer registro y guarda sus respuestas.
+static int init_queries(void) {
+    Conn c;
+    char *reply = malloc(REPLY_SZ);
+    if (!reply || conn_open(&c) != 0) {
+        perror("stress: no se pudo conectar con el servidor");
+        free(reply);
+        return -1;
+    }
+
+    char id[256], title[256], word[256] = "";
+    if (call(&c, CMD_READIDX, "1", reply, REPLY_SZ) != 0 ||
+        !csv_get_column(reply, 1, id, sizeof(id)) || !csv_get_column(reply, 4, title, sizeof(title))) {
+        fprintf(stderr, "stress: no se pudo leer el registro 1\n");
+        goto fail;
+    }
+    // La palabra más larga del título (que no aparezca en lo que se inserta)
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", title);
+    for (char *save, *w = strtok_r(copy, " \t\n", &save); w; w = strtok_r(NULL, " \t\n", &save))
+        if (strlen(w) > strlen(word) && !strstr("zzstress", w)) snprintf(word, sizeof(word), "%s", w);
+
+    g_queries[0].cmd = CMD_ID;
+    snprintf(g_queries[0].payload, sizeof(g_queries[0].payload), "%s", id);
+    g_queries[1].cmd = CMD_TITLE;
+    snprintf(g_queries[1].payload, sizeof(g_queries[1].payload), "%s", title);
+    g_queries[2].cmd = CMD_FIND;
+    snprintf(g_queries[2].payload, sizeof(g_queries[2].payload), "q=%s", word);
+    g_queries[3].cmd = CMD_BM25;
+    snprintf(g_queries[3].payload, sizeof(g_queries[3].payload), "%s", word);
+    g_queries[4].cmd = CMD_PREFIX;
+    snprintf(g_queries[4].payload, sizeof(g_queries[4].payload), "%.3s", title);
+
+    for (int i = 0; i < N_QUERIES; i++) {
+        if (call(&c, g_queries[i].cmd, g_queries[i].payload, reply, REPLY_SZ) != 0) {
+            fprintf(stderr, "stress: se cortó la conexión\n");
+            goto fail;
+        }
+        if (strncmp(reply, "ERROR", 5) == 0) {
+            fprintf(stderr, "stress: '%s': %s\n", g_queries[i].payload, reply);
+            goto fail;
+        }
+        g_queries[i].expected = strdup(reply);
+        printf("consulta %d '%s': %zu bytes\n", g_queries[i].cmd, g_queries[i].payload, strlen(reply));
+    }
+    close(c.sock);
+    free(reply);
+    return 0;
+
+fail:
+    close(c.sock);
+    free(reply);
+    return -1;
+}
+
+static void *finder(void *arg) {
+    Worker *w = arg;
+    Conn c;
+    char *reply = malloc(REPLY_SZ);
+    if (!reply || conn_open(&c) != 0) {
+        w->errors++;
+        free(reply);
+        return NULL;
+    }
+    for (long i = w->k; !g_stop; i++) {
+        const Query *q = &g_queries[i % N_QUERIES];
+        double t0 = now();
+        if (call(&c, q->cmd, q->payload, reply, REPLY_SZ) != 0) {
+            report("búsqueda '%s': se cortó la conexión%s", q->payload, "");
+            w->errors++;
+            break;
+        }
+        lat_add(&w->lat, now() - t0);
+        w->ops++;
+        if (strcmp(reply, q->expected) != 0) {
+            report("búsqueda '%s': la respuesta cambió (%.60s)", q->payload, reply);
+            w->errors++;
+        }
+    }
+    close(c.sock);
+    free(reply);
+    return NULL;
+}
+
+// --- Inserciones ---
+
+typedef struct {
+    char id[64], doi[64], title[128];
+    char line[512];
+} Record;
+
+// El registro j del hilo k: único por proceso y distinto de las consultas
+static void make_record(Record *r, int k, long j) {
+    snprintf(r->id, sizeof(r->id), "zz%ld.%d.%ld", g_pid, k, j);
+    snprintf(r->doi, sizeof(r->doi), "10.9999/zz%ld.%d.%ld", g_pid, k, j);
+    snprintf(r->title, sizeof(r->title), "zzstress %ld %d %ld, \"q\"", g_pid, k, j);
+    snprintf(r->line, sizeof(r->line),
+             "\"%s\",\"S\",\"A\",\"zzstress %ld %d %ld, \"\"q\"\"\",\"zzstress\",\"cs.ZZ\",\"\",\"\",\"%s\",\"\",\"cc-by\",\"%s\",\"1\",\"x\"",
+             r->id, g_pid, k, j, r->doi, g_date);
+}
+
+// Busca r por id, doi y título exacto. Devuelve cuántas búsquedas no lo encontraron.
+static int verify(Conn *c, const Record *r, char *reply, const char *when) {
+    const struct { int cmd; const char *key; } keys[] = {
+        { CMD_ID, r->id }, { CMD_DOI, r->doi }, { CMD_TITLE, r->title }
+    };
+    int missing = 0;
+    for (int i = 0; i < 3; i++) {
+        if (call(c, keys[i].cmd, keys[i].key, reply, REPLY_SZ) != 0 || !strstr(reply, r->id)) {
+            report("'%s' no aparece %s", keys[i].key, when);
+            missing++;
+        }
+    }
+    return missing;
+}
+
+static void *inserter(void *arg) {
+    Worker *w = arg;
+    Conn c;
+    char *reply = malloc(REPLY_SZ);
+    if (!reply || conn_open(&c) != 0) {
+        w->errors++;
+        free(reply);
+        return NULL;
+    }
+    Record r;
+    for (long j = 1; !g_stop; j++) {
+        make_record(&r, w->k, j);
+        double t0 = now();
+        if (call(&c, CMD_INSERT, r.line, reply, REPLY_SZ) != 0) {
+            report("inserción '%s': se cortó la conexión%s", r.id, "");
+            w->errors++;
+            break;
+        }
+        lat_add(&w->lat, now() - t0);
+        w->ops++;
+        if (strcmp(reply, "OK") != 0) {
+            report("inserción '%s': %s", r.id, reply);
+            w->errors++;
+            break;                  // lo verificado al final es 1..inserted
+        }
+        w->inserted = j;
+        w->errors += verify(&c, &r, reply, "después de insertarlo");
+    }
+    close(c.sock);
+    free(reply);
+    return NULL;
+}
+
+// --- Resultados ---
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Junta las latencias de n hilos e imprime la línea de resumen.
+static long summarize(const char *what, Worker *ws, int n, double secs) {
+    Latencies all = { NULL, 0, 0 };
+    long ops = 0, errors = 0;
+    for (int i = 0; i < n; i++) {
+        for (long j = 0; j < ws[i].lat.n; j++) lat_add(&all, ws[i].lat.v[j]);
+        ops += ws[i].ops;
+        errors += ws[i].errors;
+    }
+    qsort(all.v, all.n, sizeof(double), cmp_double);
+    double p50 = all.n ? all.v[all.n / 2] : 0, p99 = all.n ? all.v[all.n * 99 / 100] : 0;
+    double max = all.n ? all.v[all.n - 1] : 0;
+    printf("%-11s %3d hilos %8ld (%7.1f/s)  p50 %6.2f ms  p99 %6.2f ms  max %6.2f ms  errores %ld\n",
+           what, n, ops, ops / secs, p50 * 1e3, p99 * 1e3, max * 1e3, errors);
+    free(all.v);
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    int n_find = argc > 1 ? atoi(argv[1]) : 4;
+    int n_ins = argc > 2 ? atoi(argv[2]) : 2;
+    double secs = argc > 3 ? atof(argv[3]) : 10;
+    if (n_find < 0 || n_ins < 0 || n_find + n_ins == 0 || secs <= 0) {
+        fprintf(stderr, "uso: %s [busquedas] [inserciones] [segundos]\n", argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    g_pid = (long)getpid();
+    time_t t = time(NULL);
+    strftime(g_date, sizeof(g_date), "%Y-%m-%d", localtime(&t));
+    if (init_queries() != 0) return 1;
+
+    Worker *finds = calloc(n_find ? n_find : 1, sizeof(Worker));
+    Worker *ins = calloc(n_ins ? n_ins : 1, sizeof(Worker));
+    pthread_t *th = calloc(n_find + n_ins, sizeof(pthread_t));
+    if (!finds || !ins || !th) {
+        perror("calloc");
+        return 1;
+    }
+    double t0 = now();
+    for (int i = 0; i < n_find; i++) {
+        finds[i].k = i;
+        pthread_create(&th[i], NULL, finder, &finds[i]);
+    }
+    for (int i = 0; i < n_ins; i++) {
+        ins[i].k = i;
+        pthread_create(&th[n_find + i], NULL, inserter, &ins[i]);
+    }
+    struct timespec d = { (time_t)secs, (long)((secs - (time_t)secs) * 1e9) };
+    nanosleep(&d, NULL);
+    g_stop = 1;
+    for (int i = 0; i < n_find + n_ins; i++) pthread_join(th[i], NULL);
+    double elapsed = now() - t0;
+
+    long errors = summarize("búsquedas", finds, n_find, elapsed);
+    errors += summarize("inserciones", ins, n_ins, elapsed);
+
+    // Todo lo confirmado, otra vez, con las inserciones ya terminadas
+    long checked = 0, missing = 0;
+    Conn c;
+    char *reply = malloc(REPLY_SZ);
+    if (n_ins && (!reply || conn_open(&c) != 0)) {
+        perror("stress: no se pudo conectar para verificar");
+        missing++;
+    } else if (n_ins) {
+        Record r;
+        for (int i = 0; i < n_ins; i++)
+            for (long j = 1; j <= ins[i].inserted; j++, checked++) {
+                make_record(&r, i, j);
+                missing += verify(&c, &r, reply, "al final");
+            }
+        close(c.sock);
+    }
+    printf("verificados %ld registros insertados, faltan %ld\n", checked, missing);
+
+    for (int i = 0; i < n_find; i++) free(finds[i].lat.v);
+    for (int i = 0; i < n_ins; i++) free(ins[i].lat.v);
+    free(finds);
+    free(ins);
+    free(th);
+    free(reply);
+    for (int i = 0; i < N_QUERIES; i++) free(g_queries[i].expected);
+    return errors || missing ? 1 : 0;
+}
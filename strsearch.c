@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRSEARCH_X86 1
+#endif
+#include "strsearch.h"
+
+typedef const char *(*SearchFn)(const char *h, size_t n, const char *lower, size_t m);
+
+// ¿s[0..n) es igual a lower[0..n) (ya en minúsculas) sin mirar mayúsculas?
+static int equal_ci(const char *s, const char *lower, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        if (tolower((unsigned char)s[i]) != (unsigned char)lower[i]) return 0;
+    return 1;
+}
+
+// x | 0x20 pasa a minúscula las letras ASCII y no convierte en letra a
+// ningún otro byte; por eso el OR se aplica solo si el byte de la aguja es letra.
+static unsigned char fold_of(unsigned char c) {
+    return isalpha(c) ? 0x20 : 0;
+}
+
+// Resto (o todo, sin SIMD): posición por posición desde i.
+static const char *search_tail(const char *h, size_t n, const char *lower, size_t m, size_t i) {
+    unsigned char first = (unsigned char)lower[0], last = (unsigned char)lower[m - 1];
+    unsigned char ff = fold_of(first), lf = fold_of(last);
+    for (; i + m <= n; i++) {
+        if (((unsigned char)h[i] | ff) == first && ((unsigned char)h[i + m - 1] | lf) == last &&
+            equal_ci(h + i, lower, m)) return h + i;
+    }
+    return NULL;
+}
+
+static const char *search_scalar(const char *h, size_t n, const char *lower, size_t m) {
+    return search_tail(h, n, lower, m, 0);
+}
+
+#ifdef __SSE2__
+static const char *search_sse2(const char *h, size_t n, const char *lower, size_t m) {
+    unsigned char first = (unsigned char)lower[0], last = (unsigned char)lower[m - 1];
+    __m128i vf = _mm_set1_epi8((char)first), vl = _mm_set1_epi8((char)last);
+    __m128i ff = _mm_set1_epi8((char)fold_of(first)), lf = _mm_set1_epi8((char)fold_of(last));
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i *)(h + i)), ff);
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i *)(h + i + m - 1)), lf);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, vf), _mm_cmpeq_epi8(b, vl)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (equal_ci(h + i + bit, lower, m)) return h + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return search_tail(h, n, lower, m, i);
+}
+#endif
+
+#ifdef STRSEARCH_X86
+__attribute__((target("avx2")))
+static const char *search_avx2(const char *h, size_t n, const char *lower, size_t m) {
+    unsigned char first = (unsigned char)lower[0], last = (unsigned char)lower[m - 1];
+    __m256i vf = _mm256_set1_epi8((char)first), vl = _mm256_set1_epi8((char)last);
+    __m256i ff = _mm256_set1_epi8((char)fold_of(first)), lf = _mm256_set1_epi8((char)fold_of(last));
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(h + i)), ff);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(h + i + m - 1)), lf);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, vf),
+                                                                         _mm256_cmpeq_epi8(b, vl)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (equal_ci(h + i + bit, lower, m)) return h + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return search_tail(h, n, lower, m, i);
+}
+#endif
+
+// --- Elección de la versión ---
+
+static const struct {
+    const char *name;
+    SearchFn fn;
+} impls[] = {
+#ifdef STRSEARCH_X86
+    { "avx2", search_avx2 },
+#endif
+#ifdef __SSE2__
+    { "sse2", search_sse2 },
+#endif
+    { "scalar", search_scalar },
+};
+#define N_IMPLS ((int)(sizeof(impls) / sizeof(impls[0])))
+
+static int impl_supported(const char *name) {
+#ifdef STRSEARCH_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0) return __builtin_cpu_supports("avx2");
+#endif
+    (void)name;
+    return 1;
+}
+
+static int current = -1;
+static pthread_once_t choose_once = PTHREAD_ONCE_INIT;
+
+static void choose_impl(void) {
+    int i = 0;
+    while (i < N_IMPLS - 1 && !impl_supported(impls[i].name)) i++;
+    current = i;
+}
+
+const char *strsearch_impl(void) {
+    pthread_once(&choose_once, choose_impl);
+    return impls[current].name;
+}
+
+int strsearch_use(const char *name) {
+    pthread_once(&choose_once, choose_impl);
+    for (int i = 0; i < N_IMPLS; i++) {
+        if (strcmp(impls[i].name, name) == 0 && impl_supported(name)) {
+            current = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// --- API ---
+
+const char *strsearch_ci(const char *h, size_t n, const char *lower, size_t m) {
+    if (m == 0) return h;
+    if (n < m) return NULL;
+    pthread_once(&choose_once, choose_impl);
+    return impls[current].fn(h, n, lower, m);
+}
+
+const char *strsearch_ci_str(const char *haystack, const char *needle) {
+    if (!haystack || !needle) return NULL;
+    size_t m = strlen(needle);
+    if (m == 0) return haystack;
+
+    char buf[256];
+    char *lower = m < sizeof(buf) ? buf : malloc(m + 1);
+    if (!lower) return NULL;
+    for (size_t i = 0; i < m; i++) lower[i] = (char)tolower((unsigned char)needle[i]);
+
+    const char *hit = strsearch_ci(haystack, strlen(haystack), lower, m);
+    if (lower != buf) free(lower);
+    return hit;
+}
@@ -0,0 +1,24 @@
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <stddef.h>
+
+/* Búsqueda de subcadenas sin distinguir mayúsculas (ASCII).
+   Se filtran muchas posiciones a la vez comparando solo el primer y el
+   último byte de la aguja (con las letras pasadas a minúscula con x | 0x20)
+   y se verifican completas únicamente las posiciones que pasan ambos.
+   Hay tres versiones: AVX2 (32 posiciones por vuelta), SSE2 (16) y escalar;
+   la primera llamada elige la mejor que soporte el procesador. */
+
+/* Primera aparición de lower[0..m) (ya en minúsculas) en h[0..n), o NULL. */
+const char *strsearch_ci(const char *h, size_t n, const char *lower, size_t m);
+
+/* Como strcasestr: cadenas terminadas en '\0', la aguja en cualquier caso. */
+const char *strsearch_ci_str(const char *haystack, const char *needle);
+
+/* Versión en uso ("avx2", "sse2" o "scalar"); strsearch_use() la fuerza
+   (para comparar en el benchmark). Devuelve -1 si no está disponible. */
+const char *strsearch_impl(void);
+int strsearch_use(const char *name);
+
+#endif
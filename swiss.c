@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "hash.h"
+#include "index.h"
+#include "swiss.h"
+
+#define SWISS_MAX_LOAD_NUM 7        // se agranda al superar 7/8 de ocupación
+#define SWISS_MAX_LOAD_DEN 8
+
+static unsigned char h2_of(unsigned long h) { return (unsigned char)(h & 0x7f); }
+static long group_of(const SwissTable *t, unsigned long h) {
+    return (long)((h >> 7) & (unsigned long)(t->cap / SWISS_GROUP - 1));
+}
+
+// Bits (uno por byte) de los bytes de control del grupo iguales a b.
+static unsigned group_match(const unsigned char *ctrl, unsigned char b) {
+#ifdef __SSE2__
+    __m128i g = _mm_load_si128((const __m128i *)ctrl);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)b)));
+#else
+    unsigned m = 0;
+    for (int i = 0; i < SWISS_GROUP; i++) m |= (unsigned)(ctrl[i] == b) << i;
+    return m;
+#endif
+}
+
+static int alloc_table(SwissTable *t, long cap) {
+    unsigned char *ctrl = aligned_alloc(SWISS_GROUP, (size_t)cap);
+    SwissSlot *slots = malloc(sizeof(SwissSlot) * (size_t)cap);
+    if (!ctrl || !slots) {
+        free(ctrl);
+        free(slots);
+        return -1;
+    }
+    memset(ctrl, SWISS_EMPTY, (size_t)cap);
+    t->ctrl = ctrl;
+    t->slots = slots;
+    t->cap = cap;
+    return 0;
+}
+
+int swiss_init(SwissTable *t, long expected) {
+    memset(t, 0, sizeof(*t));
+    long cap = SWISS_GROUP;
+    while (cap * SWISS_MAX_LOAD_NUM / SWISS_MAX_LOAD_DEN < expected) cap *= 2;
+    return alloc_table(t, cap);
+}
+
+void swiss_free(SwissTable *t) {
+    free(t->ctrl);
+    free(t->slots);
+    free(t->arena);
+    memset(t, 0, sizeof(*t));
+}
+
+// Memoria que ocupa la tabla (control + slots + arena reservados).
+size_t swiss_bytes(const SwissTable *t) {
+    return (size_t)t->cap * (1 + sizeof(SwissSlot)) + t->arena_cap;
+}
+
+// Ubica un slot ya armado en el primer lugar libre de su secuencia de
+// grupos (sondeo triangular: 0, 1, 3, 6... grupos más allá).
+static void place(SwissTable *t, const SwissSlot *s) {
+    long mask = t->cap / SWISS_GROUP - 1;
+    long g = group_of(t, s->hash);
+    for (long step = 1;; step++) {
+        unsigned char *ctrl = t->ctrl + g * SWISS_GROUP;
+        unsigned empty = group_match(ctrl, SWISS_EMPTY);
+        if (empty) {
+            int i = __builtin_ctz(empty);
+            ctrl[i] = h2_of(s->hash);
+            t->slots[g * SWISS_GROUP + i] = *s;
+            return;
+        }
+        g = (g + step) & mask;
+    }
+}
+
+static int grow(SwissTable *t) {
+    SwissTable old = *t;
+    if (alloc_table(t, old.cap * 2) != 0) {
+        *t = old;
+        return -1;
+    }
+    for (long i = 0; i < old.cap; i++)
+        if (old.ctrl[i] != SWISS_EMPTY) place(t, &old.slots[i]);
+    free(old.ctrl);
+    free(old.slots);
+    return 0;
+}
+
+// Agrega (key, csv_offset). Los títulos repetidos ocupan slots distintos.
+int swiss_insert(SwissTable *t, const char *key, long csv_offset) {
+    if ((t->n + 1) * SWISS_MAX_LOAD_DEN > t->cap * SWISS_MAX_LOAD_NUM && grow(t) != 0) return -1;
+
+    size_t len = strlen(key);
+    if (t->arena_len + len + 1 > t->arena_cap) {
+        size_t ncap = t->arena_cap ? t->arena_cap * 2 : (size_t)1 << 20;
+        while (ncap < t->arena_len + len + 1) ncap *= 2;
+        char *na = realloc(t->arena, ncap);
+        if (!na) return -1;
+        t->arena = na;
+        t->arena_cap = ncap;
+    }
+    memcpy(t->arena + t->arena_len, key, len + 1);
+
+    SwissSlot s = { hash_fold64(key), (long)t->arena_len, csv_offset };
+    t->arena_len += len + 1;
+    place(t, &s);
+    t->n++;
+    return 0;
+}
+
+// Llama a fn con el offset de cada registro cuyo título es key (sin
+// distinguir mayúsculas) hasta que devuelva != 0. Un grupo con algún
+// slot vacío termina la búsqueda. Devuelve la cantidad de coincidencias.
+long swiss_find(const SwissTable *t, const char *key, SwissMatchFn fn, void *arg) {
+    unsigned long h = hash_fold64(key);
+    unsigned char b = h2_of(h);
+    long mask = t->cap / SWISS_GROUP - 1;
+    long g = group_of(t, h), found = 0;
+
+    for (long step = 1; step <= mask + 1; step++) {
+        const unsigned char *ctrl = t->ctrl + g * SWISS_GROUP;
+        for (unsigned m = group_match(ctrl, b); m; m &= m - 1) {
+            const SwissSlot *s = &t->slots[g * SWISS_GROUP + __builtin_ctz(m)];
+            if (s->hash != h || strcasecmp(t->arena + s->key_pos, key) != 0) continue;
+            found++;
+            if (fn(s->csv_offset, arg)) return found;
+        }
+        if (group_match(ctrl, SWISS_EMPTY)) break;
+        g = (g + step) & mask;
+    }
+    return found;
+}
+
+// --- Carga desde index.bin ---
+
+static int load_entry(const IndexEntry *e, void *arg) {
+    return swiss_insert(arg, e->key, e->csv_offset) != 0 ? -1 : 0;
+}
+
+// Inicializa t con todas las entradas de index.bin, reservando de una vez
+// lugar para ellas (más un margen para las inserciones) sin rehashear.
+int swiss_load_index(SwissTable *t, const char *index_path) {
+    FILE *idx = fopen(index_path, "rb");
+    if (!idx) return -1;
+    IndexHeader h;
+    int ok = index_read_header(idx, &h) == 0;
+    fclose(idx);
+    if (!ok || swiss_init(t, h.n_entries + h.n_entries / 8) != 0) return -1;
+
+    if (index_for_each(index_path, load_entry, t) != 0) {
+        swiss_free(t);
+        return -1;
+    }
+    // El arena crece duplicándose: se devuelve lo que sobró de la carga
+    char *fit = realloc(t->arena, t->arena_len ? t->arena_len : 1);
+    if (fit) {
+        t->arena = fit;
+        t->arena_cap = t->arena_len ? t->arena_len : 1;
+    }
+    return 0;
+}
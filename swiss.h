@@ -0,0 +1,39 @@
+#ifndef SWISS_H
+#define SWISS_H
+
+#include <stddef.h>
+
+#define SWISS_GROUP 16              /* bytes de control por grupo (un registro SSE2) */
+#define SWISS_EMPTY 0x80
+
+/* Tabla de títulos en memoria con direccionamiento abierto al estilo
+   "swiss table": por cada slot hay un byte de control con 7 bits del hash
+   (o SWISS_EMPTY) y los 16 bytes de un grupo se comparan de una vez.
+   Solo al coincidir esos bits se mira el slot (hash completo y offset) y,
+   si también coincide el hash, la clave en el arena.
+   Las claves se comparan sin distinguir mayúsculas (hash_fold64). */
+typedef struct {
+    unsigned long hash;     /* hash_fold64 de la clave */
+    long key_pos;           /* posición en el arena (terminada en '\0') */
+    long csv_offset;
+} SwissSlot;
+
+typedef struct {
+    unsigned char *ctrl;    /* cap bytes, alineados a 16 */
+    SwissSlot *slots;
+    long cap;               /* múltiplo de SWISS_GROUP, potencia de 2 */
+    long n;
+    char *arena;
+    size_t arena_len, arena_cap;
+} SwissTable;
+
+typedef int (*SwissMatchFn)(long csv_offset, void *arg);
+
+int    swiss_init(SwissTable *t, long expected);
+void   swiss_free(SwissTable *t);
+int    swiss_insert(SwissTable *t, const char *key, long csv_offset);
+long   swiss_find(const SwissTable *t, const char *key, SwissMatchFn fn, void *arg);
+size_t swiss_bytes(const SwissTable *t);
+int    swiss_load_index(SwissTable *t, const char *index_path);
+
+#endif
@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "index.h"
+#include "titletree.h"
+
+#define TTREE_KEY_MAX INDEX_KEY_MAX
+#define LEAF_FIXED (sizeof(long) + 2 * sizeof(unsigned short))
+#define INNER_FIXED (sizeof(unsigned short) + 2 * sizeof(long))
+#define PAGE_ROOM (TTREE_PAGE_SIZE - sizeof(TTreePage))
+
+static void lower_copy(char *dst, const char *src, size_t len) {
+    for (size_t i = 0; i < len; i++) dst[i] = (char)tolower((unsigned char)src[i]);
+}
+
+static int key_cmp(const char *a, size_t alen, const char *b, size_t blen) {
+    int c = memcmp(a, b, alen < blen ? alen : blen);
+    if (c) return c;
+    return (alen > blen) - (alen < blen);
+}
+
+// Compara (clave, offset) como hace el árbol.
+static int pair_cmp(const char *a, size_t alen, long aoff, const char *b, size_t blen, long boff) {
+    int c = key_cmp(a, alen, b, blen);
+    if (c) return c;
+    return (aoff > boff) - (aoff < boff);
+}
+
+static int has_prefix(const char *key, size_t len, const char *p, size_t plen) {
+    return len >= plen && memcmp(key, p, plen) == 0;
+}
+
+// --- Construcción ---
+
+static const IndexKeyList *sort_list;   // qsort no recibe contexto
+
+static int ref_cmp(const void *a, const void *b) {
+    const IndexKeyRef *x = a, *y = b;
+    return pair_cmp(sort_list->keys + x->key_pos, x->key_len, x->csv_offset,
+                    sort_list->keys + y->key_pos, y->key_len, y->csv_offset);
+}
+
+// Primer par de cada página de un nivel: el separador en el nivel de arriba
+typedef struct {
+    const char *key;
+    size_t len;
+    long csv_offset;
+    long page;
+} TTreeChild;
+
+static int push_child(TTreeChild **v, long *n, long *cap, TTreeChild c) {
+    if (*n == *cap) {
+        long ncap = *cap ? *cap * 2 : 256;
+        TTreeChild *nv = realloc(*v, sizeof(TTreeChild) * ncap);
+        if (!nv) return -1;
+        *v = nv;
+        *cap = ncap;
+    }
+    (*v)[(*n)++] = c;
+    return 0;
+}
+
+static int flush_page(FILE *out, unsigned char *pg, long *next_page) {
+    (*next_page)++;
+    int r = fwrite(pg, 1, TTREE_PAGE_SIZE, out) == TTREE_PAGE_SIZE ? 0 : -1;
+    memset(pg, 0, TTREE_PAGE_SIZE);
+    return r;
+}
+
+// Las hojas se llenan en orden hasta que no entra la próxima clave; cada
+// nivel interno se arma igual con el primer par de cada página de abajo.
+int titletree_build(const char *index_path, const char *out_path, long csv_end) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    IndexKeyList c;
+    if (index_collect_keys(index_path, &c) != 0) return -1;
+    lower_copy(c.keys, c.keys, c.keys_len);
+    sort_list = &c;
+    qsort(c.refs, c.n, sizeof(IndexKeyRef), ref_cmp);
+    sort_list = NULL;
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) {
+        index_key_list_free(&c);
+        return -1;
+    }
+
+    TitleTreeHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = TTREE_MAGIC;
+    h.version = TTREE_VERSION;
+    h.n_keys = c.n;
+    h.csv_end = csv_end;
+
+    unsigned char pg[TTREE_PAGE_SIZE];
+    memset(pg, 0, sizeof(pg));
+    long next_page = 0;
+    int failed = flush_page(out, pg, &next_page) != 0;     // lugar del header
+
+    // --- Hojas ---
+    TTreeChild *level = NULL, *up = NULL;
+    long n_level = 0, level_cap = 0, n_up = 0, up_cap = 0;
+    TTreePage *hd = (TTreePage *)pg;
+    const char *prev = NULL;
+    size_t prev_len = 0;
+    hd->is_leaf = 1;
+    for (long i = 0; !failed && i < c.n; i++) {
+        const char *key = c.keys + c.refs[i].key_pos;
+        size_t len = c.refs[i].key_len < TTREE_KEY_MAX ? c.refs[i].key_len : TTREE_KEY_MAX;
+        size_t shared = 0;
+        if (hd->n > 0) {
+            while (shared < len && shared < prev_len && key[shared] == prev[shared]) shared++;
+        }
+        if (hd->n > 0 && hd->used + LEAF_FIXED + (len - shared) > PAGE_ROOM) {
+            hd->next = next_page + 1;
+            failed = flush_page(out, pg, &next_page) != 0;
+            hd->is_leaf = 1;
+            shared = 0;
+        }
+        if (hd->n == 0) {
+            TTreeChild ch = { key, len, c.refs[i].csv_offset, next_page };
+            failed |= push_child(&level, &n_level, &level_cap, ch) != 0;
+        }
+        unsigned char *e = pg + sizeof(TTreePage) + hd->used;
+        unsigned short sh = (unsigned short)shared, sl = (unsigned short)(len - shared);
+        memcpy(e, &c.refs[i].csv_offset, sizeof(long));
+        memcpy(e + sizeof(long), &sh, sizeof(sh));
+        memcpy(e + sizeof(long) + sizeof(sh), &sl, sizeof(sl));
+        memcpy(e + LEAF_FIXED, key + shared, sl);
+        hd->used += (unsigned short)(LEAF_FIXED + sl);
+        hd->n++;
+        prev = key;
+        prev_len = len;
+    }
+    if (!failed) {
+        if (hd->n == 0) {
+            TTreeChild ch = { "", 0, 0, next_page };
+            failed |= push_child(&level, &n_level, &level_cap, ch) != 0;
+        }
+        hd->next = -1;
+        failed |= flush_page(out, pg, &next_page) != 0;
+    }
+
+    // --- Niveles internos ---
+    h.height = 1;
+    while (!failed && n_level > 1) {
+        n_up = 0;
+        for (long i = 0; !failed && i < n_level; i++) {
+            if (hd->n > 0 || i > 0) {
+                if (hd->used + INNER_FIXED + level[i].len <= PAGE_ROOM) {
+                    unsigned char *e = pg + sizeof(TTreePage) + hd->used;
+                    unsigned short kl = (unsigned short)level[i].len;
+                    memcpy(e, &kl, sizeof(kl));
+                    memcpy(e + sizeof(kl), level[i].key, kl);
+                    memcpy(e + sizeof(kl) + kl, &level[i].csv_offset, sizeof(long));
+                    memcpy(e + sizeof(kl) + kl + sizeof(long), &level[i].page, sizeof(long));
+                    hd->used += (unsigned short)(INNER_FIXED + kl);
+                    hd->n++;
+                    continue;
+                }
+                hd->next = -1;
+                failed = flush_page(out, pg, &next_page) != 0;
+            }
+            // Página nueva: este hijo es su hijo0
+            TTreeChild ch = level[i];
+            ch.page = next_page;
+            failed |= push_child(&up, &n_up, &up_cap, ch) != 0;
+            memcpy(pg + sizeof(TTreePage), &level[i].page, sizeof(long));
+            hd->used = sizeof(long);
+        }
+        hd->next = -1;
+        if (!failed) failed = flush_page(out, pg, &next_page) != 0;
+
+        TTreeChild *tmp = level; level = up; up = tmp;
+        long tcap = level_cap; level_cap = up_cap; up_cap = tcap;
+        n_level = n_up;
+        h.height++;
+    }
+
+    if (!failed) {
+        h.root = level[0].page;
+        h.n_pages = next_page;
+        memcpy(pg, &h, sizeof(h));
+        failed = fseek(out, 0, SEEK_SET) != 0 || fwrite(pg, 1, TTREE_PAGE_SIZE, out) != TTREE_PAGE_SIZE;
+    }
+    free(level);
+    free(up);
+    index_key_list_free(&c);
+    if (fclose(out) != 0) failed = 1;
+    if (!failed && rename(tmp_path, out_path) != 0) failed = 1;
+    if (failed) {
+        remove(tmp_path);
+        fprintf(stderr, "[TITLES] Error construyendo %s\n", out_path);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("[TITLES] %ld títulos, %ld páginas, altura %d, %.3f s\n", h.n_keys, h.n_pages, h.height,
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    return 0;
+}
+
+// --- Apertura ---
+
+int titletree_open(TitleTree *t, const char *path) {
+    memset(t, 0, sizeof(*t));
+    if (fmap_open(&t->map, path) != 0) return -1;
+
+    const TitleTreeHeader *h = (const TitleTreeHeader *)t->map.base;
+    if (t->map.size < TTREE_PAGE_SIZE || h->magic != TTREE_MAGIC || h->version != TTREE_VERSION ||
+        h->height < 1 || h->root <= 0 || h->root >= h->n_pages ||
+        (size_t)h->n_pages * TTREE_PAGE_SIZE > t->map.size) {
+        fmap_close(&t->map);
+        return -1;
+    }
+    t->h = *h;
+    return 0;
+}
+
+void titletree_close(TitleTree *t) {
+    fmap_close(&t->map);
+    for (long i = 0; i < t->tail_n; i++) free(t->tail_title[i]);
+    free(t->tail_title);
+    free(t->tail_csv);
+    memset(t, 0, sizeof(*t));
+    t->map.fd = -1;
+}
+
+// Posición de (title, csv_offset) en la cola ordenada.
+static long tail_lower_bound(const TitleTree *t, const char *key, size_t len, long csv_offset) {
+    long lo = 0, hi = t->tail_n;
+    while (lo < hi) {
+        long mid = (lo + hi) / 2;
+        const char *m = t->tail_title[mid];
+        if (pair_cmp(m, strlen(m), t->tail_csv[mid], key, len, csv_offset) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Registro agregado al CSV después de construir titles.bin.
+int titletree_add(TitleTree *t, const char *title, long csv_offset) {
+    if (t->tail_n == t->tail_cap) {
+        long ncap = t->tail_cap ? t->tail_cap * 2 : 64;
+        long *nc = realloc(t->tail_csv, sizeof(long) * ncap);
+        if (!nc) return -1;
+        t->tail_csv = nc;
+        char **nt = realloc(t->tail_title, sizeof(char *) * ncap);
+        if (!nt) return -1;
+        t->tail_title = nt;
+        t->tail_cap = ncap;
+    }
+    size_t len = strlen(title);
+    char *s = malloc(len + 1);
+    if (!s) return -1;
+    lower_copy(s, title, len);
+    s[len] = '\0';
+
+    long at = tail_lower_bound(t, s, len, csv_offset);
+    memmove(t->tail_title + at + 1, t->tail_title + at, sizeof(char *) * (t->tail_n - at));
+    memmove(t->tail_csv + at + 1, t->tail_csv + at, sizeof(long) * (t->tail_n - at));
+    t->tail_title[at] = s;
+    t->tail_csv[at] = csv_offset;
+    t->tail_n++;
+    return 0;
+}
+
+// --- Búsqueda por prefijo ---
+
+static const unsigned char *map_page(const TitleTree *t, long p) {
+    if (p <= 0 || p >= t->h.n_pages) return NULL;
+    const unsigned char *pg = t->map.base + (size_t)p * TTREE_PAGE_SIZE;
+    return ((const TTreePage *)pg)->used <= PAGE_ROOM ? pg : NULL;
+}
+
+// Hijo por el que seguir: el último cuyo separador es menor que el prefijo
+// (los pares de los hijos anteriores son todos menores que el prefijo).
+static long inner_descend(const unsigned char *pg, const char *p, size_t plen) {
+    const TTreePage *hd = (const TTreePage *)pg;
+    const unsigned char *e = pg + sizeof(TTreePage), *end = e + hd->used;
+    long child;
+    memcpy(&child, e, sizeof(long));
+    e += sizeof(long);
+    for (unsigned i = 0; i < hd->n; i++) {
+        unsigned short kl;
+        if (e + INNER_FIXED > end) break;
+        memcpy(&kl, e, sizeof(kl));
+        if (e + INNER_FIXED + kl > end) break;
+        if (key_cmp((const char *)e + sizeof(kl), kl, p, plen) >= 0) break;
+        memcpy(&child, e + sizeof(kl) + kl + sizeof(long), sizeof(long));
+        e += INNER_FIXED + kl;
+    }
+    return child;
+}
+
+typedef struct {
+    const TitleTree *t;
+    const char *p;
+    size_t plen;
+    long tail_i;            // próxima entrada de la cola a considerar
+    long found;
+    TitleMatchFn fn;
+    void *arg;
+} PrefixScan;
+
+// Emite las entradas de la cola con el prefijo que van antes de (key, off)
+// (key == NULL: todas las que quedan). Devuelve != 0 si hay que cortar.
+static int emit_tail_before(PrefixScan *s, const char *key, size_t len, long off) {
+    const TitleTree *t = s->t;
+    while (s->tail_i < t->tail_n) {
+        const char *tk = t->tail_title[s->tail_i];
+        size_t tl = strlen(tk);
+        if (!has_prefix(tk, tl, s->p, s->plen)) { s->tail_i = t->tail_n; break; }
+        if (key && pair_cmp(tk, tl, t->tail_csv[s->tail_i], key, len, off) > 0) break;
+        long csv = t->tail_csv[s->tail_i++];
+        s->found++;
+        if (s->fn(csv, s->arg)) return 1;
+    }
+    return 0;
+}
+
+// Llama a fn con cada título que empieza con prefix (sin distinguir
+// mayúsculas), en orden alfabético; prefix vacío recorre todos. Se baja
+// una vez por el árbol y después solo se leen las hojas de los resultados.
+// Devuelve la cantidad de coincidencias entregadas, o -1 si el archivo
+// está dañado.
+long titletree_prefix(const TitleTree *t, const char *prefix, TitleMatchFn fn, void *arg) {
+    size_t plen = strlen(prefix);
+    if (plen > TTREE_KEY_MAX) plen = TTREE_KEY_MAX;
+    char p[TTREE_KEY_MAX];
+    lower_copy(p, prefix, plen);
+
+    PrefixScan s = { t, p, plen, tail_lower_bound(t, p, plen, -1), 0, fn, arg };
+
+    const unsigned char *pg = map_page(t, t->h.root);
+    for (int lvl = t->h.height; pg && lvl > 1; lvl--) pg = map_page(t, inner_descend(pg, p, plen));
+    if (!pg) return -1;
+
+    char cur[TTREE_KEY_MAX];
+    size_t cur_len = 0;
+    while (pg) {
+        const TTreePage *hd = (const TTreePage *)pg;
+        const unsigned char *e = pg + sizeof(TTreePage), *end = e + hd->used;
+        for (unsigned i = 0; i < hd->n; i++) {
+            long off;
+            unsigned short sh, sl;
+            if (e + LEAF_FIXED > end) return -1;
+            memcpy(&off, e, sizeof(long));
+            memcpy(&sh, e + sizeof(long), sizeof(sh));
+            memcpy(&sl, e + sizeof(long) + sizeof(sh), sizeof(sl));
+            if (sh > cur_len || (size_t)sh + sl > TTREE_KEY_MAX || e + LEAF_FIXED + sl > end) return -1;
+            memcpy(cur + sh, e + LEAF_FIXED, sl);
+            cur_len = (size_t)sh + sl;
+            e += LEAF_FIXED + sl;
+
+            if (key_cmp(cur, cur_len, p, plen) < 0) continue;
+            if (!has_prefix(cur, cur_len, p, plen)) {
+                emit_tail_before(&s, NULL, 0, 0);
+                return s.found;
+            }
+            if (emit_tail_before(&s, cur, cur_len, off)) return s.found;
+            s.found++;
+            if (fn(off, arg)) return s.found;
+        }
+        pg = hd->next > 0 ? map_page(t, hd->next) : NULL;
+        cur_len = 0;
+    }
+    emit_tail_before(&s, NULL, 0, 0);
+    return s.found;
+}
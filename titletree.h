@@ -0,0 +1,61 @@
+#ifndef TITLETREE_H
+#define TITLETREE_H
+
+#include <stddef.h>
+#include "fmap.h"
+
+#define TITLES_FILE "titles.bin"
+#define TTREE_MAGIC 0x45525454u     /* "TTRE" */
+#define TTREE_VERSION 1
+#define TTREE_PAGE_SIZE 4096
+
+/* Títulos ordenados (en minúsculas, y por offset entre iguales) en un
+   árbol B+ de solo lectura, construido de abajo hacia arriba a partir de
+   index.bin. Sirve para buscar por prefijo y recorrer en orden alfabético:
+   se baja una vez hasta la hoja del prefijo y se avanza por las hojas.
+
+   La página 0 es el header. Cada página es TTreePage seguido de:
+     hoja:    n * (long offset, u16 compartido, u16 largo, sufijo)
+              codificación por prefijo: cada clave guarda solo lo que no
+              comparte con la anterior; la primera de la hoja va completa
+     interna: long hijo0, n * (u16 largo, clave, long offset, long hijo)
+              el separador es el primer par del hijo derecho */
+typedef struct {
+    unsigned int magic;
+    int version;
+    int height;             /* 1 = la raíz es una hoja */
+    int pad;
+    long root;
+    long n_pages;
+    long n_keys;
+    long csv_end;           /* tamaño del CSV cubierto al construir */
+} TitleTreeHeader;
+
+typedef struct {
+    unsigned short is_leaf;
+    unsigned short n;
+    unsigned short used;    /* bytes ocupados después del TTreePage */
+    unsigned short pad;
+    long next;              /* hoja siguiente (-1 en la última) */
+} TTreePage;
+
+/* Árbol abierto, más una cola ordenada con lo insertado después */
+typedef struct {
+    FileMap map;
+    TitleTreeHeader h;
+
+    long tail_n, tail_cap;
+    long *tail_csv;
+    char **tail_title;      /* en minúsculas, en orden (título, offset) */
+} TitleTree;
+
+/* Se llama con cada coincidencia, en orden alfabético; devolver != 0 corta. */
+typedef int (*TitleMatchFn)(long csv_offset, void *arg);
+
+int  titletree_build(const char *index_path, const char *out_path, long csv_end);
+int  titletree_open(TitleTree *t, const char *path);
+void titletree_close(TitleTree *t);
+int  titletree_add(TitleTree *t, const char *title, long csv_offset);
+long titletree_prefix(const TitleTree *t, const char *prefix, TitleMatchFn fn, void *arg);
+
+#endif
@@ -0,0 +1,309 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "index.h"
+#include "trigram.h"
+
+#define TRIGRAM_SPACE (1u << 24)    // trigramas posibles (3 bytes)
+
+static void lower_copy(char *dst, const char *src, size_t len) {
+    for (size_t i = 0; i < len; i++) dst[i] = (char)tolower((unsigned char)src[i]);
+}
+
+static int cmp_unsigned(const void *a, const void *b) {
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return (x > y) - (x < y);
+}
+
+// Trigramas distintos de s (ya en minúsculas), ordenados. out debe tener
+// lugar para len - 2 valores. Devuelve cuántos quedaron.
+static long text_trigrams(const char *s, size_t len, unsigned *out) {
+    if (len < 3) return 0;
+    long n = 0;
+    for (size_t i = 0; i + 2 < len; i++)
+        out[n++] = ((unsigned)(unsigned char)s[i] << 16) |
+                   ((unsigned)(unsigned char)s[i + 1] << 8) |
+                   (unsigned)(unsigned char)s[i + 2];
+    qsort(out, n, sizeof(unsigned), cmp_unsigned);
+    long u = 0;
+    for (long i = 0; i < n; i++)
+        if (u == 0 || out[u - 1] != out[i]) out[u++] = out[i];
+    return u;
+}
+
+// --- Construcción ---
+// Los títulos salen de index.bin (las mismas claves que el índice hash,
+// incluidas las inserciones) ordenados por offset en el CSV. Después,
+// como en el constructor del índice: una pasada cuenta cuántos documentos
+// tiene cada trigrama, se fija la disposición del archivo y una segunda
+// pasada escribe las listas directamente en el archivo mapeado.
+
+int trigram_build(const char *index_path, const char *out_path, long csv_end) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    IndexKeyList c;
+    if (index_collect_keys(index_path, &c) != 0) return -1;
+    lower_copy(c.keys, c.keys, c.keys_len);
+
+    unsigned *count = calloc(TRIGRAM_SPACE, sizeof(unsigned));
+    unsigned *tri = malloc(sizeof(unsigned) * INDEX_KEY_MAX);
+    int failed = !count || !tri;
+
+    // --- Pasada 1: documentos por trigrama ---
+    long n_postings = 0, n_trigrams = 0;
+    for (long d = 0; !failed && d < c.n; d++) {
+        long k = text_trigrams(c.keys + c.refs[d].key_pos, c.refs[d].key_len, tri);
+        for (long i = 0; i < k; i++) {
+            if (count[tri[i]]++ == 0) n_trigrams++;
+        }
+        n_postings += k;
+    }
+    if (n_postings >= (long)UINT_MAX) failed = 1;
+
+    // --- Disposición del archivo ---
+    TrigramHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = TRIGRAM_MAGIC;
+    h.version = TRIGRAM_VERSION;
+    h.n_docs = c.n;
+    h.n_trigrams = n_trigrams;
+    h.n_postings = n_postings;
+    h.csv_end = csv_end;
+    h.offset_docs = sizeof(TrigramHeader);
+    h.offset_titles = h.offset_docs + (long)sizeof(TrigramDoc) * c.n;
+    h.offset_table = (h.offset_titles + (long)c.keys_len + 7) & ~7L;
+    h.offset_postings = h.offset_table + (long)sizeof(TrigramDisk) * n_trigrams;
+    size_t file_size = (size_t)h.offset_postings + sizeof(unsigned) * (size_t)n_postings;
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+    int fd = -1;
+    unsigned char *out = MAP_FAILED;
+    if (!failed) {
+        fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, (off_t)file_size) != 0) failed = 1;
+    }
+    if (!failed) {
+        out = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (out == MAP_FAILED) failed = 1;
+    }
+
+    if (!failed) {
+        memcpy(out, &h, sizeof(h));
+
+        TrigramDoc *docs = (TrigramDoc *)(out + h.offset_docs);
+        for (long d = 0; d < c.n; d++) {
+            docs[d].csv_offset = c.refs[d].csv_offset;
+            docs[d].title_offset = c.refs[d].key_pos;
+            docs[d].title_len = c.refs[d].key_len;
+            docs[d].pad = 0;
+        }
+        memcpy(out + h.offset_titles, c.keys, c.keys_len);
+
+        // Tabla de trigramas; count pasa a ser la próxima posición de cada lista
+        TrigramDisk *table = (TrigramDisk *)(out + h.offset_table);
+        unsigned pos = 0;
+        long t = 0;
+        for (unsigned g = 0; g < TRIGRAM_SPACE; g++) {
+            if (!count[g]) continue;
+            table[t].trigram = g;
+            table[t].count = count[g];
+            table[t].first = pos;
+            t++;
+            unsigned n = count[g];
+            count[g] = pos;
+            pos += n;
+        }
+
+        // --- Pasada 2: listas en orden de documento (quedan crecientes) ---
+        unsigned *postings = (unsigned *)(out + h.offset_postings);
+        for (long d = 0; d < c.n; d++) {
+            long k = text_trigrams(c.keys + c.refs[d].key_pos, c.refs[d].key_len, tri);
+            for (long i = 0; i < k; i++) postings[count[tri[i]]++] = (unsigned)d;
+        }
+        if (munmap(out, file_size) != 0) failed = 1;
+    }
+    if (fd >= 0 && close(fd) != 0) failed = 1;
+    if (!failed && rename(tmp_path, out_path) != 0) failed = 1;
+    if (failed) unlink(tmp_path);
+
+    free(count);
+    free(tri);
+    index_key_list_free(&c);
+
+    if (failed) {
+        fprintf(stderr, "[TRIGRAM] Error construyendo %s\n", out_path);
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("[TRIGRAM] %ld títulos, %ld trigramas, %ld postings, %.3f s\n",
+           h.n_docs, h.n_trigrams, h.n_postings,
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    return 0;
+}
+
+// --- Apertura ---
+
+int trigram_open(TrigramIndex *t, const char *path) {
+    memset(t, 0, sizeof(*t));
+    if (fmap_open(&t->map, path) != 0) return -1;
+
+    const TrigramHeader *h = (const TrigramHeader *)t->map.base;
+    size_t size = t->map.size;
+    if (size < sizeof(TrigramHeader) || h->magic != TRIGRAM_MAGIC || h->version != TRIGRAM_VERSION ||
+        h->n_docs < 0 || h->n_trigrams < 0 || h->n_postings < 0 ||
+        h->offset_titles != h->offset_docs + (long)sizeof(TrigramDoc) * h->n_docs ||
+        h->offset_table < h->offset_titles ||
+        h->offset_postings != h->offset_table + (long)sizeof(TrigramDisk) * h->n_trigrams ||
+        (size_t)h->offset_postings + sizeof(unsigned) * (size_t)h->n_postings > size) {
+        fmap_close(&t->map);
+        return -1;
+    }
+    t->h = *h;
+    t->docs = (const TrigramDoc *)(t->map.base + h->offset_docs);
+    t->titles = (const char *)(t->map.base + h->offset_titles);
+    t->table = (const TrigramDisk *)(t->map.base + h->offset_table);
+    t->postings = (const unsigned *)(t->map.base + h->offset_postings);
+    return 0;
+}
+
+void trigram_close(TrigramIndex *t) {
+    fmap_close(&t->map);
+    for (long i = 0; i < t->tail_n; i++) free(t->tail_title[i]);
+    free(t->tail_title);
+    free(t->tail_csv);
+    memset(t, 0, sizeof(*t));
+    t->map.fd = -1;
+}
+
+// Registro agregado al CSV después de construir trigram.bin.
+int trigram_add(TrigramIndex *t, const char *title, long csv_offset) {
+    if (t->tail_n == t->tail_cap) {
+        long ncap = t->tail_cap ? t->tail_cap * 2 : 64;
+        long *nc = realloc(t->tail_csv, sizeof(long) * ncap);
+        if (!nc) return -1;
+        t->tail_csv = nc;
+        char **nt = realloc(t->tail_title, sizeof(char *) * ncap);
+        if (!nt) return -1;
+        t->tail_title = nt;
+        t->tail_cap = ncap;
+    }
+    size_t len = strlen(title);
+    char *s = malloc(len + 1);
+    if (!s) return -1;
+    lower_copy(s, title, len);
+    s[len] = '\0';
+    t->tail_title[t->tail_n] = s;
+    t->tail_csv[t->tail_n] = csv_offset;
+    t->tail_n++;
+    return 0;
+}
+
+// --- Búsqueda ---
+
+static int disk_cmp(const void *key, const void *elem) {
+    unsigned k = *(const unsigned *)key, g = ((const TrigramDisk *)elem)->trigram;
+    return (k > g) - (k < g);
+}
+
+// Deja en cand los valores que también están en list. Como cand suele ser
+// mucho más corta, se avanza en list galopando (saltos de 1, 2, 4...) y se
+// termina con búsqueda binaria.
+static long intersect(unsigned *cand, long nc, const unsigned *list, long nl) {
+    long out = 0, j = 0;
+    for (long i = 0; i < nc && j < nl; i++) {
+        unsigned v = cand[i];
+        if (list[j] < v) {
+            long lo = j, hi = j + 1, step = 1;     // list[lo] < v
+            while (hi < nl && list[hi] < v) {
+                lo = hi;
+                step <<= 1;
+                hi = lo + step;
+            }
+            if (hi > nl) hi = nl;
+            while (hi - lo > 1) {
+                long mid = lo + (hi - lo) / 2;
+                if (list[mid] < v) lo = mid;
+                else hi = mid;
+            }
+            j = hi;
+        }
+        if (j < nl && list[j] == v) cand[out++] = v;
+    }
+    return out;
+}
+
+// Devuelve cuántas coincidencias se entregaron a fn (-1 si hubo error).
+long trigram_search(const TrigramIndex *t, const char *query, TrigramMatchFn fn, void *arg) {
+    char q[INDEX_KEY_MAX];
+    size_t qlen = strlen(query);
+    if (qlen >= sizeof(q)) return 0;    // más larga que cualquier título
+    lower_copy(q, query, qlen);
+
+    long found = 0;
+    int stop = 0;
+
+    if (t->docs && qlen < 3) {
+        // Sin trigramas: se recorre el heap de títulos (memoria contigua)
+        for (long d = 0; !stop && d < t->h.n_docs; d++) {
+            const TrigramDoc *doc = &t->docs[d];
+            if (memmem(t->titles + doc->title_offset, doc->title_len, q, qlen)) {
+                found++;
+                stop = fn(doc->csv_offset, arg) != 0;
+            }
+        }
+    } else if (t->docs) {
+        unsigned tri[INDEX_KEY_MAX];
+        long nt = text_trigrams(q, qlen, tri);
+        const TrigramDisk *lists[INDEX_KEY_MAX];
+        int missing = 0;
+        for (long i = 0; i < nt && !missing; i++) {
+            lists[i] = bsearch(&tri[i], t->table, t->h.n_trigrams, sizeof(TrigramDisk), disk_cmp);
+            if (!lists[i]) missing = 1;
+        }
+
+        if (!missing) {
+            // De la lista más corta a la más larga
+            for (long i = 1; i < nt; i++) {
+                const TrigramDisk *x = lists[i];
+                long j = i;
+                while (j > 0 && lists[j - 1]->count > x->count) { lists[j] = lists[j - 1]; j--; }
+                lists[j] = x;
+            }
+
+            long nc = lists[0]->count;
+            unsigned *cand = malloc(sizeof(unsigned) * (nc > 0 ? nc : 1));
+            if (!cand) return -1;
+            memcpy(cand, t->postings + lists[0]->first, sizeof(unsigned) * nc);
+            for (long i = 1; i < nt && nc > 0; i++)
+                nc = intersect(cand, nc, t->postings + lists[i]->first, lists[i]->count);
+
+            // Tener todos los trigramas no alcanza: se verifica la subcadena
+            for (long i = 0; !stop && i < nc; i++) {
+                const TrigramDoc *doc = &t->docs[cand[i]];
+                if (memmem(t->titles + doc->title_offset, doc->title_len, q, qlen)) {
+                    found++;
+                    stop = fn(doc->csv_offset, arg) != 0;
+                }
+            }
+            free(cand);
+        }
+    }
+
+    // Lo insertado después de construir el índice va al final del CSV
+    for (long i = 0; !stop && i < t->tail_n; i++) {
+        if (memmem(t->tail_title[i], strlen(t->tail_title[i]), q, qlen)) {
+            found++;
+            stop = fn(t->tail_csv[i], arg) != 0;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,70 @@
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include "fmap.h"
+
+#define TRIGRAM_FILE "trigram.bin"
+#define TRIGRAM_MAGIC 0x33475254u   /* "TRG3" */
+#define TRIGRAM_VERSION 1
+
+/* Índice invertido de trigramas sobre los títulos (en minúsculas).
+   Cada título es un documento; los documentos están ordenados por offset
+   en el CSV, así que su número es también el orden en el archivo.
+
+   Disposición de trigram.bin:
+     TrigramHeader
+     TrigramDoc[n_docs]          offset en el CSV y título de cada documento
+     heap de títulos             en minúsculas, sin '\0'
+     TrigramDisk[n_trigrams]     ordenado por trigrama
+     unsigned[n_postings]        listas de documentos, cada una creciente */
+typedef struct {
+    unsigned int magic;
+    int version;
+    long n_docs;
+    long n_trigrams;
+    long n_postings;
+    long csv_end;           /* tamaño del CSV cubierto al construir */
+    long offset_docs;
+    long offset_titles;
+    long offset_table;
+    long offset_postings;
+} TrigramHeader;
+
+typedef struct {
+    long csv_offset;
+    long title_offset;      /* relativo al heap de títulos */
+    unsigned int title_len;
+    unsigned int pad;
+} TrigramDoc;
+
+typedef struct {
+    unsigned int trigram;   /* (b0 << 16) | (b1 << 8) | b2 */
+    unsigned int count;
+    long first;             /* posición de la lista en el arreglo de postings */
+} TrigramDisk;
+
+/* Índice abierto: el archivo mapeado más una cola en memoria con lo
+   insertado después de construirlo (se integra en la próxima construcción). */
+typedef struct {
+    FileMap map;
+    TrigramHeader h;
+    const TrigramDoc *docs;
+    const char *titles;
+    const TrigramDisk *table;
+    const unsigned int *postings;
+
+    long tail_n, tail_cap;
+    long *tail_csv;
+    char **tail_title;      /* en minúsculas */
+} TrigramIndex;
+
+/* Se llama con cada coincidencia, en orden del CSV; devolver != 0 corta la búsqueda. */
+typedef int (*TrigramMatchFn)(long csv_offset, void *arg);
+
+int  trigram_build(const char *index_path, const char *out_path, long csv_end);
+int  trigram_open(TrigramIndex *t, const char *path);
+void trigram_close(TrigramIndex *t);
+int  trigram_add(TrigramIndex *t, const char *title, long csv_offset);
+long trigram_search(const TrigramIndex *t, const char *query, TrigramMatchFn fn, void *arg);
+
+#endif
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "wal.h"
+
+// FNV-1a de 32 bits sobre el offset y la línea.
+static unsigned int record_sum(long csv_offset, const char *data, size_t len) {
+    unsigned int h = 2166136261u;
+    const unsigned char *p = (const unsigned char *)&csv_offset;
+    for (size_t i = 0; i < sizeof(csv_offset); i++) h = (h ^ p[i]) * 16777619u;
+    p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+// Abre (o crea vacío) el log. Devuelve -1 si no se puede o si el archivo
+// no es un log de este formato (no se pisa).
+int wal_open(Wal *w, const char *path, WalBatchFn fn, void *arg) {
+    memset(w, 0, sizeof(*w));
+    w->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (w->fd < 0) return -1;
+    w->size = (long)lseek(w->fd, 0, SEEK_END);
+
+    WalHeader h = { WAL_MAGIC, WAL_VERSION };
+    if (w->size == 0) {
+        if (pwrite(w->fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || fsync(w->fd) != 0) goto fail;
+        w->size = sizeof(h);
+    } else {
+        WalHeader got;
+        if (pread(w->fd, &got, sizeof(got), 0) != (ssize_t)sizeof(got) ||
+            got.magic != WAL_MAGIC || got.version != WAL_VERSION) {
+            errno = EINVAL;
+            goto fail;
+        }
+    }
+    w->fn = fn;
+    w->arg = arg;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->done, NULL);
+    return 0;
+
+fail:
+    close(w->fd);
+    w->fd = -1;
+    return -1;
+}
+
+// Recorre los registros del log en orden y llama a fn con cada uno (data
+// terminada en '\0'); si fn devuelve distinto de 0 se detiene. El primer
+// registro incompleto o que no coincide con su suma es lo que quedó a
+// medio escribir en una caída: se corta el log ahí. Devuelve cuántos
+// registros pasó a fn, o -1 si falla la lectura.
+int wal_replay(Wal *w, int (*fn)(const WalRecord *r, void *arg), void *arg) {
+    long at = sizeof(WalHeader);
+    char *buf = NULL;
+    size_t cap = 0;
+    int n = 0, torn = 0;
+
+    while (at < w->size) {
+        WalRecordHead rh;
+        if (w->size - at < (long)sizeof(rh) ||
+            pread(w->fd, &rh, sizeof(rh), at) != (ssize_t)sizeof(rh) ||
+            rh.len == 0 || rh.len > WAL_MAX_RECORD ||
+            w->size - at - (long)sizeof(rh) < (long)rh.len) {
+            torn = 1;
+            break;
+        }
+        if (rh.len + 1 > cap) {
+            char *nb = realloc(buf, rh.len + 1);
+            if (!nb) { n = -1; break; }
+            buf = nb;
+            cap = rh.len + 1;
+        }
+        if (pread(w->fd, buf, rh.len, at + (long)sizeof(rh)) != (ssize_t)rh.len) { n = -1; break; }
+        if (record_sum(rh.csv_offset, buf, rh.len) != rh.sum) {
+            torn = 1;
+            break;
+        }
+        buf[rh.len] = '\0';
+
+        WalRecord r = { .csv_offset = rh.csv_offset, .data = buf, .len = rh.len };
+        n++;
+        at += (long)sizeof(rh) + (long)rh.len;
+        if (fn(&r, arg)) break;
+    }
+    free(buf);
+
+    if (torn) {
+        fprintf(stderr, "[WAL] Descartando %ld bytes incompletos al final del log\n", w->size - at);
+        if (wal_truncate(w, at) != 0) perror("[WAL] ftruncate");
+    }
+    return n;
+}
+
+// Escribe los registros del lote al final del log con un solo write y un
+// solo fdatasync. Si falla, el log vuelve a como estaba.
+int wal_write(Wal *w, WalRecord *batch) {
+    size_t total = 0;
+    for (WalRecord *r = batch; r; r = r->next) total += sizeof(WalRecordHead) + r->len;
+    char *buf = malloc(total);
+    if (!buf) return -1;
+
+    size_t pos = 0;
+    for (WalRecord *r = batch; r; r = r->next) {
+        WalRecordHead rh = { (unsigned int)r->len, record_sum(r->csv_offset, r->data, r->len), r->csv_offset };
+        memcpy(buf + pos, &rh, sizeof(rh));
+        memcpy(buf + pos + sizeof(rh), r->data, r->len);
+        pos += sizeof(rh) + r->len;
+    }
+
+    struct timespec t0, t1;
+    ssize_t wrote = pwrite(w->fd, buf, total, w->size);
+    free(buf);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int failed = wrote != (ssize_t)total || fdatasync(w->fd) != 0;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (failed) {
+        int saved = errno;
+        if (ftruncate(w->fd, w->size) != 0) perror("[WAL] ftruncate");
+        errno = saved;
+        return -1;
+    }
+    pthread_mutex_lock(&w->lock);
+    w->size += (long)total;
+    w->sync_secs += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+// Agrega r al próximo lote y espera a que quede escrito y aplicado.
+// Devuelve r->status.
+int wal_commit(Wal *w, WalRecord *r) {
+    r->status = -1;
+    r->done = 0;
+    r->next = NULL;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->pending_tail) w->pending_tail->next = r;
+    else w->pending_head = r;
+    w->pending_tail = r;
+
+    while (!r->done) {
+        if (w->writing) {
+            pthread_cond_wait(&w->done, &w->lock);
+            continue;
+        }
+        // Líder: se lleva todo lo pendiente (incluido r)
+        WalRecord *batch = w->pending_head;
+        w->pending_head = w->pending_tail = NULL;
+        w->writing = 1;
+        pthread_mutex_unlock(&w->lock);
+
+        w->fn(batch, w->arg);
+
+        pthread_mutex_lock(&w->lock);
+        long n = 0;
+        for (WalRecord *b = batch, *next; b; b = next) {
+            next = b->next;     // después de done el hilo de b puede liberarlo
+            b->done = 1;
+            n++;
+        }
+        w->batches++;
+        w->records += n;
+        if (n > w->batch_max) w->batch_max = n;
+        w->writing = 0;
+        pthread_cond_broadcast(&w->done);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return r->status;
+}
+
+// Deja el log en size bytes (lo escrito después se descarta).
+int wal_truncate(Wal *w, long size) {
+    if (ftruncate(w->fd, size) != 0 || fsync(w->fd) != 0) return -1;
+    pthread_mutex_lock(&w->lock);
+    w->size = size;
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+// Vacía el log: lo que tenía ya está en disco en el CSV y los índices.
+int wal_reset(Wal *w) {
+    return wal_truncate(w, sizeof(WalHeader));
+}
+
+void wal_stats(Wal *w, WalStats *s) {
+    pthread_mutex_lock(&w->lock);
+    s->batches = w->batches;
+    s->records = w->records;
+    s->batch_max = w->batch_max;
+    s->size = w->size;
+    s->sync_secs = w->sync_secs;
+    pthread_mutex_unlock(&w->lock);
+}
+
+void wal_close(Wal *w) {
+    if (w->fd >= 0) {
+        close(w->fd);
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->done);
+    }
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+}
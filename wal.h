@@ -0,0 +1,85 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define WAL_FILE "inserts.wal"
+#define WAL_MAGIC 0x4c415750u       /* "PWAL" */
+#define WAL_VERSION 1
+#define WAL_MAX_RECORD (16u << 20)  /* un registro más largo se toma como basura (fin del log) */
+#define WAL_CHECKPOINT_BYTES (4L << 20)  /* con más log que esto se hace un checkpoint */
+
+/* Log de escritura anticipada (write-ahead log) de las inserciones.
+   Cada registro nuevo se escribe primero acá y recién cuando el log está
+   en disco (fdatasync) se agrega al CSV y a los índices, que ya no se
+   sincronizan uno por uno. Si el servidor se cae en el medio, al arrancar
+   se vuelven a aplicar los registros del log (wal_replay): cada uno lleva
+   su offset en el CSV, así que aplicar dos veces el mismo no cambia nada.
+
+   Commit en grupo: las inserciones que llegan mientras se está escribiendo
+   un lote esperan juntas en pending. El primer hilo que encuentra el log
+   libre (el líder) se lleva todo lo pendiente y llama a fn, que lo escribe
+   con wal_write (un solo fdatasync para todo el lote) y lo aplica; después
+   despierta a los demás. n inserciones concurrentes cuestan un fsync, no n.
+
+   Checkpoint: cuando el log crece, quien lo usa sincroniza el CSV y los
+   índices y lo vacía con wal_reset.
+
+   Disposición del archivo:
+     WalHeader
+     por registro: WalRecordHead + len bytes (la línea del CSV, con su '\n') */
+typedef struct {
+    unsigned int magic;
+    int version;
+} WalHeader;
+
+typedef struct {
+    unsigned int len;
+    unsigned int sum;           /* de csv_offset y la línea: un registro a medio escribir no coincide */
+    long csv_offset;
+} WalRecordHead;
+
+typedef struct WalRecord WalRecord;
+
+struct WalRecord {
+    long csv_offset;            /* lo asigna fn al armar el lote */
+    const char *data;
+    size_t len;
+    int status;                 /* 0 si quedó en el log y aplicado (lo pone fn) */
+    int done;
+    WalRecord *next;            /* en pending o en el lote */
+};
+
+/* Escribe el lote (lista por next) con wal_write y lo aplica. La llama el
+   líder, de a un lote por vez y sin el lock del log. */
+typedef void (*WalBatchFn)(WalRecord *batch, void *arg);
+
+typedef struct {
+    int fd;
+    long size;                  /* bytes del archivo */
+    pthread_mutex_t lock;       /* protege pending, writing y los contadores */
+    pthread_cond_t done;
+    WalRecord *pending_head, *pending_tail;
+    int writing;                /* hay un líder con un lote */
+    WalBatchFn fn;
+    void *arg;
+    long batches, records, batch_max;
+    double sync_secs;
+} Wal;
+
+typedef struct {
+    long batches, records, batch_max, size;
+    double sync_secs;           /* total en fdatasync */
+} WalStats;
+
+int  wal_open(Wal *w, const char *path, WalBatchFn fn, void *arg);
+int  wal_replay(Wal *w, int (*fn)(const WalRecord *r, void *arg), void *arg);
+int  wal_commit(Wal *w, WalRecord *r);
+int  wal_write(Wal *w, WalRecord *batch);
+int  wal_truncate(Wal *w, long size);
+int  wal_reset(Wal *w);
+void wal_stats(Wal *w, WalStats *s);
+void wal_close(Wal *w);
+
+#endif
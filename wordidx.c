@@ -0,0 +1,548 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "index.h"
+#include "hash.h"
+#include "wordidx.h"
+
+// --- Palabras ---
+
+static int is_word_byte(unsigned char c) {
+    return isalnum(c) || c >= 0x80;
+}
+
+// Copia en out (en minúsculas, terminada en '\0') la próxima palabra de
+// s a partir de *i y deja *i después de ella. Devuelve su largo (0 si no hay más).
+size_t wordidx_next_word(const char *s, size_t len, size_t *i, char *out) {
+    size_t p = *i;
+    while (p < len && s[p] && !is_word_byte((unsigned char)s[p])) p++;
+    size_t n = 0;
+    while (p < len && s[p] && is_word_byte((unsigned char)s[p])) {
+        if (n < WORD_MAX) out[n++] = (char)tolower((unsigned char)s[p]);
+        p++;
+    }
+    out[n] = '\0';
+    *i = p;
+    return n;
+}
+
+// --- Construcción ---
+
+void wordidx_builder_init(WordBuilder *b, int with_tf) {
+    memset(b, 0, sizeof(*b));
+    b->with_tf = with_tf;
+}
+
+void wordidx_builder_free(WordBuilder *b) {
+    for (long i = 0; i < b->n_words; i++) postings_free(&b->lists[i]);
+    free(b->heap);
+    free(b->word_pos);
+    free(b->lists);
+    free(b->doc_tf);
+    free(b->table);
+    free(b->touched);
+    free(b->csv_offsets);
+    free(b->lengths);
+    memset(b, 0, sizeof(*b));
+}
+
+static int builder_rehash(WordBuilder *b, long cap) {
+    long *nt = calloc(cap, sizeof(long));
+    if (!nt) return -1;
+    for (long id = 0; id < b->n_words; id++) {
+        unsigned long s = hash_string(b->heap + b->word_pos[id]) & (cap - 1);
+        while (nt[s]) s = (s + 1) & (cap - 1);
+        nt[s] = id + 1;
+    }
+    free(b->table);
+    b->table = nt;
+    b->table_cap = cap;
+    return 0;
+}
+
+// Número de la palabra w (la agrega al diccionario si es nueva).
+static long builder_word_id(WordBuilder *b, const char *w, size_t len) {
+    if ((b->n_words + 1) * 2 > b->table_cap &&
+        builder_rehash(b, b->table_cap ? b->table_cap * 2 : 1 << 16) != 0) return -1;
+
+    unsigned long s = hash_string(w) & (b->table_cap - 1);
+    while (b->table[s]) {
+        long id = b->table[s] - 1;
+        if (strcmp(b->heap + b->word_pos[id], w) == 0) return id;
+        s = (s + 1) & (b->table_cap - 1);
+    }
+
+    if (b->n_words == b->words_cap) {
+        long ncap = b->words_cap ? b->words_cap * 2 : 1 << 14;
+        long *np = realloc(b->word_pos, sizeof(long) * ncap);
+        if (!np) return -1;
+        b->word_pos = np;
+        PostingWriter *nl = realloc(b->lists, sizeof(PostingWriter) * ncap);
+        if (!nl) return -1;
+        b->lists = nl;
+        unsigned *nf = realloc(b->doc_tf, sizeof(unsigned) * ncap);
+        if (!nf) return -1;
+        b->doc_tf = nf;
+        b->words_cap = ncap;
+    }
+    if (b->heap_len + len + 1 > b->heap_cap) {
+        size_t ncap = b->heap_cap ? b->heap_cap * 2 : 1 << 20;
+        char *nh = realloc(b->heap, ncap);
+        if (!nh) return -1;
+        b->heap = nh;
+        b->heap_cap = ncap;
+    }
+    long id = b->n_words++;
+    memcpy(b->heap + b->heap_len, w, len + 1);
+    b->word_pos[id] = (long)b->heap_len;
+    b->heap_len += len + 1;
+    memset(&b->lists[id], 0, sizeof(PostingWriter));
+    b->doc_tf[id] = 0;
+    b->table[s] = id + 1;
+    return id;
+}
+
+// Agrega el siguiente documento (el número es el orden de llegada).
+int wordidx_builder_add(WordBuilder *b, long csv_offset, const char *text, size_t len) {
+    if (b->n_docs == b->docs_cap) {
+        long ncap = b->docs_cap ? b->docs_cap * 2 : 1 << 16;
+        long *no = realloc(b->csv_offsets, sizeof(long) * ncap);
+        if (!no) return -1;
+        b->csv_offsets = no;
+        unsigned *nl = realloc(b->lengths, sizeof(unsigned) * ncap);
+        if (!nl) return -1;
+        b->lengths = nl;
+        b->docs_cap = ncap;
+    }
+    unsigned doc = (unsigned)b->n_docs;
+    b->csv_offsets[b->n_docs] = csv_offset;
+    b->lengths[b->n_docs] = 0;
+    b->n_docs++;
+
+    char w[WORD_MAX + 1];
+    size_t i = 0, wl;
+    b->n_touched = 0;
+    while ((wl = wordidx_next_word(text, len, &i, w)) > 0) {
+        b->lengths[doc]++;
+        b->total_words++;
+        long id = builder_word_id(b, w, wl);
+        if (id < 0) return -1;
+        if (b->doc_tf[id]++ > 0) continue;
+        if (b->n_touched == b->touched_cap) {
+            long ncap = b->touched_cap ? b->touched_cap * 2 : 256;
+            long *nt = realloc(b->touched, sizeof(long) * ncap);
+            if (!nt) return -1;
+            b->touched = nt;
+            b->touched_cap = ncap;
+        }
+        b->touched[b->n_touched++] = id;
+    }
+
+    for (long k = 0; k < b->n_touched; k++) {
+        long id = b->touched[k];
+        if (postings_add(&b->lists[id], doc, b->with_tf, b->doc_tf[id]) != 0) return -1;
+        b->doc_tf[id] = 0;
+    }
+    return 0;
+}
+
+typedef struct {
+    const char *word;
+    long id;
+} WordRef;
+
+static int word_ref_cmp(const void *a, const void *b) {
+    return strcmp(((const WordRef *)a)->word, ((const WordRef *)b)->word);
+}
+
+static size_t align4(size_t n) { return (n + 3) & ~(size_t)3; }
+
+// Parte de BM25 que depende del documento (sin el idf).
+double wordidx_bm25_weight(unsigned int tf, unsigned int doc_len, double avg_len) {
+    double norm = BM25_K1 * (1.0 - BM25_B + BM25_B * doc_len / avg_len);
+    return tf * (BM25_K1 + 1.0) / (tf + norm);
+}
+
+// Cota superior de lo que la lista puede aportar a un documento: permite
+// descartar documentos sin terminar de puntuarlos (max-score).
+static float list_max_weight(const WordBuilder *b, const PostingWriter *pw, double avg_len) {
+    PostingCursor c;
+    postings_open_writer(&c, pw, 1);
+    double best = 0.0;
+    while (postings_next(&c)) {
+        double wgt = wordidx_bm25_weight(c.tf, b->lengths[c.doc], avg_len);
+        if (wgt > best) best = wgt;
+    }
+    return (float)(best * 1.000001);   // redondeo hacia arriba: sigue siendo cota
+}
+
+int wordidx_builder_write(WordBuilder *b, const char *out_path, long csv_end) {
+    WordRef *order = malloc(sizeof(WordRef) * (b->n_words > 0 ? b->n_words : 1));
+    WordDisk *disk = malloc(sizeof(WordDisk) * (b->n_words > 0 ? b->n_words : 1));
+    if (!order || !disk) { free(order); free(disk); return -1; }
+
+    for (long id = 0; id < b->n_words; id++) {
+        order[id].word = b->heap + b->word_pos[id];
+        order[id].id = id;
+    }
+    qsort(order, b->n_words, sizeof(WordRef), word_ref_cmp);
+
+    // --- Disposición: palabras en orden y listas una detrás de otra ---
+    double avg_len = b->n_docs > 0 ? (double)b->total_words / b->n_docs : 1.0;
+    if (avg_len <= 0.0) avg_len = 1.0;
+    long heap_bytes = 0, list_bytes = 0;
+    for (long k = 0; k < b->n_words; k++) {
+        const PostingWriter *pw = &b->lists[order[k].id];
+        WordDisk *d = &disk[k];
+        memset(d, 0, sizeof(*d));
+        d->word_offset = heap_bytes;
+        d->word_len = (unsigned)strlen(order[k].word);
+        d->count = (unsigned)pw->count;
+        d->n_skips = (unsigned)pw->n_skips;
+        d->max_weight = b->with_tf ? list_max_weight(b, pw, avg_len) : 0.0f;
+        d->offset = list_bytes;
+        d->bytes = (long)pw->len;
+        heap_bytes += d->word_len;
+        list_bytes += (long)align4(postings_size(pw));
+    }
+
+    WordIndexHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = WORDS_MAGIC;
+    h.version = WORDS_VERSION;
+    h.with_tf = b->with_tf;
+    h.n_docs = b->n_docs;
+    h.n_words = b->n_words;
+    h.csv_end = csv_end;
+    h.total_words = b->total_words;
+    h.offset_docs = sizeof(WordIndexHeader);
+    h.offset_lengths = h.offset_docs + (long)sizeof(long) * b->n_docs;
+    h.offset_words = (h.offset_lengths + (long)sizeof(unsigned) * b->n_docs + 7) & ~7L;
+    h.offset_heap = h.offset_words + (long)sizeof(WordDisk) * b->n_words;
+    h.offset_postings = (h.offset_heap + heap_bytes + 7) & ~7L;
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+    FILE *out = fopen(tmp_path, "wb");
+    int failed = !out;
+    if (!failed) {
+        static const char zeros[8] = {0};
+        failed |= fwrite(&h, sizeof(h), 1, out) != 1;
+        failed |= fwrite(b->csv_offsets, sizeof(long), b->n_docs, out) != (size_t)b->n_docs;
+        failed |= fwrite(b->lengths, sizeof(unsigned), b->n_docs, out) != (size_t)b->n_docs;
+        long lpad = h.offset_words - (h.offset_lengths + (long)sizeof(unsigned) * b->n_docs);
+        failed |= fwrite(zeros, 1, lpad, out) != (size_t)lpad;
+        failed |= fwrite(disk, sizeof(WordDisk), b->n_words, out) != (size_t)b->n_words;
+        for (long k = 0; !failed && k < b->n_words; k++)
+            failed |= fwrite(order[k].word, 1, disk[k].word_len, out) != disk[k].word_len;
+        long pad = h.offset_postings - (h.offset_heap + heap_bytes);
+        failed |= fwrite(zeros, 1, pad, out) != (size_t)pad;
+
+        unsigned char *buf = NULL;
+        size_t buf_cap = 0;
+        for (long k = 0; !failed && k < b->n_words; k++) {
+            const PostingWriter *pw = &b->lists[order[k].id];
+            size_t n = align4(postings_size(pw));
+            if (n > buf_cap) {
+                unsigned char *nb = realloc(buf, n);
+                if (!nb) { failed = 1; break; }
+                buf = nb;
+                buf_cap = n;
+            }
+            memset(buf, 0, n);
+            postings_write(pw, buf);
+            failed |= fwrite(buf, 1, n, out) != n;
+        }
+        free(buf);
+        if (fclose(out) != 0) failed = 1;
+    }
+    if (!failed && rename(tmp_path, out_path) != 0) failed = 1;
+    if (failed) remove(tmp_path);
+
+    free(order);
+    free(disk);
+    return failed ? -1 : 0;
+}
+
+// words.bin sobre los títulos de index.bin, en orden del CSV.
+int wordidx_build(const char *index_path, const char *out_path, long csv_end) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    IndexKeyList keys;
+    if (index_collect_keys(index_path, &keys) != 0) return -1;
+
+    WordBuilder b;
+    wordidx_builder_init(&b, 0);
+    int failed = 0;
+    for (long d = 0; !failed && d < keys.n; d++) {
+        const IndexKeyRef *r = &keys.refs[d];
+        failed = wordidx_builder_add(&b, r->csv_offset, keys.keys + r->key_pos, r->key_len) != 0;
+    }
+    if (!failed) failed = wordidx_builder_write(&b, out_path, csv_end) != 0;
+
+    long n_docs = b.n_docs, n_words = b.n_words;
+    wordidx_builder_free(&b);
+    index_key_list_free(&keys);
+
+    if (failed) {
+        fprintf(stderr, "[WORDS] Error construyendo %s\n", out_path);
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("[WORDS] %ld títulos, %ld palabras, %.3f s\n", n_docs, n_words,
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    return 0;
+}
+
+// --- Apertura ---
+
+int wordidx_open(WordIndex *w, const char *path) {
+    memset(w, 0, sizeof(*w));
+    if (fmap_open(&w->map, path) != 0) return -1;
+
+    const WordIndexHeader *h = (const WordIndexHeader *)w->map.base;
+    size_t size = w->map.size;
+    if (size < sizeof(WordIndexHeader) || h->magic != WORDS_MAGIC || h->version != WORDS_VERSION ||
+        h->n_docs < 0 || h->n_words < 0 ||
+        h->offset_lengths != h->offset_docs + (long)sizeof(long) * h->n_docs ||
+        h->offset_words < h->offset_lengths + (long)sizeof(unsigned) * h->n_docs ||
+        h->offset_heap != h->offset_words + (long)sizeof(WordDisk) * h->n_words ||
+        h->offset_postings < h->offset_heap || (size_t)h->offset_postings > size) {
+        fmap_close(&w->map);
+        return -1;
+    }
+    w->h = *h;
+    w->docs = (const long *)(w->map.base + h->offset_docs);
+    w->lengths = (const unsigned *)(w->map.base + h->offset_lengths);
+    w->words = (const WordDisk *)(w->map.base + h->offset_words);
+    w->heap = (const char *)(w->map.base + h->offset_heap);
+    w->postings = w->map.base + h->offset_postings;
+
+    // Verifica que ninguna lista se salga del archivo
+    size_t area = size - (size_t)h->offset_postings;
+    for (long k = 0; k < h->n_words; k++) {
+        const WordDisk *d = &w->words[k];
+        if (d->offset < 0 || d->bytes < 0 ||
+            (size_t)d->offset + sizeof(PostingSkip) * d->n_skips + (size_t)d->bytes > area) {
+            wordidx_close(w);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void wordidx_close(WordIndex *w) {
+    fmap_close(&w->map);
+    for (long i = 0; i < w->tail_n; i++) free(w->tail_text[i]);
+    free(w->tail_text);
+    free(w->tail_csv);
+    memset(w, 0, sizeof(*w));
+    w->map.fd = -1;
+}
+
+// Registro agregado al CSV después de construir el índice.
+int wordidx_add(WordIndex *w, const char *text, long csv_offset) {
+    if (w->tail_n == w->tail_cap) {
+        long ncap = w->tail_cap ? w->tail_cap * 2 : 64;
+        long *nc = realloc(w->tail_csv, sizeof(long) * ncap);
+        if (!nc) return -1;
+        w->tail_csv = nc;
+        char **nt = realloc(w->tail_text, sizeof(char *) * ncap);
+        if (!nt) return -1;
+        w->tail_text = nt;
+        w->tail_cap = ncap;
+    }
+    char *s = strdup(text);
+    if (!s) return -1;
+    w->tail_text[w->tail_n] = s;
+    w->tail_csv[w->tail_n] = csv_offset;
+    w->tail_n++;
+    return 0;
+}
+
+const WordDisk *wordidx_lookup(const WordIndex *w, const char *word, size_t len) {
+    long lo = 0, hi = w->h.n_words;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        const WordDisk *d = &w->words[mid];
+        size_t n = d->word_len < len ? d->word_len : len;
+        int c = memcmp(w->heap + d->word_offset, word, n);
+        if (c == 0) c = (d->word_len > len) - (d->word_len < len);
+        if (c == 0) return d;
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+void wordidx_cursor(const WordIndex *w, const WordDisk *d, PostingCursor *c) {
+    postings_open(c, w->postings + d->offset, d->count, d->n_skips, (size_t)d->bytes, w->h.with_tf);
+}
+
+// --- Consultas booleanas ---
+// "neural AND network NOT graph": AND liga más fuerte que OR y NOT niega
+// el término que le sigue. La consulta queda como un OR de cláusulas, cada
+// una con términos que deben estar y términos que no.
+
+typedef struct {
+    char word[WORD_MAX + 1];
+    size_t len;
+    int clause;
+    int neg;
+} WordTerm;
+
+int wordidx_is_boolean(const char *query) {
+    return strstr(query, " AND ") || strstr(query, " OR ") || strstr(query, " NOT ") ||
+           strncmp(query, "NOT ", 4) == 0;
+}
+
+// Devuelve la cantidad de términos; *n_clauses queda con las cláusulas.
+static int parse_query(const char *q, WordTerm *terms, int *n_clauses) {
+    int n = 0, clause = 0, neg = 0, clause_used = 0;
+    size_t len = strlen(q), p = 0;
+    while (p < len) {
+        while (p < len && isspace((unsigned char)q[p])) p++;
+        size_t start = p;
+        while (p < len && !isspace((unsigned char)q[p])) p++;
+        size_t tl = p - start;
+        if (tl == 0) break;
+
+        if (tl == 3 && memcmp(q + start, "AND", 3) == 0) continue;
+        if (tl == 3 && memcmp(q + start, "NOT", 3) == 0) { neg = 1; continue; }
+        if (tl == 2 && memcmp(q + start, "OR", 2) == 0) {
+            if (clause_used && clause + 1 < WORD_QUERY_TERMS) clause++;
+            clause_used = 0;
+            neg = 0;
+            continue;
+        }
+
+        // Un término con signos ("self-attention") aporta todas sus palabras
+        size_t i = start;
+        WordTerm t;
+        while (n < WORD_QUERY_TERMS && (t.len = wordidx_next_word(q, p, &i, t.word)) > 0) {
+            t.clause = clause;
+            t.neg = neg;
+            terms[n++] = t;
+            clause_used = 1;
+        }
+        neg = 0;
+    }
+    *n_clauses = clause_used ? clause + 1 : clause;
+    return n;
+}
+
+typedef struct {
+    PostingCursor pos[WORD_QUERY_TERMS];
+    PostingCursor neg[WORD_QUERY_TERMS];
+    int n_pos, n_neg;
+    int live;
+    unsigned int doc;
+} WordClause;
+
+// Deja la cláusula en su primer documento >= target. Las listas positivas
+// (de la más corta a la más larga) se persiguen entre sí con avances que
+// usan los saltos; las negativas solo se consultan en los candidatos.
+static void clause_seek(WordClause *c, unsigned int target, long n_docs) {
+    unsigned int doc = target;
+    for (;;) {
+        if ((long)doc >= n_docs) { c->live = 0; return; }
+        int moved = 0;
+        for (int i = 0; i < c->n_pos; i++) {
+            if (!postings_advance(&c->pos[i], doc)) { c->live = 0; return; }
+            if (c->pos[i].doc > doc) { doc = c->pos[i].doc; moved = 1; break; }
+        }
+        if (moved) continue;
+
+        int excluded = 0;
+        for (int i = 0; i < c->n_neg && !excluded; i++)
+            excluded = postings_advance(&c->neg[i], doc) && c->neg[i].doc == doc;
+        if (excluded) { doc++; continue; }
+
+        c->doc = doc;
+        return;
+    }
+}
+
+static int text_has_word(const char *text, const char *word) {
+    char w[WORD_MAX + 1];
+    size_t i = 0, len = strlen(text);
+    while (wordidx_next_word(text, len, &i, w) > 0)
+        if (strcmp(w, word) == 0) return 1;
+    return 0;
+}
+
+// Devuelve cuántos documentos cumplen la consulta (entregados a fn en orden
+// del CSV, hasta que fn devuelva != 0), o -1 si la consulta no tiene términos.
+long wordidx_search(const WordIndex *w, const char *query, WordMatchFn fn, void *arg) {
+    WordTerm terms[WORD_QUERY_TERMS];
+    int n_clauses;
+    int n_terms = parse_query(query, terms, &n_clauses);
+    if (n_terms == 0) return -1;
+
+    WordClause *clauses = calloc(n_clauses, sizeof(WordClause));
+    if (!clauses) return -1;
+
+    for (int k = 0; k < n_clauses; k++) {
+        WordClause *c = &clauses[k];
+        c->live = w->docs != NULL;
+        const WordDisk *pos[WORD_QUERY_TERMS];
+        int np = 0;
+        for (int t = 0; t < n_terms && c->live; t++) {
+            if (terms[t].clause != k) continue;
+            const WordDisk *d = w->docs ? wordidx_lookup(w, terms[t].word, terms[t].len) : NULL;
+            if (terms[t].neg) {
+                if (d) wordidx_cursor(w, d, &c->neg[c->n_neg++]);
+            } else if (!d) {
+                c->live = 0;    // una palabra que no existe: la cláusula no da nada
+            } else {
+                // Ordenadas de la lista más corta a la más larga
+                int j = np++;
+                while (j > 0 && pos[j - 1]->count > d->count) { pos[j] = pos[j - 1]; j--; }
+                pos[j] = d;
+            }
+        }
+        for (int i = 0; i < np; i++) wordidx_cursor(w, pos[i], &c->pos[i]);
+        c->n_pos = np;
+        if (c->live) clause_seek(c, 0, w->h.n_docs);
+    }
+
+    // --- OR: siempre el menor documento entre las cláusulas vivas ---
+    long found = 0;
+    int stop = 0;
+    while (!stop) {
+        int have = 0;
+        unsigned int doc = 0;
+        for (int k = 0; k < n_clauses; k++) {
+            if (clauses[k].live && (!have || clauses[k].doc < doc)) { doc = clauses[k].doc; have = 1; }
+        }
+        if (!have) break;
+        found++;
+        stop = fn(w->docs[doc], arg) != 0;
+        for (int k = 0; k < n_clauses; k++) {
+            if (clauses[k].live && clauses[k].doc == doc) clause_seek(&clauses[k], doc + 1, w->h.n_docs);
+        }
+    }
+    free(clauses);
+
+    // Lo insertado después de construir el índice: se evalúa sobre el texto
+    for (long i = 0; !stop && i < w->tail_n; i++) {
+        int match = 0;
+        for (int k = 0; k < n_clauses && !match; k++) {
+            int ok = 0, seen = 0;
+            for (int t = 0; t < n_terms; t++) {
+                if (terms[t].clause != k) continue;
+                if (!seen) { ok = 1; seen = 1; }
+                if (text_has_word(w->tail_text[i], terms[t].word) == terms[t].neg) { ok = 0; break; }
+            }
+            match = ok;
+        }
+        if (match) {
+            found++;
+            stop = fn(w->tail_csv[i], arg) != 0;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,110 @@
+#ifndef WORDIDX_H
+#define WORDIDX_H
+
+#include "fmap.h"
+#include "postings.h"
+
+#define WORDS_FILE "words.bin"
+#define WORDS_MAGIC 0x53445257u     /* "WRDS" */
+#define WORDS_VERSION 2
+#define WORD_MAX 64                 /* bytes por palabra; lo que sobra se ignora */
+#define WORD_QUERY_TERMS 32         /* términos por consulta */
+
+/* Parámetros de BM25 (el peso máximo de cada lista se calcula con ellos) */
+#define BM25_K1 1.2
+#define BM25_B 0.75
+
+/* Índice invertido de palabras (palabra -> documentos). Una palabra es una
+   secuencia de letras/dígitos ASCII o bytes UTF-8, en minúsculas. Los
+   documentos van en orden del CSV, como en trigram.bin.
+
+   Disposición de words.bin:
+     WordIndexHeader
+     long[n_docs]                offset en el CSV de cada documento
+     unsigned[n_docs]            largo de cada documento en palabras
+     WordDisk[n_words]           ordenado por palabra
+     heap de palabras            sin '\0'
+     listas (ver postings.h)     alineadas a 4 bytes */
+typedef struct {
+    unsigned int magic;
+    int version;
+    int with_tf;            /* las listas llevan la frecuencia en cada documento */
+    int pad;
+    long n_docs;
+    long n_words;
+    long csv_end;           /* tamaño del CSV cubierto al construir */
+    long total_words;       /* suma de los largos (para el largo promedio) */
+    long offset_docs;
+    long offset_lengths;
+    long offset_words;
+    long offset_heap;
+    long offset_postings;
+} WordIndexHeader;
+
+typedef struct {
+    long word_offset;       /* relativo al heap */
+    unsigned int word_len;
+    unsigned int count;     /* documentos en la lista */
+    unsigned int n_skips;
+    float max_weight;       /* con tf: máximo de tf*(k1+1)/(tf+k1*(1-b+b*dl/avgdl)) en la lista */
+    long offset;            /* relativo a offset_postings */
+    long bytes;             /* solo los varint, sin los saltos */
+} WordDisk;
+
+/* Construcción: los documentos se agregan en orden y cada lista se
+   comprime a medida que crece. */
+typedef struct {
+    int with_tf;
+    char *heap;                 /* palabras terminadas en '\0' */
+    size_t heap_len, heap_cap;
+    long *word_pos;
+    PostingWriter *lists;
+    unsigned int *doc_tf;       /* apariciones en el documento actual */
+    long n_words, words_cap;
+    long *table;                /* hash abierto: id + 1, 0 = libre */
+    long table_cap;
+    long *touched;              /* palabras del documento actual */
+    long n_touched, touched_cap;
+    long *csv_offsets;
+    unsigned int *lengths;
+    long n_docs, docs_cap;
+    long total_words;
+} WordBuilder;
+
+/* Índice abierto, más una cola en memoria con lo insertado después */
+typedef struct {
+    FileMap map;
+    WordIndexHeader h;
+    const long *docs;
+    const unsigned int *lengths;
+    const WordDisk *words;
+    const char *heap;
+    const unsigned char *postings;
+
+    long tail_n, tail_cap;
+    long *tail_csv;
+    char **tail_text;
+} WordIndex;
+
+typedef int (*WordMatchFn)(long csv_offset, void *arg);
+
+size_t wordidx_next_word(const char *s, size_t len, size_t *i, char *out);
+
+void wordidx_builder_init(WordBuilder *b, int with_tf);
+int  wordidx_builder_add(WordBuilder *b, long csv_offset, const char *text, size_t len);
+int  wordidx_builder_write(WordBuilder *b, const char *out_path, long csv_end);
+void wordidx_builder_free(WordBuilder *b);
+int  wordidx_build(const char *index_path, const char *out_path, long csv_end);
+
+int  wordidx_open(WordIndex *w, const char *path);
+void wordidx_close(WordIndex *w);
+int  wordidx_add(WordIndex *w, const char *text, long csv_offset);
+const WordDisk *wordidx_lookup(const WordIndex *w, const char *word, size_t len);
+void wordidx_cursor(const WordIndex *w, const WordDisk *d, PostingCursor *c);
+
+double wordidx_bm25_weight(unsigned int tf, unsigned int doc_len, double avg_len);
+
+int  wordidx_is_boolean(const char *query);
+long wordidx_search(const WordIndex *w, const char *query, WordMatchFn fn, void *arg);
+
+#endif